@@ -0,0 +1,252 @@
+"""
+asset_pipeline.py  --  Build-time image conversion for the disk images
+
+PNG assets are decoded here (stdlib only: zlib + struct) and re-encoded as
+QOI (https://qoiformat.org) so the kernel can load them with a single
+linear pass instead of a full inflate. Wallpapers are also pre-scaled to the
+resolutions the two targets actually run at, so the WM can draw them 1:1.
+
+Original PNGs are still shipped; the kernel falls back to them when no
+converted variant matches.
+
+Converted files are cached under temp/assets and only rebuilt when the
+source PNG changes.
+"""
+
+import os
+import struct
+import zlib
+
+CACHE_DIR = os.path.join("temp", "assets")
+
+# Extra pre-scaled variants: source name -> list of (width, height).
+# 1280x800 is the QEMU virtio-gpu default scanout, 1024x768 is what
+# rpi_gpu_init() asks the firmware for.
+PRESCALE = {
+    "wallpaper.png": [(1280, 800), (1024, 768)],
+}
+
+# Convert these at native size as well (small images only: QOI is larger
+# than PNG and the disk is 16 MB).
+NATIVE_QOI_MAX_PIXELS = 1024 * 1024
+
+
+# ── PNG decoding ─────────────────────────────────────────────────────
+
+def _paeth(a, b, c):
+    p = a + b - c
+    pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+    if pa <= pb and pa <= pc:
+        return a
+    return b if pb <= pc else c
+
+
+def decode_png(data):
+    """Return (w, h, rgba_bytes). Supports non-interlaced 8-bit images."""
+    if data[:8] != b"\x89PNG\r\n\x1a\n":
+        raise ValueError("not a PNG")
+    pos = 8
+    idat = bytearray()
+    palette = None
+    trns = None
+    while pos + 8 <= len(data):
+        length, ctype = struct.unpack(">I4s", data[pos:pos + 8])
+        body = data[pos + 8:pos + 8 + length]
+        if ctype == b"IHDR":
+            w, h, depth, color, _, _, interlace = struct.unpack(">IIBBBBB", body)
+        elif ctype == b"PLTE":
+            palette = body
+        elif ctype == b"tRNS":
+            trns = body
+        elif ctype == b"IDAT":
+            idat += body
+        elif ctype == b"IEND":
+            break
+        pos += 12 + length
+
+    if depth != 8 or interlace != 0:
+        raise ValueError("unsupported PNG (depth %d, interlace %d)" % (depth, interlace))
+    channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}[color]
+    stride = w * channels
+    raw = zlib.decompress(bytes(idat))
+
+    rows = []
+    prev = bytearray(stride)
+    bpp = channels
+    for y in range(h):
+        off = y * (stride + 1)
+        ftype = raw[off]
+        line = bytearray(raw[off + 1:off + 1 + stride])
+        if ftype == 1:
+            for i in range(bpp, stride):
+                line[i] = (line[i] + line[i - bpp]) & 0xFF
+        elif ftype == 2:
+            line = bytearray((a + b) & 0xFF for a, b in zip(line, prev))
+        elif ftype == 3:
+            for i in range(stride):
+                left = line[i - bpp] if i >= bpp else 0
+                line[i] = (line[i] + ((left + prev[i]) >> 1)) & 0xFF
+        elif ftype == 4:
+            for i in range(stride):
+                if i >= bpp:
+                    line[i] = (line[i] + _paeth(line[i - bpp], prev[i], prev[i - bpp])) & 0xFF
+                else:
+                    line[i] = (line[i] + prev[i]) & 0xFF
+        rows.append(line)
+        prev = line
+
+    out = bytearray(w * h * 4)
+    for y, line in enumerate(rows):
+        o = y * w * 4
+        if color == 6:
+            out[o:o + w * 4] = line
+        elif color == 2:
+            out[o:o + w * 4:4] = line[0::3]
+            out[o + 1:o + w * 4:4] = line[1::3]
+            out[o + 2:o + w * 4:4] = line[2::3]
+            out[o + 3:o + w * 4:4] = b"\xff" * w
+        elif color == 0:
+            out[o:o + w * 4:4] = line
+            out[o + 1:o + w * 4:4] = line
+            out[o + 2:o + w * 4:4] = line
+            out[o + 3:o + w * 4:4] = b"\xff" * w
+        elif color == 4:
+            out[o:o + w * 4:4] = line[0::2]
+            out[o + 1:o + w * 4:4] = line[0::2]
+            out[o + 2:o + w * 4:4] = line[0::2]
+            out[o + 3:o + w * 4:4] = line[1::2]
+        else:
+            for x, idx in enumerate(line):
+                p = o + x * 4
+                out[p:p + 3] = palette[idx * 3:idx * 3 + 3]
+                out[p + 3] = trns[idx] if trns and idx < len(trns) else 255
+    return w, h, bytes(out)
+
+
+# ── Scaling ──────────────────────────────────────────────────────────
+
+def _spans(src, dst):
+    return [((i * src) // dst, max(((i + 1) * src) // dst, (i * src) // dst + 1)) for i in range(dst)]
+
+
+def scale_box(w, h, rgba, dw, dh):
+    """Area-average RGBA down (or nearest up) to dw x dh."""
+    xs = _spans(w, dw)
+    ys = _spans(h, dh)
+    # Horizontal pass per channel, then vertical, to keep Python loops short
+    tmp = []
+    for y in range(h):
+        row = rgba[y * w * 4:(y + 1) * w * 4]
+        chans = [row[c::4] for c in range(4)]
+        out_row = []
+        for c in range(4):
+            ch = chans[c]
+            out_row.append([sum(ch[x0:x1]) / (x1 - x0) for x0, x1 in xs])
+        tmp.append(out_row)
+    out = bytearray(dw * dh * 4)
+    for y, (y0, y1) in enumerate(ys):
+        n = y1 - y0
+        for c in range(4):
+            cols = [tmp[yy][c] for yy in range(y0, y1)]
+            vals = [int(sum(col[x] for col in cols) / n + 0.5) for x in range(dw)]
+            out[y * dw * 4 + c:(y + 1) * dw * 4:4] = bytes(vals)
+    return bytes(out)
+
+
+# ── QOI encoding ─────────────────────────────────────────────────────
+
+def encode_qoi(w, h, rgba):
+    out = bytearray(struct.pack(">4sIIBB", b"qoif", w, h, 4, 0))
+    index = [(0, 0, 0, 0)] * 64
+    pr, pg, pb, pa = 0, 0, 0, 255
+    run = 0
+    npx = w * h
+    for i in range(npx):
+        r, g, b, a = rgba[i * 4], rgba[i * 4 + 1], rgba[i * 4 + 2], rgba[i * 4 + 3]
+        if (r, g, b, a) == (pr, pg, pb, pa):
+            run += 1
+            if run == 62 or i == npx - 1:
+                out.append(0xC0 | (run - 1))
+                run = 0
+            continue
+        if run:
+            out.append(0xC0 | (run - 1))
+            run = 0
+        h_idx = (r * 3 + g * 5 + b * 7 + a * 11) % 64
+        if index[h_idx] == (r, g, b, a):
+            out.append(h_idx)
+        else:
+            index[h_idx] = (r, g, b, a)
+            if a == pa:
+                dr = ((r - pr + 128) & 0xFF) - 128
+                dg = ((g - pg + 128) & 0xFF) - 128
+                db = ((b - pb + 128) & 0xFF) - 128
+                dr_dg = dr - dg
+                db_dg = db - dg
+                if -2 <= dr <= 1 and -2 <= dg <= 1 and -2 <= db <= 1:
+                    out.append(0x40 | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2))
+                elif -32 <= dg <= 31 and -8 <= dr_dg <= 7 and -8 <= db_dg <= 7:
+                    out.append(0x80 | (dg + 32))
+                    out.append(((dr_dg + 8) << 4) | (db_dg + 8))
+                else:
+                    out += bytes((0xFE, r, g, b))
+            else:
+                out += bytes((0xFF, r, g, b, a))
+        pr, pg, pb, pa = r, g, b, a
+    out += b"\x00" * 7 + b"\x01"
+    return bytes(out)
+
+
+# ── Pipeline ─────────────────────────────────────────────────────────
+
+def _cached(src_path, out_name, build):
+    os.makedirs(CACHE_DIR, exist_ok=True)
+    cpath = os.path.join(CACHE_DIR, out_name)
+    if os.path.exists(cpath) and os.path.getmtime(cpath) >= os.path.getmtime(src_path):
+        with open(cpath, "rb") as f:
+            return f.read()
+    data = build()
+    with open(cpath, "wb") as f:
+        f.write(data)
+    return data
+
+
+def convert_asset(fname, fpath, content):
+    """Yield (name, bytes) for the file itself plus any converted variants."""
+    yield fname, content
+    if not fname.lower().endswith(".png"):
+        return
+    base = fname[:-4]
+    decoded = []
+
+    def rgba():
+        if not decoded:
+            decoded.append(decode_png(content))
+        return decoded[0]
+
+    try:
+        w, h = struct.unpack(">II", content[16:24])
+        if w * h <= NATIVE_QOI_MAX_PIXELS:
+            yield base + ".qoi", _cached(fpath, base + ".qoi",
+                                         lambda: encode_qoi(*rgba()))
+        for dw, dh in PRESCALE.get(fname, []):
+            name = "%s_%dx%d.qoi" % (base, dw, dh)
+            yield name, _cached(fpath, name,
+                                lambda dw=dw, dh=dh: encode_qoi(dw, dh, scale_box(*rgba(), dw, dh)))
+    except (ValueError, KeyError, struct.error) as e:
+        print(f"    Warning: could not convert {fname}: {e}")
+
+
+def collect_assets(assets_dir):
+    """Return [(name, bytes)] for every asset, converted variants included."""
+    result = []
+    if not os.path.exists(assets_dir):
+        return result
+    for fname in sorted(os.listdir(assets_dir)):
+        fpath = os.path.join(assets_dir, fname)
+        if not os.path.isfile(fpath):
+            continue
+        with open(fpath, "rb") as f:
+            content = f.read()
+        result.extend(convert_asset(fname, fpath, content))
+    return result
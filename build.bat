@@ -1,6 +1,7 @@
 @echo ON
 set REAL_FLAG=
 set DEBUG_FLAG=
+set FB_FLAG=
 set LINKER_SCRIPT=linkers\linker.ld
 set IS_REAL=0
 set IS_DEBUG=0
@@ -12,6 +13,9 @@ if /I "%~1"=="--real" (
     set LINKER_SCRIPT=linkers\linker_pi.ld
     set IS_REAL=1
 )
+if /I "%~1"=="--rgb565" (
+    set FB_FLAG=-DRPI_FB_RGB565
+)
 if /I "%~1"=="--debug" (
     set DEBUG_FLAG=-DDEBUG
     set IS_DEBUG=1
@@ -48,11 +52,14 @@ del /F /Q temp\binaries\*.img
 del /F /Q temp\maps\*.map
 
 set GCC=aarch64\aarch64-none-elf-gcc.bat
-set C_FLAGS=-ffixed-x18 -fno-builtin -fno-merge-constants -fno-common -mgeneral-regs-only -ffreestanding -nostdlib -nostartfiles -mcpu=cortex-a53 -march=armv8-a -mabi=lp64 -Wall -Wextra -Wmissing-prototypes -Ikernel -DLODEPNG_NO_COMPILE_ALLOCATORS -DLODEPNG_NO_COMPILE_DISK %REAL_FLAG% %DEBUG_FLAG%
+set C_FLAGS=-ffixed-x18 -fno-builtin -fno-merge-constants -fno-common -mgeneral-regs-only -ffreestanding -nostdlib -nostartfiles -mcpu=cortex-a53 -march=armv8-a -mabi=lp64 -Wall -Wextra -Wmissing-prototypes -Ikernel -DLODEPNG_NO_COMPILE_ALLOCATORS -DLODEPNG_NO_COMPILE_DISK %REAL_FLAG% %DEBUG_FLAG% %FB_FLAG%
+@REM NEON units (pixel_neon.c, fpsimd.S) may use the FP/SIMD registers
+set SIMD_FLAGS=%C_FLAGS:-mgeneral-regs-only=%
 
 call %GCC% %C_FLAGS% -c boot\start.S -o temp\objects\start.o 
 call %GCC% %C_FLAGS% -c kernel\vectors.S -o temp\objects\vectors.o
 call %GCC% %C_FLAGS% -c kernel\swtch.S -o temp\objects\swtch.o
+call %GCC% %SIMD_FLAGS% -c kernel\fpsimd.S -o temp\objects\fpsimd.o
 call %GCC% %C_FLAGS% -c kernel\kernel.c -o temp\objects\kernel.o
 call %GCC% %C_FLAGS% -c kernel\uart.c -o temp\objects\uart.o
 call %GCC% %C_FLAGS% -c kernel\palloc.c -o temp\objects\palloc.o
@@ -61,11 +68,22 @@ call %GCC% %C_FLAGS% -c kernel\ramfs.c -o temp\objects\ramfs.o
 call %GCC% %C_FLAGS% -c kernel\lib.c -o temp\objects\lib.o
 call %GCC% %C_FLAGS% -c kernel\syscall.c -o temp\objects\syscall.o
 call %GCC% %C_FLAGS% -c kernel\timer.c -o temp\objects\timer.o
+call %GCC% %C_FLAGS% -c kernel\timepage.c -o temp\objects\timepage.o
 call %GCC% %C_FLAGS% -c kernel\irq.c -o temp\objects\irq.o
 call %GCC% %C_FLAGS% -c kernel\framebuffer.c -o temp\objects\framebuffer.o
 call %GCC% %C_FLAGS% -c kernel\virtio.c -o temp\objects\virtio.o
+call %GCC% %C_FLAGS% -c kernel\virtio_console.c -o temp\objects\virtio_console.o
 call %GCC% %C_FLAGS% -c kernel\rpi_fx.c -o temp\objects\rpi_fx.o
 call %GCC% %C_FLAGS% -c kernel\dma.c -o temp\objects\dma.o
+call %GCC% %C_FLAGS% -c kernel\dma_blit.c -o temp\objects\dma_blit.o
+call %GCC% %C_FLAGS% -c kernel\simd.c -o temp\objects\simd.o
+call %GCC% %C_FLAGS% -c kernel\pixel.c -o temp\objects\pixel.o
+call %GCC% %SIMD_FLAGS% -c kernel\pixel_neon.c -o temp\objects\pixel_neon.o
+call %GCC% %C_FLAGS% -c kernel\ring.c -o temp\objects\ring.o
+call %GCC% %C_FLAGS% -c kernel\latency.c -o temp\objects\latency.o
+call %GCC% %C_FLAGS% -c kernel\input_rec.c -o temp\objects\input_rec.o
+call %GCC% %C_FLAGS% -c kernel\klog.c -o temp\objects\klog.o
+call %GCC% %C_FLAGS% -c kernel\kconsole.c -o temp\objects\kconsole.o
 call %GCC% %C_FLAGS% -c kernel\emmc.c -o temp\objects\emmc.o
 call %GCC% %C_FLAGS% -c kernel\emmc_clock.c -o temp\objects\emmc_clock.o
 call %GCC% %C_FLAGS% -c kernel\usb.c -o temp\objects\usb.o
@@ -95,6 +113,13 @@ call %GCC% %C_FLAGS% -c kernel\panic.c -o temp\objects\panic.o
 call %GCC% %C_FLAGS% -c kernel\service.c -o temp\objects\service.o
 call %GCC% %C_FLAGS% -c kernel\glob.c -o temp\objects\glob.o
 call %GCC% %C_FLAGS% -c kernel\pty.c -o temp\objects\pty.o
+call %GCC% %C_FLAGS% -c kernel\poll.c -o temp\objects\poll.o
+call %GCC% %C_FLAGS% -c kernel\uring.c -o temp\objects\uring.o
+call %GCC% %C_FLAGS% -c kernel\shm.c -o temp\objects\shm.o
+call %GCC% %C_FLAGS% -c kernel\chan.c -o temp\objects\chan.o
+call %GCC% %C_FLAGS% -c kernel\etask.c -o temp\objects\etask.o
+call %GCC% %C_FLAGS% -c kernel\hrtimer.c -o temp\objects\hrtimer.o
+call %GCC% %C_FLAGS% -c kernel\futex.c -o temp\objects\futex.o
 call %GCC% %C_FLAGS% -c kernel\input.c -o temp\objects\input.o
 call %GCC% %C_FLAGS% -c kernel\wm.c -o temp\objects\wm.o
 call %GCC% %C_FLAGS% -c kernel\apps\terminal_app.c -o temp\objects\terminal_app.o
@@ -109,6 +134,10 @@ call %GCC% %C_FLAGS% -c kernel\files.c -o temp\objects\files.o
 call %GCC% %C_FLAGS% -c kernel\lodepng.c -o temp\objects\lodepng.o
 call %GCC% %C_FLAGS% -c kernel\lodepng_glue.c -o temp\objects\lodepng_glue.o
 call %GCC% %C_FLAGS% -c kernel\image.c -o temp\objects\image.o
+call %GCC% %C_FLAGS% -c kernel\qoi.c -o temp\objects\qoi.o
+call %GCC% %C_FLAGS% -c kernel\inflate.c -o temp\objects\inflate.o
+call %GCC% %C_FLAGS% -c kernel\image_decode.c -o temp\objects\image_decode.o
+call %GCC% %C_FLAGS% -c kernel\thumbnail.c -o temp\objects\thumbnail.o
 call %GCC% %C_FLAGS% -c kernel\apps\image_viewer.c -o temp\objects\image_viewer.o
 call %GCC% %C_FLAGS% -c kernel\debug_overlay.c -o temp\objects\debug_overlay.o
 
@@ -121,16 +150,32 @@ call %GCC% %C_FLAGS% -c kernel\commands\kill.c -o temp\objects\kill.o
 call %GCC% %C_FLAGS% -c kernel\commands\ramfs_tools.c -o temp\objects\ramfs_tools.o
 call %GCC% %C_FLAGS% -c kernel\commands\systemctl.c -o temp\objects\systemctl.o
 call %GCC% %C_FLAGS% -c kernel\commands\free.c -o temp\objects\free.o
+call %GCC% %C_FLAGS% -c kernel\commands\pngbench.c -o temp\objects\pngbench.o
+call %GCC% %C_FLAGS% -c kernel\commands\blittest.c -o temp\objects\blittest.o
+call %GCC% %C_FLAGS% -c kernel\commands\fbmode.c -o temp\objects\fbmode.o
+call %GCC% %C_FLAGS% -c kernel\commands\pixtest.c -o temp\objects\pixtest.o
+call %GCC% %C_FLAGS% -c kernel\commands\ringbench.c -o temp\objects\ringbench.o
+call %GCC% %C_FLAGS% -c kernel\commands\usbstat.c -o temp\objects\usbstat.o
+call %GCC% %C_FLAGS% -c kernel\commands\inlat.c -o temp\objects\inlat.o
+call %GCC% %C_FLAGS% -c kernel\commands\inrec.c -o temp\objects\inrec.o
+call %GCC% %C_FLAGS% -c kernel\commands\dmesg.c -o temp\objects\dmesg.o
+call %GCC% %C_FLAGS% -c kernel\commands\console.c -o temp\objects\console.o
+call %GCC% %C_FLAGS% -c kernel\commands\uringbench.c -o temp\objects\uringbench.o
+call %GCC% %C_FLAGS% -c kernel\commands\shmbench.c -o temp\objects\shmbench.o
+call %GCC% %C_FLAGS% -c kernel\commands\etasks.c -o temp\objects\etasks.o
+call %GCC% %C_FLAGS% -c kernel\commands\hrtimers.c -o temp\objects\hrtimers.o
+call %GCC% %C_FLAGS% -c kernel\commands\irqstat.c -o temp\objects\irqstat.o
+call %GCC% %C_FLAGS% -c kernel\commands\utimebench.c -o temp\objects\utimebench.o
 
 
 
 
 if "%IS_REAL%"=="1" (
     echo Linking for REAL hardware...
-    call "aarch64\aarch64-none-elf-ld.bat" temp\objects\start.o temp\objects\mmu.o temp\objects\diskfs.o temp\objects\vectors.o temp\objects\swtch.o temp\objects\kernel.o temp\objects\uart.o temp\objects\palloc.o temp\objects\kmalloc.o temp\objects\ramfs.o temp\objects\lib.o temp\objects\syscall.o temp\objects\timer.o temp\objects\irq.o temp\objects\framebuffer.o temp\objects\virtio.o temp\objects\rpi_fx.o temp\objects\dma.o temp\objects\emmc.o temp\objects\emmc_clock.o temp\objects\usb.o temp\objects\init.o temp\objects\programs.o temp\objects\echo.o temp\objects\help.o temp\objects\touch.o temp\objects\write.o temp\objects\cat.o temp\objects\ls.o temp\objects\rm.o temp\objects\mkdir.o temp\objects\rmdir.o temp\objects\cp.o temp\objects\mv.o temp\objects\grep.o temp\objects\head.o temp\objects\tail.o temp\objects\more.o temp\objects\tree.o temp\objects\shell.o temp\objects\sched.o temp\objects\panic.o temp\objects\service.o temp\objects\glob.o temp\objects\pty.o temp\objects\input.o temp\objects\wm.o temp\objects\terminal_app.o temp\objects\myra_app.o temp\objects\calculator_app.o temp\objects\files_app.o temp\objects\cursor.o temp\objects\keyboard_tester_app.o temp\objects\editor_app.o temp\objects\edit.o temp\objects\files.o temp\objects\image.o temp\objects\image_viewer.o temp\objects\lodepng.o temp\objects\lodepng_glue.o temp\objects\view.o temp\objects\clear.o temp\objects\ps.o temp\objects\sleep.o temp\objects\wait.o temp\objects\kill.o temp\objects\ramfs_tools.o temp\objects\systemctl.o temp\objects\free.o temp\objects\debug_overlay.o -T %LINKER_SCRIPT% -o temp\elfs\kernel.elf -Map temp\maps\kernel.map
+    call "aarch64\aarch64-none-elf-ld.bat" temp\objects\start.o temp\objects\mmu.o temp\objects\diskfs.o temp\objects\vectors.o temp\objects\swtch.o temp\objects\kernel.o temp\objects\uart.o temp\objects\palloc.o temp\objects\kmalloc.o temp\objects\ramfs.o temp\objects\lib.o temp\objects\syscall.o temp\objects\timer.o temp\objects\irq.o temp\objects\framebuffer.o temp\objects\virtio.o temp\objects\rpi_fx.o temp\objects\dma.o temp\objects\emmc.o temp\objects\emmc_clock.o temp\objects\usb.o temp\objects\init.o temp\objects\programs.o temp\objects\echo.o temp\objects\help.o temp\objects\touch.o temp\objects\write.o temp\objects\cat.o temp\objects\ls.o temp\objects\rm.o temp\objects\mkdir.o temp\objects\rmdir.o temp\objects\cp.o temp\objects\mv.o temp\objects\grep.o temp\objects\head.o temp\objects\tail.o temp\objects\more.o temp\objects\tree.o temp\objects\shell.o temp\objects\sched.o temp\objects\panic.o temp\objects\service.o temp\objects\glob.o temp\objects\pty.o temp\objects\input.o temp\objects\wm.o temp\objects\terminal_app.o temp\objects\myra_app.o temp\objects\calculator_app.o temp\objects\files_app.o temp\objects\cursor.o temp\objects\keyboard_tester_app.o temp\objects\editor_app.o temp\objects\edit.o temp\objects\files.o temp\objects\image.o temp\objects\image_viewer.o temp\objects\lodepng.o temp\objects\lodepng_glue.o temp\objects\view.o temp\objects\clear.o temp\objects\ps.o temp\objects\sleep.o temp\objects\wait.o temp\objects\kill.o temp\objects\ramfs_tools.o temp\objects\systemctl.o temp\objects\free.o temp\objects\debug_overlay.o temp\objects\inflate.o temp\objects\image_decode.o temp\objects\thumbnail.o temp\objects\qoi.o temp\objects\pngbench.o temp\objects\dma_blit.o temp\objects\blittest.o temp\objects\fbmode.o temp\objects\simd.o temp\objects\pixel.o temp\objects\pixel_neon.o temp\objects\fpsimd.o temp\objects\pixtest.o temp\objects\ring.o temp\objects\ringbench.o temp\objects\usbstat.o temp\objects\latency.o temp\objects\inlat.o temp\objects\input_rec.o temp\objects\inrec.o temp\objects\klog.o temp\objects\dmesg.o temp\objects\virtio_console.o temp\objects\kconsole.o temp\objects\console.o temp\objects\poll.o temp\objects\timepage.o temp\objects\uring.o temp\objects\uringbench.o temp\objects\shm.o temp\objects\futex.o temp\objects\shmbench.o temp\objects\chan.o temp\objects\etask.o temp\objects\etasks.o temp\objects\hrtimer.o temp\objects\hrtimers.o temp\objects\irqstat.o temp\objects\utimebench.o -T %LINKER_SCRIPT% -o temp\elfs\kernel.elf -Map temp\maps\kernel.map
 ) else (
     echo Linking for SIMULATION...
-    call "aarch64\aarch64-none-elf-ld.bat" temp\objects\start.o temp\objects\mmu.o temp\objects\diskfs.o temp\objects\vectors.o temp\objects\swtch.o temp\objects\kernel.o temp\objects\uart.o temp\objects\palloc.o temp\objects\kmalloc.o temp\objects\ramfs.o temp\objects\lib.o temp\objects\syscall.o temp\objects\timer.o temp\objects\irq.o temp\objects\framebuffer.o temp\objects\virtio.o temp\objects\rpi_fx.o temp\objects\dma.o temp\objects\emmc.o temp\objects\emmc_clock.o temp\objects\usb.o temp\objects\init.o temp\objects\programs.o temp\objects\echo.o temp\objects\help.o temp\objects\touch.o temp\objects\write.o temp\objects\cat.o temp\objects\ls.o temp\objects\rm.o temp\objects\mkdir.o temp\objects\rmdir.o temp\objects\cp.o temp\objects\mv.o temp\objects\grep.o temp\objects\head.o temp\objects\tail.o temp\objects\more.o temp\objects\tree.o temp\objects\shell.o temp\objects\sched.o temp\objects\panic.o temp\objects\service.o temp\objects\glob.o temp\objects\pty.o temp\objects\input.o temp\objects\wm.o temp\objects\terminal_app.o temp\objects\myra_app.o temp\objects\calculator_app.o temp\objects\files_app.o temp\objects\cursor.o temp\objects\keyboard_tester_app.o temp\objects\editor_app.o temp\objects\edit.o temp\objects\files.o temp\objects\image.o temp\objects\image_viewer.o temp\objects\lodepng.o temp\objects\lodepng_glue.o temp\objects\view.o temp\objects\clear.o temp\objects\ps.o temp\objects\sleep.o temp\objects\wait.o temp\objects\kill.o temp\objects\ramfs_tools.o temp\objects\systemctl.o temp\objects\free.o temp\objects\debug_overlay.o -T %LINKER_SCRIPT% -o temp\elfs\kernel.elf -Map temp\maps\kernel.map
+    call "aarch64\aarch64-none-elf-ld.bat" temp\objects\start.o temp\objects\mmu.o temp\objects\diskfs.o temp\objects\vectors.o temp\objects\swtch.o temp\objects\kernel.o temp\objects\uart.o temp\objects\palloc.o temp\objects\kmalloc.o temp\objects\ramfs.o temp\objects\lib.o temp\objects\syscall.o temp\objects\timer.o temp\objects\irq.o temp\objects\framebuffer.o temp\objects\virtio.o temp\objects\rpi_fx.o temp\objects\dma.o temp\objects\emmc.o temp\objects\emmc_clock.o temp\objects\usb.o temp\objects\init.o temp\objects\programs.o temp\objects\echo.o temp\objects\help.o temp\objects\touch.o temp\objects\write.o temp\objects\cat.o temp\objects\ls.o temp\objects\rm.o temp\objects\mkdir.o temp\objects\rmdir.o temp\objects\cp.o temp\objects\mv.o temp\objects\grep.o temp\objects\head.o temp\objects\tail.o temp\objects\more.o temp\objects\tree.o temp\objects\shell.o temp\objects\sched.o temp\objects\panic.o temp\objects\service.o temp\objects\glob.o temp\objects\pty.o temp\objects\input.o temp\objects\wm.o temp\objects\terminal_app.o temp\objects\myra_app.o temp\objects\calculator_app.o temp\objects\files_app.o temp\objects\cursor.o temp\objects\keyboard_tester_app.o temp\objects\editor_app.o temp\objects\edit.o temp\objects\files.o temp\objects\image.o temp\objects\image_viewer.o temp\objects\lodepng.o temp\objects\lodepng_glue.o temp\objects\view.o temp\objects\clear.o temp\objects\ps.o temp\objects\sleep.o temp\objects\wait.o temp\objects\kill.o temp\objects\ramfs_tools.o temp\objects\systemctl.o temp\objects\free.o temp\objects\debug_overlay.o temp\objects\inflate.o temp\objects\image_decode.o temp\objects\thumbnail.o temp\objects\qoi.o temp\objects\pngbench.o temp\objects\dma_blit.o temp\objects\blittest.o temp\objects\fbmode.o temp\objects\simd.o temp\objects\pixel.o temp\objects\pixel_neon.o temp\objects\fpsimd.o temp\objects\pixtest.o temp\objects\ring.o temp\objects\ringbench.o temp\objects\usbstat.o temp\objects\latency.o temp\objects\inlat.o temp\objects\input_rec.o temp\objects\inrec.o temp\objects\klog.o temp\objects\dmesg.o temp\objects\virtio_console.o temp\objects\kconsole.o temp\objects\console.o temp\objects\poll.o temp\objects\timepage.o temp\objects\uring.o temp\objects\uringbench.o temp\objects\shm.o temp\objects\futex.o temp\objects\shmbench.o temp\objects\chan.o temp\objects\etask.o temp\objects\etasks.o temp\objects\hrtimer.o temp\objects\hrtimers.o temp\objects\irqstat.o temp\objects\utimebench.o -T %LINKER_SCRIPT% -o temp\elfs\kernel.elf -Map temp\maps\kernel.map
 )
 
 call "aarch64\aarch64-none-elf-objcopy.bat" -O binary temp\elfs\kernel.elf temp\binaries\kernel8.img
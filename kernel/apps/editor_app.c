@@ -4,7 +4,7 @@
 #include "sched.h"
 #include "input.h"
 #include "uart.h"
-#include "timer.h"
+#include "hrtimer.h"
 #include "init.h"
 #include "editor_app.h"
 #include "files.h"
@@ -36,8 +36,8 @@ struct editor_state {
     char cmd_buf[64];
     int cmd_len;
     int is_dirty;
-    int last_blink;
     int cursor_visible;
+    struct hrtimer blink;
 };
 
 static struct editor_state *g_editor = NULL;
@@ -45,6 +45,7 @@ static struct editor_state *g_editor = NULL;
 static void editor_on_close(struct window *win) {
     (void)win;
     if (g_editor) {
+        hrtimer_cancel(&g_editor->blink);
         if (g_editor->buffer) kfree(g_editor->buffer);
         kfree(g_editor);
         g_editor = NULL;
@@ -142,12 +143,16 @@ static void handle_command(struct editor_state *st) {
     st->cmd_len = 0; st->cmd_buf[0] = '\0';
 }
 
+/* hrtimer callback, every 500ms while the editor is open */
+static void editor_blink(struct hrtimer *h) {
+    struct editor_state *st = h->arg;
+    st->cursor_visible = !st->cursor_visible;
+    wm_request_render(st->win);
+}
+
 static void editor_task(void *arg) {
     struct editor_state *st = (struct editor_state *)arg;
-    uint32_t last_blink = 0;
     while (g_editor == st) {
-        uint32_t now = timer_get_ms();
-        if (now - last_blink > 500) { st->cursor_visible = !st->cursor_visible; last_blink = now; wm_request_render(st->win); }
         if (wm_is_focused(st->win)) {
             struct wm_input_event ev;
             while (wm_pop_key_event(st->win, &ev)) {
@@ -185,5 +190,7 @@ void editor_app_start(const char *filename) {
     if (filename) load_file(st, filename); else strcpy(st->filename, "untitled.txt");
     st->win = wm_create_window(EDITOR_NAME, 100, 100, 640, 400, editor_draw);
     st->win->on_close = editor_on_close; g_editor = st;
+    hrtimer_init(&st->blink, editor_blink, st, "editor-blink");
+    hrtimer_start_ms(&st->blink, 500, 500);
     int tid = task_create(editor_task, st, "valli_editor"); task_set_parent(tid, 1);
 }
@@ -6,15 +6,20 @@
 #include "input.h"
 #include "sched.h"
 #include "timer.h"
+#include "hrtimer.h"
 #include "init.h"
 #include "uart.h"
 #include <string.h>
 #include "programs.h"
 #include "shell.h"
+#include "thumbnail.h"
 
 #define MAX_FILES 40
 #define MAX_PATH_LEN 256
 #define FILE_LIST_BUF_SIZE 2048
+#define THUMB_BOX 20
+#define FILES_REFRESH_MS 3000
+#define FILES_BLINK_MS 500
 
 struct file_entry {
     char name[64];
@@ -41,9 +46,11 @@ struct files_state {
     char search_query[64];
     int search_len;
     int cursor_visible;
-    uint32_t last_cursor_toggle;
+    struct hrtimer blink;
     int shift_state;
-    uint32_t last_periodic_refresh;
+    struct hrtimer refresh;
+    volatile int refresh_due;
+    uint32_t thumb_gen;
 };
 
 static struct files_state *g_files = NULL;
@@ -186,8 +193,24 @@ static void files_draw(struct window *win) {
             wm_draw_rect(win, 0, y_pos, win->w - 4, item_h, 0x45475A);
         }
         
-        uint32_t icon_color = g_files->files[idx].is_dir ? 0xF9E2AF : 0x89DCEB;
-        wm_draw_rect(win, 8, y_pos + 6, 12, 12, icon_color);
+        const struct thumb *th = NULL;
+        if (!g_files->files[idx].is_dir && thumb_supported(g_files->files[idx].name)) {
+            char full[MAX_PATH_LEN + 64];
+            strcpy(full, g_files->current_path);
+            if (full[strlen(full) - 1] != '/') strcat(full, "/");
+            strcat(full, g_files->files[idx].name);
+            th = thumb_lookup(full, THUMB_BOX);
+        }
+
+        if (th) {
+            /* Center the preview where the 12x12 icon would be */
+            int tx = 14 - th->w / 2;
+            int ty = y_pos + 12 - th->h / 2;
+            wm_draw_bitmap(win, tx, ty, th->w, th->h, th->pixels, th->w, th->h);
+        } else {
+            uint32_t icon_color = g_files->files[idx].is_dir ? 0xF9E2AF : 0x89DCEB;
+            wm_draw_rect(win, 8, y_pos + 6, 12, 12, icon_color);
+        }
         
         wm_draw_text(win, 28, y_pos + 8, g_files->files[idx].name, 0xCDD6F4, 1);
     }
@@ -206,9 +229,24 @@ static void files_draw(struct window *win) {
     wm_draw_text(win, 8, (win->h - 24) - footer_h + 5, stats, 0x9399B2, 1);
 }
 
+/* hrtimer callbacks. Listing the directory is too much for one, so the
+ * refresh only flags it for files_task. */
+static void files_refresh_due(struct hrtimer *h) {
+    struct files_state *st = h->arg;
+    st->refresh_due = 1;
+}
+
+static void files_blink(struct hrtimer *h) {
+    struct files_state *st = h->arg;
+    st->cursor_visible = !st->cursor_visible;
+    if (wm_is_focused(st->win)) wm_request_render(st->win);
+}
+
 static void files_on_close(struct window *win) {
     (void)win;
     if (g_files) {
+        hrtimer_cancel(&g_files->refresh);
+        hrtimer_cancel(&g_files->blink);
         g_files = NULL; 
         // Note: The task will free the memory when it exits loop
     }
@@ -278,6 +316,9 @@ static void files_task(void *arg) {
     refresh_file_list();
     uart_puts("[files] first refresh done. items="); uart_put_hex(st->num_files); uart_puts("\n");
     
+    hrtimer_start_ms(&st->refresh, FILES_REFRESH_MS, FILES_REFRESH_MS);
+    hrtimer_start_ms(&st->blink, FILES_BLINK_MS, FILES_BLINK_MS);
+
     int last_mouse_btn = 0;
     uint32_t last_click_time = 0;
     uint32_t last_heartbeat = 0;
@@ -290,20 +331,17 @@ static void files_task(void *arg) {
             last_heartbeat = now;
         }
         
-        // 1. Periodic Refresh (Every 3 seconds)
-        if (now - st->last_periodic_refresh > 3000) {
+        // 1. Periodic Refresh (Every 3 seconds, flagged by st->refresh)
+        if (st->refresh_due) {
+            st->refresh_due = 0;
             refresh_file_list();
-            st->last_periodic_refresh = now;
             wm_request_render(st->win);
         }
 
-        // 2. Cursor Blink Logic
-        if (now - st->last_cursor_toggle > 500) {
-            st->cursor_visible = !st->cursor_visible;
-            st->last_cursor_toggle = now;
-            if (wm_is_focused(st->win)) {
-                wm_request_render(st->win);
-            }
+        // Redraw when queued thumbnails arrive
+        if (thumb_generation() != st->thumb_gen) {
+            st->thumb_gen = thumb_generation();
+            wm_request_render(st->win);
         }
 
         if (wm_is_focused(st->win)) {
@@ -352,7 +390,7 @@ static void files_task(void *arg) {
                         }
                         
                         st->cursor_visible = 1;
-                        st->last_cursor_toggle = now;
+                        hrtimer_start_ms(&st->blink, FILES_BLINK_MS, FILES_BLINK_MS);
                         wm_request_render(st->win);
                     }
                 }
@@ -396,6 +434,8 @@ static void files_task(void *arg) {
         yield();
     }
     
+    hrtimer_cancel(&st->refresh);
+    hrtimer_cancel(&st->blink);
     if (st->files) kfree(st->files);
     if (st->list_buffer) kfree(st->list_buffer);
     kfree(st);
@@ -408,6 +448,8 @@ void files_app_start(void) {
     g_files = kmalloc(sizeof(struct files_state));
     if (!g_files) return;
     memset(g_files, 0, sizeof(*g_files));
+    hrtimer_init(&g_files->refresh, files_refresh_due, g_files, "files-refresh");
+    hrtimer_init(&g_files->blink, files_blink, g_files, "files-blink");
 
     // Alloc buffers
     g_files->files = kmalloc(sizeof(struct file_entry) * MAX_FILES);
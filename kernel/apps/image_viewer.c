@@ -1,6 +1,7 @@
 #include "image_viewer.h"
 #include "wm.h"
 #include "image.h"
+#include "image_decode.h"
 #include "kmalloc.h"
 #include "framebuffer.h"
 #include "lib.h"
@@ -16,6 +17,10 @@ struct iv_state {
     int img_w;
     int img_h;
     int loading_error;
+
+    /* Background decode; img_w/img_h are valid once sized is set */
+    struct img_decode *job;
+    int sized;
     
     /* Input state for text box */
     int requesting_file;
@@ -23,56 +28,98 @@ struct iv_state {
     int input_len;
 };
 
+static void iv_fit_window(struct iv_state *st) {
+    /* Goal: Window size <= 75% screen size, but fit image. */
+    int screen_w, screen_h;
+    fb_get_res(&screen_w, &screen_h);
+
+    int max_w = (screen_w * 3) / 4;
+    int max_h = (screen_h * 3) / 4;
+
+    int w = st->img_w;
+    int h = st->img_h;
+
+    /* Scale down if needed */
+    if (w > max_w) {
+        h = (h * max_w) / w;
+        w = max_w;
+    }
+    if (h > max_h) {
+        w = (w * max_h) / h;
+        h = max_h;
+    }
+
+    /* Ensure min size for UI */
+    if (w < 300) w = 300;
+    if (h < 200) h = 200;
+
+    /* Update window */
+    st->win->w = w;
+    st->win->h = h;
+    st->win->x = (screen_w - w) / 2;
+    st->win->y = (screen_h - h) / 2;
+
+    /* Ensure we are in normal state when loading new image? */
+    if (st->win->state == WM_STATE_FULLSCREEN) {
+         wm_set_state(st->win, WM_STATE_NORMAL);
+    } else {
+         /* Update saved state too if currently normal, so it doesn't restore to old size */
+         st->win->saved_w = w; st->win->saved_h = h;
+         st->win->saved_x = st->win->x; st->win->saved_y = st->win->y;
+    }
+}
+
+static void iv_decode_update(struct img_decode *job, void *arg) {
+    (void)job;
+    struct iv_state *st = (struct iv_state *)arg;
+    wm_request_render(st->win);
+}
+
+static void iv_cancel_decode(struct iv_state *st) {
+    if (st->job) {
+        img_decode_release(st->job);
+        st->job = NULL;
+    }
+}
+
 static void iv_load_image(struct iv_state *st, const char *path) {
+    iv_cancel_decode(st);
     if (st->img_buf) {
         kfree(st->img_buf);
         st->img_buf = NULL;
     }
     st->loading_error = 0;
+    st->sized = 0;
+    st->img_w = st->img_h = 0;
     strncpy(st->path, path, 127);
-    
-    int ret = img_load_png(path, &st->img_w, &st->img_h, &st->img_buf);
-    if (ret < 0) {
-        st->loading_error = ret;
-    } else {
-        /* Goal: Window size <= 75% screen size, but fit image. */
-        int screen_w, screen_h;
-        fb_get_res(&screen_w, &screen_h);
-        
-        int max_w = (screen_w * 3) / 4;
-        int max_h = (screen_h * 3) / 4;
-        
-        int w = st->img_w;
-        int h = st->img_h;
-        
-        /* Scale down if needed */
-        if (w > max_w) {
-            h = (h * max_w) / w;
-            w = max_w;
-        }
-        if (h > max_h) {
-            w = (w * max_h) / h;
-            h = max_h;
-        }
-        
-        /* Ensure min size for UI */
-        if (w < 300) w = 300;
-        if (h < 200) h = 200;
-        
-        /* Update window */
-        st->win->w = w;
-        st->win->h = h;
-        st->win->x = (screen_w - w) / 2;
-        st->win->y = (screen_h - h) / 2;
-        
-        /* Ensure we are in normal state when loading new image? */
-        if (st->win->state == WM_STATE_FULLSCREEN) {
-             wm_set_state(st->win, WM_STATE_NORMAL);
-        } else {
-             /* Update saved state too if currently normal, so it doesn't restore to old size */
-             st->win->saved_w = w; st->win->saved_h = h;
-             st->win->saved_x = st->win->x; st->win->saved_y = st->win->y;
-        }
+
+    /* Decoding runs in its own task; iv_task picks up the result */
+    st->job = img_decode_start(path, iv_decode_update, st);
+    if (!st->job) st->loading_error = -4;
+}
+
+/* Called from iv_task: size the window once the header is known and
+ * adopt the pixels when the decode finishes. */
+static void iv_poll_decode(struct iv_state *st) {
+    struct img_decode *job = st->job;
+    if (!job) return;
+
+    if (!st->sized && job->w > 0) {
+        st->img_w = job->w;
+        st->img_h = job->h;
+        st->sized = 1;
+        iv_fit_window(st);
+        wm_request_render(st->win);
+    }
+
+    if (job->status == IMG_DECODE_DONE) {
+        st->img_buf = img_decode_take_pixels(job);
+        iv_cancel_decode(st);
+        wm_request_render(st->win);
+    } else if (job->status == IMG_DECODE_FAILED || job->status == IMG_DECODE_CANCELLED) {
+        st->loading_error = job->error ? job->error : -7;
+        iv_cancel_decode(st);
+        wm_request_render(st->win);
     }
 }
 
@@ -94,7 +141,11 @@ static void iv_draw(struct window *win) {
         return;
     }
 
-    if (st->img_buf) {
+    /* While decoding, show whatever rows are ready */
+    uint32_t *pixels = st->img_buf;
+    if (!pixels && st->job && st->sized) pixels = st->job->pixels;
+
+    if (pixels) {
         /* Calculate Dest Rect to fit image in window maintaining aspect ratio */
         /* Content area adjustments are handled by wm_draw_bitmap if we passed simpler coords? 
            No, win->w is full window width. wm_draw_bitmap handles Chrome offsets. 
@@ -114,7 +165,14 @@ static void iv_draw(struct window *win) {
         int dst_x = (avail_w - dst_w) / 2;
         int dst_y = (avail_h - dst_h) / 2;
         
-        wm_draw_bitmap(win, dst_x, dst_y, dst_w, dst_h, st->img_buf, st->img_w, st->img_h);
+        wm_draw_bitmap(win, dst_x, dst_y, dst_w, dst_h, pixels, st->img_w, st->img_h);
+
+        if (st->job) {
+            /* Progress bar along the bottom of the image area */
+            int pct = st->job->progress;
+            wm_draw_rect(win, 10, avail_h - 34, avail_w - 20, 6, 0x444444);
+            wm_draw_rect(win, 10, avail_h - 34, ((avail_w - 20) * pct) / 100, 6, 0x00AAFF);
+        }
         
         /* Overlay path if not fullscreen/distracting? Maybe just at bottom if space */
         if (win->state != WM_STATE_FULLSCREEN) {
@@ -125,7 +183,19 @@ static void iv_draw(struct window *win) {
             wm_draw_text(win, 10, 40, "Error loading image:", 0xFF5555, 1);
             if (st->loading_error == -2) wm_draw_text(win, 10, 60, "File not found", 0xFFFFFF, 1);
             else if (st->loading_error == -7) wm_draw_text(win, 10, 60, "Decode error", 0xFFFFFF, 1);
+            else if (st->loading_error == -4 || st->loading_error == -8) wm_draw_text(win, 10, 60, "Out of memory", 0xFFFFFF, 1);
             else wm_draw_text(win, 10, 60, "Unknown error", 0xFFFFFF, 1);
+        } else if (st->job) {
+            char msg[32];
+            int pct = st->job->progress;
+            strcpy(msg, "Decoding ");
+            int n = strlen(msg);
+            if (pct >= 100) msg[n++] = '0' + pct / 100;
+            if (pct >= 10) msg[n++] = '0' + (pct / 10) % 10;
+            msg[n++] = '0' + pct % 10;
+            msg[n++] = '%';
+            msg[n] = '\0';
+            wm_draw_text(win, 10, 40, msg, 0xAAAAAA, 1);
         } else {
             wm_draw_text(win, 10, 40, "No image loaded.", 0xAAAAAA, 1);
         }
@@ -135,6 +205,7 @@ static void iv_draw(struct window *win) {
 static void iv_on_close(struct window *win) {
     struct iv_state *st = (struct iv_state *)win->user_data;
     if (st) {
+        iv_cancel_decode(st);
         if (st->img_buf) kfree(st->img_buf);
         kfree(st);
     }
@@ -145,6 +216,8 @@ static void iv_task(void *arg) {
     
     while (1) {
         if (!st->win) break;
+
+        iv_poll_decode(st);
         
         struct wm_input_event ev;
         if (wm_pop_key_event(st->win, &ev)) {
@@ -7,13 +7,14 @@
 #include "terminal_app.h"
 #include "calculator_app.h"
 #include "sched.h"
-#include "timer.h"
+#include "hrtimer.h"
 #include <string.h>
 #include "uart.h"
 #include "files_app.h"
 #include "keyboard_tester_app.h"
 #include "editor_app.h"
 #include "image_viewer.h"
+#include "thumbnail.h"
 
 struct app_info {
     const char *name;
@@ -50,15 +51,16 @@ static void launch_calculator(void) { calculator_app_start(); }
 static void launch_keytester(void) { keyboard_tester_app_start(); }
 static void launch_editor(void) { editor_app_start(NULL); }
 
+/* icon_path: a shipped image, NULL for the plain placeholder */
 static struct app_info apps[] = {
-    {"Terminal", launch_terminal, "/icons/terminal.bin", 0},
-    {"Calculator", launch_calculator, "/icons/calc.bin", 0},
-    {"Keyboard Tester", launch_keytester, "/icons/keys.bin", 0},
-    {"File Explorer", launch_files, "/icons/files.bin", 0},
-    {"Valli Editor", launch_editor, "/icons/editor.bin", 0},
-    {"Image Viewer", (void(*)(void))image_viewer_start, "/icons/image.bin", 0},
-    {"Settings", launch_settings, "/icons/settings.bin", 0},
-    {"Help", launch_help, "/icons/help.bin", 0}
+    {"Terminal", launch_terminal, NULL, 0},
+    {"Calculator", launch_calculator, "/system/assets/calculator.png", 0},
+    {"Keyboard Tester", launch_keytester, NULL, 0},
+    {"File Explorer", launch_files, NULL, 0},
+    {"Valli Editor", launch_editor, NULL, 0},
+    {"Image Viewer", (void(*)(void))image_viewer_start, NULL, 0},
+    {"Settings", launch_settings, NULL, 0},
+    {"Help", launch_help, NULL, 0}
 };
 #define NUM_APPS (sizeof(apps)/sizeof(apps[0]))
 
@@ -69,7 +71,8 @@ struct myra_app_state {
     struct app_info *filtered_apps[NUM_APPS];
     int num_filtered;
     int cursor_visible;
-    uint32_t last_blink;
+    struct hrtimer blink;
+    uint32_t thumb_gen;
 };
 
 static struct myra_app_state *g_myra = NULL;
@@ -100,7 +103,17 @@ static int get_search_score(char *input, const char *candidate) {
 
 static void myra_on_close(struct window *win) {
     (void)win;
-    if (g_myra) g_myra = NULL;
+    if (g_myra) {
+        hrtimer_cancel(&g_myra->blink);
+        g_myra = NULL;
+    }
+}
+
+/* hrtimer callback: search bar cursor */
+static void myra_blink(struct hrtimer *h) {
+    struct myra_app_state *st = h->arg;
+    st->cursor_visible = !st->cursor_visible;
+    wm_request_render(st->win);
 }
 
 static void update_search(void) {
@@ -161,8 +174,14 @@ static void myra_draw(struct window *win) {
         int x = c * cell_w + 10;
         int y = 43 + r * cell_h + 10;
 
-        /* App Icon placeholder */
+        /* App Icon: thumbnail of icon_path once the service has it */
         wm_draw_rect(win, x, y, 40, 40, 0x555555);
+        const char *icon = g_myra->filtered_apps[i]->icon_path;
+        const struct thumb *th = icon ? thumb_lookup(icon, 40) : NULL;
+        if (th) {
+            wm_draw_bitmap(win, x + (40 - th->w) / 2, y + (40 - th->h) / 2,
+                           th->w, th->h, th->pixels, th->w, th->h);
+        }
         
         /* App Name */
         if (g_myra->filtered_apps[i] && g_myra->filtered_apps[i]->name) {
@@ -179,15 +198,13 @@ static void myra_task(void *arg) {
     /* Initialize Blink */
     if (g_myra) {
         g_myra->cursor_visible = 1;
-        g_myra->last_blink = timer_get_ms(); // Ensure timer.h is included
+        hrtimer_start_ms(&g_myra->blink, 500, 500);
     }
 
     while (g_myra) {
-        /* Blink update */
-        uint32_t now = timer_get_ms();
-        if (now - g_myra->last_blink > 500) {
-            g_myra->cursor_visible = !g_myra->cursor_visible;
-            g_myra->last_blink = now;
+        /* Icons decoded in the background */
+        if (thumb_generation() != g_myra->thumb_gen) {
+            g_myra->thumb_gen = thumb_generation();
             wm_request_render(g_myra->win);
         }
 
@@ -272,6 +289,7 @@ static void myra_task(void *arg) {
     /* We stored 'arg' which IS g_myra (or was). */
     struct myra_app_state *st = (struct myra_app_state *)arg;
     g_myra = NULL; /* Just in case */
+    hrtimer_cancel(&st->blink);
     kfree(st);
     task_set_fn_null(task_current_id());
 }
@@ -282,6 +300,7 @@ void myra_app_open(void) {
     g_myra = kmalloc(sizeof(struct myra_app_state));
     if (!g_myra) return;
     memset(g_myra, 0, sizeof(*g_myra));
+    hrtimer_init(&g_myra->blink, myra_blink, g_myra, "myra-blink");
     
     int w = 500, h = 400;
     int screen_w, screen_h;
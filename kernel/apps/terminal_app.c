@@ -7,11 +7,17 @@
 #include "input.h"
 #include <string.h>
 #include "lib.h"
-#include "timer.h"
+#include "hrtimer.h"
 #include "terminal_app.h"
 
 #define TERM_ROWS 24
 #define TERM_COLS 80
+/* bytes parsed per render request before yielding to the shell and WM */
+#define TERM_CHUNK 256
+/* room for a burst of command output between two updates */
+#define TERM_OUT_RING 8192
+#define TERM_IDLE_MS 100
+#define TERM_BLINK_MS 500
 
 struct terminal_app {
     struct pty *pty;
@@ -20,7 +26,7 @@ struct terminal_app {
     int shell_pid;
     struct window *win;
     int cursor_visible;
-    uint32_t last_blink;
+    struct hrtimer blink;
 };
 
 
@@ -29,6 +35,7 @@ static struct terminal_app *g_term = NULL;
 static void terminal_on_close(struct window *win) {
     (void)win;
     if (g_term) {
+        hrtimer_cancel(&g_term->blink);
         /* Kill shell if it's still running */
         if (g_term->shell_pid > 0) task_kill(g_term->shell_pid);
         /* Signal task to exit and kfree */
@@ -36,6 +43,13 @@ static void terminal_on_close(struct window *win) {
     }
 }
 
+/* hrtimer callback: toggle the cursor and have the WM redraw */
+static void term_blink(struct hrtimer *h) {
+    struct terminal_app *t = h->arg;
+    t->cursor_visible = !t->cursor_visible;
+    wm_request_render(t->win);
+}
+
 static void term_render_fn(struct window *win) {
     if (!g_term) return;
     
@@ -52,14 +66,6 @@ static void term_render_fn(struct window *win) {
         }
     }
     
-    /* Blink cursor every 500ms */
-    uint32_t now = timer_get_ms();
-    if (now - g_term->last_blink > 500) {
-        g_term->cursor_visible = !g_term->cursor_visible;
-        g_term->last_blink = now;
-        wm_request_render(win);
-    }
-
     if (g_term->cursor_visible) {
         wm_draw_rect(win, 5 + g_term->cursor_x * 7, 5 + g_term->cursor_y * 10, 6, 9, 0x00AA00);
     }
@@ -67,6 +73,64 @@ static void term_render_fn(struct window *win) {
 
 
 
+/* ANSI Parser State Machine */
+/* State 0: Normal, 1: ESC, 2: '[' (CSI), 3: Params */
+static int term_state = 0;
+static char state_buf[16];
+static int state_idx = 0;
+
+static void term_put_char(struct terminal_app *t, char c) {
+    if (term_state == 0) {
+        if (c == '\x1b') {
+            term_state = 1;
+        } else if (c == '\n') { 
+            t->cursor_x = 0; t->cursor_y++; 
+        } else if (c == '\r') { 
+            t->cursor_x = 0; 
+        } else if (c == '\b') { 
+            if (t->cursor_x > 0) t->cursor_x--; 
+            t->grid[t->cursor_y][t->cursor_x] = ' '; 
+        } else {
+            if (t->cursor_x < TERM_COLS && t->cursor_y < TERM_ROWS) {
+                t->grid[t->cursor_y][t->cursor_x] = c;
+                t->cursor_x++;
+            }
+        }
+    } else if (term_state == 1) {
+        if (c == '[') {
+            term_state = 2;
+            state_idx = 0;
+        } else {
+            term_state = 0; /* invalid, drop */
+        }
+    } else if (term_state == 2) {
+        if (c >= '0' && c <= '9') {
+            if (state_idx < 15) state_buf[state_idx++] = c;
+        } else if (c == ';') {
+            if (state_idx < 15) state_buf[state_idx++] = c;
+        } else {
+            /* Command char */
+            state_buf[state_idx] = '\0';
+            if (strcmp(state_buf, "2") == 0) {
+                /* 2J = clear screen */
+                memset(t->grid, ' ', sizeof(t->grid));
+                t->cursor_x = 0; t->cursor_y = 0;
+            } else if (strcmp(state_buf, "H") == 0) {
+                /* Home cursor (H or f) - ignoring params for now, assume 0,0 */
+                t->cursor_x = 0; t->cursor_y = 0;
+            }
+            term_state = 0;
+        }
+    }
+
+    /* Scroll check */
+    if (t->cursor_y >= TERM_ROWS) {
+        memmove(t->grid[0], t->grid[1], TERM_COLS * (TERM_ROWS - 1));
+        memset(t->grid[TERM_ROWS - 1], ' ', TERM_COLS);
+        t->cursor_y = TERM_ROWS - 1;
+    }
+}
+
 static void term_update_task(void *arg) {
     (void)arg;
     struct terminal_app *my_term = g_term;
@@ -84,6 +148,7 @@ static void term_update_task(void *arg) {
         /* Check shell death */
         if (t->shell_pid > 0 && !task_exists(t->shell_pid)) {
              struct window *w = t->win;
+             hrtimer_cancel(&t->blink);
              g_term = NULL;
              wm_close_window(w);
              break;
@@ -97,78 +162,36 @@ static void term_update_task(void *arg) {
              */
         }
 
-        int count = 0;
         int active = 0;
-        while (g_term && pty_has_out(t->pty)) {
+        const char *seg;
+        size_t n;
+        /* parse straight out of the pty ring, one contiguous run at a time */
+        while (g_term && (n = pty_peek_out(t->pty, &seg)) > 0) {
              active = 1;
-             char c = pty_read_out(t->pty);
-
-             /* ANSI Parser State Machine */
-             /* State 0: Normal, 1: ESC, 2: '[' (CSI), 3: Params */
-             static int term_state = 0;
-             static char state_buf[16];
-             static int state_idx = 0;
-
-             if (term_state == 0) {
-                 if (c == '\x1b') {
-                     term_state = 1;
-                 } else if (c == '\n') { 
-                     t->cursor_x = 0; t->cursor_y++; 
-                 } else if (c == '\r') { 
-                     t->cursor_x = 0; 
-                 } else if (c == '\b') { 
-                     if (t->cursor_x > 0) t->cursor_x--; 
-                     t->grid[t->cursor_y][t->cursor_x] = ' '; 
-                 } else {
-                     if (t->cursor_x < TERM_COLS && t->cursor_y < TERM_ROWS) {
-                         t->grid[t->cursor_y][t->cursor_x] = c;
-                         t->cursor_x++;
-                     }
-                 }
-             } else if (term_state == 1) {
-                 if (c == '[') {
-                     term_state = 2;
-                     state_idx = 0;
-                 } else {
-                     term_state = 0; /* invalid, drop */
-                 }
-             } else if (term_state == 2) {
-                 if (c >= '0' && c <= '9') {
-                     if (state_idx < 15) state_buf[state_idx++] = c;
-                 } else if (c == ';') {
-                     if (state_idx < 15) state_buf[state_idx++] = c;
-                 } else {
-                     /* Command char */
-                     state_buf[state_idx] = '\0';
-                     if (strcmp(state_buf, "2") == 0) {
-                         /* 2J = clear screen */
-                         memset(t->grid, ' ', sizeof(t->grid));
-                         t->cursor_x = 0; t->cursor_y = 0;
-                     } else if (strcmp(state_buf, "H") == 0) {
-                         /* Home cursor (H or f) - ignoring params for now, assume 0,0 */
-                         t->cursor_x = 0; t->cursor_y = 0;
-                     }
-                     term_state = 0;
-                 }
-             }
-
-             /* Scroll check */
-             if (t->cursor_y >= TERM_ROWS) {
-                 memmove(t->grid[0], t->grid[1], TERM_COLS * (TERM_ROWS - 1));
-                 memset(t->grid[TERM_ROWS - 1], ' ', TERM_COLS);
-                 t->cursor_y = TERM_ROWS - 1;
-             }
+             if (n > TERM_CHUNK) n = TERM_CHUNK;
+             for (size_t i = 0; i < n; i++) term_put_char(t, seg[i]);
+             pty_consume_out(t->pty, n);
+
+             /* solid while output arrives; the blink restarts after it */
              t->cursor_visible = 1;
-             t->last_blink = timer_get_ms();
+             hrtimer_start_ms(&t->blink, TERM_BLINK_MS, TERM_BLINK_MS);
              wm_request_render(t->win);
-
-             if (++count > 64) { count = 0; yield(); }
+             yield();
+        }
+        if (!active && g_term) {
+            /* sleep until the shell writes or a key reaches the window; the
+               timeout is only there to notice the shell exiting */
+            struct poll_item it[2] = {
+                { pty_term_waitable(t->pty), POLLIN, 0 },
+                { &t->win->input_w, POLLIN, 0 },
+            };
+            poll(it, 2, TERM_IDLE_MS);
         }
-        if (!active) yield();
     }
     
     /* Cleanup */
     if (my_term) {
+        hrtimer_cancel(&my_term->blink);
         if (my_term->shell_pid > 0 && task_exists(my_term->shell_pid)) task_kill(my_term->shell_pid);
         pty_free(my_term->pty);
         kfree(my_term);
@@ -187,17 +210,18 @@ void terminal_app_start(void) {
     memset(g_term, 0, sizeof(*g_term));
     uart_puts("[terminal] g_term memset done\n");
     
-    g_term->pty = pty_alloc();
+    g_term->pty = pty_alloc_sized(PTY_IN_SIZE, TERM_OUT_RING);
     uart_puts("[terminal] pty alloc: "); uart_put_hex((uintptr_t)g_term->pty); uart_puts("\n");
 
     g_term->cursor_visible = 1;
-    g_term->last_blink = timer_get_ms();
     
     g_term->win = wm_create_window("Terminal", 50, 50, 600, 300, term_render_fn);
     uart_puts("[terminal] window allocated at: "); uart_put_hex((uintptr_t)g_term->win); uart_puts("\n");
     
     g_term->win->on_close = terminal_on_close;
     g_term->win->tty = g_term->pty; /* Redirect input handled by WM */
+    hrtimer_init(&g_term->blink, term_blink, g_term, "term-blink");
+    hrtimer_start_ms(&g_term->blink, TERM_BLINK_MS, TERM_BLINK_MS);
     // g_term->win->tty = NULL;
     
     uart_puts("[terminal] About to create task. Checking task list...\n");
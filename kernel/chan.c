@@ -0,0 +1,198 @@
+#include "chan.h"
+#include "sched.h"
+#include "kmalloc.h"
+#include "palloc.h"
+#include "lib.h"
+
+#define CALL_PENDING 0
+#define CALL_DONE    1
+#define CALL_DROPPED 2
+
+/* One per chan_call, shared by the caller and the request in flight */
+struct chan_call {
+    int refs;
+    volatile int state;
+    volatile uint32_t gen;
+    struct chan_msg reply;
+};
+
+static void call_put(struct chan_call *k) {
+    if (--k->refs > 0) return;
+    /* a reply nobody collected */
+    if (k->state == CALL_DONE && k->reply.page) chan_page_free(k->reply.page);
+    kfree(k);
+}
+
+static void call_finish(struct chan_call *k, int state) {
+    k->state = state;
+    k->gen++;
+    task_wake_event(k);
+    call_put(k);
+}
+
+static uint32_t chan_ready(struct waitable *w) {
+    struct chan *c = container_of(w, struct chan, w);
+    uint32_t r = 0;
+    if (!ring_empty(&c->q)) r |= POLLIN;
+    if (c->closed) r |= POLLHUP;
+    else if (ring_space(&c->q)) r |= POLLOUT;
+    return r;
+}
+
+static void changed(struct chan *c) {
+    c->gen++;
+    task_wake_event(c);
+    waitable_notify(&c->w);
+}
+
+/* Sleep until gen moves past seen; 0 once the deadline has passed */
+static int wait_change(volatile uint32_t *gen, void *ev, uint32_t seen, int timeout_ms, uint32_t until) {
+    if (timeout_ms == 0) return 0;
+    if (timeout_ms < 0) {
+        task_wait_event_unless(ev, gen, seen);
+        return 1;
+    }
+    if ((int32_t)(scheduler_get_tick() - until) >= 0) return 0;
+    task_wait_event_until(ev, gen, seen, until);
+    return 1;
+}
+
+struct chan *chan_create(uint32_t depth) {
+    if (depth == 0 || depth > CHAN_MAX_DEPTH) return NULL;
+    uint32_t n = 1;
+    while (n < depth) n <<= 1;
+    struct chan *c = kmalloc(sizeof(*c) + n * sizeof(struct chan_msg));
+    if (!c) return NULL;
+    memset(c, 0, sizeof(*c));
+    ring_init(&c->q, c + 1, n, sizeof(struct chan_msg));
+    waitable_init(&c->w, chan_ready);
+    c->refs = 1;
+    return c;
+}
+
+void chan_get(struct chan *c) {
+    c->refs++;
+}
+
+void chan_put(struct chan *c) {
+    if (--c->refs > 0) return;
+    struct chan_msg m;
+    while (ring_pop(&c->q, &m)) chan_msg_drop(&m);
+    waitable_detach(&c->w);
+    kfree(c);
+}
+
+void chan_close(struct chan *c) {
+    c->closed = 1;
+    changed(c);
+}
+
+int chan_send(struct chan *c, struct chan_msg *m, int timeout_ms) {
+    uint32_t until = scheduler_get_tick() + (uint32_t)timeout_ms;
+    int r = CHAN_OK;
+    chan_get(c);
+    for (;;) {
+        uint32_t seen = c->gen;
+        if (c->closed) { r = CHAN_CLOSED; break; }
+        if (ring_space(&c->q)) break;
+        c->send_waits++;
+        if (!wait_change(&c->gen, c, seen, timeout_ms, until)) { r = CHAN_TIMEDOUT; break; }
+    }
+    if (r == CHAN_OK) {
+        m->sender = task_current_id();
+        if (m->call) m->call->refs++;       /* the queued request holds the call */
+        ring_push(&c->q, m);
+        c->sent++;
+        changed(c);
+    }
+    chan_put(c);
+    return r;
+}
+
+int chan_recv(struct chan *c, struct chan_msg *m, int timeout_ms) {
+    uint32_t until = scheduler_get_tick() + (uint32_t)timeout_ms;
+    int r = CHAN_OK;
+    chan_get(c);
+    for (;;) {
+        uint32_t seen = c->gen;
+        if (ring_pop(&c->q, m)) break;
+        if (c->closed) { r = CHAN_CLOSED; break; }
+        c->recv_waits++;
+        if (!wait_change(&c->gen, c, seen, timeout_ms, until)) { r = CHAN_TIMEDOUT; break; }
+    }
+    if (r == CHAN_OK) {
+        c->received++;
+        changed(c);
+    }
+    chan_put(c);
+    return r;
+}
+
+/* The caller was killed while waiting for its answer */
+static void call_abandon(void *arg) {
+    call_put((struct chan_call *)arg);
+}
+
+int chan_call(struct chan *c, struct chan_msg *req, struct chan_msg *reply, int timeout_ms) {
+    uint32_t until = scheduler_get_tick() + (uint32_t)timeout_ms;
+    struct chan_call *k = kmalloc(sizeof(*k));
+    if (!k) return CHAN_CLOSED;
+    memset(k, 0, sizeof(*k));
+    k->refs = 1;
+
+    req->call = k;
+    int r = chan_send(c, req, timeout_ms);
+    req->call = NULL;
+    if (r != CHAN_OK) {
+        call_put(k);
+        return r;
+    }
+
+    task_set_reap_hook(call_abandon, k);
+    for (;;) {
+        uint32_t seen = k->gen;
+        if (k->state != CALL_PENDING) break;
+        if (!wait_change(&k->gen, k, seen, timeout_ms, until)) break;
+    }
+    task_set_reap_hook(0, 0);
+
+    if (k->state == CALL_DONE) {
+        *reply = k->reply;
+        k->reply.page = NULL;               /* now the caller's */
+        r = CHAN_OK;
+    } else {
+        r = k->state == CALL_DROPPED ? CHAN_CLOSED : CHAN_TIMEDOUT;
+    }
+    call_put(k);
+    return r;
+}
+
+int chan_reply(struct chan_msg *req, struct chan_msg *reply) {
+    struct chan_call *k = req->call;
+    if (!k) return -1;
+    req->call = NULL;
+    k->reply = *reply;
+    k->reply.sender = task_current_id();
+    k->reply.call = NULL;
+    call_finish(k, CALL_DONE);
+    return 0;
+}
+
+void chan_msg_drop(struct chan_msg *m) {
+    if (m->page) {
+        chan_page_free(m->page);
+        m->page = NULL;
+    }
+    if (m->call) {
+        call_finish(m->call, CALL_DROPPED);
+        m->call = NULL;
+    }
+}
+
+void *chan_page_alloc(void) {
+    return palloc_alloc();
+}
+
+void chan_page_free(void *page) {
+    palloc_free_one(page);
+}
@@ -0,0 +1,84 @@
+#ifndef CHAN_H
+#define CHAN_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ring.h"
+#include "poll.h"
+
+/* Message channels between tasks.
+ *
+ * A channel is a bounded queue of fixed-size messages. A message carries
+ * up to CHAN_INLINE bytes in its header and may carry one page on top:
+ * sending a page hands it over rather than copying it, so after a
+ * successful send the sender must not touch it, and the receiver frees
+ * it (chan_page_free) or passes it on. Any task may send or receive;
+ * both block while the queue is full / empty, up to a timeout.
+ *
+ * chan_call sends a request and waits for the answer that the receiver
+ * gives with chan_reply. A receiver that drops a request without
+ * answering should use chan_msg_drop, which fails the caller at once.
+ *
+ * Channels are for tasks only, not IRQ handlers. The waitable reports
+ * POLLIN with messages queued, POLLOUT with room, POLLHUP once closed. */
+
+#define CHAN_INLINE     32
+#define CHAN_MAX_DEPTH  256
+
+#define CHAN_OK         0
+#define CHAN_TIMEDOUT   1       /* also: would block, with timeout 0 */
+#define CHAN_CLOSED     2
+
+struct chan_call;
+
+struct chan_msg {
+    uint32_t type;              /* meaning is up to the users of the channel */
+    uint32_t len;               /* bytes in page if there is one, else in data */
+    int sender;                 /* task id, filled in by the send */
+    uint32_t arg;
+    void *page;                 /* optional PAGE_SIZE payload, owned by the holder */
+    struct chan_call *call;     /* set by chan_call: where the reply goes */
+    uint8_t data[CHAN_INLINE];
+};
+
+struct chan {
+    struct ring q;
+    struct waitable w;
+    volatile uint32_t gen;      /* bumped on every change; waiters sleep on it */
+    int closed;
+    int refs;
+    uint32_t sent, received, send_waits, recv_waits;
+};
+
+/* depth is rounded up to a power of two. Returns NULL on failure */
+struct chan *chan_create(uint32_t depth);
+/* Another holder; each chan_get needs a chan_put */
+void chan_get(struct chan *c);
+/* Drop a reference; the last one frees the channel and what is still queued */
+void chan_put(struct chan *c);
+/* Refuse new messages and wake everyone. Queued messages can still be received. */
+void chan_close(struct chan *c);
+
+/* timeout_ms < 0 waits for as long as it takes, 0 does not wait.
+ * Return CHAN_OK, CHAN_TIMEDOUT or CHAN_CLOSED. On anything but
+ * CHAN_OK a page stays with the sender. */
+int chan_send(struct chan *c, struct chan_msg *m, int timeout_ms);
+int chan_recv(struct chan *c, struct chan_msg *m, int timeout_ms);
+
+/* Request/reply. The timeout covers both the send and the answer; a reply
+ * that arrives after the caller gave up is discarded. A receiver that
+ * drops the request makes the call return CHAN_CLOSED. */
+int chan_call(struct chan *c, struct chan_msg *req, struct chan_msg *reply, int timeout_ms);
+/* Answer a request received from chan_recv; -1 if it was not a call */
+int chan_reply(struct chan_msg *req, struct chan_msg *reply);
+/* Dispose of a received message: free its page, fail its caller */
+void chan_msg_drop(struct chan_msg *m);
+
+void *chan_page_alloc(void);
+void chan_page_free(void *page);
+
+static inline struct waitable *chan_waitable(struct chan *c) {
+    return &c->w;
+}
+
+#endif
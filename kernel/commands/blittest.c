@@ -0,0 +1,142 @@
+#include "programs.h"
+#include "dma_blit.h"
+#include "kmalloc.h"
+#include "timer.h"
+#include "lib.h"
+#include <string.h>
+
+/* blittest
+ * Checks the DMA blitter against a CPU reference on offscreen surfaces
+ * (fills, copies, overlapping scrolls and a chained batch), then times a
+ * full-screen-sized fill and copy both ways. Runs under QEMU -M raspi3b,
+ * which emulates the BCM DMA controller. */
+
+#define BT_W 1024
+#define BT_H 768
+#define BT_PITCH (BT_W * 4)
+
+static void ref_fill(uint32_t *buf, int x, int y, int w, int h, uint32_t color) {
+    for (int j = 0; j < h; j++)
+        for (int i = 0; i < w; i++) buf[(y + j) * BT_W + x + i] = color;
+}
+
+static void ref_copy(uint32_t *dst, int dx, int dy, const uint32_t *src, int sx, int sy, int w, int h) {
+    int down = (dst == src) && (dy > sy || (dy == sy && dx > sx));
+    for (int j = 0; j < h; j++) {
+        int r = down ? h - 1 - j : j;
+        memmove(&dst[(dy + r) * BT_W + dx], &src[(sy + r) * BT_W + sx], (size_t)w * 4);
+    }
+}
+
+static void dma_or_cpu_fill(uint32_t *buf, int x, int y, int w, int h, uint32_t color) {
+    if (dma_blit_fill(&buf[y * BT_W + x], BT_PITCH, w, h, color) < 0) ref_fill(buf, x, y, w, h, color);
+}
+
+static void dma_or_cpu_copy(uint32_t *dst, int dx, int dy, const uint32_t *src, int sx, int sy, int w, int h) {
+    if (dma_blit_copy(&dst[dy * BT_W + dx], BT_PITCH, &src[sy * BT_W + sx], BT_PITCH, w, h) < 0)
+        ref_copy(dst, dx, dy, src, sx, sy, w, h);
+}
+
+static uint32_t lcg(uint32_t *s) {
+    *s = *s * 1103515245u + 12345u;
+    return *s >> 8;
+}
+
+int prog_blittest(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap) {
+    (void)argc; (void)argv; (void)in; (void)in_len;
+    size_t off = 0;
+    if (!dma_blit_available()) {
+        out_puts(out, out_cap, &off, "DMA blitter not available on this target\n");
+        return (int)off;
+    }
+
+    size_t bytes = (size_t)BT_W * BT_H * 4;
+    uint32_t *a = kmalloc(bytes), *b = kmalloc(bytes), *src = kmalloc(bytes);
+    if (!a || !b || !src) {
+        out_puts(out, out_cap, &off, "out of memory\n");
+        if (a) kfree(a);
+        if (b) kfree(b);
+        if (src) kfree(src);
+        return (int)off;
+    }
+    uint32_t seed = 1;
+    for (int i = 0; i < BT_W * BT_H; i++) { src[i] = lcg(&seed) | 0xFF000000; a[i] = b[i] = 0; }
+
+    /* a: DMA (with CPU fallback for small rects), b: CPU reference */
+    int errors = 0, ops = 0;
+    for (int round = 0; round < 200; ++round) {
+        int w = 1 + lcg(&seed) % 400, h = 1 + lcg(&seed) % 300;
+        int x = lcg(&seed) % (BT_W - w), y = lcg(&seed) % (BT_H - h);
+        int kind = lcg(&seed) % 3;
+        if (kind == 0) {
+            uint32_t c = lcg(&seed) | 0xFF000000;
+            dma_or_cpu_fill(a, x, y, w, h, c);
+            ref_fill(b, x, y, w, h, c);
+        } else if (kind == 1) {
+            int sx = lcg(&seed) % (BT_W - w), sy = lcg(&seed) % (BT_H - h);
+            dma_or_cpu_copy(a, x, y, src, sx, sy, w, h);
+            ref_copy(b, x, y, src, sx, sy, w, h);
+        } else {
+            /* in-place scroll by a few rows, either direction */
+            int sy = y + (int)(lcg(&seed) % 40) - 20;
+            if (sy < 0) sy = 0;
+            if (sy + h > BT_H) sy = BT_H - h;
+            dma_or_cpu_copy(a, x, y, a, x, sy, w, h);
+            ref_copy(b, x, y, b, x, sy, w, h);
+        }
+        ops++;
+    }
+
+    /* One chain: a grid of disjoint fills */
+    dma_blit_begin();
+    for (int j = 0; j < 6; j++) {
+        for (int i = 0; i < 8; i++) {
+            uint32_t c = 0xFF000000 | (uint32_t)(i * 31 + j * 17);
+            dma_or_cpu_fill(a, i * 128, j * 128, 120, 120, c);
+            ref_fill(b, i * 128, j * 128, 120, 120, c);
+            ops++;
+        }
+    }
+    dma_blit_end();
+
+    for (int i = 0; i < BT_W * BT_H; i++) if (a[i] != b[i]) errors++;
+    out_puts(out, out_cap, &off, "check: ");
+    out_putd(out, out_cap, &off, ops);
+    out_puts(out, out_cap, &off, " ops, ");
+    out_putd(out, out_cap, &off, errors);
+    out_puts(out, out_cap, &off, errors ? " pixels differ  FAIL\n" : " pixels differ  OK\n");
+
+    /* Timing: full-surface fill and copy */
+    uint64_t t0 = timer_get_us();
+    dma_blit_fill(a, BT_PITCH, BT_W, BT_H, 0xFF336699);
+    uint64_t t1 = timer_get_us();
+    ref_fill(b, 0, 0, BT_W, BT_H, 0xFF336699);
+    uint64_t t2 = timer_get_us();
+    dma_blit_copy(a, BT_PITCH, src, BT_PITCH, BT_W, BT_H);
+    uint64_t t3 = timer_get_us();
+    ref_copy(b, 0, 0, src, 0, 0, BT_W, BT_H);
+    uint64_t t4 = timer_get_us();
+
+    out_puts(out, out_cap, &off, "fill 1024x768: dma ");
+    out_putd(out, out_cap, &off, (int)(t1 - t0));
+    out_puts(out, out_cap, &off, " us, cpu ");
+    out_putd(out, out_cap, &off, (int)(t2 - t1));
+    out_puts(out, out_cap, &off, " us\ncopy 1024x768: dma ");
+    out_putd(out, out_cap, &off, (int)(t3 - t2));
+    out_puts(out, out_cap, &off, " us, cpu ");
+    out_putd(out, out_cap, &off, (int)(t4 - t3));
+    out_puts(out, out_cap, &off, " us\n");
+
+    uint32_t rects, chains;
+    dma_blit_stats(&rects, &chains);
+    out_puts(out, out_cap, &off, "since boot: ");
+    out_putd(out, out_cap, &off, (int)rects);
+    out_puts(out, out_cap, &off, " rects in ");
+    out_putd(out, out_cap, &off, (int)chains);
+    out_puts(out, out_cap, &off, " chains\n");
+
+    kfree(a);
+    kfree(b);
+    kfree(src);
+    return (int)off;
+}
@@ -0,0 +1,69 @@
+#include "programs.h"
+#include "kconsole.h"
+#include "virtio_console.h"
+#include "lib.h"
+#include <string.h>
+
+/* console                  which device is the system console, and the
+ *                          virtio-console ports with their counters
+ * console use uart|virtio  switch the system console
+ * console shell <port>     run a shell on a virtio-console port
+ *                          (QEMU: -device virtio-serial-device
+ *                           -device virtserialport,chardev=...) */
+
+static void show(char *out, size_t out_cap, size_t *off) {
+    out_puts(out, out_cap, off, "console: ");
+    out_puts(out, out_cap, off, kconsole_device() == KCONSOLE_VIRTIO ? "virtio-console\n" : "uart (PL011)\n");
+    if (!virtio_console_present()) {
+        out_puts(out, out_cap, off, "no virtio-console device\n");
+        return;
+    }
+    for (int i = 0; i < VCON_MAX_PORTS; i++) {
+        struct vcon_port_info info;
+        if (!virtio_console_port_info(i, &info)) continue;
+        out_puts(out, out_cap, off, "port ");
+        out_putd(out, out_cap, off, i);
+        if (info.name[0]) {
+            out_puts(out, out_cap, off, " '");
+            out_puts(out, out_cap, off, info.name);
+            out_puts(out, out_cap, off, "'");
+        }
+        if (info.console) out_puts(out, out_cap, off, " console");
+        out_puts(out, out_cap, off, info.host_open ? " open" : " closed");
+        out_puts(out, out_cap, off, ": tx ");
+        out_putd(out, out_cap, off, (int)info.tx_bytes);
+        out_puts(out, out_cap, off, " bytes in ");
+        out_putd(out, out_cap, off, (int)info.kicks);
+        out_puts(out, out_cap, off, " kicks, rx ");
+        out_putd(out, out_cap, off, (int)info.rx_bytes);
+        out_puts(out, out_cap, off, ", dropped ");
+        out_putd(out, out_cap, off, (int)info.tx_dropped);
+        out_puts(out, out_cap, off, "/");
+        out_putd(out, out_cap, off, (int)info.rx_dropped);
+        out_puts(out, out_cap, off, "\n");
+    }
+}
+
+int prog_console(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap) {
+    (void)in; (void)in_len;
+    size_t off = 0;
+    if (argc == 1) {
+        show(out, out_cap, &off);
+    } else if (argc > 2 && strcmp(argv[1], "use") == 0) {
+        int dev = strcmp(argv[2], "virtio") == 0 ? KCONSOLE_VIRTIO :
+                  strcmp(argv[2], "uart") == 0 ? KCONSOLE_UART : -1;
+        if (dev < 0 || kconsole_select(dev) < 0) out_puts(out, out_cap, &off, "console: no such device\n");
+    } else if (argc > 2 && strcmp(argv[1], "shell") == 0) {
+        int pid = kconsole_start_shell(atoi(argv[2]));
+        if (pid < 0) {
+            out_puts(out, out_cap, &off, "console: no such port\n");
+        } else {
+            out_puts(out, out_cap, &off, "started pid ");
+            out_putd(out, out_cap, &off, pid);
+            out_puts(out, out_cap, &off, "\n");
+        }
+    } else {
+        out_puts(out, out_cap, &off, "usage: console [use uart|virtio | shell <port>]\n");
+    }
+    return (int)off;
+}
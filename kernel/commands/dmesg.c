@@ -0,0 +1,73 @@
+#include "programs.h"
+#include "klog.h"
+#include "lib.h"
+#include <string.h>
+
+/* dmesg                      print the kernel log ring (newest lines that fit)
+ * dmesg -c                   print, then clear
+ * dmesg -C                   clear
+ * dmesg -n <level>           console level: records at or below it go to the UART
+ * dmesg -l                   show the per-subsystem levels
+ * dmesg -l <sub|all> <level> set what a subsystem records
+ * Levels: err, warn, info, debug (or 0-3). */
+
+static void show_ring(char *out, size_t out_cap, size_t *off) {
+    char line[192];
+    size_t len, total = 0;
+    uint32_t seq = 0;
+    /* first pass sizes the log so the newest lines are the ones kept */
+    while ((len = klog_read(&seq, line, sizeof(line))) > 0) total += len;
+    size_t room = out_cap > *off + 1 ? out_cap - *off - 1 : 0;
+    seq = 0;
+    while ((len = klog_read(&seq, line, sizeof(line))) > 0) {
+        if (total > room) { total -= len; continue; }
+        out_puts(out, out_cap, off, line);
+    }
+}
+
+static void show_levels(char *out, size_t out_cap, size_t *off) {
+    out_puts(out, out_cap, off, "console: ");
+    out_puts(out, out_cap, off, klog_level_name(klog_get_console_level()));
+    out_puts(out, out_cap, off, "\n");
+    for (int s = 0; s < KLOG_NSUBS; s++) {
+        out_puts(out, out_cap, off, klog_sub_name(s));
+        out_puts(out, out_cap, off, ": ");
+        out_puts(out, out_cap, off, klog_level_name(klog_level[s]));
+        out_puts(out, out_cap, off, "\n");
+    }
+    out_putd(out, out_cap, off, (int)klog_total());
+    out_puts(out, out_cap, off, " records logged, ");
+    out_putd(out, out_cap, off, (int)klog_console_lost());
+    out_puts(out, out_cap, off, " overwritten before the console showed them\n");
+}
+
+int prog_dmesg(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap) {
+    (void)in; (void)in_len;
+    size_t off = 0;
+    if (argc == 1) {
+        show_ring(out, out_cap, &off);
+    } else if (strcmp(argv[1], "-c") == 0) {
+        show_ring(out, out_cap, &off);
+        klog_clear();
+    } else if (strcmp(argv[1], "-C") == 0) {
+        klog_clear();
+    } else if (strcmp(argv[1], "-n") == 0 && argc > 2) {
+        int level = klog_level_by_name(argv[2]);
+        if (level < 0) out_puts(out, out_cap, &off, "dmesg: unknown level\n");
+        else klog_set_console_level(level);
+    } else if (strcmp(argv[1], "-l") == 0 && argc == 2) {
+        show_levels(out, out_cap, &off);
+    } else if (strcmp(argv[1], "-l") == 0 && argc > 3) {
+        int level = klog_level_by_name(argv[3]);
+        int sub = strcmp(argv[2], "all") == 0 ? KLOG_NSUBS : klog_sub_by_name(argv[2]);
+        if (level < 0 || sub < 0) {
+            out_puts(out, out_cap, &off, "dmesg: unknown subsystem or level\n");
+        } else {
+            for (int s = 0; s < KLOG_NSUBS; s++)
+                if (sub == KLOG_NSUBS || s == sub) klog_level[s] = (uint8_t)level;
+        }
+    } else {
+        out_puts(out, out_cap, &off, "usage: dmesg [-c | -C | -n <level> | -l [<sub|all> <level>]]\n");
+    }
+    return (int)off;
+}
@@ -0,0 +1,40 @@
+#include "programs.h"
+#include "etask.h"
+#include "lib.h"
+#include <string.h>
+
+/* etasks
+ * Lists the stackless event tasks with how often each handler ran, then
+ * how many switches into etaskd those runs took and the memory they use
+ * next to what the same jobs take as kernel tasks. */
+
+int prog_etasks(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap) {
+    (void)argc; (void)argv; (void)in; (void)in_len;
+    size_t off = 0;
+    out_puts(out, out_cap, &off, "NAME             RUNS      STATE\n");
+    const char *name;
+    uint32_t runs;
+    int waiting;
+    for (int i = 0; etask_info(i, &name, &runs, &waiting); i++) {
+        char num[16];
+        out_putpad(out, out_cap, &off, name, 17);
+        fmt_dec(num, (int)runs);
+        out_putpad(out, out_cap, &off, num, 10);
+        out_puts(out, out_cap, &off, waiting ? "waiting\n" : "ready\n");
+    }
+
+    struct etask_stats st;
+    etask_get_stats(&st);
+    out_putd(out, out_cap, &off, st.tasks);
+    out_puts(out, out_cap, &off, " event tasks: ");
+    out_putd(out, out_cap, &off, (int)st.runs);
+    out_puts(out, out_cap, &off, " handler runs in ");
+    out_putd(out, out_cap, &off, (int)st.passes);
+    out_puts(out, out_cap, &off, " switches to etaskd\n");
+    out_puts(out, out_cap, &off, "memory: ");
+    out_putd(out, out_cap, &off, (int)(st.bytes / 1024));
+    out_puts(out, out_cap, &off, " KB with etaskd, ");
+    out_putd(out, out_cap, &off, (int)(st.thread_bytes / 1024));
+    out_puts(out, out_cap, &off, " KB as kernel tasks\n");
+    return (int)off;
+}
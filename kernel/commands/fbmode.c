@@ -0,0 +1,93 @@
+#include "programs.h"
+#include "timer.h"
+#include "wm.h"
+#include "lib.h"
+#include <string.h>
+#ifdef REAL
+#include "rpi_fx.h"
+#endif
+
+/* fbmode                  show scanout depth, dithering and mapping
+ * fbmode 16|32            switch the Pi framebuffer depth
+ * fbmode dither on|off    ordered dithering for RGB565
+ * fbmode cache on|off     scanout mapped write-back or Normal-NC
+ * fbmode bench [frames]   full-screen redraw rate for each depth with a
+ *                         cached and an uncached scanout, then restore
+ *                         the current mode */
+
+#define FBMODE_BENCH_FRAMES 20
+
+#ifdef REAL
+static void show_mode(char *out, size_t out_cap, size_t *off) {
+    out_puts(out, out_cap, off, "framebuffer: ");
+    out_putd(out, out_cap, off, rpi_gpu_get_depth());
+    out_puts(out, out_cap, off, " bpp");
+    if (rpi_gpu_get_depth() == 16)
+        out_puts(out, out_cap, off, rpi_gpu_get_dither() ? ", dithered" : ", no dither");
+    out_puts(out, out_cap, off, rpi_gpu_get_cached() ? ", write-back\n" : ", uncached\n");
+}
+
+/* Time `frames` full composes (wallpaper, windows, taskbar, flush) */
+static void bench_mode(int depth, int dither, int cached, int frames, char *out, size_t out_cap, size_t *off) {
+    out_puts(out, out_cap, off, depth == 32 ? "32 bpp         " : (dither ? "16 bpp dither  " : "16 bpp         "));
+    out_puts(out, out_cap, off, cached ? "wb  " : "nc  ");
+    if (rpi_gpu_set_depth(depth) < 0 || rpi_gpu_set_cached(cached) < 0) {
+        out_puts(out, out_cap, off, "switch failed\n");
+        return;
+    }
+    rpi_gpu_set_dither(dither);
+    uint64_t t0 = timer_get_us();
+    for (int i = 0; i < frames; i++) {
+        wm_request_redraw();
+        wm_compose();
+    }
+    uint64_t us = timer_get_us() - t0;
+    if (us == 0) us = 1;
+    out_putd(out, out_cap, off, (int)(us / frames / 1000));
+    out_puts(out, out_cap, off, " ms/frame, ");
+    uint64_t fps10 = (uint64_t)frames * 10000000ULL / us;
+    out_putd(out, out_cap, off, (int)(fps10 / 10));
+    out_puts(out, out_cap, off, ".");
+    out_putd(out, out_cap, off, (int)(fps10 % 10));
+    out_puts(out, out_cap, off, " fps\n");
+}
+#endif
+
+int prog_fbmode(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap) {
+    (void)in; (void)in_len;
+    size_t off = 0;
+#ifndef REAL
+    (void)argc; (void)argv;
+    out_puts(out, out_cap, &off, "fbmode: only the Raspberry Pi framebuffer has selectable depth\n");
+#else
+    if (argc < 2) {
+        show_mode(out, out_cap, &off);
+    } else if (strcmp(argv[1], "16") == 0 || strcmp(argv[1], "32") == 0) {
+        if (rpi_gpu_set_depth(atoi(argv[1])) < 0) out_puts(out, out_cap, &off, "fbmode: switch failed\n");
+        wm_request_redraw();
+        show_mode(out, out_cap, &off);
+    } else if (strcmp(argv[1], "dither") == 0 && argc > 2) {
+        rpi_gpu_set_dither(strcmp(argv[2], "on") == 0);
+        show_mode(out, out_cap, &off);
+    } else if (strcmp(argv[1], "cache") == 0 && argc > 2) {
+        if (rpi_gpu_set_cached(strcmp(argv[2], "on") == 0) < 0) out_puts(out, out_cap, &off, "fbmode: remap failed\n");
+        show_mode(out, out_cap, &off);
+    } else if (strcmp(argv[1], "bench") == 0) {
+        int frames = (argc > 2) ? atoi(argv[2]) : FBMODE_BENCH_FRAMES;
+        if (frames <= 0) frames = FBMODE_BENCH_FRAMES;
+        int depth = rpi_gpu_get_depth(), dither = rpi_gpu_get_dither(), cached = rpi_gpu_get_cached();
+        for (int c = 1; c >= 0; c--) {
+            bench_mode(32, 0, c, frames, out, out_cap, &off);
+            bench_mode(16, 0, c, frames, out, out_cap, &off);
+            bench_mode(16, 1, c, frames, out, out_cap, &off);
+        }
+        rpi_gpu_set_depth(depth);
+        rpi_gpu_set_cached(cached);
+        rpi_gpu_set_dither(dither);
+        wm_request_redraw();
+    } else {
+        out_puts(out, out_cap, &off, "usage: fbmode [16|32|dither on|off|cache on|off|bench [frames]]\n");
+    }
+#endif
+    return (int)off;
+}
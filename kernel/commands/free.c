@@ -8,15 +8,6 @@
 #include "uart.h" 
 #include <string.h>
 
-/* Helper to formatting int to string */
-static void fmt_int(char *buf, int v) {
-    if (v == 0) { strcpy(buf, "0"); return; }
-    char tmp[16]; int i=0;
-    while(v > 0) { tmp[i++] = (v%10)+'0'; v/=10; }
-    int j=0; while(i>0) buf[j++] = tmp[--i];
-    buf[j] = '\0';
-}
-
 int prog_free(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap) {
     (void)argc; (void)argv; (void)in; (void)in_len;
     /* We need palloc stats */
@@ -28,7 +19,7 @@ int prog_free(int argc, char **argv, const char *in, size_t in_len, char *out, s
     int used = 8;
     
     char num[32];
-    fmt_int(num, (int)free_mem);
+    fmt_dec(num, (int)free_mem);
     
     if (used + strlen(num) + 7 < sizeof(buf)) {
         strcat(buf, num);
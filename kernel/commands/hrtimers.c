@@ -0,0 +1,44 @@
+#include "programs.h"
+#include "hrtimer.h"
+#include "lib.h"
+#include <string.h>
+
+/* hrtimers
+ * Lists the queued kernel timers with the time left until each fires,
+ * then how many callbacks ran and how many comparator interrupts and
+ * reprograms that took. */
+
+int prog_hrtimers(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap) {
+    (void)argc; (void)argv; (void)in; (void)in_len;
+    size_t off = 0;
+    out_puts(out, out_cap, &off, "NAME             DUE(ms)   PERIOD(ms) FIRED\n");
+    const char *name;
+    uint64_t due_us, period_us;
+    uint32_t fired;
+    for (int i = 0; hrtimer_info(i, &name, &due_us, &period_us, &fired); i++) {
+        char num[16];
+        out_putpad(out, out_cap, &off, name, 17);
+        fmt_dec(num, (int)(due_us / 1000));
+        out_putpad(out, out_cap, &off, num, 10);
+        if (period_us) fmt_dec(num, (int)(period_us / 1000));
+        else strcpy(num, "-");
+        out_putpad(out, out_cap, &off, num, 11);
+        out_putd(out, out_cap, &off, (int)fired);
+        out_puts(out, out_cap, &off, "\n");
+    }
+
+    struct hrtimer_stats st;
+    hrtimer_get_stats(&st);
+    out_putd(out, out_cap, &off, st.queued);
+    out_puts(out, out_cap, &off, " queued: ");
+    out_putd(out, out_cap, &off, (int)st.fired);
+    out_puts(out, out_cap, &off, " callbacks, ");
+    out_putd(out, out_cap, &off, (int)st.irqs);
+    out_puts(out, out_cap, &off, " comparator interrupts, ");
+    out_putd(out, out_cap, &off, (int)st.programs);
+    out_puts(out, out_cap, &off, " reprograms, ");
+    out_putd(out, out_cap, &off, (int)st.missed);
+    out_puts(out, out_cap, &off, " missed periods\n");
+    if (!st.irq_wired) out_puts(out, out_cap, &off, "comparator interrupt not wired; expiry is polled\n");
+    return (int)off;
+}
@@ -0,0 +1,132 @@
+#include "programs.h"
+#include "latency.h"
+#include "input.h"
+#include "wm.h"
+#include "framebuffer.h"
+#include "sched.h"
+#include "timer.h"
+#include "lib.h"
+#include <string.h>
+
+/* inlat              input-to-pixel latency per stage (p50/p90/p99/max)
+ * inlat reset        clear the histograms
+ * inlat inject [n]   headless run: clear, then send n key events into a
+ *                    probe window and n mouse nudges, each one waited out
+ *                    until its frame is flushed, and print the table.
+ *                    Needs only the wm and a framebuffer (QEMU virt with
+ *                    -display none is enough). */
+
+#define INLAT_DEFAULT_N  100
+#define INLAT_TIMEOUT_MS 1000
+#define INLAT_PROBE_SCAN 30     /* 'a': no wm shortcut, probe has no tty */
+
+/* right-aligned in `width` columns */
+static void out_col(char *out, size_t out_cap, size_t *off, int v, int width) {
+    char num[16];
+    fmt_dec(num, v);
+    for (int pad = width - (int)strlen(num); pad > 0; pad--) out_puts(out, out_cap, off, " ");
+    out_puts(out, out_cap, off, num);
+}
+
+static void show_table(char *out, size_t out_cap, size_t *off) {
+    out_puts(out, out_cap, off, "stage          count    p50    p90    p99    max  (us)\n");
+    for (int s = 0; s < LAT_NSTAGES; s++) {
+        const char *name = lat_stage_name(s);
+        out_puts(out, out_cap, off, name);
+        for (int pad = 12 - (int)strlen(name); pad > 0; pad--) out_puts(out, out_cap, off, " ");
+        out_col(out, out_cap, off, (int)lat_count(s), 8);
+        out_col(out, out_cap, off, (int)lat_percentile_us(s, 50), 7);
+        out_col(out, out_cap, off, (int)lat_percentile_us(s, 90), 7);
+        out_col(out, out_cap, off, (int)lat_percentile_us(s, 99), 7);
+        out_col(out, out_cap, off, (int)lat_max_us(s), 7);
+        out_puts(out, out_cap, off, "\n");
+    }
+}
+
+static int probe_events = 0;
+
+static void probe_render(struct window *win) {
+    char buf[32] = "events: ";
+    fmt_dec(buf + strlen(buf), probe_events);
+    wm_draw_text(win, 8, 8, buf, 0xFFFFFFFF, 2);
+}
+
+/* Yield until `stage` has `target` samples; -1 on timeout */
+static int wait_count(int stage, uint32_t target) {
+    uint32_t t0 = timer_get_ms();
+    while (lat_count(stage) < target) {
+        if (timer_get_ms() - t0 > INLAT_TIMEOUT_MS) return -1;
+        yield();
+    }
+    return 0;
+}
+
+/* The probe's "app": take the event off the window queue, ask for a render */
+static int probe_consume(struct window *probe) {
+    struct wm_input_event ev;
+    uint32_t t0 = timer_get_ms();
+    while (!wm_pop_key_event(probe, &ev)) {
+        if (timer_get_ms() - t0 > INLAT_TIMEOUT_MS) return -1;
+        yield();
+    }
+    probe_events++;
+    wm_request_render(probe);
+    return 0;
+}
+
+static int inject(int n, char *out, size_t out_cap, size_t *off) {
+    struct window *probe = wm_create_window("latency probe", 40, 40, 240, 64, probe_render);
+    if (!probe) {
+        out_puts(out, out_cap, off, "inlat: cannot create the probe window\n");
+        return -1;
+    }
+    probe_events = 0;
+    lat_reset();
+    int lost = 0;
+
+    /* keys: alternate press and release so nothing is left held */
+    for (int i = 0; i < n; i++) {
+        uint32_t target = lat_count(LAT_KEY_TOTAL) + 1;
+        input_push_event(INPUT_TYPE_KEY, INLAT_PROBE_SCAN, (i & 1) ? 0 : 1);
+        if (probe_consume(probe) < 0 || wait_count(LAT_KEY_TOTAL, target) < 0) lost++;
+    }
+    if (n & 1) input_push_event(INPUT_TYPE_KEY, INLAT_PROBE_SCAN, 0);
+
+    /* mouse: nudge back and forth so the pointer ends where it started */
+    for (int i = 0; i < n; i++) {
+        uint32_t target = lat_count(LAT_MOUSE_TOTAL) + 1;
+        input_push_event(INPUT_TYPE_REL, 0, (i & 1) ? -4 : 4);
+        if (wait_count(LAT_MOUSE_TOTAL, target) < 0) lost++;
+    }
+
+    wm_close_window(probe);
+    if (lost) {
+        out_putd(out, out_cap, off, lost);
+        out_puts(out, out_cap, off, " events never reached the screen\n");
+    }
+    return 0;
+}
+
+int prog_inlat(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap) {
+    (void)in; (void)in_len;
+    size_t off = 0;
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        lat_reset();
+        out_puts(out, out_cap, &off, "latency histograms cleared\n");
+        return (int)off;
+    }
+    if (argc > 1 && strcmp(argv[1], "inject") == 0) {
+        if (!fb_is_init()) {
+            out_puts(out, out_cap, &off, "inlat: no framebuffer\n");
+            return (int)off;
+        }
+        int n = (argc > 2) ? atoi(argv[2]) : INLAT_DEFAULT_N;
+        if (n <= 0) n = INLAT_DEFAULT_N;
+        if (inject(n, out, out_cap, &off) < 0) return (int)off;
+    } else if (argc > 1) {
+        out_puts(out, out_cap, &off, "usage: inlat [reset|inject [n]]\n");
+        return (int)off;
+    }
+    show_table(out, out_cap, &off);
+    return (int)off;
+}
@@ -0,0 +1,90 @@
+#include "programs.h"
+#include "input_rec.h"
+#include "lib.h"
+#include <string.h>
+
+/* inrec start                     record input_push_event() into memory
+ * inrec stop <file>               stop and save the recording
+ * inrec play <file> [-f] [-c] [-o <log>]
+ *                                 replay at the recorded timing (-f: as
+ *                                 fast as the wm drains it), timing every
+ *                                 frame; -c checksums each frame, -o writes
+ *                                 "frame us checksum" lines to <log>
+ *
+ * A scenario ("open terminal, cat file, drag window") is recorded once and
+ * replayed headless on every build; equal scene hashes mean every frame
+ * came out identical, the frame times compare the builds. */
+
+static void out_hex(char *out, size_t out_cap, size_t *off, uint32_t v) {
+    char num[9];
+    for (int i = 0; i < 8; i++) num[i] = "0123456789abcdef"[(v >> (28 - 4 * i)) & 0xF];
+    num[8] = '\0';
+    out_puts(out, out_cap, off, num);
+}
+
+static int play(int argc, char **argv, char *out, size_t out_cap, size_t *off) {
+    int flags = 0;
+    const char *log_path = NULL;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0) flags |= INREC_FAST;
+        else if (strcmp(argv[i], "-c") == 0) flags |= INREC_CHECKSUM;
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) log_path = argv[++i];
+    }
+    struct inrec_result res;
+    int r = inrec_play(argv[2], flags, log_path, &res);
+    if (r == -1) {
+        out_puts(out, out_cap, off, "inrec: cannot replay ");
+        out_puts(out, out_cap, off, argv[2]);
+        out_puts(out, out_cap, off, "\n");
+        return -1;
+    }
+    out_putd(out, out_cap, off, (int)res.events);
+    out_puts(out, out_cap, off, " events in ");
+    out_putd(out, out_cap, off, (int)(res.elapsed_us / 1000));
+    out_puts(out, out_cap, off, " ms, ");
+    out_putd(out, out_cap, off, (int)res.frames);
+    out_puts(out, out_cap, off, " frames");
+    if (res.frames_lost) {
+        out_puts(out, out_cap, off, " (+");
+        out_putd(out, out_cap, off, (int)res.frames_lost);
+        out_puts(out, out_cap, off, " not logged)");
+    }
+    out_puts(out, out_cap, off, "\nframe us: p50 ");
+    out_putd(out, out_cap, off, (int)res.frame_p50_us);
+    out_puts(out, out_cap, off, ", p90 ");
+    out_putd(out, out_cap, off, (int)res.frame_p90_us);
+    out_puts(out, out_cap, off, ", max ");
+    out_putd(out, out_cap, off, (int)res.frame_max_us);
+    out_puts(out, out_cap, off, "\n");
+    if (flags & INREC_CHECKSUM) {
+        out_puts(out, out_cap, off, "scene hash ");
+        out_hex(out, out_cap, off, res.scene_hash);
+        out_puts(out, out_cap, off, "\n");
+    }
+    if (r == -2) out_puts(out, out_cap, off, "inrec: could not write the frame log\n");
+    return 0;
+}
+
+int prog_inrec(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap) {
+    (void)in; (void)in_len;
+    size_t off = 0;
+    if (argc > 1 && strcmp(argv[1], "start") == 0) {
+        if (inrec_start() < 0) out_puts(out, out_cap, &off, "inrec: already recording or replaying\n");
+        else out_puts(out, out_cap, &off, "recording input\n");
+    } else if (argc > 2 && strcmp(argv[1], "stop") == 0) {
+        int n = inrec_stop(argv[2]);
+        if (n < 0) {
+            out_puts(out, out_cap, &off, "inrec: not recording, or cannot write ");
+            out_puts(out, out_cap, &off, argv[2]);
+            out_puts(out, out_cap, &off, "\n");
+        } else {
+            out_putd(out, out_cap, &off, n);
+            out_puts(out, out_cap, &off, " events saved\n");
+        }
+    } else if (argc > 2 && strcmp(argv[1], "play") == 0) {
+        play(argc, argv, out, out_cap, &off);
+    } else {
+        out_puts(out, out_cap, &off, "usage: inrec start | stop <file> | play <file> [-f] [-c] [-o <log>]\n");
+    }
+    return (int)off;
+}
@@ -0,0 +1,43 @@
+#include "programs.h"
+#include "irq.h"
+#include "lib.h"
+#include <string.h>
+
+/* irqstat
+ * One line per installed interrupt: how often it fired, the time spent
+ * in its top half (total and longest) and, for threaded ones, how often
+ * the bottom half ran in irqd and the time it took. */
+
+static void out_num(char *out, size_t out_cap, size_t *off, int v, int width) {
+    char num[16];
+    fmt_dec(num, v);
+    out_puts(out, out_cap, off, num);
+    for (int pad = (int)strlen(num); pad < width; pad++) out_puts(out, out_cap, off, " ");
+}
+
+int prog_irqstat(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap) {
+    (void)argc; (void)argv; (void)in; (void)in_len;
+    size_t off = 0;
+    out_puts(out, out_cap, &off, "IRQ   COUNT     TOP(us)   MAX(us)  THREAD    THR(us)   NAME\n");
+    struct irq_stat st;
+    uint32_t total = 0;
+    for (int i = 0; i < IRQ_NR; i++) {
+        if (!irq_get_stat(i, &st)) continue;
+        total += st.count;
+        out_num(out, out_cap, &off, i, 6);
+        out_num(out, out_cap, &off, (int)st.count, 10);
+        out_num(out, out_cap, &off, (int)st.top_us, 10);
+        out_num(out, out_cap, &off, (int)st.top_max_us, 9);
+        if (st.threaded) {
+            out_num(out, out_cap, &off, (int)st.thread_runs, 10);
+            out_num(out, out_cap, &off, (int)st.thread_us, 10);
+        } else {
+            out_puts(out, out_cap, &off, "-         -         ");
+        }
+        out_puts(out, out_cap, &off, st.name);
+        out_puts(out, out_cap, &off, "\n");
+    }
+    out_num(out, out_cap, &off, (int)total, 0);
+    out_puts(out, out_cap, &off, " interrupts\n");
+    return (int)off;
+}
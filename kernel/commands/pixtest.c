@@ -0,0 +1,119 @@
+#include "programs.h"
+#include "pixel.h"
+#include "simd.h"
+#include "kmalloc.h"
+#include "timer.h"
+#include "lib.h"
+#include <string.h>
+
+/* pixtest
+ * Checks every NEON pixel kernel against its C version on random rows of
+ * every length up to a few hundred pixels and odd alignments, then times
+ * both over a 1024x768 frame, row by row as the framebuffer uses them. */
+
+#define PT_W 1024
+#define PT_H 768
+#define PT_ROUNDS 400
+#define PT_MAXN 600
+
+static uint32_t lcg(uint32_t *s) {
+    *s = *s * 1103515245u + 12345u;
+    return *s >> 8;
+}
+
+/* Mostly opaque, some clear and some translucent pixels, in runs */
+static uint32_t test_pixel(uint32_t *seed, int i) {
+    uint32_t c = lcg(seed) ^ (lcg(seed) << 16);
+    switch ((i / 24 + (int)(*seed & 1)) % 4) {
+    case 0: return c | 0xFF000000;
+    case 1: return c & 0x00FFFFFF;
+    default: return c;
+    }
+}
+
+enum { K_FILL, K_COPY, K_BLEND, K_TO_RGBA, K_TO_ARGB, K_565, K_COUNT };
+static const char *kernel_names[K_COUNT] = { "fill", "copy", "blend", "argb->rgba", "rgba->argb", "rgb565" };
+
+/* Run kernel k once over n pixels, C or NEON */
+static void run_kernel(int k, int neon, uint32_t *dst, const uint32_t *src, int n, uint32_t color) {
+    if (neon) kernel_neon_begin();
+    switch (k) {
+    case K_FILL: if (neon) pix_fill_neon(dst, color, n); else pix_fill_c(dst, color, n); break;
+    case K_COPY: if (neon) pix_copy_neon(dst, src, n); else pix_copy_c(dst, src, n); break;
+    case K_BLEND: if (neon) pix_blend_neon(dst, src, n); else pix_blend_c(dst, src, n); break;
+    case K_TO_RGBA: if (neon) pix_argb_to_rgba_neon((uint8_t *)dst, src, n); else pix_argb_to_rgba_c((uint8_t *)dst, src, n); break;
+    case K_TO_ARGB: if (neon) pix_rgba_to_argb_neon(dst, (const uint8_t *)src, n); else pix_rgba_to_argb_c(dst, (const uint8_t *)src, n); break;
+    case K_565: if (neon) pix_pack_rgb565_neon((uint16_t *)dst, src, n); else pix_pack_rgb565_c((uint16_t *)dst, src, n); break;
+    }
+    if (neon) kernel_neon_end();
+}
+
+int prog_pixtest(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap) {
+    (void)argc; (void)argv; (void)in; (void)in_len;
+    size_t off = 0;
+    if (!pix_simd_available() || !pix_get_simd()) {
+        out_puts(out, out_cap, &off, "NEON pixel kernels not available on this build\n");
+        return (int)off;
+    }
+
+    size_t bytes = (size_t)PT_W * PT_H * 4;
+    uint32_t *src = kmalloc(bytes), *a = kmalloc(bytes), *b = kmalloc(bytes);
+    if (!src || !a || !b) {
+        out_puts(out, out_cap, &off, "out of memory\n");
+        if (src) kfree(src);
+        if (a) kfree(a);
+        if (b) kfree(b);
+        return (int)off;
+    }
+    uint32_t seed = 1;
+    for (int i = 0; i < PT_W * PT_H; i++) src[i] = test_pixel(&seed, i);
+
+    /* Equivalence: same input, C into a, NEON into b, compare the lot */
+    int failed = 0;
+    for (int k = 0; k < K_COUNT; k++) {
+        int bad = 0;
+        for (int r = 0; r < PT_ROUNDS && !bad; r++) {
+            int n = r < 64 ? r : (int)(lcg(&seed) % PT_MAXN);
+            int d_off = (int)(lcg(&seed) % 5), s_off = (int)(lcg(&seed) % 5);
+            uint32_t color = lcg(&seed);
+            for (int i = 0; i < PT_MAXN + 8; i++) a[i] = b[i] = test_pixel(&seed, i);
+            run_kernel(k, 0, a + d_off, src + s_off, n, color);
+            run_kernel(k, 1, b + d_off, src + s_off, n, color);
+            if (memcmp(a, b, (PT_MAXN + 8) * 4) != 0) bad = n + 1;
+        }
+        out_puts(out, out_cap, &off, kernel_names[k]);
+        if (bad) {
+            out_puts(out, out_cap, &off, ": MISMATCH at n=");
+            out_putd(out, out_cap, &off, bad - 1);
+            out_puts(out, out_cap, &off, "\n");
+            failed++;
+        } else {
+            out_puts(out, out_cap, &off, ": OK\n");
+        }
+    }
+
+    /* Throughput: one 1024x768 frame, row by row */
+    out_puts(out, out_cap, &off, "1024x768 frame       C us   NEON us\n");
+    for (int k = 0; k < K_COUNT; k++) {
+        uint64_t us[2];
+        for (int neon = 0; neon < 2; neon++) {
+            for (int i = 0; i < PT_W * PT_H; i++) a[i] = 0xFF202020;
+            uint64_t t0 = timer_get_us();
+            for (int y = 0; y < PT_H; y++)
+                run_kernel(k, neon, a + (size_t)y * PT_W, src + (size_t)y * PT_W, PT_W, 0xFF336699);
+            us[neon] = timer_get_us() - t0;
+        }
+        out_puts(out, out_cap, &off, kernel_names[k]);
+        for (int pad = (int)strlen(kernel_names[k]); pad < 20; pad++) out_puts(out, out_cap, &off, " ");
+        out_putd(out, out_cap, &off, (int)us[0]);
+        out_puts(out, out_cap, &off, "   ");
+        out_putd(out, out_cap, &off, (int)us[1]);
+        out_puts(out, out_cap, &off, "\n");
+    }
+    out_puts(out, out_cap, &off, failed ? "FAIL\n" : "all kernels match\n");
+
+    kfree(src);
+    kfree(a);
+    kfree(b);
+    return (int)off;
+}
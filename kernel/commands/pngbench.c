@@ -0,0 +1,138 @@
+#include "programs.h"
+#include "files.h"
+#include "kmalloc.h"
+#include "timer.h"
+#include "lodepng.h"
+#include "lodepng_glue.h"
+#include "lib.h"
+#include <string.h>
+
+/* pngbench [file.png ...]
+ * Decodes each PNG with lodepng's built-in inflate and with the kernel's
+ * table-driven one (lodepng_fast_zlib), checks the pixels match and prints
+ * the best time of a few runs for each. */
+
+#define PNGBENCH_RUNS 3
+
+static const char *default_paths[] = {
+    "/system/assets/wallpaper.png",
+    "/system/assets/calculator.png",
+    NULL
+};
+
+/* microseconds as "N.NNN ms" */
+static void out_ms(char *out, size_t out_cap, size_t *off, uint64_t us) {
+    char num[4];
+    out_putd(out, out_cap, off, (int)(us / 1000));
+    out_puts(out, out_cap, off, ".");
+    int frac = (int)(us % 1000);
+    num[0] = (char)('0' + frac / 100);
+    num[1] = (char)('0' + frac / 10 % 10);
+    num[2] = (char)('0' + frac % 10);
+    num[3] = '\0';
+    out_puts(out, out_cap, off, num);
+    out_puts(out, out_cap, off, " ms");
+}
+
+static int read_file(const char *path, unsigned char **buf, size_t *len) {
+    struct file_stat st;
+    if (files_stat(path, &st) < 0 || st.is_dir || st.size == 0) return -1;
+    *buf = kmalloc(st.size);
+    if (!*buf) return -1;
+    int fd = files_open(path, O_RDONLY);
+    if (fd < 0) { kfree(*buf); return -1; }
+    int r = files_read(fd, *buf, st.size);
+    files_close(fd);
+    if (r <= 0) { kfree(*buf); return -1; }
+    *len = (size_t)r;
+    return 0;
+}
+
+/* One decode; returns elapsed us, 0 on failure. *image is left for the caller. */
+static uint64_t decode_once(const unsigned char *png, size_t len, int fast,
+                            unsigned char **image, unsigned *w, unsigned *h) {
+    LodePNGState state;
+    lodepng_state_init(&state);
+    size_t raw_hint = 0;
+    uint64_t t0 = timer_get_us();
+    if (fast) {
+        if (lodepng_inspect(w, h, &state, png, len) == 0) {
+            size_t bpp = lodepng_get_bpp(&state.info_png.color);
+            raw_hint = (size_t)*h * (1 + ((size_t)*w * bpp + 7) / 8);
+            if (state.info_png.interlace_method) raw_hint += raw_hint / 8;
+        }
+        lodepng_use_fast_zlib(&state.decoder.zlibsettings, &raw_hint);
+    }
+    unsigned err = lodepng_decode(image, w, h, &state, png, len);
+    uint64_t t1 = timer_get_us();
+    lodepng_state_cleanup(&state);
+    if (err) {
+        if (*image) { kfree(*image); *image = NULL; }
+        return 0;
+    }
+    return t1 > t0 ? t1 - t0 : 1;
+}
+
+static void bench_one(const char *path, char *out, size_t out_cap, size_t *off) {
+    unsigned char *png;
+    size_t len;
+    out_puts(out, out_cap, off, path);
+    if (read_file(path, &png, &len) < 0) {
+        out_puts(out, out_cap, off, ": cannot read\n");
+        return;
+    }
+
+    uint64_t best[2] = {0, 0};
+    unsigned char *ref = NULL;
+    unsigned w = 0, h = 0;
+    int mismatch = 0;
+    for (int run = 0; run < PNGBENCH_RUNS; ++run) {
+        for (int fast = 0; fast < 2; ++fast) {
+            unsigned char *image = NULL;
+            unsigned iw, ih;
+            uint64_t us = decode_once(png, len, fast, &image, &iw, &ih);
+            if (!us) {
+                out_puts(out, out_cap, off, fast ? ": fast decode failed\n" : ": decode failed\n");
+                if (ref) kfree(ref);
+                kfree(png);
+                return;
+            }
+            if (!best[fast] || us < best[fast]) best[fast] = us;
+            if (!ref) { ref = image; w = iw; h = ih; continue; }
+            if (iw != w || ih != h || memcmp(image, ref, (size_t)w * h * 4) != 0) mismatch = 1;
+            kfree(image);
+        }
+    }
+    if (ref) kfree(ref);
+    kfree(png);
+
+    char num[16];
+    out_puts(out, out_cap, off, " (");
+    out_putd(out, out_cap, off, (int)w);
+    out_puts(out, out_cap, off, "x");
+    out_putd(out, out_cap, off, (int)h);
+    out_puts(out, out_cap, off, ")\n  lodepng: ");
+    out_ms(out, out_cap, off, best[0]);
+    out_puts(out, out_cap, off, "\n  fast:    ");
+    out_ms(out, out_cap, off, best[1]);
+    out_puts(out, out_cap, off, "  x");
+    uint64_t ratio = best[0] * 100 / best[1];
+    out_putd(out, out_cap, off, (int)(ratio / 100));
+    out_puts(out, out_cap, off, ".");
+    num[0] = (char)('0' + ratio / 10 % 10);
+    num[1] = (char)('0' + ratio % 10);
+    num[2] = '\0';
+    out_puts(out, out_cap, off, num);
+    out_puts(out, out_cap, off, mismatch ? "  PIXEL MISMATCH\n" : "\n");
+}
+
+int prog_pngbench(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap) {
+    (void)in; (void)in_len;
+    size_t off = 0;
+    if (argc > 1) {
+        for (int i = 1; i < argc; ++i) bench_one(argv[i], out, out_cap, &off);
+    } else {
+        for (int i = 0; default_paths[i]; ++i) bench_one(default_paths[i], out, out_cap, &off);
+    }
+    return (int)off;
+}
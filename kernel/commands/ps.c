@@ -3,15 +3,6 @@
 #include "lib.h"
 #include <string.h>
 
-/* Helper to formatting int to string */
-static void fmt_int(char *buf, int v) {
-    if (v == 0) { strcpy(buf, "0"); return; }
-    char tmp[16]; int i=0;
-    while(v > 0) { tmp[i++] = (v%10)+'0'; v/=10; }
-    int j=0; while(i>0) buf[j++] = tmp[--i];
-    buf[j] = '\0';
-}
-
 int prog_ps(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap) {
     (void)argc; (void)argv; (void)in; (void)in_len;
     /* need task stats from sched.h */
@@ -36,7 +27,7 @@ int prog_ps(int argc, char **argv, const char *in, size_t in_len, char *out, siz
         char num[16];
         
         /* PID */
-        fmt_int(num, ids[i]);
+        fmt_dec(num, ids[i]);
         int pad = 5 - (int)strlen(num);
         if (pad < 1) pad = 1;
         
@@ -53,7 +44,7 @@ int prog_ps(int argc, char **argv, const char *in, size_t in_len, char *out, siz
         for(int k=0;k<pad;k++) line[l_idx++] = ' ';
         
         /* RUNS */
-        fmt_int(num, runs[i]);
+        fmt_dec(num, runs[i]);
         memcpy(line + l_idx, num, strlen(num)); l_idx += strlen(num);
         line[l_idx++] = '\n';
         line[l_idx] = '\0';
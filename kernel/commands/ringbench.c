@@ -0,0 +1,115 @@
+#include "programs.h"
+#include "ring.h"
+#include "input.h"
+#include "irq.h"
+#include "timer.h"
+#include "lib.h"
+#include <string.h>
+
+/* ringbench
+ * Per-element cost of the SPSC ring against the irq_save-per-byte ring the
+ * pty used to have: single pushes/pops of bytes and input events, and
+ * bulk transfers. Each test moves RB_N elements through the ring in
+ * batches of RB_BATCH, so it never fills. */
+
+#define RB_N 262144
+#define RB_BATCH 64
+
+/* ns per element, one decimal */
+static void out_cost(char *out, size_t out_cap, size_t *off, const char *name, uint64_t us) {
+    uint64_t ns10 = us * 10000ULL / RB_N;
+    out_putpad(out, out_cap, off, name, 28);
+    out_putd(out, out_cap, off, (int)(ns10 / 10));
+    out_puts(out, out_cap, off, ".");
+    out_putd(out, out_cap, off, (int)(ns10 % 10));
+    out_puts(out, out_cap, off, " ns\n");
+}
+
+/* The old pty scheme, for comparison */
+static char old_buf[2048];
+static int old_h, old_t;
+
+static void old_push(char c) {
+    unsigned long flags = irq_save();
+    int next = (old_h + 1) % 2048;
+    if (next != old_t) { old_buf[old_h] = c; old_h = next; }
+    irq_restore(flags);
+}
+
+static char old_pop(void) {
+    unsigned long flags = irq_save();
+    if (old_h == old_t) { irq_restore(flags); return 0; }
+    char c = old_buf[old_t];
+    old_t = (old_t + 1) % 2048;
+    irq_restore(flags);
+    return c;
+}
+
+static char byte_buf[2048];
+static struct input_event ev_buf[256];
+
+int prog_ringbench(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap) {
+    (void)argc; (void)argv; (void)in; (void)in_len;
+    size_t off = 0;
+    struct ring r;
+    char chunk[RB_BATCH], sink[RB_BATCH];
+    volatile char vsink = 0;
+    uint32_t check = 0;
+    uint64_t t0;
+
+    for (int i = 0; i < RB_BATCH; i++) chunk[i] = (char)i;
+    out_puts(out, out_cap, &off, "per element (push + pop):\n");
+
+    old_h = old_t = 0;
+    t0 = timer_get_us();
+    for (int n = 0; n < RB_N; n += RB_BATCH) {
+        for (int i = 0; i < RB_BATCH; i++) old_push(chunk[i]);
+        for (int i = 0; i < RB_BATCH; i++) vsink = old_pop();
+    }
+    out_cost(out, out_cap, &off, "irq_save byte ring", timer_get_us() - t0);
+
+    ring_init(&r, byte_buf, sizeof(byte_buf), 1);
+    t0 = timer_get_us();
+    for (int n = 0; n < RB_N; n += RB_BATCH) {
+        for (int i = 0; i < RB_BATCH; i++) ring_push(&r, &chunk[i]);
+        for (int i = 0; i < RB_BATCH; i++) { char c; ring_pop(&r, &c); check += (uint8_t)c; }
+    }
+    out_cost(out, out_cap, &off, "ring byte", timer_get_us() - t0);
+
+    ring_init(&r, ev_buf, 256, sizeof(struct input_event));
+    struct input_event ev = { 1, 30, 1, 0 }, got;
+    t0 = timer_get_us();
+    for (int n = 0; n < RB_N; n += RB_BATCH) {
+        for (int i = 0; i < RB_BATCH; i++) ring_push(&r, &ev);
+        for (int i = 0; i < RB_BATCH; i++) { ring_pop(&r, &got); check += got.code; }
+    }
+    out_cost(out, out_cap, &off, "ring input_event", timer_get_us() - t0);
+
+    ring_init(&r, byte_buf, sizeof(byte_buf), 1);
+    t0 = timer_get_us();
+    for (int n = 0; n < RB_N; n += RB_BATCH) {
+        ring_push_bulk(&r, chunk, RB_BATCH);
+        check += ring_pop_bulk(&r, sink, RB_BATCH);
+    }
+    out_cost(out, out_cap, &off, "ring byte, bulk of 64", timer_get_us() - t0);
+    (void)vsink;
+
+    /* Overflow accounting: 2048 slots, push 2100 */
+    ring_init(&r, byte_buf, sizeof(byte_buf), 1);
+    for (int i = 0; i < 2100; i++) ring_push(&r, &chunk[i % RB_BATCH]);
+    out_puts(out, out_cap, &off, "overflow check: ");
+    out_putd(out, out_cap, &off, (int)ring_count(&r));
+    out_puts(out, out_cap, &off, " stored, ");
+    out_putd(out, out_cap, &off, (int)r.dropped);
+    out_puts(out, out_cap, &off, (ring_count(&r) == 2048 && r.dropped == 52) ? " dropped  OK\n" : " dropped  FAIL\n");
+
+    uint32_t kd, md;
+    input_get_stats(&kd, &md);
+    out_puts(out, out_cap, &off, "input queues since boot: ");
+    out_putd(out, out_cap, &off, (int)kd);
+    out_puts(out, out_cap, &off, " key / ");
+    out_putd(out, out_cap, &off, (int)md);
+    out_puts(out, out_cap, &off, " mouse events dropped\n");
+    (void)check;
+    return (int)off;
+}
@@ -0,0 +1,198 @@
+#include "programs.h"
+#include "usync.h"
+#include "shm.h"
+#include "sched.h"
+#include "timer.h"
+#include "lib.h"
+#include <string.h>
+
+/* shmbench [KB]
+ * A producer and a consumer task stream KB kilobytes (default 4096)
+ * through a ring in a shared memory object, both blocking on futexes
+ * when the ring is full or empty. The consumer checks every byte; the
+ * command itself waits for it on a condition variable. Prints MB/s and
+ * how often each side had to sleep.
+ * Then SB_LOCKERS tasks each take a shared umutex SB_LOCK_ITERS times and
+ * yield while holding it, so every lock after the first is contended and
+ * goes through futex_wait / futex_wake. The counter they bump under the
+ * lock has to come out exact. */
+
+#define SB_OBJ_SIZE  (64 * 1024)
+#define SB_CHUNK     4096
+#define SB_DEFAULT   4096
+#define SB_LOCKERS   4
+#define SB_LOCK_ITERS 1000
+
+struct sb_shared {
+    struct umutex lock;
+    struct ucond done_cv;
+    uint32_t done;
+    uint32_t bad;
+    uint32_t total;
+    struct umutex count_lock;
+    uint32_t counter;           /* bumped under count_lock */
+    uint32_t contended;         /* locks that did not get it at once */
+    uint32_t lockers_done;      /* under lock, signalled on done_cv */
+    struct ushm_ring ring;      /* the rest of the object */
+};
+
+static inline uint8_t pattern(uint32_t i) {
+    return (uint8_t)(i * 7 + (i >> 9));
+}
+
+/* Both sides find the object by name, as separate programs would */
+static struct sb_shared *sb_attach(void) {
+    int id = (int)usys(SYS_SHM_OPEN, (uintptr_t)"shmbench", 0, 0);
+    if (id < 0) return NULL;
+    return (struct sb_shared *)usys(SYS_SHM_MAP, (uintptr_t)id, 0, 0);
+}
+
+static void sb_detach(void) {
+    int id = (int)usys(SYS_SHM_OPEN, (uintptr_t)"shmbench", 0, 0);
+    if (id >= 0) usys(SYS_SHM_UNMAP, (uintptr_t)id, 0, 0);
+}
+
+static void producer(void *arg) {
+    (void)arg;
+    static uint8_t chunk[SB_CHUNK];
+    struct sb_shared *s = sb_attach();
+    if (s) {
+        uint32_t pos = 0;
+        while (pos < s->total) {
+            uint32_t n = s->total - pos < SB_CHUNK ? s->total - pos : SB_CHUNK;
+            for (uint32_t i = 0; i < n; i++) chunk[i] = pattern(pos + i);
+            ushm_ring_write(&s->ring, chunk, n);
+            pos += n;
+        }
+        sb_detach();
+    }
+    task_set_fn_null(task_current_id());
+}
+
+static void consumer(void *arg) {
+    (void)arg;
+    static uint8_t chunk[SB_CHUNK];
+    struct sb_shared *s = sb_attach();
+    if (!s) {
+        task_set_fn_null(task_current_id());
+        return;
+    }
+    uint32_t pos = 0, bad = 0;
+    while (pos < s->total) {
+        size_t n = ushm_ring_read(&s->ring, chunk, sizeof(chunk));
+        for (size_t i = 0; i < n; i++)
+            if (chunk[i] != pattern(pos + (uint32_t)i)) bad++;
+        pos += (uint32_t)n;
+    }
+    umutex_lock(&s->lock);
+    s->bad = bad;
+    s->done = 1;
+    ucond_broadcast(&s->done_cv);
+    umutex_unlock(&s->lock);
+    sb_detach();
+    task_set_fn_null(task_current_id());
+}
+
+static void locker(void *arg) {
+    (void)arg;
+    struct sb_shared *s = sb_attach();
+    if (!s) {
+        task_set_fn_null(task_current_id());
+        return;
+    }
+    for (int i = 0; i < SB_LOCK_ITERS; i++) {
+        if (!umutex_trylock(&s->count_lock)) {
+            umutex_lock(&s->count_lock);
+            s->contended++;
+        }
+        uint32_t v = s->counter;
+        yield();                /* the others pile up on the lock meanwhile */
+        s->counter = v + 1;
+        umutex_unlock(&s->count_lock);
+    }
+    umutex_lock(&s->lock);
+    s->lockers_done++;
+    ucond_broadcast(&s->done_cv);
+    umutex_unlock(&s->lock);
+    sb_detach();
+    task_set_fn_null(task_current_id());
+}
+
+static void run_lockers(struct sb_shared *s, char *out, size_t out_cap, size_t *off) {
+    int started = 0;
+    uint64_t t0 = timer_get_us();
+    for (int i = 0; i < SB_LOCKERS; i++)
+        if (task_create(locker, NULL, "shm_locker") > 0) started++;
+    umutex_lock(&s->lock);
+    while (s->lockers_done < (uint32_t)started) ucond_wait(&s->done_cv, &s->lock);
+    umutex_unlock(&s->lock);
+    uint64_t us = timer_get_us() - t0;
+
+    uint32_t want = (uint32_t)started * SB_LOCK_ITERS;
+    out_putd(out, out_cap, off, started);
+    out_puts(out, out_cap, off, " tasks x ");
+    out_putd(out, out_cap, off, SB_LOCK_ITERS);
+    out_puts(out, out_cap, off, " contended locks in ");
+    out_putd(out, out_cap, off, (int)(us / 1000));
+    out_puts(out, out_cap, off, " ms: ");
+    out_putd(out, out_cap, off, want ? (int)(us * 1000 / want) : 0);
+    out_puts(out, out_cap, off, " ns per hand-off\n  ");
+    out_putd(out, out_cap, off, (int)s->contended);
+    out_puts(out, out_cap, off, " had to wait, counter ");
+    out_putd(out, out_cap, off, (int)s->counter);
+    out_puts(out, out_cap, off, s->counter == want ? " (ok)\n" : " (LOST UPDATES)\n");
+}
+
+int prog_shmbench(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap) {
+    (void)in; (void)in_len;
+    size_t off = 0;
+    int kb = argc > 1 ? atoi(argv[1]) : SB_DEFAULT;
+    if (kb <= 0 || kb > 1024 * 1024) kb = SB_DEFAULT;
+
+    int id = (int)usys(SYS_SHM_OPEN, (uintptr_t)"shmbench", SB_OBJ_SIZE, 0);
+    struct sb_shared *s = id >= 0 ? (struct sb_shared *)usys(SYS_SHM_MAP, (uintptr_t)id, 0, 0) : NULL;
+    if (!s) {
+        out_puts(out, out_cap, &off, "shmbench: cannot create shared memory\n");
+        if (id >= 0) usys(SYS_SHM_UNLINK, (uintptr_t)"shmbench", 0, 0);
+        return (int)off;
+    }
+    memset(s, 0, offsetof(struct sb_shared, ring));
+    uint32_t ring_size = ushm_ring_init(&s->ring, SB_OBJ_SIZE - offsetof(struct sb_shared, ring));
+    s->total = (uint32_t)kb * 1024;
+
+    uint64_t t0 = timer_get_us();
+    int c = task_create(consumer, NULL, "shm_consumer");
+    int p = task_create(producer, NULL, "shm_producer");
+    if (c <= 0 || p <= 0) {
+        if (c > 0) task_kill(c);
+        if (p > 0) task_kill(p);
+        out_puts(out, out_cap, &off, "shmbench: cannot start tasks\n");
+    } else {
+        umutex_lock(&s->lock);
+        while (!s->done) ucond_wait(&s->done_cv, &s->lock);
+        umutex_unlock(&s->lock);
+        uint64_t us = timer_get_us() - t0;
+        if (us == 0) us = 1;
+
+        out_putd(out, out_cap, &off, kb);
+        out_puts(out, out_cap, &off, " KB through a ");
+        out_putd(out, out_cap, &off, (int)(ring_size / 1024));
+        out_puts(out, out_cap, &off, " KB ring in ");
+        out_putd(out, out_cap, &off, (int)(us / 1000));
+        out_puts(out, out_cap, &off, " ms: ");
+        out_putd(out, out_cap, &off, (int)((uint64_t)s->total / us));
+        out_puts(out, out_cap, &off, " MB/s\n  producer slept ");
+        out_putd(out, out_cap, &off, (int)s->ring.wr_sleeps);
+        out_puts(out, out_cap, &off, " times, consumer ");
+        out_putd(out, out_cap, &off, (int)s->ring.rd_sleeps);
+        out_puts(out, out_cap, &off, s->bad ? ", DATA MISMATCH: " : ", data ok\n");
+        if (s->bad) {
+            out_putd(out, out_cap, &off, (int)s->bad);
+            out_puts(out, out_cap, &off, " bytes\n");
+        }
+        run_lockers(s, out, out_cap, &off);
+    }
+    usys(SYS_SHM_UNMAP, (uintptr_t)id, 0, 0);
+    usys(SYS_SHM_UNLINK, (uintptr_t)"shmbench", 0, 0);
+    return (int)off;
+}
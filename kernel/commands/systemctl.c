@@ -116,8 +116,13 @@ int prog_systemctl(int argc, char **argv, const char *in, size_t in_len, char *o
         const char *s = (r==0)?"restarted\n":"failed\n"; size_t m=strlen(s); if(m>out_cap)m=out_cap; memcpy(out,s,m); return (int)m;
 
     } else if (strcmp(argv[1], "status") == 0) {
-        /* Not fully implemented in service.c yet? or is it? Assuming basic exists */
-        const char *s = "status not impl\n"; size_t m=strlen(s); if(m>out_cap)m=out_cap; memcpy(out,s,m); return (int)m;
+        if (argc < 3) { const char *f="unit required\n"; size_t m=strlen(f); if(m>out_cap)m=out_cap; memcpy(out,f,m); return (int)m; }
+        if (derive_service_shortname(argv[2], name, sizeof(name), NULL, 0) != 0) {
+             const char *f="invalid unit\n"; size_t m=strlen(f); if(m>out_cap)m=out_cap; memcpy(out,f,m); return (int)m;
+        }
+        if (out_cap == 0) return 0;
+        service_status(name, out, out_cap);
+        return (int)strlen(out);
     } else {
         const char *f="unknown op\n"; size_t m=strlen(f); if(m>out_cap)m=out_cap; memcpy(out,f,m); return (int)m;
     }
@@ -0,0 +1,151 @@
+#include "programs.h"
+#include "uring.h"
+#include "syscall.h"
+#include "sched.h"
+#include "timer.h"
+#include "lib.h"
+#include <string.h>
+
+/* uringbench [files]
+ * A file-heavy workload (create, write 64 bytes, read back, remove) run
+ * three ways: one svc per call, batches through a uring entered once per
+ * batch, and a SQPOLL uring whose worker picks the batches up by itself.
+ * Prints us per call and how many svc traps each way took. */
+
+#define UB_FILES   16           /* names in rotation, one batch */
+#define UB_OPS     4            /* calls per file */
+#define UB_DEFAULT 2048
+
+static char names[UB_FILES][16];
+static char wbuf[64];
+static char rbuf[UB_FILES][64];
+
+/* A real trap, as a user task would take */
+static inline uintptr_t svc(uint32_t num, uintptr_t a0, uintptr_t a1, uintptr_t a2) {
+    register uintptr_t x0 __asm__("x0") = a0;
+    register uintptr_t x1 __asm__("x1") = a1;
+    register uintptr_t x2 __asm__("x2") = a2;
+    register uintptr_t x8 __asm__("x8") = num;
+    __asm__ volatile("svc #0" : "+r"(x0) : "r"(x1), "r"(x2), "r"(x8) : "memory");
+    return x0;
+}
+
+static int run_svc(int files, int *traps) {
+    int errors = 0;
+    for (int i = 0; i < files; i++) {
+        int k = i % UB_FILES;
+        if ((intptr_t)svc(SYS_RAMFS_CREATE, (uintptr_t)names[k], 0, 0) < 0) errors++;
+        svc(SYS_RAMFS_WRITE, (uintptr_t)names[k], (uintptr_t)wbuf, sizeof(wbuf));
+        if ((intptr_t)svc(SYS_RAMFS_READ, (uintptr_t)names[k], (uintptr_t)rbuf[k], sizeof(rbuf[k])) != sizeof(wbuf)) errors++;
+        svc(SYS_RAMFS_REMOVE, (uintptr_t)names[k], 0, 0);
+        *traps += UB_OPS;
+    }
+    return errors;
+}
+
+static void queue_batch(struct uring *u, int first, int count) {
+    for (int i = first; i < first + count; i++) {
+        int k = i % UB_FILES;
+        uring_queue(u, SYS_RAMFS_CREATE, (uintptr_t)names[k], 0, 0, (uint64_t)SYS_RAMFS_CREATE);
+        uring_queue(u, SYS_RAMFS_WRITE, (uintptr_t)names[k], (uintptr_t)wbuf, sizeof(wbuf), (uint64_t)SYS_RAMFS_WRITE);
+        uring_queue(u, SYS_RAMFS_READ, (uintptr_t)names[k], (uintptr_t)rbuf[k], sizeof(rbuf[k]), (uint64_t)SYS_RAMFS_READ);
+        uring_queue(u, SYS_RAMFS_REMOVE, (uintptr_t)names[k], 0, 0, (uint64_t)SYS_RAMFS_REMOVE);
+    }
+}
+
+static int check(const struct uring_cqe *c) {
+    if (c->user_data == SYS_RAMFS_CREATE) return c->res < 0;
+    if (c->user_data == SYS_RAMFS_READ) return c->res != (intptr_t)sizeof(wbuf);
+    return 0;
+}
+
+static int run_uring(int ring, struct uring *u, int files, int *traps) {
+    int errors = 0;
+    for (int i = 0; i < files; i += UB_FILES) {
+        int count = files - i < UB_FILES ? files - i : UB_FILES;
+        int want = count * UB_OPS, got = 0;
+        queue_batch(u, i, count);
+        while (got < want) {
+            struct uring_cqe c;
+            if (uring_reap(u, &c)) {
+                errors += check(&c);
+                got++;
+            } else if (uring_needs_enter(u)) {
+                svc(SYS_URING_ENTER, (uintptr_t)ring, (uintptr_t)(want - got), 0);
+                (*traps)++;
+            } else {
+                yield();    /* the worker is awake: let it run */
+            }
+        }
+    }
+    return errors;
+}
+
+static void report(char *out, size_t out_cap, size_t *off, const char *name, uint64_t us,
+                   int calls, int traps, int errors) {
+    uint64_t ns = us * 1000ULL / (uint64_t)calls;
+    out_putpad(out, out_cap, off, name, 16);
+    out_putd(out, out_cap, off, (int)(ns / 1000));
+    out_puts(out, out_cap, off, ".");
+    char frac[4] = { (char)('0' + ns % 1000 / 100), (char)('0' + ns % 100 / 10), (char)('0' + ns % 10), 0 };
+    out_puts(out, out_cap, off, frac);
+    out_puts(out, out_cap, off, " us/call, ");
+    out_putd(out, out_cap, off, traps);
+    out_puts(out, out_cap, off, " traps");
+    if (errors) {
+        out_puts(out, out_cap, off, ", ");
+        out_putd(out, out_cap, off, errors);
+        out_puts(out, out_cap, off, " errors");
+    }
+    out_puts(out, out_cap, off, "\n");
+}
+
+int prog_uringbench(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap) {
+    (void)in; (void)in_len;
+    size_t off = 0;
+    int files = argc > 1 ? atoi(argv[1]) : UB_DEFAULT;
+    if (files <= 0) files = UB_DEFAULT;
+    for (int k = 0; k < UB_FILES; k++) {
+        strcpy(names[k], "/ubench");
+        fmt_dec(names[k] + 7, k);
+    }
+    for (size_t i = 0; i < sizeof(wbuf); i++) wbuf[i] = (char)('a' + i % 26);
+
+    int calls = files * UB_OPS;
+    out_putd(out, out_cap, &off, files);
+    out_puts(out, out_cap, &off, " files, ");
+    out_putd(out, out_cap, &off, calls);
+    out_puts(out, out_cap, &off, " calls\n");
+
+    int traps = 0;
+    uint64_t t0 = timer_get_us();
+    int errors = run_svc(files, &traps);
+    report(out, out_cap, &off, "svc per call", timer_get_us() - t0, calls, traps, errors);
+
+    /* set up and torn down through the same svcs a user task would use */
+    struct uring *u;
+    int ring = (int)svc(SYS_URING_SETUP, UB_FILES * UB_OPS, 0, (uintptr_t)&u);
+    if (ring >= 0) {
+        traps = 0;
+        t0 = timer_get_us();
+        errors = run_uring(ring, u, files, &traps);
+        report(out, out_cap, &off, "uring, enter", timer_get_us() - t0, calls, traps, errors);
+        svc(SYS_URING_DESTROY, (uintptr_t)ring, 0, 0);
+    }
+
+    ring = (int)svc(SYS_URING_SETUP, UB_FILES * UB_OPS, URING_SETUP_SQPOLL, (uintptr_t)&u);
+    if (ring >= 0) {
+        traps = 0;
+        t0 = timer_get_us();
+        errors = run_uring(ring, u, files, &traps);
+        uint32_t wakeups = u->wakeups;
+        report(out, out_cap, &off, "uring, sqpoll", timer_get_us() - t0, calls, traps, errors);
+        out_puts(out, out_cap, &off, "  worker woken ");
+        out_putd(out, out_cap, &off, (int)wakeups);
+        out_puts(out, out_cap, &off, " times\n");
+        svc(SYS_URING_DESTROY, (uintptr_t)ring, 0, 0);
+    } else {
+        out_puts(out, out_cap, &off, "uringbench: no sqpoll worker\n");
+    }
+    return (int)off;
+}
@@ -0,0 +1,52 @@
+#include "programs.h"
+#include "lib.h"
+#include <string.h>
+#ifdef REAL
+#include "usb.h"
+#endif
+
+/* usbstat
+ * Interrupt and transfer counters of the DWC2 host driver, and the polling
+ * period each attached HID device asked for. The IRQ count should grow with
+ * the HID intervals and with input, not with how busy the scheduler is. */
+
+#ifdef REAL
+static void show_hid(const char *name, int interval_ms, uint32_t reports,
+                     char *out, size_t out_cap, size_t *off) {
+    out_puts(out, out_cap, off, name);
+    if (!interval_ms) {
+        out_puts(out, out_cap, off, "not attached\n");
+        return;
+    }
+    out_puts(out, out_cap, off, "every ");
+    out_putd(out, out_cap, off, interval_ms);
+    out_puts(out, out_cap, off, " ms, ");
+    out_putd(out, out_cap, off, (int)reports);
+    out_puts(out, out_cap, off, " reports\n");
+}
+#endif
+
+int prog_usbstat(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap) {
+    (void)argc; (void)argv; (void)in; (void)in_len;
+    size_t off = 0;
+#ifndef REAL
+    out_puts(out, out_cap, &off, "usbstat: no DWC2 USB host on this target\n");
+#else
+    struct usb_stats st;
+    usb_get_stats(&st);
+    out_puts(out, out_cap, &off, "irqs ");
+    out_putd(out, out_cap, &off, (int)st.irqs);
+    out_puts(out, out_cap, &off, ", sofs ");
+    out_putd(out, out_cap, &off, (int)st.sofs);
+    out_puts(out, out_cap, &off, ", transfers ");
+    out_putd(out, out_cap, &off, (int)st.xfers);
+    out_puts(out, out_cap, &off, ", naks ");
+    out_putd(out, out_cap, &off, (int)st.naks);
+    out_puts(out, out_cap, &off, ", errors ");
+    out_putd(out, out_cap, &off, (int)st.errors);
+    out_puts(out, out_cap, &off, "\n");
+    show_hid("keyboard: ", st.kb_interval_ms, st.kb_reports, out, out_cap, &off);
+    show_hid("mouse:    ", st.mouse_interval_ms, st.mouse_reports, out, out_cap, &off);
+#endif
+    return (int)off;
+}
@@ -0,0 +1,146 @@
+#include "programs.h"
+#include "utime.h"
+#include "usync.h"
+#include "syscall.h"
+#include "sched.h"
+#include "timer.h"
+#include "lib.h"
+#include <string.h>
+
+/* utimebench [reads]
+ * Starts a user task that reads the clock at EL0 through utime.h (the
+ * virtual counter plus the read-only time page, no syscall). It
+ *  - brackets SYS_TIME between two utime_ms() reads, which must not
+ *    disagree with it,
+ *  - checks that utime_ns() never goes backwards,
+ *  - times `reads` utime_ns() reads (default 100000) against as many
+ *    SYS_TIME calls.
+ * The results come back through a shared memory object. The task's code
+ * is the one page task_create_user maps, so utb_user is page aligned and
+ * uses nothing but inlined helpers. */
+
+#define UTB_DEFAULT 100000
+#define UTB_CHECKS  1000
+#define UTB_TIMEOUT_MS 5000
+
+struct utb_shared {
+    volatile uint32_t done;
+    uint32_t reads;
+    uint32_t magic_ok;      /* the time page is mapped and initialized */
+    uint32_t disagree;      /* SYS_TIME outside [utime_ms before, after] */
+    uint32_t backwards;     /* utime_ns went down */
+    uint32_t pad;
+    uint64_t read_ns;       /* `reads` utime_ns calls */
+    uint64_t sys_ns;        /* `reads` SYS_TIME calls */
+};
+
+static inline __attribute__((always_inline)) uintptr_t utb_svc(uint32_t num, uintptr_t a0, uintptr_t a1, uintptr_t a2) {
+    register uintptr_t x0 __asm__("x0") = a0;
+    register uintptr_t x1 __asm__("x1") = a1;
+    register uintptr_t x2 __asm__("x2") = a2;
+    register uintptr_t x8 __asm__("x8") = num;
+    __asm__ volatile("svc #0" : "+r"(x0) : "r"(x1), "r"(x2), "r"(x8) : "memory");
+    return x0;
+}
+
+/* Runs at EL0; x0 is the shm id */
+static void __attribute__((noinline, aligned(4096))) utb_user(uintptr_t id) {
+    struct utb_shared *s = (struct utb_shared *)utb_svc(SYS_SHM_MAP, id, 0, 0);
+    volatile uint32_t park = 0;
+    if (s) {
+        s->magic_ok = utime_page()->magic == TIME_PAGE_MAGIC;
+        if (s->magic_ok) {
+            for (uint32_t i = 0; i < UTB_CHECKS; i++) {
+                uint32_t before = utime_ms();
+                uint32_t sys = (uint32_t)utb_svc(SYS_TIME, 0, 0, 0);
+                uint32_t after = utime_ms();
+                if ((int32_t)(sys - before) < 0 || (int32_t)(after - sys) < 0) s->disagree++;
+            }
+
+            uint64_t prev = utime_ns();
+            uint64_t t0 = prev;
+            for (uint32_t i = 0; i < s->reads; i++) {
+                uint64_t now = utime_ns();
+                if (now < prev) s->backwards++;
+                prev = now;
+            }
+            s->read_ns = utime_ns() - t0;
+
+            t0 = utime_ns();
+            for (uint32_t i = 0; i < s->reads; i++) utb_svc(SYS_TIME, 0, 0, 0);
+            s->sys_ns = utime_ns() - t0;
+        }
+        s->done = 1;
+        utb_svc(SYS_FUTEX_WAKE, (uintptr_t)&s->done, 1, 0);
+    }
+    /* nothing to return to: wait to be killed */
+    for (;;) utb_svc(SYS_FUTEX_WAIT, (uintptr_t)&park, 0, (uintptr_t)-1);
+}
+
+/* "N.N ns" from a total over `reads` */
+static void out_per_read(char *out, size_t out_cap, size_t *off, uint64_t total_ns, uint32_t reads) {
+    uint64_t ns10 = total_ns * 10 / reads;
+    out_putd(out, out_cap, off, (int)(ns10 / 10));
+    out_puts(out, out_cap, off, ".");
+    out_putd(out, out_cap, off, (int)(ns10 % 10));
+    out_puts(out, out_cap, off, " ns");
+}
+
+int prog_utimebench(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap) {
+    (void)in; (void)in_len;
+    size_t off = 0;
+    int reads = argc > 1 ? atoi(argv[1]) : UTB_DEFAULT;
+    if (reads <= 0) reads = UTB_DEFAULT;
+
+    uint64_t kctl;
+    __asm__ volatile("mrs %0, cntkctl_el1" : "=r"(kctl));
+    if (!(kctl & (1u << 1))) {
+        out_puts(out, out_cap, &off, "utimebench: CNTKCTL_EL1.EL0VCTEN is off, EL0 cannot read the counter\n");
+        return (int)off;
+    }
+
+    int id = (int)usys(SYS_SHM_OPEN, (uintptr_t)"utimebench", sizeof(struct utb_shared), 0);
+    struct utb_shared *s = id >= 0 ? (struct utb_shared *)usys(SYS_SHM_MAP, (uintptr_t)id, 0, 0) : NULL;
+    if (!s) {
+        out_puts(out, out_cap, &off, "utimebench: cannot create shared memory\n");
+        if (id >= 0) usys(SYS_SHM_UNLINK, (uintptr_t)"utimebench", 0, 0);
+        return (int)off;
+    }
+    memset(s, 0, sizeof(*s));
+    s->reads = (uint32_t)reads;
+
+    int pid = task_create_user("utimebench", (void *)utb_user, (uintptr_t)id);
+    if (pid <= 0) {
+        out_puts(out, out_cap, &off, "utimebench: cannot start the user task\n");
+    } else {
+        uint32_t start = timer_get_ms();
+        while (!s->done && timer_get_ms() - start < UTB_TIMEOUT_MS)
+            usys(SYS_FUTEX_WAIT, (uintptr_t)&s->done, 0, UTB_TIMEOUT_MS);
+        task_kill(pid);
+
+        if (!s->done) {
+            out_puts(out, out_cap, &off, "utimebench: no result from the user task\n");
+        } else if (!s->magic_ok) {
+            out_puts(out, out_cap, &off, "utimebench: time page not mapped at EL0\n");
+        } else {
+            out_putd(out, out_cap, &off, reads);
+            out_puts(out, out_cap, &off, " reads at EL0\n");
+            out_putpad(out, out_cap, &off, "utime_ns()", 14);
+            out_per_read(out, out_cap, &off, s->read_ns, s->reads);
+            out_puts(out, out_cap, &off, " per read\n");
+            out_putpad(out, out_cap, &off, "SYS_TIME", 14);
+            out_per_read(out, out_cap, &off, s->sys_ns, s->reads);
+            out_puts(out, out_cap, &off, " per call\n");
+            out_puts(out, out_cap, &off, "agreement: ");
+            out_putd(out, out_cap, &off, (int)s->disagree);
+            out_puts(out, out_cap, &off, " of ");
+            out_putd(out, out_cap, &off, UTB_CHECKS);
+            out_puts(out, out_cap, &off, " SYS_TIME results outside utime_ms(), ");
+            out_putd(out, out_cap, &off, (int)s->backwards);
+            out_puts(out, out_cap, &off, " backward steps\n");
+        }
+    }
+    usys(SYS_SHM_UNMAP, (uintptr_t)id, 0, 0);
+    usys(SYS_SHM_UNLINK, (uintptr_t)"utimebench", 0, 0);
+    return (int)off;
+}
@@ -7,6 +7,7 @@
 #include "uart.h"
 #include "timer.h"
 #include "cursor.h"
+#include "etask.h"
 
 static uint32_t bg_buffer[CURSOR_W * CURSOR_H];
 static int last_x = -1, last_y = -1;
@@ -51,56 +52,59 @@ void draw_cursor_overlay(int x, int y) {
     fb_set_pixel(x+4, y+4, c);
 }
 
-void cursor_task(void *arg) {
-    (void)arg;
-    int screen_w, screen_h;
-    fb_get_res(&screen_w, &screen_h);
-    
-    int mx = screen_w / 2;
-    int my = screen_h / 2;
-    
-    while (1) {
-        /* Wait for mouse event from IRQ or WM */
-        task_wait_event(MOUSE_EVENT_ID);
-        // uart_puts("Mouse event received\n");
+/* Hands mouse movement to the WM, which draws the cursor on top */
+static struct etask cursor_et;
+
+static int cursor_fn(struct etask *t) {
+    if (t->runs > 1) {
         int nx, ny, btn;
         input_get_mouse_state(&nx, &ny, &btn);
-        
         if (nx != last_x || ny != last_y) {
             /* Now handled by WM to ensure top-most layering */
             task_wake_event(WM_EVENT_ID);
         }
     }
+    /* Wait for mouse event from IRQ or WM */
+    etask_wait_event(t, MOUSE_EVENT_ID, NULL, 0);
+    return ETASK_WAIT;
 }
 
-void mouse_sim_task(void *arg) {
-    (void)arg;
-    int step = 0;
-    int dir = 0; // 0: Right, 1: Down, 2: Left, 3: Up
-    
-    while (1) {
-        timer_sleep_ms(50);
-        
+#ifdef REAL
+/* No mouse on the Pi yet: trace a square every 50ms */
+struct mouse_sim {
+    int step;
+    int dir; // 0: Right, 1: Down, 2: Left, 3: Up
+};
+
+static struct mouse_sim sim;
+static struct etask mouse_sim_et;
+
+static int mouse_sim_fn(struct etask *t) {
+    struct mouse_sim *m = (struct mouse_sim *)t->arg;
+    if (t->runs > 1) {
         int dx = 0, dy = 0;
-        if (dir == 0) dx = 5;
-        else if (dir == 1) dy = 5;
-        else if (dir == 2) dx = -5;
-        else if (dir == 3) dy = -5;
-        
+        if (m->dir == 0) dx = 5;
+        else if (m->dir == 1) dy = 5;
+        else if (m->dir == 2) dx = -5;
+        else if (m->dir == 3) dy = -5;
+
         input_push_event(INPUT_TYPE_REL, 0, dx);
         input_push_event(INPUT_TYPE_REL, 1, dy);
-        
-        step++;
-        if (step >= 40) {
-            step = 0;
-            dir = (dir + 1) % 4;
+
+        m->step++;
+        if (m->step >= 40) {
+            m->step = 0;
+            m->dir = (m->dir + 1) % 4;
         }
     }
+    etask_sleep_until(t, scheduler_get_tick() + 50);
+    return ETASK_WAIT;
 }
+#endif
 
 void cursor_init(void) {
-    task_create_with_stack(cursor_task, NULL, "cursor_overlay", 16);
+    etask_start(&cursor_et, cursor_fn, NULL, "cursor_overlay");
 #ifdef REAL
-    task_create(mouse_sim_task, NULL, "mouse_sim");
+    etask_start(&mouse_sim_et, mouse_sim_fn, &sim, "mouse_sim");
 #endif
 }
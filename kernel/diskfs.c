@@ -1,7 +1,7 @@
 #include "diskfs.h"
 #include "virtio.h"
 #include "ramfs.h"
-#include "uart.h"
+#include "klog.h"
 #include "kmalloc.h"
 #include "debug_overlay.h"
 #include "rpi_fx.h"
@@ -61,12 +61,12 @@ static int find_file_index(const char *name) {
 void diskfs_init(void) {
 #ifdef REAL
     if (rpi_blk_init() < 0) {
-        uart_puts("[diskfs] RPi block device (EMMC) init failed, diskfs disabled.\n");
+        KLOG(KLOG_FS, KLOG_WARN, "RPi block device (EMMC) init failed, diskfs disabled");
         return;
     }
 #else
     if (virtio_blk_init() < 0) {
-        uart_puts("[diskfs] block device not found, diskfs disabled.\n");
+        KLOG(KLOG_FS, KLOG_WARN, "block device not found, diskfs disabled");
         return;
     }
 #endif
@@ -82,9 +82,7 @@ void diskfs_init(void) {
 #else
         if (virtio_blk_rw(DIR_START_SECTOR + i, sector_bounce, 0) < 0) {
 #endif
-            uart_puts("[diskfs] ERROR: failed to read dir sector ");
-            uart_put_hex(DIR_START_SECTOR + i);
-            uart_puts("\n");
+            KLOG(KLOG_FS, KLOG_ERR, "failed to read dir sector %d", DIR_START_SECTOR + i);
             continue;
         }
         /* Copy bounce buf into the right slot of dir_cache */
@@ -105,7 +103,7 @@ void diskfs_init(void) {
             if (end > next_free_sector) next_free_sector = end;
         }
     }
-    uart_puts("[diskfs] ready, "); uart_putu(num_files); uart_puts(" files.\n");
+    KLOG(KLOG_FS, KLOG_INFO, "diskfs ready, %d files", num_files);
     dbg_set_diskfs(1, num_files);
 }
 
@@ -241,7 +239,7 @@ int diskfs_file_size(const char *name) {
 }
 
 void diskfs_sync_from_ramfs(void) {
-    uart_puts("[diskfs] syncing from ramfs...\n");
+    KLOG(KLOG_FS, KLOG_INFO, "syncing diskfs from ramfs");
     char list_buf[1024];
     int count = ramfs_list("/", list_buf, sizeof(list_buf));
     if (count < 0) return;
@@ -252,9 +250,7 @@ void diskfs_sync_from_ramfs(void) {
             // Read from ramfs
             uint8_t *tmp = kmalloc(65536); // Assume max 64KB for now
             if (!tmp) {
-                uart_puts("[diskfs] ERROR: kmalloc(65536) failed for file: ");
-                uart_puts(name);
-                uart_puts("\n");
+                KLOG(KLOG_FS, KLOG_ERR, "kmalloc(65536) failed for file: %s", name);
                 name += strlen(name) + 1;
                 continue;
             }
@@ -264,12 +260,12 @@ void diskfs_sync_from_ramfs(void) {
                 // For now, simple logic: create/overwrite.
                 // Log only if creating
                 if (find_file_index(name) < 0) {
-                    uart_puts("  syncing NEW: "); uart_puts(name); uart_puts("\n");
+                    KLOG(KLOG_FS, KLOG_DEBUG, "  syncing NEW: %s", name);
                     diskfs_create(name);
                     diskfs_write(name, tmp, read_len, 0);
                 } else {
                      // Update? 
-                     uart_puts("  syncing UPDATE: "); uart_puts(name); uart_puts("\n");
+                     KLOG(KLOG_FS, KLOG_DEBUG, "  syncing UPDATE: %s", name);
                      diskfs_write(name, tmp, read_len, 0); 
                 }
             }
@@ -277,14 +273,14 @@ void diskfs_sync_from_ramfs(void) {
         }
         name += strlen(name) + 1;
     }
-    uart_puts("[diskfs] sync complete.\n");
+    KLOG(KLOG_FS, KLOG_INFO, "diskfs sync complete");
 }
 
 void diskfs_sync_to_ramfs(void) {
     int loaded_count = 0;
     for (int i = 0; i < MAX_DISK_FILES; i++) {
         if (dir_cache[i].name[0] != '\0') {
-             uart_puts("[diskfs] loading: "); uart_puts(dir_cache[i].name); uart_puts("\n");
+             KLOG(KLOG_FS, KLOG_DEBUG, "loading: %s", dir_cache[i].name);
               
              /* Naive load */
              int size = dir_cache[i].size;
@@ -310,15 +306,14 @@ void diskfs_sync_to_ramfs(void) {
                  if (ramfs_create(dir_cache[i].name) == 0) {
                      ramfs_write(dir_cache[i].name, buf, size, 0);
                      loaded_count++;
-                     uart_puts("  created in RAMFS\n");
                  } else {
-                     uart_puts("  FAILED to create in RAMFS\n");
+                     KLOG(KLOG_FS, KLOG_ERR, "failed to create %s in ramfs", dir_cache[i].name);
                  }
                  kfree(buf);
              } else {
-                 uart_puts("  FAILED to malloc buffer for sync\n");
+                 KLOG(KLOG_FS, KLOG_ERR, "failed to malloc %d bytes to load %s", size, dir_cache[i].name);
              }
         }
     }
-    uart_puts("[diskfs] sync to ramfs complete. Loaded "); uart_putu(loaded_count); uart_puts(" files.\n");
+    KLOG(KLOG_FS, KLOG_INFO, "sync to ramfs complete, loaded %d files", loaded_count);
 }
@@ -9,6 +9,7 @@
 
 #define CS_RESET (1 << 31)
 #define CS_ACTIVE (1 << 0)
+#define CS_END (1 << 1)
 #define CS_ERROR (1 << 8)
 #define CS_WAIT_FOR_OUTSTANDING_WRITES (1 << 28)
 #define CS_PANIC_PRIORITY_SHIFT 20
@@ -22,6 +23,8 @@
 #define TI_SRC_INC (1 << 8)
 #define TI_DEST_WIDTH (1 << 5)
 #define TI_DEST_INC (1 << 4)
+#define TI_WAIT_RESP (1 << 3)
+#define TI_TDMODE (1 << 1)   /* 2D mode, channels 0-6 only */
 
 #define BUS_ADDRESS(x) (((uintptr_t)(x)) | 0xC0000000ULL)
 
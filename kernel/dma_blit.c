@@ -0,0 +1,289 @@
+#include "dma_blit.h"
+#include "dma.h"
+#include "palloc.h"
+#include "mmu.h"
+#include "uart.h"
+#include "lib.h"
+#include <stdint.h>
+#include <stddef.h>
+
+static uint32_t stat_rects = 0;
+static uint32_t stat_chains = 0;
+
+void dma_blit_stats(uint32_t *rects, uint32_t *chains) {
+    if (rects) *rects = stat_rects;
+    if (chains) *chains = stat_chains;
+}
+
+#ifdef REAL
+
+#define BLIT_MAX_CBS 64
+#define BLIT_BURST 8
+#define BLIT_TIMEOUT 100000000  /* spins before the engine is declared stuck */
+
+#define CACHE_CLEAN 0
+#define CACHE_CLEAN_INV 1
+
+struct blit_op {
+    uint32_t *dst;
+    const uint32_t *src;    /* NULL for fills */
+    int dst_pitch, src_pitch;
+    int w, h;
+    uint32_t color;
+};
+
+/* Lives in one page: control blocks must be 32-byte aligned, 128-bit fill
+ * sources 16-byte aligned. */
+struct blit_pool {
+    dma_control_block cb[BLIT_MAX_CBS];
+    uint32_t fill_src[BLIT_MAX_CBS][4];
+};
+
+static dma_channel *blit_ch = NULL;
+static struct blit_pool *pool = NULL;
+static struct blit_op ops[BLIT_MAX_CBS];
+static int n_ops = 0;
+static int batch_depth = 0;
+/* Real BCM2837 silicon performs YLENGTH+1 rows in 2D mode, emulators
+ * may perform YLENGTH; measured once in dma_blit_init(). */
+static int ylen_bias = 0;
+
+static void cache_range(uintptr_t start, uintptr_t end, int op) {
+    for (uintptr_t p = start & ~63ULL; p < end; p += 64) {
+        if (op == CACHE_CLEAN) __asm__ volatile("dc cvac, %0" : : "r" (p) : "memory");
+        else __asm__ volatile("dc civac, %0" : : "r" (p) : "memory");
+    }
+}
+
+static void cache_rect(const void *base, int pitch, int w, int h, int op) {
+    uintptr_t a = (uintptr_t)base;
+    /* Uncached targets (the Normal-NC scanout) have no lines to maintain */
+    if (mmu_get_memtype(a) > MMU_NORMAL_WB &&
+        mmu_get_memtype(a + (uintptr_t)pitch * (h - 1) + (uintptr_t)w * 4 - 1) > MMU_NORMAL_WB)
+        return;
+    if (pitch == w * 4) {
+        cache_range(a, a + (uintptr_t)pitch * h, op);
+        return;
+    }
+    for (int y = 0; y < h; y++, a += pitch) cache_range(a, a + (uintptr_t)w * 4, op);
+}
+
+static void cpu_run(const struct blit_op *op) {
+    for (int y = 0; y < op->h; y++) {
+        uint32_t *d = (uint32_t *)((uint8_t *)op->dst + (size_t)y * op->dst_pitch);
+        if (op->src) {
+            const uint32_t *s = (const uint32_t *)((const uint8_t *)op->src + (size_t)y * op->src_pitch);
+            memmove(d, s, (size_t)op->w * 4);
+        } else {
+            for (int x = 0; x < op->w; x++) d[x] = op->color;
+        }
+    }
+}
+
+static void blit_submit(void) {
+    if (n_ops == 0 || !blit_ch) return;
+    dma_req_regs *regs = REGS_DMA(blit_ch->channel);
+
+    /* Write back and drop every line the engine touches: dirty lines left
+     * in the cache would later be evicted over the DMA'd pixels, and the
+     * CPU must not read stale copies afterwards. Done here rather than at
+     * queue time because the CPU may draw next to queued rects meanwhile. */
+    for (int i = 0; i < n_ops; i++) {
+        cache_rect(ops[i].dst, ops[i].dst_pitch, ops[i].w, ops[i].h, CACHE_CLEAN_INV);
+        if (ops[i].src) cache_rect(ops[i].src, ops[i].src_pitch, ops[i].w, ops[i].h, CACHE_CLEAN);
+    }
+    cache_range((uintptr_t)&pool->cb[0], (uintptr_t)&pool->cb[n_ops], CACHE_CLEAN);
+    cache_range((uintptr_t)&pool->fill_src[0], (uintptr_t)&pool->fill_src[n_ops], CACHE_CLEAN);
+    __asm__ volatile("dsb sy" ::: "memory");
+
+    regs->control_block_addr = (uint32_t)BUS_ADDRESS(&pool->cb[0]);
+    regs->control = CS_END | CS_WAIT_FOR_OUTSTANDING_WRITES
+                  | (DEFAULT_PANIC_PRIORITY << CS_PANIC_PRIORITY_SHIFT)
+                  | (DEFAULT_PRIORITY << CS_PRIORITY_SHIFT)
+                  | CS_ACTIVE;
+
+    uint32_t spins = 0;
+    while ((regs->control & CS_ACTIVE) && ++spins < BLIT_TIMEOUT) ;
+    int ok = spins < BLIT_TIMEOUT && !(regs->control & CS_ERROR);
+
+    /* Drop lines speculatively refilled while the engine was writing */
+    for (int i = 0; i < n_ops; i++)
+        cache_rect(ops[i].dst, ops[i].dst_pitch, ops[i].w, ops[i].h, CACHE_CLEAN_INV);
+    __asm__ volatile("dsb sy" ::: "memory");
+
+    if (ok) {
+        stat_rects += n_ops;
+        stat_chains++;
+    } else {
+        _uart_puts("[dma_blit] transfer failed, falling back to CPU\n");
+        regs->control = CS_RESET;
+        blit_ch = NULL;
+        for (int i = 0; i < n_ops; i++) cpu_run(&ops[i]);
+    }
+    n_ops = 0;
+}
+
+static void blit_queue(const struct blit_op *op) {
+    if (n_ops == BLIT_MAX_CBS) blit_submit();
+    if (!blit_ch) {   /* engine gave up during that submit */
+        cpu_run(op);
+        return;
+    }
+    int n = n_ops;
+    dma_control_block *cb = &pool->cb[n];
+    int row_bytes = op->w * 4;
+
+    uint32_t ti = TI_TDMODE | TI_WAIT_RESP | TI_DEST_INC | (BLIT_BURST << TI_BURST_LENGTH_SHIFT);
+    int wide = ((uintptr_t)op->dst & 15) == 0 && (op->dst_pitch & 15) == 0 && (row_bytes & 15) == 0;
+    uint32_t src_stride;
+    if (op->src) {
+        ti |= TI_SRC_INC;
+        wide = wide && ((uintptr_t)op->src & 15) == 0 && (op->src_pitch & 15) == 0;
+        cb->src_addr = (uint32_t)BUS_ADDRESS(op->src);
+        src_stride = (uint16_t)(op->src_pitch - row_bytes);
+    } else {
+        /* Constant source: no SRC_INC, so every read hits the same 16 bytes */
+        for (int i = 0; i < 4; i++) pool->fill_src[n][i] = op->color;
+        cb->src_addr = (uint32_t)BUS_ADDRESS(pool->fill_src[n]);
+        src_stride = 0;
+    }
+    if (wide) ti |= TI_SRC_WIDTH | TI_DEST_WIDTH;
+
+    cb->transfer_info = ti;
+    cb->dest_addr = (uint32_t)BUS_ADDRESS(op->dst);
+    cb->transfer_length = ((uint32_t)(op->h - ylen_bias) << 16) | (uint32_t)row_bytes;
+    cb->mode_2d_stride = ((uint32_t)(uint16_t)(op->dst_pitch - row_bytes) << 16) | src_stride;
+    cb->next_block_addr = 0;
+    cb->res[0] = cb->res[1] = 0;
+    if (n > 0) pool->cb[n - 1].next_block_addr = (uint32_t)BUS_ADDRESS(cb);
+
+    ops[n] = *op;
+    n_ops = n + 1;
+    if (batch_depth == 0) blit_submit();
+}
+
+/* Can 2D mode express this rect with these pitches? */
+static int blit_shape_ok(int w, int h, int pitch) {
+    if (w <= 0 || h <= 0 || h > 0x3FFF || w * 4 > 0xFFFF) return 0;
+    if (pitch < w * 4 || pitch - w * 4 > 0x7FFF) return 0;
+    return 1;
+}
+
+static int blit_worth_it(int w, int h) {
+    return blit_ch && w * h >= DMA_BLIT_MIN_PIXELS;
+}
+
+int dma_blit_fill(uint32_t *dst, int dst_pitch, int w, int h, uint32_t color) {
+    if (!blit_worth_it(w, h) || !blit_shape_ok(w, h, dst_pitch)) return -1;
+    if ((uintptr_t)dst & 3) return -1;
+    struct blit_op op = { dst, NULL, dst_pitch, 0, w, h, color };
+    blit_queue(&op);
+    return 0;
+}
+
+int dma_blit_copy(uint32_t *dst, int dst_pitch, const uint32_t *src, int src_pitch, int w, int h) {
+    if (!blit_worth_it(w, h) || !blit_shape_ok(w, h, dst_pitch) || !blit_shape_ok(w, h, src_pitch)) return -1;
+    if (((uintptr_t)dst | (uintptr_t)src) & 3) return -1;
+
+    uintptr_t d0 = (uintptr_t)dst, d1 = d0 + (uintptr_t)(h - 1) * dst_pitch + (uintptr_t)w * 4;
+    uintptr_t s0 = (uintptr_t)src, s1 = s0 + (uintptr_t)(h - 1) * src_pitch + (uintptr_t)w * 4;
+    if (d0 > s0 && d0 < s1 && s0 < d1) {
+        /* Overlapping with the destination further down (scrolling down):
+         * the engine only walks forwards, so copy bands of `shift` rows
+         * from the bottom up; each band reads rows not yet overwritten. */
+        if (dst_pitch != src_pitch) return -1;
+        int shift = (int)((d0 - s0) / (uintptr_t)dst_pitch);
+        if (shift == 0) return -1;   /* same-row overlap: CPU memmove */
+        int bands = (h + shift - 1) / shift;
+        if (bands > BLIT_MAX_CBS) return -1;
+        if (n_ops + bands > BLIT_MAX_CBS) blit_submit();
+        batch_depth++;
+        for (int y = h; y > 0; y -= shift) {
+            int rows = (y >= shift) ? shift : y;
+            int top = y - rows;
+            struct blit_op op = {
+                (uint32_t *)((uint8_t *)dst + (size_t)top * dst_pitch),
+                (const uint32_t *)((const uint8_t *)src + (size_t)top * src_pitch),
+                dst_pitch, src_pitch, w, rows, 0
+            };
+            blit_queue(&op);
+        }
+        batch_depth--;
+        if (batch_depth == 0) blit_submit();
+        return 0;
+    }
+
+    struct blit_op op = { dst, src, dst_pitch, src_pitch, w, h, 0 };
+    blit_queue(&op);
+    return 0;
+}
+
+void dma_blit_begin(void) {
+    batch_depth++;
+}
+
+void dma_blit_end(void) {
+    if (batch_depth > 0 && --batch_depth == 0 && blit_ch) blit_submit();
+}
+
+int dma_blit_available(void) {
+    return blit_ch != NULL;
+}
+
+/* Run a one-row 2D fill into a scratch page and count the rows written */
+static int blit_calibrate(void) {
+    uint32_t *scratch = (uint32_t *)palloc_alloc();
+    if (!scratch) return -1;
+    memset(scratch, 0, 64);
+
+    ylen_bias = 0;
+    struct blit_op op = { scratch, NULL, 16, 0, 4, 1, 0xA5A5A5A5 };
+    blit_queue(&op);
+    int rows = 0;
+    if (blit_ch) {
+        for (int r = 0; r < 4; r++) if (scratch[r * 4] == 0xA5A5A5A5) rows++;
+    }
+    palloc_free(scratch, 1);
+    if (rows != 1 && rows != 2) return -1;
+    ylen_bias = rows - 1;
+    return 0;
+}
+
+int dma_blit_init(void) {
+    pool = (struct blit_pool *)palloc_alloc();
+    if (!pool) return -1;
+    memset(pool, 0, sizeof(*pool));
+
+    /* CT_NORMAL picks a full channel (0-6); lite channels lack 2D mode */
+    blit_ch = dma_open_channel(CT_NORMAL);
+    if (!blit_ch) return -1;
+
+    if (blit_calibrate() < 0) {
+        _uart_puts("[dma_blit] 2D DMA self-test failed, using CPU\n");
+        blit_ch = NULL;
+        return -1;
+    }
+    _uart_puts("[dma_blit] channel "); _uart_putu(blit_ch->channel);
+    _uart_puts(", 2D ylen bias "); _uart_putu((unsigned)ylen_bias); _uart_puts("\n");
+    return 0;
+}
+
+#else /* !REAL: no BCM DMA controller on QEMU virt */
+
+int dma_blit_init(void) { return -1; }
+int dma_blit_available(void) { return 0; }
+
+int dma_blit_fill(uint32_t *dst, int dst_pitch, int w, int h, uint32_t color) {
+    (void)dst; (void)dst_pitch; (void)w; (void)h; (void)color;
+    return -1;
+}
+
+int dma_blit_copy(uint32_t *dst, int dst_pitch, const uint32_t *src, int src_pitch, int w, int h) {
+    (void)dst; (void)dst_pitch; (void)src; (void)src_pitch; (void)w; (void)h;
+    return -1;
+}
+
+void dma_blit_begin(void) {}
+void dma_blit_end(void) {}
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef DMA_BLIT_H
+#define DMA_BLIT_H
+
+#include <stdint.h>
+
+/* DMA-engine blitter for 32bpp surfaces (REAL only).
+ *
+ * Fills and copies run as 2D DMA transfers: one control block per
+ * rectangle, chained when several are queued between dma_blit_begin()
+ * and dma_blit_end(). Widths/heights are in pixels, pitches in bytes.
+ *
+ * Both calls return 0 when the rectangle was handed to the DMA engine
+ * (finished on return, or queued in the open batch) and -1 when the
+ * caller should draw it with the CPU: no DMA on this target, rectangle
+ * below DMA_BLIT_MIN_PIXELS, or a layout 2D mode cannot express.
+ *
+ * Inside a batch, queued rectangles must not overlap anything the CPU
+ * draws before dma_blit_end(). */
+
+#define DMA_BLIT_MIN_PIXELS 4096
+
+int dma_blit_init(void);
+int dma_blit_available(void);
+
+int dma_blit_fill(uint32_t *dst, int dst_pitch, int w, int h, uint32_t color);
+int dma_blit_copy(uint32_t *dst, int dst_pitch, const uint32_t *src, int src_pitch, int w, int h);
+
+void dma_blit_begin(void);
+void dma_blit_end(void);
+
+/* Counters since boot: rectangles done by DMA, chains submitted */
+void dma_blit_stats(uint32_t *rects, uint32_t *chains);
+
+#endif
@@ -0,0 +1,157 @@
+#include "etask.h"
+#include "sched.h"
+#include "irq.h"
+#include "klog.h"
+
+#define ETASKD_STACK_KB 16
+
+static struct etask *etasks = NULL;     /* in start order */
+static volatile uint32_t etask_gen = 0; /* bumped when one is woken; etaskd sleeps on it */
+static int etaskd_pid = 0;
+static uint32_t passes = 0;
+
+static int is_ready(const struct etask *t, uint32_t now) {
+    if (t->ready) return 1;
+    if (t->gen && *t->gen != t->seen) return 1;
+    return t->timed && (int32_t)(now - t->wake_tick) >= 0;
+}
+
+static int armed(const struct etask *t) {
+    return t->event || t->gen || t->timed;
+}
+
+static void unlink(struct etask *t) {
+    unsigned long flags = irq_save();
+    for (struct etask **pp = &etasks; *pp; pp = &(*pp)->next) {
+        if (*pp == t) { *pp = t->next; break; }
+    }
+    t->linked = 0;
+    irq_restore(flags);
+}
+
+static void etaskd(void *arg) {
+    (void)arg;
+    for (;;) {
+        uint32_t seen = etask_gen;
+        uint32_t now = scheduler_get_tick();
+        int again = 0, timed = 0;
+        uint32_t deadline = 0;
+        passes++;
+
+        struct etask **pp = &etasks;
+        while (*pp) {
+            struct etask *t = *pp;
+            if (is_ready(t, now)) {
+                unsigned long flags = irq_save();
+                t->event = 0;
+                t->gen = 0;
+                t->timed = 0;
+                t->ready = 0;
+                irq_restore(flags);
+                t->runs++;
+                int r = t->fn(t);
+                if (!t->linked) continue;           /* stopped itself: *pp is its successor */
+                if (r == ETASK_DONE) { unlink(t); continue; }
+                if (!armed(t)) { t->ready = 1; again = 1; }
+            }
+            if (t->timed && (!timed || (int32_t)(t->wake_tick - deadline) < 0)) {
+                deadline = t->wake_tick;
+                timed = 1;
+            }
+            pp = &t->next;
+        }
+
+        if (again) yield();
+        else if (timed) task_wait_event_until((void *)&etask_gen, &etask_gen, seen, deadline);
+        else task_wait_event_unless((void *)&etask_gen, &etask_gen, seen);
+    }
+}
+
+int etask_start(struct etask *t, etask_fn fn, void *arg, const char *name) {
+    if (!t || !fn || t->linked) return -1;
+    if (etaskd_pid <= 0 || !task_exists(etaskd_pid)) {
+        etaskd_pid = task_create_with_stack(etaskd, 0, "etaskd", ETASKD_STACK_KB);
+        if (etaskd_pid <= 0) { etaskd_pid = 0; return -1; }
+        task_set_parent(etaskd_pid, 0);
+    }
+    t->fn = fn;
+    t->arg = arg;
+    t->state = 0;
+    t->name = name;
+    t->event = 0;
+    t->gen = 0;
+    t->timed = 0;
+    t->ready = 1;
+    t->runs = 0;
+    t->next = 0;
+
+    unsigned long flags = irq_save();
+    struct etask **pp = &etasks;
+    while (*pp) pp = &(*pp)->next;
+    *pp = t;
+    t->linked = 1;
+    etask_gen++;
+    irq_restore(flags);
+    task_wake_event((void *)&etask_gen);
+    KLOG(KLOG_SCHED, KLOG_DEBUG, "etask %s started", name ? name : "?");
+    return 0;
+}
+
+void etask_stop(struct etask *t) {
+    if (t && t->linked) unlink(t);
+}
+
+void etask_wait_event(struct etask *t, void *event, volatile uint32_t *gen, uint32_t seen) {
+    t->gen = gen;
+    t->seen = seen;
+    t->event = event;
+}
+
+void etask_wait_event_until(struct etask *t, void *event, volatile uint32_t *gen, uint32_t seen,
+                            uint32_t wake_tick) {
+    t->wake_tick = wake_tick;
+    t->timed = 1;
+    etask_wait_event(t, event, gen, seen);
+}
+
+void etask_sleep_until(struct etask *t, uint32_t wake_tick) {
+    t->wake_tick = wake_tick;
+    t->timed = 1;
+}
+
+void etask_wake_event(void *event) {
+    if (!etasks || event == (void *)&etask_gen) return;
+    int woke = 0;
+    unsigned long flags = irq_save();
+    for (struct etask *t = etasks; t; t = t->next) {
+        if (t->event == event) {
+            t->ready = 1;
+            woke = 1;
+        }
+    }
+    if (woke) etask_gen++;
+    irq_restore(flags);
+    if (woke) task_wake_event((void *)&etask_gen);
+}
+
+void etask_get_stats(struct etask_stats *s) {
+    s->tasks = 0;
+    s->runs = 0;
+    for (struct etask *t = etasks; t; t = t->next) {
+        s->tasks++;
+        s->runs += t->runs;
+    }
+    s->passes = passes;
+    s->bytes = (size_t)s->tasks * sizeof(struct etask) + (etaskd_pid ? task_footprint(ETASKD_STACK_KB) : 0);
+    s->thread_bytes = (size_t)s->tasks * task_footprint(16);
+}
+
+int etask_info(int i, const char **name, uint32_t *runs, int *waiting) {
+    struct etask *t = etasks;
+    while (t && i-- > 0) t = t->next;
+    if (!t) return 0;
+    *name = t->name ? t->name : "?";
+    *runs = t->runs;
+    *waiting = !is_ready(t, scheduler_get_tick());
+    return 1;
+}
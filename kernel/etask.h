@@ -0,0 +1,71 @@
+#ifndef ETASK_H
+#define ETASK_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Stackless event tasks.
+ *
+ * For jobs that wait for something and then do a little work. An event
+ * task is a handler plus a small struct: no stack, no context. All of
+ * them are run by one kernel task, "etaskd", which calls each handler
+ * whose wait is over and goes back to sleep when none is. The handler
+ * runs to completion. It must not block or yield. It keeps whatever has
+ * to survive until the next call in its struct (state, arg), arms its
+ * next wait with etask_wait_*, and returns:
+ *   ETASK_WAIT   the wait it armed (no wait armed: runs again next pass)
+ *   ETASK_DONE   never run again; the struct is free to reuse
+ * Waits use the same event ids and generation words as the blocking
+ * task_wait_event_* calls, so anything that wakes tasks wakes event tasks. */
+
+#define ETASK_WAIT  0
+#define ETASK_DONE  1
+
+struct etask;
+typedef int (*etask_fn)(struct etask *t);
+
+struct etask {
+    etask_fn fn;
+    void *arg;
+    int state;                  /* continuation point, the handler's to use */
+    const char *name;
+    /* armed wait */
+    void *event;
+    volatile uint32_t *gen;
+    uint32_t seen;
+    uint32_t wake_tick;
+    uint8_t timed;
+    volatile uint8_t ready;
+    uint8_t linked;
+    uint32_t runs;
+    struct etask *next;
+};
+
+/* Set up t (usually static) and make it runnable */
+int etask_start(struct etask *t, etask_fn fn, void *arg, const char *name);
+/* Stop t from another context; a handler stops itself with ETASK_DONE */
+void etask_stop(struct etask *t);
+
+/* Called by the handler before returning ETASK_WAIT. gen may be NULL;
+ * otherwise the task also runs once *gen no longer equals seen. */
+void etask_wait_event(struct etask *t, void *event, volatile uint32_t *gen, uint32_t seen);
+void etask_wait_event_until(struct etask *t, void *event, volatile uint32_t *gen, uint32_t seen,
+                            uint32_t wake_tick);
+void etask_sleep_until(struct etask *t, uint32_t wake_tick);
+
+/* From task_wake_event: mark the tasks waiting on event ready (IRQ-safe) */
+void etask_wake_event(void *event);
+
+struct etask_stats {
+    int tasks;
+    uint32_t runs;              /* handler calls */
+    uint32_t passes;            /* times etaskd was switched to */
+    size_t bytes;               /* what the tasks take */
+    size_t thread_bytes;        /* what they would take as kernel tasks */
+};
+
+void etask_get_stats(struct etask_stats *s);
+/* Name, runs and readiness of task i (in start order); 0 past the end */
+int etask_info(int i, const char **name, uint32_t *runs, int *waiting);
+
+#endif
@@ -1,5 +1,7 @@
 #include "framebuffer.h"
 #include "virtio.h"
+#include "dma_blit.h"
+#include "pixel.h"
 #include <stdint.h>
 #include <stddef.h>
 
@@ -9,6 +11,9 @@ static int fb_h = 0;
 static int fb_stride = 0; /* in pixels (not bytes) */
 static int fb_init_done = 0;
 
+static struct fb_rect fb_clip_rects[FB_CLIP_MAX];
+static int fb_clip_count = -1; /* -1 = no clip region */
+
 /* Simple 5x7 block glyphs for a small character set used in the splash */
 struct glyph5x7 { char ch; uint8_t rows[7]; };
 
@@ -131,16 +136,31 @@ void fb_init(void *addr, int width, int height, int stride_bytes) {
     fb_init_done = 1;
 }
 
+/* Point the drawing primitives at another surface without clearing it */
+void fb_set_target(void *addr, int width, int height, int stride_bytes) {
+    fb = (volatile uint32_t *)addr;
+    fb_w = width;
+    fb_h = height;
+    fb_stride = stride_bytes / 4;
+}
+
 int fb_is_init(void) { return fb_init_done; }
 void fb_get_res(int *w, int *h) { if (w) *w = fb_w; if (h) *h = fb_h; }
 
-void fb_fill(uint32_t color) {
-    if (!fb) return;
+uint32_t fb_checksum(void) {
+    if (!fb) return 0;
+    uint32_t h = 2166136261u;
     for (int y = 0; y < fb_h; ++y) {
-        volatile uint32_t *p = fb + (y * fb_stride);
-        int n = fb_w;
-        while (n--) *p++ = color;
+        const uint32_t *row = (const uint32_t *)(fb + (y * fb_stride));
+        for (int x = 0; x < fb_w; ++x) h = (h ^ row[x]) * 16777619u;
     }
+    return h;
+}
+
+void fb_fill(uint32_t color) {
+    if (!fb) return;
+    for (int y = 0; y < fb_h; ++y)
+        pix_fill((uint32_t *)(fb + (y * fb_stride)), color, fb_w);
 }
 
 /* ASM friendly wrapper that doesn't rely on complex context */
@@ -155,9 +175,41 @@ void fb_fill_asm(uint32_t color) {
     rpi_gpu_flush();
 }
 
+void fb_set_clip(const struct fb_rect *rects, int count) {
+    if (count > FB_CLIP_MAX) count = FB_CLIP_MAX;
+    if (count < 0) count = 0;
+    for (int i = 0; i < count; i++) fb_clip_rects[i] = rects[i];
+    fb_clip_count = count;
+}
+
+void fb_clear_clip(void) {
+    fb_clip_count = -1;
+}
+
+static int fb_clip_contains(int x, int y) {
+    for (int i = 0; i < fb_clip_count; i++) {
+        const struct fb_rect *r = &fb_clip_rects[i];
+        if (x >= r->x && x < r->x + r->w && y >= r->y && y < r->y + r->h) return 1;
+    }
+    return 0;
+}
+
+/* Intersect (x,y,w,h) with clip rect i; returns 0 if nothing is left */
+static int fb_clip_to(int i, int *x, int *y, int *w, int *h) {
+    const struct fb_rect *r = &fb_clip_rects[i];
+    int x0 = (*x > r->x) ? *x : r->x;
+    int y0 = (*y > r->y) ? *y : r->y;
+    int x1 = (*x + *w < r->x + r->w) ? *x + *w : r->x + r->w;
+    int y1 = (*y + *h < r->y + r->h) ? *y + *h : r->y + r->h;
+    if (x1 <= x0 || y1 <= y0) return 0;
+    *x = x0; *y = y0; *w = x1 - x0; *h = y1 - y0;
+    return 1;
+}
+
 void fb_set_pixel(int x, int y, uint32_t color) {
     if (!fb) return;
     if ((unsigned int)x < (unsigned int)fb_w && (unsigned int)y < (unsigned int)fb_h) {
+        if (fb_clip_count >= 0 && !fb_clip_contains(x, y)) return;
         fb[y * fb_stride + x] = color;
     }
 }
@@ -170,6 +222,12 @@ uint32_t fb_get_pixel(int x, int y) {
     return 0;
 }
 
+static void fb_fill_rect(int x, int y, int w, int h, uint32_t color) {
+    if (dma_blit_fill((uint32_t *)(fb + y * fb_stride + x), fb_stride * 4, w, h, color) == 0) return;
+    for (int i = 0; i < h; i++)
+        pix_fill((uint32_t *)(fb + ((y + i) * fb_stride) + x), color, w);
+}
+
 void fb_draw_rect(int x, int y, int w, int h, uint32_t color) {
     if (!fb) return;
     /* Clip to screen */
@@ -179,10 +237,72 @@ void fb_draw_rect(int x, int y, int w, int h, uint32_t color) {
     if (y + h > fb_h) h = fb_h - y;
     if (w <= 0 || h <= 0) return;
 
+    if (fb_clip_count < 0) {
+        fb_fill_rect(x, y, w, h, color);
+        return;
+    }
+    /* clip rects are disjoint, so their DMA fills can go out as one chain */
+    dma_blit_begin();
+    for (int i = 0; i < fb_clip_count; i++) {
+        int cx = x, cy = y, cw = w, ch = h;
+        if (fb_clip_to(i, &cx, &cy, &cw, &ch)) fb_fill_rect(cx, cy, cw, ch, color);
+    }
+    dma_blit_end();
+}
+
+static void fb_copy_in(int x, int y, int w, int h, const uint32_t *src, int src_stride) {
+    if (dma_blit_copy((uint32_t *)(fb + y * fb_stride + x), fb_stride * 4, src, src_stride * 4, w, h) == 0) return;
+    for (int i = 0; i < h; i++)
+        pix_copy((uint32_t *)(fb + ((y + i) * fb_stride) + x), src + (size_t)i * src_stride, w);
+}
+
+void fb_blit(int x, int y, int w, int h, const uint32_t *src, int src_stride) {
+    if (!fb || !src) return;
+    /* Clip to screen, moving the source origin along */
+    if (x < 0) { src -= x; w += x; x = 0; }
+    if (y < 0) { src -= (size_t)y * src_stride; h += y; y = 0; }
+    if (x + w > fb_w) w = fb_w - x;
+    if (y + h > fb_h) h = fb_h - y;
+    if (w <= 0 || h <= 0) return;
+
+    if (fb_clip_count < 0) {
+        fb_copy_in(x, y, w, h, src, src_stride);
+        return;
+    }
+    dma_blit_begin();
+    for (int i = 0; i < fb_clip_count; i++) {
+        int cx = x, cy = y, cw = w, ch = h;
+        if (fb_clip_to(i, &cx, &cy, &cw, &ch))
+            fb_copy_in(cx, cy, cw, ch, src + (size_t)(cy - y) * src_stride + (cx - x), src_stride);
+    }
+    dma_blit_end();
+}
+
+void fb_copy_rect(int dx, int dy, int sx, int sy, int w, int h) {
+    if (!fb) return;
+    /* Clip both rectangles to the screen */
+    if (sx < 0) { dx -= sx; w += sx; sx = 0; }
+    if (sy < 0) { dy -= sy; h += sy; sy = 0; }
+    if (dx < 0) { sx -= dx; w += dx; dx = 0; }
+    if (dy < 0) { sy -= dy; h += dy; dy = 0; }
+    if (sx + w > fb_w) w = fb_w - sx;
+    if (dx + w > fb_w) w = fb_w - dx;
+    if (sy + h > fb_h) h = fb_h - sy;
+    if (dy + h > fb_h) h = fb_h - dy;
+    if (w <= 0 || h <= 0) return;
+
+    if (dma_blit_copy((uint32_t *)(fb + dy * fb_stride + dx), fb_stride * 4,
+                      (const uint32_t *)(fb + sy * fb_stride + sx), fb_stride * 4, w, h) == 0) return;
+
+    /* CPU: walk rows (and pixels) in the direction that never reads a
+     * pixel after overwriting it */
+    int down = dy > sy || (dy == sy && dx > sx);
     for (int i = 0; i < h; i++) {
-        volatile uint32_t *p = fb + ((y + i) * fb_stride) + x;
-        int n = w;
-        while (n--) *p++ = color;
+        int r = down ? h - 1 - i : i;
+        volatile uint32_t *d = fb + (dy + r) * fb_stride + dx;
+        volatile uint32_t *s = fb + (sy + r) * fb_stride + sx;
+        if (down) { for (int n = w - 1; n >= 0; n--) d[n] = s[n]; }
+        else { for (int n = 0; n < w; n++) d[n] = s[n]; }
     }
 }
 
@@ -358,8 +478,41 @@ void fb_puts(const char *s) {
     }
 }
 
+/* Blit the part of the scaled bitmap that falls in screen area (ix,iy,iw,ih) */
+static void fb_blit_scaled(int x, int y, int w, int h, const uint32_t *bitmap, int bw, int bh, int ix, int iy, int iw, int ih) {
+    /* Nearest neighbour: src_x = (dst_x - x) * bw / w, likewise for y.
+     * Each row is scaled into a small buffer (unless 1:1) and then
+     * alpha-blended onto the screen. */
+    int x0 = ix < 0 ? 0 : ix;
+    int x1 = ix + iw > fb_w ? fb_w : ix + iw;
+    if (x0 >= x1) return;
+    uint32_t row[256];
+
+    for (int dy = 0; dy < ih; dy++) {
+        int screen_y = iy + dy;
+        if (screen_y < 0 || screen_y >= fb_h) continue;
+
+        int src_y = ((screen_y - y) * bh) / h;
+        if (src_y < 0) src_y = 0;
+        if (src_y >= bh) src_y = bh - 1;
+
+        uint32_t *row_dst = (uint32_t *)(fb + (screen_y * fb_stride));
+        const uint32_t *row_src = bitmap + (src_y * bw);
+
+        if (bw == w) {
+            pix_blend(row_dst + x0, row_src + (x0 - x), x1 - x0);
+            continue;
+        }
+        for (int sx = x0; sx < x1; sx += 256) {
+            int n = x1 - sx < 256 ? x1 - sx : 256;
+            pix_scale_row(row, row_src, n, sx - x, bw, w);
+            pix_blend(row_dst + sx, row, n);
+        }
+    }
+}
+
 void fb_draw_bitmap_scaled(int x, int y, int w, int h, const uint32_t *bitmap, int bw, int bh, int cx, int cy, int cw, int ch) {
-    if (!fb || !bitmap) return;
+    if (!fb || !bitmap || w <= 0 || h <= 0) return;
     
     /* Clipping */
     /* Intersection of target rect (x,y,w,h) and clip rect (cx,cy,cw,ch) */
@@ -373,62 +526,12 @@ void fb_draw_bitmap_scaled(int x, int y, int w, int h, const uint32_t *bitmap, i
     
     if (iw <= 0 || ih <= 0) return;
 
-    /* For nearest neighbor scaling:
-       src_x = (dst_x - x) * bw / w
-       src_y = (dst_y - y) * bh / h
-    */
-
-    for (int dy = 0; dy < ih; dy++) {
-        int screen_y = iy + dy;
-        /* Screen bounds check */
-        if (screen_y < 0 || screen_y >= fb_h) continue;
-        
-        /* Map screen_y back to source y */
-        /* relative y in dst rect */
-        int rel_y = screen_y - y;
-        
-        int src_y = (rel_y * bh) / h;
-        if (src_y < 0) src_y = 0;
-        if (src_y >= bh) src_y = bh - 1;
-
-        volatile uint32_t *row_dst = fb + (screen_y * fb_stride);
-        const uint32_t *row_src_base = bitmap + (src_y * bw);
-
-        for (int dx = 0; dx < iw; dx++) {
-            int screen_x = ix + dx;
-            if (screen_x < 0 || screen_x >= fb_w) continue;
-
-            int rel_x = screen_x - x;
-            int src_x = (rel_x * bw) / w;
-            if (src_x < 0) src_x = 0;
-            if (src_x >= bw) src_x = bw - 1;
-
-            uint32_t color = row_src_base[src_x];
-            
-            /* Simple Alpha Blend */
-            uint8_t a = (color >> 24) & 0xFF;
-            if (a == 0) continue;
-            if (a == 255) {
-                row_dst[screen_x] = color;
-            } else {
-                /* read dst */
-                uint32_t dst = row_dst[screen_x];
-                uint8_t dr = (dst >> 16) & 0xFF;
-                uint8_t dg = (dst >> 8) & 0xFF;
-                uint8_t db = dst & 0xFF;
-                
-                uint8_t sr = (color >> 16) & 0xFF;
-                uint8_t sg = (color >> 8) & 0xFF;
-                uint8_t sb = color & 0xFF;
-
-                uint16_t inv_a = 255 - a;
-                uint8_t r = (uint8_t)((sr * a + dr * inv_a) / 255);
-                uint8_t g = (uint8_t)((sg * a + dg * inv_a) / 255);
-                uint8_t b = (uint8_t)((sb * a + db * inv_a) / 255);
-                
-                row_dst[screen_x] = (0xFF << 24) | (r << 16) | (g << 8) | b;
-            }
-        }
+    if (fb_clip_count < 0) {
+        fb_blit_scaled(x, y, w, h, bitmap, bw, bh, ix, iy, iw, ih);
+        return;
+    }
+    for (int i = 0; i < fb_clip_count; i++) {
+        int rx = ix, ry = iy, rw = iw, rh = ih;
+        if (fb_clip_to(i, &rx, &ry, &rw, &rh)) fb_blit_scaled(x, y, w, h, bitmap, bw, bh, rx, ry, rw, rh);
     }
 }
-
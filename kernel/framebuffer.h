@@ -4,6 +4,7 @@
 #include <stdint.h>
 
 void fb_init(void *addr, int width, int height, int stride_bytes);
+void fb_set_target(void *addr, int width, int height, int stride_bytes);
 void fb_set_pixel(int x, int y, uint32_t color);
 uint32_t fb_get_pixel(int x, int y);
 void fb_draw_rect(int x, int y, int w, int h, uint32_t color);
@@ -19,5 +20,20 @@ void fb_put_text(const char *s, int x, int y, uint32_t color);
 void fb_get_res(int *w, int *h);
 void fb_draw_bitmap_scaled(int x, int y, int w, int h, const uint32_t *bitmap, int bw, int bh, int cx, int cy, int cw, int ch);
 void fb_draw_scaled_glyph(const uint8_t *g, int x, int y, int scale, uint32_t color);
+/* Opaque 1:1 copy of a w x h ARGB image (src_stride in pixels); honours the clip region */
+void fb_blit(int x, int y, int w, int h, const uint32_t *src, int src_stride);
+/* Screen-to-screen move, overlap-safe (scrolling); ignores the clip region */
+void fb_copy_rect(int dx, int dy, int sx, int sy, int w, int h);
+/* FNV-1a over the visible pixels of the current target (frame regression checks) */
+uint32_t fb_checksum(void);
+
+/* Clip region: while set, the drawing primitives above only touch pixels
+ * inside the union of the given rectangles (fb_fill ignores it).
+ * count == 0 clips everything away. The compositor uses this to restrict
+ * each window to the part not covered by windows above it. */
+#define FB_CLIP_MAX 32
+struct fb_rect { int x, y, w, h; };
+void fb_set_clip(const struct fb_rect *rects, int count);
+void fb_clear_clip(void);
 
 #endif
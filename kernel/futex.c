@@ -0,0 +1,95 @@
+#include "futex.h"
+#include "sched.h"
+#include "mmu.h"
+#include "irq.h"
+
+#define FUTEX_BUCKETS 32
+
+/* On the waiting task's stack */
+struct futex_waiter {
+    struct futex_waiter *next;
+    uintptr_t key;
+    volatile uint32_t gen;
+    volatile int woken;
+    int queued;
+};
+
+static struct futex_waiter *buckets[FUTEX_BUCKETS];
+
+static int futex_key(volatile uint32_t *uaddr, uintptr_t *key) {
+    if (!uaddr || ((uintptr_t)uaddr & 3)) return -1;
+    return mmu_translate(task_current_pgd(), (uintptr_t)uaddr, key);
+}
+
+static struct futex_waiter **bucket(uintptr_t key) {
+    return &buckets[(key >> 2) % FUTEX_BUCKETS];
+}
+
+static void dequeue(struct futex_waiter *w) {
+    unsigned long flags = irq_save();
+    if (w->queued) {
+        struct futex_waiter **pp = bucket(w->key);
+        while (*pp && *pp != w) pp = &(*pp)->next;
+        if (*pp) *pp = w->next;
+        w->queued = 0;
+    }
+    irq_restore(flags);
+}
+
+static void abandon(void *arg) {
+    dequeue((struct futex_waiter *)arg);
+}
+
+int futex_wait(volatile uint32_t *uaddr, uint32_t expected, int timeout_ms) {
+    struct futex_waiter w = { 0 };
+    if (futex_key(uaddr, &w.key) < 0) return -1;
+
+    unsigned long flags = irq_save();
+    if (*uaddr != expected) {
+        irq_restore(flags);
+        return FUTEX_AGAIN;
+    }
+    /* at the tail: wakes go out in arrival order */
+    struct futex_waiter **pp = bucket(w.key);
+    while (*pp) pp = &(*pp)->next;
+    *pp = &w;
+    w.queued = 1;
+    irq_restore(flags);
+
+    /* a task killed while waiting must not stay linked */
+    task_set_reap_hook(abandon, &w);
+    uint32_t until = scheduler_get_tick() + (uint32_t)timeout_ms;
+    while (!w.woken) {
+        uint32_t seen = w.gen;
+        if (w.woken) break;
+        if (timeout_ms < 0) {
+            task_wait_event_unless(&w, &w.gen, seen);
+        } else {
+            if ((int32_t)(scheduler_get_tick() - until) >= 0) break;
+            task_wait_event_until(&w, &w.gen, seen, until);
+        }
+    }
+    task_set_reap_hook(0, 0);
+    dequeue(&w);
+    return w.woken ? FUTEX_WOKEN : FUTEX_TIMEDOUT;
+}
+
+int futex_wake(volatile uint32_t *uaddr, int n) {
+    uintptr_t key;
+    if (futex_key(uaddr, &key) < 0) return -1;
+    int woken = 0;
+    unsigned long flags = irq_save();
+    struct futex_waiter **pp = bucket(key);
+    while (*pp && woken < n) {
+        struct futex_waiter *w = *pp;
+        if (w->key != key) { pp = &w->next; continue; }
+        *pp = w->next;
+        w->queued = 0;
+        w->woken = 1;
+        w->gen++;
+        task_wake_event(w);
+        woken++;
+    }
+    irq_restore(flags);
+    return woken;
+}
@@ -0,0 +1,21 @@
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include <stdint.h>
+
+/* Wait queues keyed by the physical address of a 32-bit word, so tasks
+ * mapping the same shared page at different addresses meet on the same
+ * queue. futex_wait sleeps only if the word still holds `expected`, and
+ * the test and the enqueue happen together, so a wake that follows a
+ * change of the word is never lost. */
+
+#define FUTEX_WOKEN     0
+#define FUTEX_AGAIN     1       /* the word did not hold the expected value */
+#define FUTEX_TIMEDOUT  2
+
+/* timeout_ms < 0 waits until woken. Returns FUTEX_*, -1 if uaddr is not mapped */
+int futex_wait(volatile uint32_t *uaddr, uint32_t expected, int timeout_ms);
+/* Wake up to n waiters; returns how many */
+int futex_wake(volatile uint32_t *uaddr, int n);
+
+#endif
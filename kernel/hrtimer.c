@@ -0,0 +1,185 @@
+#include "hrtimer.h"
+#include "timer.h"
+#include "irq.h"
+#include "klog.h"
+
+#define HRTIMER_MAX 64
+
+#define CNTP_CTL_ENABLE (1u << 0)
+#define CNTP_CTL_IMASK  (1u << 1)
+
+static struct hrtimer *heap[HRTIMER_MAX];
+static int nheap = 0;
+static volatile int pending = 0;    /* the comparator fired */
+static int running = 0;             /* inside hrtimer_run */
+static uint64_t programmed = 0;     /* what CNTP_CVAL holds; 0 while disarmed */
+static struct hrtimer_stats stats;
+
+static inline void cntp_write(uint64_t cval, uint64_t ctl) {
+    __asm__ volatile("msr cntp_cval_el0, %0" :: "r"(cval));
+    __asm__ volatile("msr cntp_ctl_el0, %0" :: "r"(ctl));
+    __asm__ volatile("isb" ::: "memory");
+}
+
+static inline int before(uint64_t a, uint64_t b) {
+    return (int64_t)(a - b) < 0;
+}
+
+static void heap_set(int i, struct hrtimer *t) {
+    heap[i] = t;
+    t->slot = i;
+}
+
+static void sift_up(int i) {
+    struct hrtimer *t = heap[i];
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!before(t->expires, heap[parent]->expires)) break;
+        heap_set(i, heap[parent]);
+        i = parent;
+    }
+    heap_set(i, t);
+}
+
+static void sift_down(int i) {
+    struct hrtimer *t = heap[i];
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= nheap) break;
+        if (c + 1 < nheap && before(heap[c + 1]->expires, heap[c]->expires)) c++;
+        if (!before(heap[c]->expires, t->expires)) break;
+        heap_set(i, heap[c]);
+        i = c;
+    }
+    heap_set(i, t);
+}
+
+static void heap_remove(struct hrtimer *t) {
+    int i = t->slot;
+    t->slot = -1;
+    if (--nheap == i) return;
+    struct hrtimer *last = heap[nheap];
+    heap_set(i, last);
+    sift_up(i);
+    sift_down(last->slot);
+}
+
+/* Point the comparator at the earliest expiry (IRQs off) */
+static void reprogram(void) {
+    if (nheap == 0) {
+        if (programmed) cntp_write(0, CNTP_CTL_IMASK);
+        programmed = 0;
+        return;
+    }
+    if (heap[0]->expires == programmed) return;
+    programmed = heap[0]->expires;
+    cntp_write(programmed, CNTP_CTL_ENABLE);
+    stats.programs++;
+}
+
+/* The timer line stays asserted while CVAL <= CNTPCT: mask it and leave
+ * the rest to hrtimer_run */
+static void hrtimer_irq(void *arg) {
+    (void)arg;
+    cntp_write(0, CNTP_CTL_IMASK);
+    programmed = 0;
+    pending = 1;
+    stats.irqs++;
+}
+
+void hrtimers_init(void) {
+    cntp_write(0, CNTP_CTL_IMASK);
+    stats.irq_wired = irq_request(IRQ_CNTPNS, hrtimer_irq, NULL, NULL, "hrtimer") == 0;
+    if (!stats.irq_wired) KLOG(KLOG_SCHED, KLOG_WARN, "hrtimer: no comparator IRQ, expiry is polled");
+}
+
+void hrtimer_init(struct hrtimer *t, hrtimer_fn fn, void *arg, const char *name) {
+    t->expires = 0;
+    t->period = 0;
+    t->fn = fn;
+    t->arg = arg;
+    t->name = name;
+    t->slot = -1;
+    t->fired = 0;
+}
+
+int hrtimer_start_us(struct hrtimer *t, uint64_t delay_us, uint64_t period_us) {
+    uint64_t now = timer_get_ticks();
+    unsigned long flags = irq_save();
+    if (t->slot >= 0) heap_remove(t);
+    if (nheap == HRTIMER_MAX) {
+        irq_restore(flags);
+        return -1;
+    }
+    t->expires = now + timer_us_to_ticks(delay_us);
+    t->period = timer_us_to_ticks(period_us);
+    heap_set(nheap++, t);
+    sift_up(t->slot);
+    if (!running) reprogram();
+    irq_restore(flags);
+    return 0;
+}
+
+void hrtimer_cancel(struct hrtimer *t) {
+    unsigned long flags = irq_save();
+    if (t->slot >= 0) {
+        heap_remove(t);
+        if (!running) reprogram();
+    }
+    irq_restore(flags);
+}
+
+void hrtimer_run(void) {
+    if (running) return;
+    /* the check is cheap; it also covers a comparator without an IRQ */
+    if (!pending && (nheap == 0 || before(timer_get_ticks(), heap[0]->expires))) return;
+
+    running = 1;
+    pending = 0;
+    uint64_t now = timer_get_ticks();
+    unsigned long flags = irq_save();
+    while (nheap && !before(now, heap[0]->expires)) {
+        struct hrtimer *t = heap[0];
+        heap_remove(t);
+        if (t->period) {
+            t->expires += t->period;
+            if (!before(now, t->expires)) {
+                uint64_t skip = (now - t->expires) / t->period + 1;
+                t->expires += skip * t->period;
+                stats.missed += (uint32_t)skip;
+            }
+            heap_set(nheap++, t);
+            sift_up(t->slot);
+        }
+        t->fired++;
+        stats.fired++;
+        /* requeued first, so the callback may cancel or restart it */
+        irq_restore(flags);
+        t->fn(t);
+        flags = irq_save();
+    }
+    reprogram();
+    irq_restore(flags);
+    running = 0;
+}
+
+void hrtimer_get_stats(struct hrtimer_stats *s) {
+    *s = stats;
+    s->queued = nheap;
+}
+
+int hrtimer_info(int i, const char **name, uint64_t *due_us, uint64_t *period_us, uint32_t *fired) {
+    unsigned long flags = irq_save();
+    if (i < 0 || i >= nheap) {
+        irq_restore(flags);
+        return 0;
+    }
+    struct hrtimer *t = heap[i];
+    uint64_t now = timer_get_ticks();
+    *name = t->name ? t->name : "?";
+    *due_us = before(now, t->expires) ? timer_ticks_to_us(t->expires - now) : 0;
+    *period_us = timer_ticks_to_us(t->period);
+    *fired = t->fired;
+    irq_restore(flags);
+    return 1;
+}
@@ -0,0 +1,77 @@
+#ifndef HRTIMER_H
+#define HRTIMER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* High-resolution kernel timers.
+ *
+ * A timer is a callback plus an expiry in generic-timer ticks (CNTPCT).
+ * Queued timers sit in a min-heap; the earliest one is programmed into
+ * the EL1 physical timer comparator (CNTP_CVAL_EL0), so the comparator
+ * interrupt comes exactly when something is due and not before. Nothing
+ * ticks in between: a blink every 500ms costs one interrupt and one
+ * callback every 500ms.
+ *
+ * The interrupt only marks expiry; callbacks run from hrtimer_run(),
+ * which schedule() calls on every pass, outside any task. A callback
+ * must not block, yield or take long. What it can do: set flags, bump
+ * generation words, task_wake_event, waitable_notify, wm_request_render,
+ * start or cancel timers (itself included). Anything heavier belongs in
+ * a task the callback wakes.
+ *
+ * period 0 makes a one-shot timer. A periodic timer is requeued one
+ * period after its last expiry, not after the callback ran; periods
+ * missed while the CPU was busy are skipped, not run back to back. */
+
+struct hrtimer;
+typedef void (*hrtimer_fn)(struct hrtimer *t);
+
+struct hrtimer {
+    uint64_t expires;           /* CNTPCT value */
+    uint64_t period;            /* ticks, 0 = one-shot */
+    hrtimer_fn fn;
+    void *arg;
+    const char *name;
+    int slot;                   /* heap index, -1 while not queued */
+    uint32_t fired;
+};
+
+/* After irq_init and timer_init: wires up the comparator interrupt */
+void hrtimers_init(void);
+
+/* Set up t (usually embedded in its owner); it is not queued yet */
+void hrtimer_init(struct hrtimer *t, hrtimer_fn fn, void *arg, const char *name);
+/* (Re)queue t to fire delay_us from now, then every period_us if nonzero.
+ * Returns -1 if too many timers are queued. IRQ-safe. */
+int hrtimer_start_us(struct hrtimer *t, uint64_t delay_us, uint64_t period_us);
+/* Dequeue t. Once this returns its callback will not run again, so the
+ * owner may free it (callbacks never run concurrently with a task). */
+void hrtimer_cancel(struct hrtimer *t);
+
+static inline int hrtimer_start_ms(struct hrtimer *t, uint32_t delay_ms, uint32_t period_ms) {
+    return hrtimer_start_us(t, (uint64_t)delay_ms * 1000, (uint64_t)period_ms * 1000);
+}
+
+static inline int hrtimer_active(const struct hrtimer *t) {
+    return t->slot >= 0;
+}
+
+/* Run the callbacks that are due and reprogram the comparator (schedule()) */
+void hrtimer_run(void);
+
+struct hrtimer_stats {
+    int queued;
+    uint32_t fired;             /* callbacks run */
+    uint32_t irqs;              /* comparator interrupts taken */
+    uint32_t programs;          /* comparator writes */
+    uint32_t missed;            /* periods skipped */
+    int irq_wired;
+};
+
+void hrtimer_get_stats(struct hrtimer_stats *s);
+/* Name, time left, period and callback count of queued timer i (heap
+ * order); 0 past the end */
+int hrtimer_info(int i, const char **name, uint64_t *due_us, uint64_t *period_us, uint32_t *fired);
+
+#endif
@@ -1,6 +1,7 @@
-/* Simple PNG display wrapper using a small embedded PNG decoder (LodePNG).
- * Decodes into 32-bit RGBA and blits (alpha blended) to framebuffer using
- * existing fb_set_pixel API.
+/* Image loading. PNG goes through the embedded LodePNG decoder; QOI
+ * (produced from assets by make_disk.py) is decoded directly. Both end up
+ * as 32-bit ARGB; img_display_png blits (alpha blended) to the framebuffer
+ * using the existing fb_set_pixel API.
  */
 
 #include "image.h"
@@ -9,6 +10,8 @@
 #include "kmalloc.h"
 #include "lodepng.h"
 #include "lodepng_glue.h"
+#include "qoi.h"
+#include "pixel.h"
 #include <stdint.h>
 #include <string.h>
 #include "rpi_fx.h"
@@ -31,15 +34,13 @@ static inline uint32_t blend_pixel(uint32_t dst, uint8_t sr, uint8_t sg, uint8_t
     return rgba_to_u32(r, g, b);
 }
 
-int img_display_png(const char *path, int x_off, int y_off) {
-    if (!fb_is_init()) return -1;
-
-    /* stat file size */
+/* Read a whole file into a kmalloc'd buffer. Returns img_load error codes. */
+static int img_read_file(const char *path, uint8_t **out, size_t *out_len) {
     struct file_stat st;
     if (files_stat(path, &st) < 0) return -2;
     if (st.size == 0) return -3;
 
-    void *buf = kmalloc(st.size);
+    uint8_t *buf = kmalloc(st.size);
     if (!buf) return -4;
 
     int fd = files_open(path, O_RDONLY);
@@ -48,62 +49,39 @@ int img_display_png(const char *path, int x_off, int y_off) {
     files_close(fd);
     if (r <= 0) { kfree(buf); return -6; }
 
-    unsigned char *image = NULL;
-    unsigned w, h;
-    unsigned err = lodepng_decode32(&image, &w, &h, (const unsigned char *)buf, (size_t)r);
-    kfree(buf);
-    if (err) {
-        if (image) lodepng_free(image);
-        return -7; /* decode error */
-    }
+    *out = buf;
+    *out_len = (size_t)r;
+    return 0;
+}
 
-    /* Blit to framebuffer with simple alpha compositing */
-    for (unsigned yy = 0; yy < h; ++yy) {
-        for (unsigned xx = 0; xx < w; ++xx) {
-            unsigned idx = (yy * w + xx) * 4;
-            uint8_t sr = image[idx + 0];
-            uint8_t sg = image[idx + 1];
-            uint8_t sb = image[idx + 2];
-            uint8_t sa = image[idx + 3];
-            int dst_x = x_off + (int)xx;
-            int dst_y = y_off + (int)yy;
-            if ((unsigned)dst_x >= (unsigned)0 && (unsigned)dst_x < (unsigned)0x7fffffff &&
-                (unsigned)dst_y >= (unsigned)0 && (unsigned)dst_y < (unsigned)0x7fffffff) {
-                /* clip against framebuffer inside fb_set_pixel (safe) */
-                uint32_t dst = fb_get_pixel(dst_x, dst_y);
-                uint32_t out = blend_pixel(dst, sr, sg, sb, sa);
-                fb_set_pixel(dst_x, dst_y, out);
-            }
-        }
+static int img_decode_qoi(const uint8_t *buf, size_t len, int qw, int qh, uint32_t **out_buffer) {
+    uint32_t *pixels = kmalloc((size_t)qw * qh * 4);
+    if (!pixels) return -8;
+    if (qoi_decode(buf, len, pixels, qw, qh) < 0) {
+        kfree(pixels);
+        return -7;
     }
-
-    lodepng_free(image);
-    virtio_gpu_flush();
+    *out_buffer = pixels;
     return 0;
 }
 
-int img_load_png(const char *path, int *w, int *h, uint32_t **out_buffer) {
-    if (!out_buffer || !w || !h) return -1;
-    *out_buffer = NULL; *w = 0; *h = 0;
-
-    struct file_stat st;
-    if (files_stat(path, &st) < 0) return -2;
-    if (st.size == 0) return -3;
-
-    void *buf = kmalloc(st.size);
-    if (!buf) return -4;
-
-    int fd = files_open(path, O_RDONLY);
-    if (fd < 0) { kfree(buf); return -5; }
-    int r = files_read(fd, buf, st.size);
-    files_close(fd);
-    if (r <= 0) { kfree(buf); return -6; }
-
+static int img_decode_png(const uint8_t *buf, size_t len, int *w, int *h, uint32_t **out_buffer) {
     unsigned char *image = NULL;
     unsigned width, height;
-    unsigned err = lodepng_decode32(&image, &width, &height, (const unsigned char *)buf, (size_t)r);
-    kfree(buf);
-    
+    LodePNGState state;
+    lodepng_state_init(&state);
+
+    /* Size the inflate output from the header so it is allocated once */
+    size_t raw_hint = 0;
+    if (lodepng_inspect(&width, &height, &state, buf, len) == 0) {
+        size_t bpp = lodepng_get_bpp(&state.info_png.color);
+        raw_hint = (size_t)height * (1 + ((size_t)width * bpp + 7) / 8);
+        if (state.info_png.interlace_method) raw_hint += raw_hint / 8;
+    }
+    lodepng_use_fast_zlib(&state.decoder.zlibsettings, &raw_hint);
+
+    unsigned err = lodepng_decode(&image, &width, &height, &state, buf, len);
+    lodepng_state_cleanup(&state);
     if (err) {
         if (image) lodepng_free(image);
         return -7;
@@ -116,17 +94,64 @@ int img_load_png(const char *path, int *w, int *h, uint32_t **out_buffer) {
         return -8;
     }
 
-    for (unsigned i = 0; i < width * height; i++) {
-        uint8_t r = image[i*4 + 0];
-        uint8_t g = image[i*4 + 1];
-        uint8_t b = image[i*4 + 2];
-        uint8_t a = image[i*4 + 3];
-        final_buf[i] = ((uint32_t)a << 24) | ((uint32_t)r << 16) | ((uint32_t)g << 8) | (uint32_t)b;
-    }
-    
+    pix_rgba_to_argb(final_buf, image, (int)(width * height));
+
     lodepng_free(image);
     *w = (int)width;
     *h = (int)height;
     *out_buffer = final_buf;
     return 0;
 }
+
+int img_load(const char *path, int *w, int *h, uint32_t **out_buffer) {
+    if (!out_buffer || !w || !h) return -1;
+    *out_buffer = NULL; *w = 0; *h = 0;
+
+    uint8_t *buf;
+    size_t len;
+    int ret = img_read_file(path, &buf, &len);
+    if (ret < 0) return ret;
+
+    /* Format is detected from content, not the file name */
+    int qw, qh;
+    if (qoi_probe(buf, len, &qw, &qh)) {
+        ret = img_decode_qoi(buf, len, qw, qh, out_buffer);
+        if (ret == 0) { *w = qw; *h = qh; }
+    } else {
+        ret = img_decode_png(buf, len, w, h, out_buffer);
+    }
+    kfree(buf);
+    return ret;
+}
+
+int img_load_png(const char *path, int *w, int *h, uint32_t **out_buffer) {
+    return img_load(path, w, h, out_buffer);
+}
+
+int img_display_png(const char *path, int x_off, int y_off) {
+    if (!fb_is_init()) return -1;
+
+    uint32_t *image;
+    int w, h;
+    int ret = img_load(path, &w, &h, &image);
+    if (ret < 0) return ret;
+
+    /* Blit to framebuffer with simple alpha compositing */
+    for (int yy = 0; yy < h; ++yy) {
+        for (int xx = 0; xx < w; ++xx) {
+            uint32_t c = image[yy * w + xx];
+            int dst_x = x_off + xx;
+            int dst_y = y_off + yy;
+            if (dst_x >= 0 && dst_y >= 0) {
+                /* clip against framebuffer inside fb_set_pixel (safe) */
+                uint32_t dst = fb_get_pixel(dst_x, dst_y);
+                uint32_t out = blend_pixel(dst, (c >> 16) & 0xFF, (c >> 8) & 0xFF, c & 0xFF, c >> 24);
+                fb_set_pixel(dst_x, dst_y, out);
+            }
+        }
+    }
+
+    kfree(image);
+    virtio_gpu_flush();
+    return 0;
+}
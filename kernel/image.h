@@ -8,6 +8,10 @@
  * Returns 0 on success, negative on error.
  */
 int img_display_png(const char *path, int x, int y);
+/* Load PNG or QOI (detected from the file contents) into a kmalloc'd ARGB
+ * buffer. Errors: -2 not found, -3 empty, -4/-8 out of memory,
+ * -5/-6 read failure, -7 decode error. */
+int img_load(const char *path, int *w, int *h, uint32_t **out_buf);
 int img_load_png(const char *path, int *w, int *h, uint32_t **out_buf);
 
 #endif
@@ -0,0 +1,530 @@
+/* Background, progressive PNG decoder.
+ *
+ * The worker task parses the chunk stream itself and inflates IDAT with
+ * inflate.c. The inflate progress hook walks every scanline that has been
+ * fully produced, unfilters it into a private row buffer (the raw buffer
+ * must stay untouched, later back-references read from it) and converts it
+ * to ARGB in job->pixels. The hook also time-slices the decode: after
+ * IMG_DECODE_SLICE_MS of work it notifies the owner and yields.
+ */
+
+#include "image_decode.h"
+#include "image.h"
+#include "inflate.h"
+#include "qoi.h"
+#include "files.h"
+#include "kmalloc.h"
+#include "sched.h"
+#include "timer.h"
+#include "lib.h"
+#include "uart.h"
+#include <stdint.h>
+#include <stddef.h>
+
+#define IMG_READ_CHUNK      (64 * 1024)
+#define IMG_INFLATE_STEP    (8 * 1024)
+#define IMG_DECODE_SLICE_MS 2
+#define IMG_MAX_DIM         16384
+
+#define PNG_GRAY        0
+#define PNG_RGB         2
+#define PNG_PALETTE     3
+#define PNG_GRAY_ALPHA  4
+#define PNG_RGBA        6
+
+/* Adam7 pass origin/spacing, and the block each pass paints while coarse */
+static const uint8_t adam7_ix[7] = {0, 4, 0, 2, 0, 1, 0};
+static const uint8_t adam7_iy[7] = {0, 0, 4, 0, 2, 0, 1};
+static const uint8_t adam7_dx[7] = {8, 8, 4, 4, 2, 2, 1};
+static const uint8_t adam7_dy[7] = {8, 8, 8, 4, 4, 2, 2};
+static const uint8_t adam7_bw[7] = {8, 4, 4, 2, 2, 1, 1};
+static const uint8_t adam7_bh[7] = {8, 8, 4, 4, 2, 2, 1};
+
+struct png_stream {
+    struct img_decode *job;
+    int w, h;
+    int depth;
+    int color_type;
+    int channels;
+    int interlace;
+    uint32_t palette[256];
+    int has_key;
+    uint16_t key_r, key_g, key_b;
+    size_t bpp;              /* filter distance in bytes (>= 1) */
+
+    const uint8_t *raw;
+    size_t raw_size;
+    size_t raw_pos;          /* next unprocessed filter byte */
+    int pass;                /* 0..6, always 0 when not interlaced */
+    int pass_w, pass_h, pass_row;
+    size_t row_bytes;
+    uint8_t *prev, *cur;
+    uint32_t *argb_row;
+
+    uint32_t last_yield;
+    int err;
+};
+
+static uint32_t png_be32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static size_t png_row_bytes(const struct png_stream *ps, int pixels) {
+    return ((size_t)pixels * ps->channels * ps->depth + 7) / 8;
+}
+
+static void png_pass_dims(const struct png_stream *ps, int pass, int *pw, int *ph) {
+    if (!ps->interlace) { *pw = ps->w; *ph = ps->h; return; }
+    *pw = (ps->w > adam7_ix[pass]) ? (ps->w - adam7_ix[pass] + adam7_dx[pass] - 1) / adam7_dx[pass] : 0;
+    *ph = (ps->h > adam7_iy[pass]) ? (ps->h - adam7_iy[pass] + adam7_dy[pass] - 1) / adam7_dy[pass] : 0;
+}
+
+static size_t png_raw_size(const struct png_stream *ps) {
+    size_t total = 0;
+    int passes = ps->interlace ? 7 : 1;
+    for (int p = 0; p < passes; p++) {
+        int pw, ph;
+        png_pass_dims(ps, p, &pw, &ph);
+        if (pw && ph) total += (size_t)ph * (1 + png_row_bytes(ps, pw));
+    }
+    return total;
+}
+
+/* ---- chunk parsing ---- */
+
+static int png_check_format(int ct, int depth) {
+    switch (ct) {
+        case PNG_GRAY: return depth == 1 || depth == 2 || depth == 4 || depth == 8 || depth == 16;
+        case PNG_PALETTE: return depth == 1 || depth == 2 || depth == 4 || depth == 8;
+        case PNG_RGB: case PNG_GRAY_ALPHA: case PNG_RGBA: return depth == 8 || depth == 16;
+        default: return 0;
+    }
+}
+
+/* Parse header chunks and gather IDAT into one kmalloc'd buffer. */
+static int png_parse(struct png_stream *ps, const uint8_t *buf, size_t len,
+                     uint8_t **idat_out, size_t *idat_len) {
+    static const uint8_t sig[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    if (len < 8 + 25 || memcmp(buf, sig, 8) != 0) return -7;
+
+    size_t total_idat = 0;
+    int have_ihdr = 0;
+    for (int i = 0; i < 256; i++) ps->palette[i] = 0xFF000000;
+
+    size_t pos = 8;
+    while (pos + 12 <= len) {
+        uint32_t clen = png_be32(buf + pos);
+        const uint8_t *type = buf + pos + 4;
+        const uint8_t *data = buf + pos + 8;
+        if (clen > len - pos - 12) return -7;
+
+        if (memcmp(type, "IHDR", 4) == 0) {
+            if (clen < 13) return -7;
+            uint32_t w = png_be32(data), h = png_be32(data + 4);
+            if (w == 0 || h == 0 || w > IMG_MAX_DIM || h > IMG_MAX_DIM) return -7;
+            ps->w = (int)w;
+            ps->h = (int)h;
+            ps->depth = data[8];
+            ps->color_type = data[9];
+            if (!png_check_format(ps->color_type, ps->depth)) return -7;
+            if (data[10] != 0 || data[11] != 0 || data[12] > 1) return -7;
+            ps->interlace = data[12];
+            ps->channels = (ps->color_type == PNG_RGB) ? 3 :
+                           (ps->color_type == PNG_GRAY_ALPHA) ? 2 :
+                           (ps->color_type == PNG_RGBA) ? 4 : 1;
+            ps->bpp = ((size_t)ps->channels * ps->depth + 7) / 8;
+            have_ihdr = 1;
+        } else if (memcmp(type, "PLTE", 4) == 0) {
+            uint32_t n = clen / 3;
+            if (n > 256) n = 256;
+            for (uint32_t i = 0; i < n; i++) {
+                ps->palette[i] = 0xFF000000 | ((uint32_t)data[i * 3] << 16) |
+                                 ((uint32_t)data[i * 3 + 1] << 8) | data[i * 3 + 2];
+            }
+        } else if (memcmp(type, "tRNS", 4) == 0) {
+            if (ps->color_type == PNG_PALETTE) {
+                for (uint32_t i = 0; i < clen && i < 256; i++) {
+                    ps->palette[i] = (ps->palette[i] & 0x00FFFFFF) | ((uint32_t)data[i] << 24);
+                }
+            } else if (ps->color_type == PNG_GRAY && clen >= 2) {
+                ps->has_key = 1;
+                ps->key_r = (uint16_t)((data[0] << 8) | data[1]);
+            } else if (ps->color_type == PNG_RGB && clen >= 6) {
+                ps->has_key = 1;
+                ps->key_r = (uint16_t)((data[0] << 8) | data[1]);
+                ps->key_g = (uint16_t)((data[2] << 8) | data[3]);
+                ps->key_b = (uint16_t)((data[4] << 8) | data[5]);
+            }
+        } else if (memcmp(type, "IDAT", 4) == 0) {
+            total_idat += clen;
+        } else if (memcmp(type, "IEND", 4) == 0) {
+            break;
+        }
+        pos += 12 + clen;
+    }
+    if (!have_ihdr || total_idat == 0) return -7;
+
+    uint8_t *idat = kmalloc(total_idat);
+    if (!idat) return -4;
+    size_t off = 0;
+    pos = 8;
+    while (pos + 12 <= len && off < total_idat) {
+        uint32_t clen = png_be32(buf + pos);
+        if (memcmp(buf + pos + 4, "IDAT", 4) == 0) {
+            memcpy(idat + off, buf + pos + 8, clen);
+            off += clen;
+        }
+        pos += 12 + clen;
+    }
+    *idat_out = idat;
+    *idat_len = total_idat;
+    return 0;
+}
+
+/* ---- scanline processing ---- */
+
+static int png_unfilter_row(uint8_t *cur, const uint8_t *prev, const uint8_t *src,
+                            size_t len, size_t bpp, int type) {
+    size_t i;
+    switch (type) {
+        case 0:
+            memcpy(cur, src, len);
+            break;
+        case 1:
+            for (i = 0; i < bpp && i < len; i++) cur[i] = src[i];
+            for (; i < len; i++) cur[i] = (uint8_t)(src[i] + cur[i - bpp]);
+            break;
+        case 2:
+            for (i = 0; i < len; i++) cur[i] = (uint8_t)(src[i] + prev[i]);
+            break;
+        case 3:
+            for (i = 0; i < bpp && i < len; i++) cur[i] = (uint8_t)(src[i] + (prev[i] >> 1));
+            for (; i < len; i++) cur[i] = (uint8_t)(src[i] + ((cur[i - bpp] + prev[i]) >> 1));
+            break;
+        case 4:
+            for (i = 0; i < bpp && i < len; i++) cur[i] = (uint8_t)(src[i] + prev[i]);
+            for (; i < len; i++) {
+                int a = cur[i - bpp], b = prev[i], c = prev[i - bpp];
+                int p = a + b - c;
+                int pa = p > a ? p - a : a - p;
+                int pb = p > b ? p - b : b - p;
+                int pc = p > c ? p - c : c - p;
+                int pred = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+                cur[i] = (uint8_t)(src[i] + pred);
+            }
+            break;
+        default:
+            return -1;
+    }
+    return 0;
+}
+
+static inline unsigned png_sample(const uint8_t *row, size_t idx, int depth) {
+    if (depth == 8) return row[idx];
+    if (depth == 16) return ((unsigned)row[idx * 2] << 8) | row[idx * 2 + 1];
+    size_t bit = idx * (size_t)depth;
+    unsigned shift = 8 - (unsigned)depth - (unsigned)(bit & 7);
+    return (row[bit >> 3] >> shift) & ((1u << depth) - 1);
+}
+
+static inline uint32_t png_to8(unsigned v, int depth) {
+    if (depth == 8) return v;
+    if (depth == 16) return v >> 8;
+    return v * 255 / ((1u << depth) - 1);
+}
+
+static void png_convert_row(const struct png_stream *ps, const uint8_t *src, int width, uint32_t *dst) {
+    int d = ps->depth;
+    for (int x = 0; x < width; x++) {
+        uint32_t r, g, b, a = 255;
+        size_t s = (size_t)x * ps->channels;
+        switch (ps->color_type) {
+            case PNG_GRAY: {
+                unsigned v = png_sample(src, s, d);
+                if (ps->has_key && v == ps->key_r) a = 0;
+                r = g = b = png_to8(v, d);
+                break;
+            }
+            case PNG_RGB: {
+                unsigned vr = png_sample(src, s, d), vg = png_sample(src, s + 1, d), vb = png_sample(src, s + 2, d);
+                if (ps->has_key && vr == ps->key_r && vg == ps->key_g && vb == ps->key_b) a = 0;
+                r = png_to8(vr, d); g = png_to8(vg, d); b = png_to8(vb, d);
+                break;
+            }
+            case PNG_PALETTE:
+                dst[x] = ps->palette[png_sample(src, s, d)];
+                continue;
+            case PNG_GRAY_ALPHA:
+                r = g = b = png_to8(png_sample(src, s, d), d);
+                a = png_to8(png_sample(src, s + 1, d), d);
+                break;
+            default: /* PNG_RGBA */
+                r = png_to8(png_sample(src, s, d), d);
+                g = png_to8(png_sample(src, s + 1, d), d);
+                b = png_to8(png_sample(src, s + 2, d), d);
+                a = png_to8(png_sample(src, s + 3, d), d);
+                break;
+        }
+        dst[x] = (a << 24) | (r << 16) | (g << 8) | b;
+    }
+}
+
+static void png_store_row(struct png_stream *ps) {
+    uint32_t *pixels = ps->job->pixels;
+    if (!ps->interlace) {
+        memcpy(pixels + (size_t)ps->pass_row * ps->w, ps->argb_row, (size_t)ps->w * 4);
+        return;
+    }
+    int p = ps->pass;
+    int y0 = adam7_iy[p] + ps->pass_row * adam7_dy[p];
+    int y1 = y0 + adam7_bh[p];
+    if (y1 > ps->h) y1 = ps->h;
+    for (int i = 0; i < ps->pass_w; i++) {
+        int x0 = adam7_ix[p] + i * adam7_dx[p];
+        int x1 = x0 + adam7_bw[p];
+        if (x1 > ps->w) x1 = ps->w;
+        uint32_t c = ps->argb_row[i];
+        for (int y = y0; y < y1; y++) {
+            uint32_t *dst = pixels + (size_t)y * ps->w;
+            for (int x = x0; x < x1; x++) dst[x] = c;
+        }
+    }
+}
+
+static void png_begin_pass(struct png_stream *ps, int pass) {
+    ps->pass = pass;
+    ps->pass_row = 0;
+    png_pass_dims(ps, pass, &ps->pass_w, &ps->pass_h);
+    ps->row_bytes = png_row_bytes(ps, ps->pass_w);
+    memset(ps->prev, 0, png_row_bytes(ps, ps->w));
+}
+
+/* Process every complete scanline in raw[raw_pos .. avail). */
+static int png_consume(struct png_stream *ps, size_t avail) {
+    int passes = ps->interlace ? 7 : 1;
+    while (ps->pass < passes) {
+        if (ps->pass_w == 0 || ps->pass_h == 0 || ps->pass_row >= ps->pass_h) {
+            if (ps->pass + 1 >= passes) { ps->pass = passes; break; }
+            png_begin_pass(ps, ps->pass + 1);
+            continue;
+        }
+        size_t need = 1 + ps->row_bytes;
+        if (ps->raw_pos + need > avail) break;
+
+        const uint8_t *src = ps->raw + ps->raw_pos;
+        if (png_unfilter_row(ps->cur, ps->prev, src + 1, ps->row_bytes, ps->bpp, src[0]) < 0) return -1;
+        png_convert_row(ps, ps->cur, ps->pass_w, ps->argb_row);
+        png_store_row(ps);
+
+        uint8_t *t = ps->prev; ps->prev = ps->cur; ps->cur = t;
+        ps->raw_pos += need;
+        ps->pass_row++;
+        ps->job->pass = ps->interlace ? ps->pass + 1 : 0;
+        ps->job->rows_done = ps->pass_row;
+    }
+    return 0;
+}
+
+/* ---- worker ---- */
+
+static void img_decode_notify(struct img_decode *job) {
+    if (job->on_update) job->on_update(job, job->update_arg);
+}
+
+static void img_decode_put(struct img_decode *job) {
+    if (--job->refs > 0) return;
+    if (job->pixels) kfree(job->pixels);
+    kfree(job);
+}
+
+/* Give the rest of the system a turn once our time slice is used up. */
+static void img_decode_slice(struct png_stream *ps) {
+    uint32_t now = timer_get_ms();
+    if (now - ps->last_yield < IMG_DECODE_SLICE_MS) return;
+    img_decode_notify(ps->job);
+    yield();
+    ps->last_yield = timer_get_ms();
+}
+
+static int png_progress(void *ctx, size_t out_len) {
+    struct png_stream *ps = (struct png_stream *)ctx;
+    if (png_consume(ps, out_len) < 0) {
+        ps->err = -7;
+        return 1;
+    }
+    ps->job->progress = 10 + (int)((out_len * 90) / ps->raw_size);
+    img_decode_slice(ps);
+    return ps->job->cancel;
+}
+
+static int img_decode_read(struct png_stream *ps, uint8_t **buf_out, size_t *len_out) {
+    struct img_decode *job = ps->job;
+    struct file_stat st;
+    if (files_stat(job->path, &st) < 0) return -2;
+    if (st.size == 0) return -3;
+
+    uint8_t *buf = kmalloc(st.size);
+    if (!buf) return -4;
+    int fd = files_open(job->path, O_RDONLY);
+    if (fd < 0) { kfree(buf); return -5; }
+
+    size_t got = 0;
+    while (got < st.size && !job->cancel) {
+        size_t want = st.size - got;
+        if (want > IMG_READ_CHUNK) want = IMG_READ_CHUNK;
+        int r = files_read(fd, buf + got, want);
+        if (r <= 0) break;
+        got += (size_t)r;
+        job->progress = (int)((got * 10) / st.size);
+        img_decode_slice(ps);
+    }
+    files_close(fd);
+    if (got == 0) { kfree(buf); return -6; }
+
+    *buf_out = buf;
+    *len_out = got;
+    return 0;
+}
+
+static int img_decode_run(struct png_stream *ps) {
+    struct img_decode *job = ps->job;
+    uint8_t *file = NULL, *idat = NULL, *raw = NULL;
+    size_t file_len = 0, idat_len = 0;
+
+    int err = img_decode_read(ps, &file, &file_len);
+    if (err || job->cancel) goto out;
+
+    /* Build-time converted assets: no inflate, decode in one pass */
+    int qw, qh;
+    if (qoi_probe(file, file_len, &qw, &qh)) {
+        uint32_t *qpix = kmalloc((size_t)qw * qh * 4);
+        if (!qpix) { err = -8; goto out; }
+        job->pixels = qpix;
+        job->h = qh;
+        job->w = qw;
+        img_decode_notify(job);
+        if (qoi_decode(file, file_len, qpix, qw, qh) < 0) err = -7;
+        goto out;
+    }
+
+    err = png_parse(ps, file, file_len, &idat, &idat_len);
+    kfree(file);
+    file = NULL;
+    if (err) goto out;
+
+    size_t npix = (size_t)ps->w * ps->h;
+    uint32_t *pixels = kmalloc(npix * 4);
+    if (!pixels) { err = -8; goto out; }
+    memset(pixels, 0, npix * 4);
+
+    ps->raw_size = png_raw_size(ps);
+    raw = kmalloc(ps->raw_size);
+    size_t row_max = png_row_bytes(ps, ps->w);
+    ps->prev = kmalloc(row_max);
+    ps->cur = kmalloc(row_max);
+    ps->argb_row = kmalloc((size_t)ps->w * 4);
+    if (!raw || !ps->prev || !ps->cur || !ps->argb_row) {
+        kfree(pixels);
+        err = -4;
+        goto out;
+    }
+
+    /* Publish the header so the owner can size its window */
+    job->pixels = pixels;
+    job->interlaced = ps->interlace;
+    job->h = ps->h;
+    job->w = ps->w;
+    img_decode_notify(job);
+
+    ps->raw = raw;
+    png_begin_pass(ps, 0);
+
+    struct inflate_opts opts = { png_progress, ps, IMG_INFLATE_STEP };
+    size_t produced = 0;
+    int r = inflate_zlib(raw, ps->raw_size, &produced, idat, idat_len, &opts);
+    if (r == INFLATE_ERR_ABORTED) {
+        err = ps->err;
+    } else if (r == INFLATE_ERR_OUTPUT) {
+        /* trailing garbage after the image data; keep what we have */
+        err = png_consume(ps, ps->raw_size) < 0 ? -7 : 0;
+    } else if (r != INFLATE_OK) {
+        err = -7;
+    }
+    if (!err && !job->cancel && ps->raw_pos != ps->raw_size) err = -7;
+
+out:
+    if (file) kfree(file);
+    if (idat) kfree(idat);
+    if (raw) kfree(raw);
+    if (ps->prev) kfree(ps->prev);
+    if (ps->cur) kfree(ps->cur);
+    if (ps->argb_row) kfree(ps->argb_row);
+    return err;
+}
+
+static void img_decode_task(void *arg) {
+    struct img_decode *job = (struct img_decode *)arg;
+    struct png_stream *ps = kmalloc(sizeof(*ps));
+    int err = -4;
+    if (ps) {
+        memset(ps, 0, sizeof(*ps));
+        ps->job = job;
+        ps->last_yield = timer_get_ms();
+        err = img_decode_run(ps);
+        kfree(ps);
+    }
+
+    if (job->cancel) {
+        job->status = IMG_DECODE_CANCELLED;
+    } else if (err) {
+        job->error = err;
+        job->status = IMG_DECODE_FAILED;
+        uart_puts("[img] decode failed: "); uart_puts(job->path); uart_puts("\n");
+    } else {
+        job->progress = 100;
+        job->status = IMG_DECODE_DONE;
+    }
+    job->done_gen++;
+    task_wake_event((void *)&job->done_gen);
+    img_decode_notify(job);
+    img_decode_put(job);
+}
+
+void img_decode_wait(struct img_decode *job) {
+    while (job->status == IMG_DECODE_RUNNING)
+        task_wait_event_unless((void *)&job->done_gen, &job->done_gen, 0);
+}
+
+struct img_decode *img_decode_start(const char *path, img_decode_update_fn on_update, void *arg) {
+    struct img_decode *job = kmalloc(sizeof(*job));
+    if (!job) return NULL;
+    memset(job, 0, sizeof(*job));
+    strncpy(job->path, path, sizeof(job->path) - 1);
+    job->status = IMG_DECODE_RUNNING;
+    job->on_update = on_update;
+    job->update_arg = arg;
+    job->refs = 2;
+
+    int tid = task_create(img_decode_task, job, "img_decode");
+    if (tid < 0) {
+        kfree(job);
+        return NULL;
+    }
+    /* Owned by init so it can always run to completion and free the job */
+    task_set_parent(tid, 1);
+    return job;
+}
+
+void img_decode_release(struct img_decode *job) {
+    if (!job) return;
+    job->on_update = NULL;
+    job->cancel = 1;
+    img_decode_put(job);
+}
+
+uint32_t *img_decode_take_pixels(struct img_decode *job) {
+    if (!job || job->status != IMG_DECODE_DONE) return NULL;
+    uint32_t *p = job->pixels;
+    job->pixels = NULL;
+    return p;
+}
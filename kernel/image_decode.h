@@ -0,0 +1,53 @@
+#ifndef IMAGE_DECODE_H
+#define IMAGE_DECODE_H
+
+#include <stdint.h>
+
+/* Background PNG decoding.
+ * A worker task reads and inflates the file in time slices, converting
+ * scanlines into `pixels` as soon as they are complete. Interlaced (Adam7)
+ * images are painted pass by pass, coarse blocks first. QOI files (the
+ * build-time asset format) are decoded in one go.
+ *
+ * Ownership: the caller holds one reference, the worker holds another.
+ * img_decode_release() drops the caller's reference and cancels the
+ * decode if it is still running; the worker frees the job when it exits.
+ */
+
+enum img_decode_status {
+    IMG_DECODE_RUNNING = 0,
+    IMG_DECODE_DONE,
+    IMG_DECODE_FAILED,
+    IMG_DECODE_CANCELLED
+};
+
+struct img_decode;
+typedef void (*img_decode_update_fn)(struct img_decode *job, void *arg);
+
+struct img_decode {
+    char path[128];
+    volatile int status;     /* enum img_decode_status */
+    volatile uint32_t done_gen;  /* bumped when status leaves RUNNING */
+    volatile int cancel;
+    int error;               /* img_load_png error codes when FAILED */
+
+    int w, h;                /* set once the header is parsed (w > 0) */
+    uint32_t *pixels;        /* ARGB, w*h, alpha 0 where not yet decoded */
+    int interlaced;
+    int pass;                /* Adam7 pass being decoded (1..7), 0 if not interlaced */
+    int rows_done;           /* rows finished in the current pass */
+    int progress;            /* 0..100 */
+
+    img_decode_update_fn on_update;  /* called from the worker task */
+    void *update_arg;
+    int refs;
+};
+
+struct img_decode *img_decode_start(const char *path, img_decode_update_fn on_update, void *arg);
+void img_decode_release(struct img_decode *job);
+/* Sleep until the decode is no longer RUNNING (caller holds its reference) */
+void img_decode_wait(struct img_decode *job);
+/* Detach the finished pixel buffer; caller kfree()s it. */
+uint32_t *img_decode_take_pixels(struct img_decode *job);
+
+#endif
@@ -0,0 +1,673 @@
+/* Table-driven DEFLATE decoder.
+ *
+ * Huffman codes are resolved with a two-level lookup: a root table indexed
+ * by the next LITLEN_ROOT/DIST_ROOT bits of input, with links to small
+ * subtables for the rare longer codes. Bits are kept in a 64-bit buffer.
+ * While at least 8 input bytes and MAX_MATCH+8 output bytes remain, the
+ * fast loop refills the buffer once per symbol with a single unaligned
+ * load and copies matches 8 bytes at a time; the tail of the stream goes
+ * through a bounds-checked slow loop over the same tables.
+ */
+
+#include "inflate.h"
+#include "kmalloc.h"
+#include "lib.h"
+#include <stdint.h>
+#include <stddef.h>
+
+#define INFLATE_MAXBITS      15
+#define INFLATE_MAXLCODES    286
+#define INFLATE_MAXDCODES    30
+#define INFLATE_FIXLCODES    288
+#define INFLATE_DEFAULT_STEP (16 * 1024)
+#define INFLATE_MAX_MATCH    258
+#define INFLATE_FAST_OUT     (INFLATE_MAX_MATCH + 8)   /* match + copy overrun */
+
+#define LITLEN_ROOT    10
+#define DIST_ROOT      8
+#define CLEN_ROOT      7
+#define LITLEN_ENOUGH  2048
+#define DIST_ENOUGH    1024
+
+/* Table entry layout:
+ *   bits  0..7   bits to consume at this level
+ *   bits  8..11  extra bits (length/distance) or subtable index bits
+ *   bits 12..15  kind flags
+ *   bits 16..31  literal byte, length/distance base, or subtable offset
+ */
+#define E_LIT      0x1000
+#define E_EOB      0x2000
+#define E_SUB      0x4000
+#define E_BAD      0x8000
+#define E_NBITS(e) ((e) & 0xFF)
+#define E_EXTRA(e) (((e) >> 8) & 0xF)
+#define E_VAL(e)   ((e) >> 16)
+
+struct inflate_state {
+    const uint8_t *in;
+    size_t in_len;
+    size_t in_pos;
+    uint64_t bitbuf;
+    unsigned bitcnt;
+    size_t overrun;          /* zero bytes fed past the end of input */
+
+    uint8_t *out;
+    size_t out_cap;
+    size_t out_pos;
+    size_t out_max;          /* growable output: hard cap (0 = none) */
+    int growable;
+
+    const struct inflate_opts *opts;
+    size_t step;
+    size_t next_report;
+
+    uint32_t litlen[LITLEN_ENOUGH];
+    uint32_t dist[DIST_ENOUGH];
+    uint8_t lens[INFLATE_MAXLCODES + INFLATE_MAXDCODES];
+    uint8_t maxlen[1 << LITLEN_ROOT];
+};
+
+static const uint16_t len_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t len_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+    8193, 12289, 16385, 24577
+};
+static const uint8_t dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+/* order of code length code lengths in a dynamic block header */
+static const uint8_t clen_order[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+typedef struct { uint64_t v; } __attribute__((packed, may_alias)) unaligned_u64;
+
+static inline uint64_t load64(const uint8_t *p) {
+    return ((const unaligned_u64 *)p)->v;
+}
+
+static inline void store64(uint8_t *p, uint64_t v) {
+    ((unaligned_u64 *)p)->v = v;
+}
+
+/* ---- table construction ---- */
+
+typedef uint32_t (*sym_entry_fn)(int sym);
+
+static uint32_t litlen_entry(int sym) {
+    if (sym < 256) return E_LIT | ((uint32_t)sym << 16);
+    if (sym == 256) return E_EOB;
+    sym -= 257;
+    if (sym >= 29) return E_BAD;
+    return ((uint32_t)len_base[sym] << 16) | ((uint32_t)len_extra[sym] << 8);
+}
+
+static uint32_t dist_entry(int sym) {
+    if (sym >= 30) return E_BAD;
+    return ((uint32_t)dist_base[sym] << 16) | ((uint32_t)dist_extra[sym] << 8);
+}
+
+static uint32_t clen_entry(int sym) {
+    return (uint32_t)sym << 16;
+}
+
+static unsigned bitrev(unsigned code, int len) {
+    unsigned r = 0;
+    for (int i = 0; i < len; i++) {
+        r = (r << 1) | (code & 1);
+        code >>= 1;
+    }
+    return r;
+}
+
+/* Build a two-level decoding table from code lengths.
+ * Returns 0 for a complete code, >0 for an incomplete one, <0 if the code
+ * is over-subscribed or does not fit in `size` entries. Unused slots decode
+ * as E_BAD. `scratch` needs 1 << root bytes. */
+static int build_table(uint32_t *table, int size, int root, const uint8_t *lens, int n,
+                       sym_entry_fn entry, uint8_t *scratch) {
+    uint16_t count[INFLATE_MAXBITS + 1];
+    uint16_t next[INFLATE_MAXBITS + 1];
+
+    for (int len = 0; len <= INFLATE_MAXBITS; len++) count[len] = 0;
+    for (int sym = 0; sym < n; sym++) count[lens[sym]]++;
+
+    int left = 1;
+    for (int len = 1; len <= INFLATE_MAXBITS; len++) {
+        left <<= 1;
+        left -= count[len];
+        if (left < 0) return -1;
+    }
+
+    unsigned code = 0;
+    count[0] = 0;
+    for (int len = 1; len <= INFLATE_MAXBITS; len++) {
+        code = (code + count[len - 1]) << 1;
+        next[len] = (uint16_t)code;
+    }
+
+    int root_size = 1 << root;
+    for (int i = 0; i < root_size; i++) {
+        table[i] = E_BAD | 1;
+        scratch[i] = 0;
+    }
+
+    /* pass 1: short codes go straight into the root table (replicated);
+     * for long codes, remember the longest length under each root prefix */
+    for (int sym = 0; sym < n; sym++) {
+        int len = lens[sym];
+        if (!len) continue;
+        unsigned rev = bitrev(next[len], len);
+        if (len <= root) {
+            uint32_t e = entry(sym) | (uint32_t)len;
+            for (unsigned i = rev; i < (unsigned)root_size; i += 1u << len) table[i] = e;
+        } else {
+            unsigned prefix = rev & (root_size - 1);
+            if (scratch[prefix] < len) scratch[prefix] = (uint8_t)len;
+        }
+        next[len]++;
+    }
+
+    /* allocate subtables */
+    int used = root_size;
+    for (int p = 0; p < root_size; p++) {
+        if (!scratch[p]) continue;
+        int sub_bits = scratch[p] - root;
+        int sub_size = 1 << sub_bits;
+        if (used + sub_size > size) return -1;
+        table[p] = E_SUB | ((uint32_t)used << 16) | ((uint32_t)sub_bits << 8) | (uint32_t)root;
+        for (int i = 0; i < sub_size; i++) table[used + i] = E_BAD | 1;
+        used += sub_size;
+    }
+
+    /* pass 2: fill subtables */
+    if (used > root_size) {
+        code = 0;
+        for (int len = 1; len <= INFLATE_MAXBITS; len++) {
+            code = (code + count[len - 1]) << 1;
+            next[len] = (uint16_t)code;
+        }
+        for (int sym = 0; sym < n; sym++) {
+            int len = lens[sym];
+            if (!len) continue;
+            unsigned rev = bitrev(next[len]++, len);
+            if (len <= root) continue;
+            uint32_t link = table[rev & (root_size - 1)];
+            uint32_t *sub = table + E_VAL(link);
+            unsigned sub_size = 1u << E_EXTRA(link);
+            uint32_t e = entry(sym) | (uint32_t)(len - root);
+            for (unsigned i = rev >> root; i < sub_size; i += 1u << (len - root)) sub[i] = e;
+        }
+    }
+    return left;
+}
+
+/* ---- bit input ---- */
+
+/* Safe refill: top up to > 48 bits (a full length/distance pair), padding
+ * with zeros past the end. Stays <= 56 so refill_fast can follow. */
+static inline void refill_slow(struct inflate_state *s) {
+    while (s->bitcnt <= 48) {
+        uint64_t byte = 0;
+        if (s->in_pos < s->in_len) byte = s->in[s->in_pos++];
+        else s->overrun++;
+        s->bitbuf |= byte << s->bitcnt;
+        s->bitcnt += 8;
+    }
+}
+
+/* Branch-free refill; needs 8 readable bytes at in_pos */
+static inline void refill_fast(struct inflate_state *s) {
+    s->bitbuf |= load64(s->in + s->in_pos) << s->bitcnt;
+    s->in_pos += (63 - s->bitcnt) >> 3;
+    s->bitcnt |= 56;
+}
+
+static inline uint32_t peek(const struct inflate_state *s, unsigned n) {
+    return (uint32_t)(s->bitbuf & ((1ULL << n) - 1));
+}
+
+static inline void drop(struct inflate_state *s, unsigned n) {
+    s->bitbuf >>= n;
+    s->bitcnt -= n;
+}
+
+/* Did we consume any of the zero padding? */
+static inline int overran(const struct inflate_state *s) {
+    return s->bitcnt < s->overrun * 8;
+}
+
+static inline uint32_t decode(struct inflate_state *s, const uint32_t *table, unsigned root) {
+    uint32_t e = table[peek(s, root)];
+    if (e & E_SUB) {
+        drop(s, root);
+        e = table[E_VAL(e) + peek(s, E_EXTRA(e))];
+    }
+    drop(s, E_NBITS(e));
+    return e;
+}
+
+/* ---- output ---- */
+
+static int report(struct inflate_state *s) {
+    if (!s->opts || !s->opts->progress) {
+        s->next_report = (size_t)-1;
+        return 0;
+    }
+    s->next_report = s->out_pos + s->step;
+    return s->opts->progress(s->opts->ctx, s->out_pos) ? INFLATE_ERR_ABORTED : 0;
+}
+
+/* Make room for `need` more bytes if the output is growable */
+static int reserve(struct inflate_state *s, size_t need) {
+    if (s->out_cap - s->out_pos >= need) return 0;
+    if (!s->growable) return INFLATE_ERR_OUTPUT;
+    size_t cap = s->out_cap ? s->out_cap : 4096;
+    while (cap - s->out_pos < need) cap *= 2;
+    if (s->out_max && cap > s->out_max) {
+        cap = s->out_max;
+        if (cap - s->out_pos < need) return INFLATE_ERR_OUTPUT;
+    }
+    uint8_t *p = krealloc(s->out, cap);
+    if (!p) return INFLATE_ERR_OUTPUT;
+    s->out = p;
+    s->out_cap = cap;
+    return 0;
+}
+
+static inline void copy_match(uint8_t *dst, size_t dist, size_t len) {
+    const uint8_t *src = dst - dist;
+    uint8_t *end = dst + len;
+    if (dist >= 8) {
+        /* may write up to 7 bytes past end; callers leave that slack */
+        do {
+            store64(dst, load64(src));
+            dst += 8;
+            src += 8;
+        } while (dst < end);
+    } else if (dist == 1) {
+        uint64_t v = 0x0101010101010101ULL * src[0];
+        do {
+            store64(dst, v);
+            dst += 8;
+        } while (dst < end);
+    } else {
+        /* short period: seed 8 bytes, then copy with a period that is a
+         * multiple of dist and >= 8 so 8-byte chunks never overlap */
+        for (int i = 0; i < 8; i++) dst[i] = src[i];
+        size_t period = dist * ((8 + dist - 1) / dist);
+        src = dst + 8 - period;
+        dst += 8;
+        while (dst < end) {
+            store64(dst, load64(src));
+            dst += 8;
+            src += 8;
+        }
+    }
+}
+
+/* ---- blocks ---- */
+
+static int inflate_stored(struct inflate_state *s) {
+    /* drop to a byte boundary and hand unread whole bytes back to the input */
+    drop(s, s->bitcnt & 7);
+    size_t buffered = s->bitcnt >> 3;
+    if (buffered < s->overrun) return INFLATE_ERR_INPUT;
+    s->in_pos -= buffered - s->overrun;
+    s->bitbuf = 0;
+    s->bitcnt = 0;
+    s->overrun = 0;
+
+    if (s->in_pos + 4 > s->in_len) return INFLATE_ERR_INPUT;
+    unsigned len = s->in[s->in_pos] | ((unsigned)s->in[s->in_pos + 1] << 8);
+    unsigned nlen = s->in[s->in_pos + 2] | ((unsigned)s->in[s->in_pos + 3] << 8);
+    s->in_pos += 4;
+    if (len != (~nlen & 0xFFFF)) return INFLATE_ERR_DATA;
+    if (s->in_pos + len > s->in_len) return INFLATE_ERR_INPUT;
+    int err = reserve(s, len);
+    if (err) return err;
+    memcpy(s->out + s->out_pos, s->in + s->in_pos, len);
+    s->in_pos += len;
+    s->out_pos += len;
+    if (s->out_pos >= s->next_report) return report(s);
+    return INFLATE_OK;
+}
+
+static int inflate_codes(struct inflate_state *s, const uint32_t *lt, const uint32_t *dt) {
+    for (;;) {
+        /* fast loop: no bounds checks per bit or per byte */
+        /* best effort: if growing fails the slow path reports it when a
+         * byte actually doesn't fit */
+        if (s->growable && s->out_cap - s->out_pos < INFLATE_FAST_OUT) reserve(s, INFLATE_FAST_OUT);
+        if (s->in_len - s->in_pos >= 8 && s->out_cap - s->out_pos >= INFLATE_FAST_OUT && !s->overrun) {
+            uint8_t *out = s->out;
+            size_t out_pos = s->out_pos;
+            size_t fast_end = s->out_cap - INFLATE_FAST_OUT;
+            size_t in_end = s->in_len - 8;
+            size_t limit = s->next_report < fast_end ? s->next_report : fast_end;
+
+            while (s->in_pos <= in_end && out_pos <= limit) {
+                refill_fast(s);
+                uint32_t e = decode(s, lt, LITLEN_ROOT);
+                if (e & E_LIT) {
+                    out[out_pos++] = (uint8_t)E_VAL(e);
+                    /* a second literal usually fits in the same refill */
+                    e = lt[peek(s, LITLEN_ROOT)];
+                    if ((e & E_LIT) && s->bitcnt >= 15) {
+                        drop(s, E_NBITS(e));
+                        out[out_pos++] = (uint8_t)E_VAL(e);
+                    }
+                    continue;
+                }
+                if (e & (E_EOB | E_BAD)) {
+                    s->out_pos = out_pos;
+                    s->bitbuf &= (1ULL << s->bitcnt) - 1;
+                    return (e & E_EOB) ? INFLATE_OK : INFLATE_ERR_DATA;
+                }
+                size_t len = E_VAL(e) + peek(s, E_EXTRA(e));
+                drop(s, E_EXTRA(e));
+
+                e = decode(s, dt, DIST_ROOT);
+                if (e & E_BAD) {
+                    s->out_pos = out_pos;
+                    return INFLATE_ERR_DATA;
+                }
+                size_t dist = E_VAL(e) + peek(s, E_EXTRA(e));
+                drop(s, E_EXTRA(e));
+                if (dist > out_pos) {
+                    s->out_pos = out_pos;
+                    return INFLATE_ERR_DATA;
+                }
+                copy_match(out + out_pos, dist, len);
+                out_pos += len;
+            }
+            s->out_pos = out_pos;
+            /* keep only counted bits so the slow refill can OR bytes in */
+            s->bitbuf &= (1ULL << s->bitcnt) - 1;
+            if (s->out_pos >= s->next_report) {
+                int err = report(s);
+                if (err) return err;
+            }
+            if (s->in_pos <= in_end && s->out_pos <= fast_end) continue;
+        }
+
+        /* slow path: one symbol at a time with full checks */
+        refill_slow(s);
+        uint32_t e = decode(s, lt, LITLEN_ROOT);
+        if (overran(s)) return INFLATE_ERR_INPUT;
+        if (e & E_LIT) {
+            int err = reserve(s, 1);
+            if (err) return err;
+            s->out[s->out_pos++] = (uint8_t)E_VAL(e);
+        } else if (e & E_EOB) {
+            return INFLATE_OK;
+        } else if (e & E_BAD) {
+            return INFLATE_ERR_DATA;
+        } else {
+            size_t len = E_VAL(e) + peek(s, E_EXTRA(e));
+            drop(s, E_EXTRA(e));
+            e = decode(s, dt, DIST_ROOT);
+            if (e & E_BAD) return INFLATE_ERR_DATA;
+            size_t dist = E_VAL(e) + peek(s, E_EXTRA(e));
+            drop(s, E_EXTRA(e));
+            if (overran(s)) return INFLATE_ERR_INPUT;
+            if (dist > s->out_pos) return INFLATE_ERR_DATA;
+            int err = reserve(s, len);
+            if (err) return err;
+            uint8_t *dst = s->out + s->out_pos;
+            for (size_t i = 0; i < len; i++) dst[i] = dst[i - dist];
+            s->out_pos += len;
+        }
+        if (s->out_pos >= s->next_report) {
+            int err = report(s);
+            if (err) return err;
+        }
+    }
+}
+
+static uint32_t fixed_litlen[LITLEN_ENOUGH];
+static uint32_t fixed_dist[DIST_ENOUGH];
+
+static int inflate_fixed(struct inflate_state *s) {
+    static int built = 0;
+
+    if (!built) {
+        uint8_t lengths[INFLATE_FIXLCODES];
+        int sym = 0;
+        for (; sym < 144; sym++) lengths[sym] = 8;
+        for (; sym < 256; sym++) lengths[sym] = 9;
+        for (; sym < 280; sym++) lengths[sym] = 7;
+        for (; sym < INFLATE_FIXLCODES; sym++) lengths[sym] = 8;
+        build_table(fixed_litlen, LITLEN_ENOUGH, LITLEN_ROOT, lengths, INFLATE_FIXLCODES,
+                    litlen_entry, s->maxlen);
+        for (sym = 0; sym < 32; sym++) lengths[sym] = 5;
+        build_table(fixed_dist, DIST_ENOUGH, DIST_ROOT, lengths, 32, dist_entry, s->maxlen);
+        built = 1;
+    }
+    return inflate_codes(s, fixed_litlen, fixed_dist);
+}
+
+static int inflate_dynamic(struct inflate_state *s) {
+    uint8_t *lengths = s->lens;
+
+    refill_slow(s);
+    int nlen = (int)peek(s, 5) + 257; drop(s, 5);
+    int ndist = (int)peek(s, 5) + 1; drop(s, 5);
+    int ncode = (int)peek(s, 4) + 4; drop(s, 4);
+    if (nlen > INFLATE_MAXLCODES || ndist > INFLATE_MAXDCODES) return INFLATE_ERR_DATA;
+
+    int index;
+    for (index = 0; index < ncode; index++) {
+        refill_slow(s);
+        lengths[clen_order[index]] = (uint8_t)peek(s, 3);
+        drop(s, 3);
+    }
+    for (; index < 19; index++) lengths[clen_order[index]] = 0;
+    if (overran(s)) return INFLATE_ERR_INPUT;
+
+    /* the code length code lives in the (not yet used) distance table */
+    if (build_table(s->dist, DIST_ENOUGH, CLEN_ROOT, lengths, 19, clen_entry, s->maxlen) != 0)
+        return INFLATE_ERR_DATA;
+
+    index = 0;
+    while (index < nlen + ndist) {
+        refill_slow(s);
+        uint32_t e = decode(s, s->dist, CLEN_ROOT);
+        if (e & E_BAD) return INFLATE_ERR_DATA;
+        int sym = (int)E_VAL(e);
+        if (sym < 16) {
+            lengths[index++] = (uint8_t)sym;
+        } else {
+            uint8_t len = 0;
+            int rep;
+            if (sym == 16) {
+                if (index == 0) return INFLATE_ERR_DATA;
+                len = lengths[index - 1];
+                rep = 3 + (int)peek(s, 2); drop(s, 2);
+            } else if (sym == 17) {
+                rep = 3 + (int)peek(s, 3); drop(s, 3);
+            } else {
+                rep = 11 + (int)peek(s, 7); drop(s, 7);
+            }
+            if (index + rep > nlen + ndist) return INFLATE_ERR_DATA;
+            while (rep--) lengths[index++] = len;
+        }
+    }
+    if (overran(s)) return INFLATE_ERR_INPUT;
+    if (lengths[256] == 0) return INFLATE_ERR_DATA;
+
+    /* incomplete codes are only allowed for a single code */
+    int err = build_table(s->litlen, LITLEN_ENOUGH, LITLEN_ROOT, lengths, nlen, litlen_entry, s->maxlen);
+    if (err < 0) return INFLATE_ERR_DATA;
+    if (err > 0) {
+        int used = 0;
+        for (int i = 0; i < nlen; i++) used += lengths[i] != 0;
+        if (used != 1) return INFLATE_ERR_DATA;
+    }
+    err = build_table(s->dist, DIST_ENOUGH, DIST_ROOT, lengths + nlen, ndist, dist_entry, s->maxlen);
+    if (err < 0) return INFLATE_ERR_DATA;
+    if (err > 0) {
+        int used = 0;
+        for (int i = 0; i < ndist; i++) used += lengths[nlen + i] != 0;
+        if (used > 1) return INFLATE_ERR_DATA;
+    }
+
+    return inflate_codes(s, s->litlen, s->dist);
+}
+
+/* Run the block loop. On success *in_used is the number of input bytes
+ * that belonged to the deflate stream. */
+static int inflate_run(struct inflate_state *s, size_t *in_used) {
+    int last, err;
+    do {
+        refill_slow(s);
+        last = (int)peek(s, 1);
+        int type = (int)(peek(s, 3) >> 1);
+        drop(s, 3);
+        if (overran(s)) { err = INFLATE_ERR_INPUT; break; }
+        if (type == 0) err = inflate_stored(s);
+        else if (type == 1) err = inflate_fixed(s);
+        else if (type == 2) err = inflate_dynamic(s);
+        else err = INFLATE_ERR_DATA;
+    } while (!err && !last);
+    if (err) return err;
+
+    size_t unread = (s->bitcnt >> 3);
+    if (unread < s->overrun) return INFLATE_ERR_INPUT;
+    *in_used = s->in_pos - (unread - s->overrun);
+
+    /* final report so the consumer sees the tail of the output */
+    if (s->opts && s->opts->progress && s->opts->progress(s->opts->ctx, s->out_pos)) return INFLATE_ERR_ABORTED;
+    return INFLATE_OK;
+}
+
+static struct inflate_state *state_new(uint8_t *out, size_t out_cap, const uint8_t *in, size_t in_len,
+                                       const struct inflate_opts *opts) {
+    struct inflate_state *s = kmalloc(sizeof(*s));
+    if (!s) return NULL;
+    s->in = in;
+    s->in_len = in_len;
+    s->in_pos = 0;
+    s->bitbuf = 0;
+    s->bitcnt = 0;
+    s->overrun = 0;
+    s->out = out;
+    s->out_cap = out_cap;
+    s->out_pos = 0;
+    s->out_max = 0;
+    s->growable = 0;
+    s->opts = opts;
+    s->step = (opts && opts->step) ? opts->step : INFLATE_DEFAULT_STEP;
+    s->next_report = (opts && opts->progress) ? s->step : (size_t)-1;
+    return s;
+}
+
+static int zlib_header(const uint8_t *in, size_t in_len) {
+    if (in_len < 2) return INFLATE_ERR_INPUT;
+    unsigned cmf = in[0], flg = in[1];
+    if (((cmf << 8) | flg) % 31 != 0) return INFLATE_ERR_DATA;
+    if ((cmf & 0x0F) != 8 || (cmf >> 4) > 7) return INFLATE_ERR_DATA;
+    if (flg & 0x20) return INFLATE_ERR_DATA; /* preset dictionary not supported */
+    return INFLATE_OK;
+}
+
+static int zlib_trailer(const uint8_t *in, size_t in_len, size_t pos, const uint8_t *out, size_t out_len) {
+    if (pos + 4 > in_len) return INFLATE_ERR_INPUT;
+    uint32_t want = ((uint32_t)in[pos] << 24) | ((uint32_t)in[pos + 1] << 16) |
+                    ((uint32_t)in[pos + 2] << 8) | in[pos + 3];
+    return inflate_adler32(1, out, out_len) == want ? INFLATE_OK : INFLATE_ERR_DATA;
+}
+
+uint32_t inflate_adler32(uint32_t adler, const uint8_t *buf, size_t len) {
+    uint32_t a = adler & 0xFFFF, b = adler >> 16;
+    while (len) {
+        /* 5552 is the largest n such that sums cannot overflow 32 bits */
+        size_t n = len < 5552 ? len : 5552;
+        len -= n;
+        while (n >= 8) {
+            a += buf[0]; b += a; a += buf[1]; b += a;
+            a += buf[2]; b += a; a += buf[3]; b += a;
+            a += buf[4]; b += a; a += buf[5]; b += a;
+            a += buf[6]; b += a; a += buf[7]; b += a;
+            buf += 8;
+            n -= 8;
+        }
+        while (n--) { a += *buf++; b += a; }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+int inflate_raw(uint8_t *out, size_t out_cap, size_t *out_len,
+                const uint8_t *in, size_t in_len, const struct inflate_opts *opts) {
+    if (out_len) *out_len = 0;
+    struct inflate_state *s = state_new(out, out_cap, in, in_len, opts);
+    if (!s) return INFLATE_ERR_NOMEM;
+    size_t used;
+    int err = inflate_run(s, &used);
+    if (out_len) *out_len = s->out_pos;
+    kfree(s);
+    return err;
+}
+
+int inflate_zlib(uint8_t *out, size_t out_cap, size_t *out_len,
+                 const uint8_t *in, size_t in_len, const struct inflate_opts *opts) {
+    if (out_len) *out_len = 0;
+    int err = zlib_header(in, in_len);
+    if (err) return err;
+
+    struct inflate_state *s = state_new(out, out_cap, in + 2, in_len - 2, opts);
+    if (!s) return INFLATE_ERR_NOMEM;
+    size_t used;
+    err = inflate_run(s, &used);
+    size_t produced = s->out_pos;
+    kfree(s);
+    if (out_len) *out_len = produced;
+    if (err) return err;
+    return zlib_trailer(in, in_len, 2 + used, out, produced);
+}
+
+int inflate_zlib_alloc(uint8_t **out, size_t *out_len, const uint8_t *in, size_t in_len,
+                       size_t size_hint, size_t max_out) {
+    *out = NULL;
+    *out_len = 0;
+    int err = zlib_header(in, in_len);
+    if (err) return err;
+
+    size_t cap = size_hint ? size_hint + INFLATE_FAST_OUT : in_len * 4 + 4096;
+    if (max_out && cap > max_out) cap = max_out;
+    uint8_t *buf = kmalloc(cap);
+    if (!buf) return INFLATE_ERR_NOMEM;
+
+    struct inflate_state *s = state_new(buf, cap, in + 2, in_len - 2, NULL);
+    if (!s) {
+        kfree(buf);
+        return INFLATE_ERR_NOMEM;
+    }
+    s->growable = 1;
+    s->out_max = max_out;
+    size_t used;
+    err = inflate_run(s, &used);
+    buf = s->out;
+    size_t produced = s->out_pos;
+    kfree(s);
+
+    if (!err) err = zlib_trailer(in, in_len, 2 + used, buf, produced);
+    if (err) {
+        kfree(buf);
+        return err;
+    }
+    *out = buf;
+    *out_len = produced;
+    return INFLATE_OK;
+}
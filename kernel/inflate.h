@@ -0,0 +1,48 @@
+#ifndef INFLATE_H
+#define INFLATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* DEFLATE (RFC 1951) / zlib (RFC 1950) decoder.
+ * Table-driven: two-level Huffman lookup tables, a 64-bit bit buffer and
+ * word-sized match copies. Shared by the PNG paths (lodepng's custom_zlib
+ * hook and the background decoder) and usable for any other zlib/deflate
+ * data in the kernel.
+ *
+ * inflate_raw/inflate_zlib write into a caller-provided buffer, so the
+ * caller decides the memory policy (PNG knows its exact raw size up
+ * front). An optional progress hook is called every `step` output bytes;
+ * it lets long decodes yield() and lets the caller consume finished
+ * output early.
+ */
+
+#define INFLATE_OK            0
+#define INFLATE_ERR_DATA     -1  /* corrupt stream or checksum mismatch */
+#define INFLATE_ERR_OUTPUT   -2  /* output buffer too small */
+#define INFLATE_ERR_INPUT    -3  /* truncated input */
+#define INFLATE_ERR_ABORTED  -4  /* progress hook asked us to stop */
+#define INFLATE_ERR_NOMEM    -5
+
+/* Return non-zero to abort the decode. out_len = bytes produced so far. */
+typedef int (*inflate_progress_fn)(void *ctx, size_t out_len);
+
+struct inflate_opts {
+    inflate_progress_fn progress;
+    void *ctx;
+    size_t step;        /* bytes between progress calls (0 = default) */
+};
+
+int inflate_raw(uint8_t *out, size_t out_cap, size_t *out_len,
+                const uint8_t *in, size_t in_len, const struct inflate_opts *opts);
+/* Also verifies the adler32 trailer */
+int inflate_zlib(uint8_t *out, size_t out_cap, size_t *out_len,
+                 const uint8_t *in, size_t in_len, const struct inflate_opts *opts);
+/* Output is kmalloc'd, sized from size_hint (0 = guess) and grown as
+ * needed up to max_out bytes (0 = unlimited). Caller kfree()s *out. */
+int inflate_zlib_alloc(uint8_t **out, size_t *out_len, const uint8_t *in, size_t in_len,
+                       size_t size_hint, size_t max_out);
+
+uint32_t inflate_adler32(uint32_t adler, const uint8_t *buf, size_t len);
+
+#endif
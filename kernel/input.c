@@ -3,35 +3,35 @@
 #include <stddef.h>
 #include "irq.h"
 #include "sched.h"
+#include "etask.h"
+#include "ring.h"
+#include "timer.h"
+#include "input_rec.h"
+#include "poll.h"
 
 #define EVENT_QUEUE_SIZE 256
 
-static struct input_event key_queue[EVENT_QUEUE_SIZE];
-static int key_head = 0, key_tail = 0;
-
-static struct input_event mouse_queue[EVENT_QUEUE_SIZE];
-static int mouse_head = 0, mouse_tail = 0;
-
-/* Simple volatile flag for "lock" (single core, so mostly to prevent interrupt race if they happen) */
-static volatile int input_lock = 0;
-
-static unsigned long lock(void) {
-    unsigned long flags = irq_save();
-    while (input_lock) {
-        irq_restore(flags);
-        yield();
-        flags = irq_save();
-    }
-    input_lock = 1;
-    return flags;
+/* Consumed by the wm task without locking. Producers are the UART bridge
+ * task and the input drivers, which may run in IRQ context, so a push
+ * masks IRQs for the few instructions it takes. */
+static struct input_event key_buf[EVENT_QUEUE_SIZE];
+static struct input_event mouse_buf[EVENT_QUEUE_SIZE];
+static struct ring key_ring = RING_INIT(key_buf, EVENT_QUEUE_SIZE);
+static struct ring mouse_ring = RING_INIT(mouse_buf, EVENT_QUEUE_SIZE);
+
+static uint32_t key_ready(struct waitable *w) {
+    (void)w;
+    return ring_empty(&key_ring) ? 0 : POLLIN;
 }
 
-static void unlock(unsigned long flags) {
-    __asm__ volatile("dmb sy" ::: "memory");
-    input_lock = 0;
-    irq_restore(flags);
+static uint32_t mouse_ready(struct waitable *w) {
+    (void)w;
+    return ring_empty(&mouse_ring) ? 0 : POLLIN;
 }
 
+static struct waitable key_w = { key_ready, NULL, NULL };
+static struct waitable mouse_w = { mouse_ready, NULL, NULL };
+
 /* Normalized mouse state */
 static int mouse_x = 0, mouse_y = 0, mouse_btn = 0;
 extern int screen_w, screen_h;
@@ -61,11 +61,19 @@ static uint8_t ascii_to_scan(char c) {
     }
 }
 
-void uart_keyboard_task(void *arg) {
-    (void)arg;
-    while(1) {
-        if (uart_haschar()) {
-            char c = uart_getc();
+/* Serial console keys become keyboard events */
+#define UART_KBD_POLL_MS 10     /* before uart_start there is no RX interrupt */
+
+static struct etask uart_kbd;
+
+static int uart_keyboard_fn(struct etask *t) {
+    char buf[32];
+    size_t n;
+    volatile uint32_t *gen = uart_rx_gen();
+    uint32_t seen = gen ? *gen : 0;
+    while ((n = uart_read(buf, sizeof(buf))) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            char c = buf[i];
             /* Special handling for uppercase */
             int shifted = (c >= 'A' && c <= 'Z');
             char lookup = shifted ? (c - 'A' + 'a') : c;
@@ -77,8 +85,11 @@ void uart_keyboard_task(void *arg) {
                 if (shifted) input_push_event(INPUT_TYPE_KEY, 0x2A, 0); /* Left Shift Release */
             }
         }
-        yield();
     }
+    /* sleeps until the UART RX interrupt delivers a byte */
+    if (gen) etask_wait_event(t, UART_EVENT_ID, gen, seen);
+    else etask_sleep_until(t, scheduler_get_tick() + UART_KBD_POLL_MS);
+    return ETASK_WAIT;
 }
 
 void input_init(int sw, int sh) {
@@ -90,7 +101,7 @@ void input_init(int sw, int sh) {
     /* Startup the UART keyboard bridge task */
     static int started = 0;
     if (!started) {
-        task_create(uart_keyboard_task, NULL, "uart_kbd");
+        etask_start(&uart_kbd, uart_keyboard_fn, NULL, "uart_kbd");
         started = 1;
     }
 }
@@ -108,7 +119,20 @@ static int scale_mouse(int val, int max_res) {
     return (val * max_res) / 32768;
 }
 
+void input_set_mouse_state(int x, int y, int btn) {
+    unsigned long flags = irq_save();
+    mouse_x = x < 0 ? 0 : (x >= screen_w ? screen_w - 1 : x);
+    mouse_y = y < 0 ? 0 : (y >= screen_h ? screen_h - 1 : y);
+    mouse_btn = btn;
+    irq_restore(flags);
+    task_wake_event(MOUSE_EVENT_ID);
+    task_wake_event(WM_EVENT_ID);
+}
+
 void input_push_event(uint16_t type, uint16_t code, int32_t value) {
+    uint64_t stamp = timer_get_ticks();
+    inrec_capture(type, code, value, stamp);
+
     /* Update global state immediately for low-latency cursor */
     if (type == INPUT_TYPE_ABS) {
         if (code == 0) mouse_x = scale_mouse(value, screen_w);
@@ -127,33 +151,25 @@ void input_push_event(uint16_t type, uint16_t code, int32_t value) {
     if (mouse_y < 0) mouse_y = 0;
     if (mouse_y >= screen_h) mouse_y = screen_h - 1;
 
-    unsigned long flags = lock();
-    struct input_event *q;
-    int *head, *tail;
-
+    struct ring *q;
     if (type == INPUT_TYPE_KEY) {
         if (code >= 0x100) {
-            q = mouse_queue; head = &mouse_head; tail = &mouse_tail;
+            q = &mouse_ring;
             type = INPUT_TYPE_MOUSE_BTN;
         } else {
-            q = key_queue; head = &key_head; tail = &key_tail;
+            q = &key_ring;
         }
     } else {
-        q = mouse_queue; head = &mouse_head; tail = &mouse_tail;
+        q = &mouse_ring;
     }
 
-    int pushed = 0;
-    int next = (*head + 1) % EVENT_QUEUE_SIZE;
-    if (next != *tail) {
-        q[*head].type = type;
-        q[*head].code = code;
-        q[*head].value = value;
-        *head = next;
-        pushed = 1;
-    }
-    unlock(flags);
+    struct input_event ev = { type, code, value, stamp };
+    unsigned long flags = irq_save();
+    int pushed = ring_push(q, &ev);
+    irq_restore(flags);
 
     if (!pushed) return;
+    waitable_notify(q == &key_ring ? &key_w : &mouse_w);
 
     if (type == INPUT_TYPE_KEY) {
         task_wake_event(WM_EVENT_ID);
@@ -164,21 +180,24 @@ void input_push_event(uint16_t type, uint16_t code, int32_t value) {
 }
 
 int input_pop_key_event(struct input_event *ev) {
-    unsigned long flags = lock();
-    if (key_tail == key_head) { unlock(flags); return 0; }
-    *ev = key_queue[key_tail];
-    key_tail = (key_tail + 1) % EVENT_QUEUE_SIZE;
-    unlock(flags);
-    return 1;
+    return ring_pop(&key_ring, ev);
 }
 
 int input_pop_mouse_event(struct input_event *ev) {
-    unsigned long flags = lock();
-    if (mouse_tail == mouse_head) { unlock(flags); return 0; }
-    *ev = mouse_queue[mouse_tail];
-    mouse_tail = (mouse_tail + 1) % EVENT_QUEUE_SIZE;
-    unlock(flags);
-    return 1;
+    return ring_pop(&mouse_ring, ev);
+}
+
+struct waitable *input_key_waitable(void) {
+    return &key_w;
+}
+
+struct waitable *input_mouse_waitable(void) {
+    return &mouse_w;
+}
+
+void input_get_stats(uint32_t *key_dropped, uint32_t *mouse_dropped) {
+    if (key_dropped) *key_dropped = key_ring.dropped;
+    if (mouse_dropped) *mouse_dropped = mouse_ring.dropped;
 }
 
 int input_pop_event(struct input_event *ev) {
@@ -16,6 +16,7 @@ struct input_event {
     uint16_t type;
     uint16_t code;
     int32_t value;
+    uint64_t stamp;     /* generic-timer count at arrival (latency.h) */
 };
 
 void input_push_event(uint16_t type, uint16_t code, int32_t value);
@@ -25,5 +26,14 @@ int input_pop_mouse_event(struct input_event *ev);
 
 void input_init(int screen_w, int screen_h);
 void input_get_mouse_state(int *x, int *y, int *btn);
+/* Place the pointer (input replay starts from the recorded position) */
+void input_set_mouse_state(int x, int y, int btn);
+/* Events lost to full queues since boot */
+void input_get_stats(uint32_t *key_dropped, uint32_t *mouse_dropped);
+
+struct waitable;
+/* poll() sources: POLLIN while the key / mouse queue is non-empty */
+struct waitable *input_key_waitable(void);
+struct waitable *input_mouse_waitable(void);
 
 #endif
@@ -0,0 +1,207 @@
+#include "input_rec.h"
+#include "input.h"
+#include "framebuffer.h"
+#include "ramfs.h"
+#include "kmalloc.h"
+#include "sched.h"
+#include "timer.h"
+#include "irq.h"
+#include "lib.h"
+#include <string.h>
+
+#define INREC_SETTLE_MS 200   /* after the last event, for its frames to land */
+
+/* Recording: appended from input_push_event(), which may run in IRQs */
+static struct inrec_event *rec_buf = NULL;
+static volatile uint32_t rec_count = 0;
+static volatile int recording = 0;
+static uint64_t rec_t0 = 0;
+static struct inrec_header rec_hdr;
+
+/* Replay: frames logged by the wm task while the player runs */
+struct frame_entry { uint32_t us; uint32_t sum; };
+static struct frame_entry *frame_log = NULL;
+static uint32_t frame_count = 0, frame_lost = 0;
+static int frame_flags = 0;
+static volatile int replaying = 0;
+
+int inrec_start(void) {
+    if (recording || replaying) return -1;
+    rec_buf = kmalloc(INREC_MAX_EVENTS * sizeof(struct inrec_event));
+    if (!rec_buf) return -1;
+    rec_hdr.magic = INREC_MAGIC;
+    rec_hdr.version = INREC_VERSION;
+    input_get_mouse_state(&rec_hdr.mouse_x, &rec_hdr.mouse_y, &rec_hdr.mouse_btn);
+    fb_get_res(&rec_hdr.screen_w, &rec_hdr.screen_h);
+    rec_count = 0;
+    rec_t0 = timer_get_ticks();
+    recording = 1;
+    return 0;
+}
+
+int inrec_recording(void) {
+    return recording;
+}
+
+void inrec_capture(uint16_t type, uint16_t code, int32_t value, uint64_t stamp) {
+    if (!recording || replaying) return;
+    unsigned long flags = irq_save();
+    if (rec_count < INREC_MAX_EVENTS) {
+        struct inrec_event *e = &rec_buf[rec_count++];
+        e->t_us = (uint32_t)timer_ticks_to_us(stamp - rec_t0);
+        e->type = type;
+        e->code = code;
+        e->value = value;
+    }
+    irq_restore(flags);
+}
+
+int inrec_stop(const char *path) {
+    if (!recording) return -1;
+    unsigned long flags = irq_save();
+    recording = 0;
+    irq_restore(flags);
+
+    uint32_t n = rec_count;
+    size_t len = sizeof(rec_hdr) + (size_t)n * sizeof(struct inrec_event);
+    uint8_t *file = kmalloc(len);
+    int ret = -1;
+    if (file) {
+        rec_hdr.count = n;
+        memcpy(file, &rec_hdr, sizeof(rec_hdr));
+        memcpy(file + sizeof(rec_hdr), rec_buf, (size_t)n * sizeof(struct inrec_event));
+        ramfs_remove(path);
+        if (ramfs_create(path) >= 0 && ramfs_write(path, file, len, 0) >= 0) ret = (int)n;
+        kfree(file);
+    }
+    kfree(rec_buf);
+    rec_buf = NULL;
+    return ret;
+}
+
+void inrec_frame(uint64_t t_start) {
+    if (!replaying || !frame_log) return;
+    if (frame_count >= INREC_MAX_FRAMES) { frame_lost++; return; }
+    struct frame_entry *f = &frame_log[frame_count++];
+    f->us = (uint32_t)timer_ticks_to_us(timer_get_ticks() - t_start);
+    f->sum = (frame_flags & INREC_CHECKSUM) ? fb_checksum() : 0;
+}
+
+static void sort_u32(uint32_t *v, uint32_t n) {
+    for (uint32_t gap = n / 2; gap > 0; gap /= 2) {
+        for (uint32_t i = gap; i < n; i++) {
+            uint32_t t = v[i], j = i;
+            for (; j >= gap && v[j - gap] > t; j -= gap) v[j] = v[j - gap];
+            v[j] = t;
+        }
+    }
+}
+
+static char *put_uint(char *p, uint32_t v) {
+    char tmp[12]; int i = 0;
+    do { tmp[i++] = (char)('0' + v % 10); v /= 10; } while (v);
+    while (i) *p++ = tmp[--i];
+    return p;
+}
+
+static char *put_hex(char *p, uint32_t v) {
+    for (int s = 28; s >= 0; s -= 4) *p++ = "0123456789abcdef"[(v >> s) & 0xF];
+    return p;
+}
+
+/* "frame us checksum" per line */
+static int write_frame_log(const char *log_path) {
+    char *text = kmalloc((size_t)frame_count * 32 + 1);
+    if (!text) return -1;
+    char *p = text;
+    for (uint32_t i = 0; i < frame_count; i++) {
+        p = put_uint(p, i); *p++ = ' ';
+        p = put_uint(p, frame_log[i].us); *p++ = ' ';
+        p = put_hex(p, frame_log[i].sum); *p++ = '\n';
+    }
+    ramfs_remove(log_path);
+    int ret = (ramfs_create(log_path) >= 0 && ramfs_write(log_path, text, (size_t)(p - text), 0) >= 0) ? 0 : -1;
+    kfree(text);
+    return ret;
+}
+
+static void summarize(struct inrec_result *res) {
+    res->frames = frame_count;
+    res->frames_lost = frame_lost;
+    res->frame_p50_us = res->frame_p90_us = res->frame_max_us = 0;
+    uint32_t h = 2166136261u;
+    for (uint32_t i = 0; i < frame_count; i++) h = (h ^ frame_log[i].sum) * 16777619u;
+    res->scene_hash = h;
+    if (!frame_count) return;
+    uint32_t *t = kmalloc(frame_count * sizeof(uint32_t));
+    if (!t) return;
+    for (uint32_t i = 0; i < frame_count; i++) t[i] = frame_log[i].us;
+    sort_u32(t, frame_count);
+    res->frame_p50_us = t[(frame_count - 1) * 50 / 100];
+    res->frame_p90_us = t[(frame_count - 1) * 90 / 100];
+    res->frame_max_us = t[frame_count - 1];
+    kfree(t);
+}
+
+/* The player was killed mid-replay: unlock recording and free its buffers */
+static void play_abandon(void *file) {
+    replaying = 0;
+    kfree(frame_log);
+    frame_log = NULL;
+    kfree(file);
+}
+
+int inrec_play(const char *path, int flags, const char *log_path, struct inrec_result *res) {
+    if (recording || replaying) return -1;
+    int size = ramfs_get_size(path);
+    if (size < (int)sizeof(struct inrec_header)) return -1;
+    uint8_t *file = kmalloc((size_t)size);
+    if (!file) return -1;
+    if (ramfs_read(path, file, (size_t)size, 0) != size) { kfree(file); return -1; }
+
+    struct inrec_header hdr;
+    memcpy(&hdr, file, sizeof(hdr));
+    uint32_t room = (uint32_t)((size_t)size - sizeof(hdr)) / sizeof(struct inrec_event);
+    if (hdr.magic != INREC_MAGIC || hdr.version != INREC_VERSION || hdr.count > room) {
+        kfree(file);
+        return -1;
+    }
+    const struct inrec_event *ev = (const struct inrec_event *)(file + sizeof(hdr));
+
+    frame_log = kmalloc(INREC_MAX_FRAMES * sizeof(struct frame_entry));
+    if (!frame_log) { kfree(file); return -1; }
+    frame_count = frame_lost = 0;
+    frame_flags = flags;
+    task_set_reap_hook(play_abandon, file);
+
+    /* REL motion depends on where the pointer starts */
+    input_set_mouse_state(hdr.mouse_x, hdr.mouse_y, hdr.mouse_btn);
+    replaying = 1;
+    uint64_t t0 = timer_get_us();
+    for (uint32_t i = 0; i < hdr.count; i++) {
+        if (!(flags & INREC_FAST)) {
+            uint64_t due = t0 + ev[i].t_us;
+            for (;;) {
+                uint64_t now = timer_get_us();
+                if (now >= due) break;
+                if (due - now > 2000) task_block_current_until(scheduler_get_tick() + (uint32_t)((due - now) / 1000) - 1);
+                else yield();
+            }
+        }
+        input_push_event(ev[i].type, ev[i].code, ev[i].value);
+        if (flags & INREC_FAST) yield();
+    }
+    task_block_current_until(scheduler_get_tick() + INREC_SETTLE_MS);
+    replaying = 0;
+
+    res->events = hdr.count;
+    res->elapsed_us = timer_get_us() - t0;
+    summarize(res);
+    int ret = 0;
+    if (log_path && write_frame_log(log_path) < 0) ret = -2;
+    task_set_reap_hook(0, 0);
+    kfree(frame_log);
+    frame_log = NULL;
+    kfree(file);
+    return ret;
+}
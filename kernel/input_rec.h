@@ -0,0 +1,66 @@
+#ifndef INPUT_REC_H
+#define INPUT_REC_H
+
+#include <stdint.h>
+
+/* Input recording and replay for reproducible UI runs.
+ *
+ * While recording, input_push_event() hands every event to
+ * inrec_capture() with its arrival stamp. The events are the raw
+ * (type, code, value) arguments, before input.c normalizes them, so
+ * replay goes through exactly the same path. inrec_stop() saves them to a
+ * ramfs file: a header that includes the pointer position at the start,
+ * then one record per event with its offset in microseconds.
+ *
+ * inrec_play() runs in the calling task and injects the file through
+ * input_push_event(). It keeps the recorded spacing, or with INREC_FAST
+ * pushes events as fast as the wm drains them. During replay,
+ * inrec_frame() logs every flushed frame's compose time. With
+ * INREC_CHECKSUM it also logs a checksum of the composed framebuffer, so
+ * two builds (or two runs) can be compared frame by frame. Checksums only
+ * match when the scene is deterministic: no blinking cursors or clocks in
+ * view. */
+
+#define INREC_MAGIC       0x5249594Du   /* "MYIR" */
+#define INREC_VERSION     1
+#define INREC_MAX_EVENTS  16384
+#define INREC_MAX_FRAMES  8192
+
+#define INREC_FAST     1
+#define INREC_CHECKSUM 2
+
+struct inrec_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    int32_t  mouse_x, mouse_y, mouse_btn;
+    int32_t  screen_w, screen_h;
+};
+
+struct inrec_event {
+    uint32_t t_us;      /* since the recording started */
+    uint16_t type;
+    uint16_t code;
+    int32_t  value;
+};
+
+struct inrec_result {
+    uint32_t events;
+    uint32_t frames;
+    uint32_t frames_lost;       /* beyond INREC_MAX_FRAMES */
+    uint64_t elapsed_us;
+    uint32_t frame_p50_us, frame_p90_us, frame_max_us;
+    uint32_t scene_hash;        /* over all frame checksums, in order */
+};
+
+int inrec_start(void);                  /* -1: already recording or no memory */
+int inrec_stop(const char *path);       /* events saved, -1 on error */
+int inrec_recording(void);
+void inrec_capture(uint16_t type, uint16_t code, int32_t value, uint64_t stamp);
+
+/* log_path (may be NULL) gets one "frame us checksum" line per frame */
+int inrec_play(const char *path, int flags, const char *log_path, struct inrec_result *res);
+/* wm_compose(), after each flush; t_start is when the compose began */
+void inrec_frame(uint64_t t_start);
+
+#endif
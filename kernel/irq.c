@@ -3,17 +3,36 @@
 #include <stdint.h>
 #include <stddef.h>
 #include "sched.h"
+#include "timer.h"
 #include "virtio.h"
 
 /* Real hardware IRQ entry/exit and VBAR setup.
    This provides the interrupt-driver API, handlers registration,
-   and dispatch for timer/uart/usb. */
+   and dispatch for timer/uart/usb. On the Pi the peripheral IRQs come
+   from the BCM2835 controller instead of a GIC. */
 
 extern void vectors(void);
 
-#define MAX_IRQ_HANDLERS 16
-struct irq_entry { int num; irq_handler_fn fn; void *arg; };
-static struct irq_entry handlers[MAX_IRQ_HANDLERS];
+/* One descriptor per interrupt number, indexed directly by dispatch */
+struct irq_desc {
+    irq_handler_fn handler;         /* top half, IRQ context */
+    irq_handler_fn thread_fn;       /* bottom half, in irqd */
+    void *arg;
+    const char *name;
+    uint32_t count;
+    uint32_t thread_runs;
+    uint64_t ticks;                 /* CNTPCT ticks spent in the top half */
+    uint64_t max_ticks;
+    uint64_t thread_ticks;
+    volatile uint8_t masked;        /* oneshot: line off until the thread ran */
+};
+static struct irq_desc descs[IRQ_NR];
+
+#define IRQ_WORDS ((IRQ_NR + 31) / 32)
+#define IRQD_STACK_KB 16
+static volatile uint32_t thread_pending[IRQ_WORDS];
+static volatile uint32_t thread_gen = 0;
+static int irqd_pid = 0;
 
 /* GIC Distributor Base for QEMU 'virt' machine */
 #define GICD_BASE 0x08000000
@@ -29,12 +48,24 @@ static struct irq_entry handlers[MAX_IRQ_HANDLERS];
 #define GICC_CTLR 0x00
 #define GICC_PMR 0x04
 
+/* BCM2835 legacy interrupt controller (GPU peripheral IRQs 0-63), reached
+ * through the BCM2836 per-core local controller on the Pi */
+#define BCM_IC_BASE     0x3F00B200
+#define BCM_IC_PENDING1 0x04
+#define BCM_IC_ENABLE1  0x10
+#define BCM_IC_DISABLE1 0x1C
+#define LOCAL_IRQ_SRC0  0x40000060
+#define LOCAL_IRQ_GPU   (1u << 8)
+#define LOCAL_IRQ_CNTPNS (1u << 1)
+#define LOCAL_TIMER_CTL0 0x40000040     /* core 0 timer interrupt routing */
+static uint32_t bcm_enabled[2];
+
 void irq_init(void) {
     /* Setup Vector Base Address Register */
     uintptr_t v = (uintptr_t)vectors;
     __asm__ volatile("msr vbar_el1, %0" : : "r"(v));
 
-    for (int i = 0; i < MAX_IRQ_HANDLERS; ++i) handlers[i].fn = NULL;
+    for (int i = 0; i < IRQ_NR; ++i) descs[i].handler = descs[i].thread_fn = NULL;
     
 #ifndef REAL
     /* Enable GIC CPU Interface (Group 0 and 1) */
@@ -53,11 +84,29 @@ void irq_init(void) {
         icenable[i] = 0xFFFFFFFF;
     }
 #else
-    uart_puts("[irq] GIC skipped for REAL hardware; using polling for IO.\n");
+    /* Start with every GPU interrupt masked; drivers enable theirs with
+     * irq_request(). Routing to core 0 IRQ is the reset default. */
+    volatile uint32_t *disable = (volatile uint32_t *)(BCM_IC_BASE + BCM_IC_DISABLE1);
+    disable[0] = 0xFFFFFFFF;
+    disable[1] = 0xFFFFFFFF;
+    bcm_enabled[0] = bcm_enabled[1] = 0;
+    uart_puts("[irq] GIC skipped for REAL hardware; using the BCM2835 controller.\n");
 #endif
 }
 
 void irq_unmask(int irq_num) {
+#ifdef REAL
+    if (irq_num == IRQ_CNTPNS) {
+        /* route the physical timer to core 0 IRQ */
+        *(volatile uint32_t *)LOCAL_TIMER_CTL0 |= LOCAL_IRQ_CNTPNS;
+        return;
+    }
+    if (irq_num < 0 || irq_num >= 64) return;
+    volatile uint32_t *enable = (volatile uint32_t *)(BCM_IC_BASE + BCM_IC_ENABLE1);
+    bcm_enabled[irq_num / 32] |= 1u << (irq_num % 32);
+    enable[irq_num / 32] = 1u << (irq_num % 32);
+    return;
+#endif
     /* GICD_IGROUPR: bit per IRQ. Set to 0 for Group 0 (Secure/Non-Secure depending on setup) */
     volatile uint32_t *igroupr = (volatile uint32_t *)(GICD_BASE + 0x080);
     igroupr[irq_num / 32] &= ~(1 << (irq_num % 32));
@@ -73,47 +122,171 @@ void irq_unmask(int irq_num) {
     }
 }
 
-int irq_register(int irq_num, irq_handler_fn fn, void *arg) {
-    for (int i = 0; i < MAX_IRQ_HANDLERS; ++i) {
-        if (!handlers[i].fn) {
-            handlers[i].num = irq_num;
-            handlers[i].fn = fn;
-            handlers[i].arg = arg;
-            
-            /* Unmask at GIC */
-            irq_unmask(irq_num);
-            return 0;
-        }
+void irq_mask(int irq_num) {
+#ifdef REAL
+    if (irq_num == IRQ_CNTPNS) {
+        *(volatile uint32_t *)LOCAL_TIMER_CTL0 &= ~LOCAL_IRQ_CNTPNS;
+        return;
     }
-    return -1;
+    if (irq_num < 0 || irq_num >= 64) return;
+    volatile uint32_t *disable = (volatile uint32_t *)(BCM_IC_BASE + BCM_IC_DISABLE1);
+    bcm_enabled[irq_num / 32] &= ~(1u << (irq_num % 32));
+    disable[irq_num / 32] = 1u << (irq_num % 32);
+    return;
+#endif
+    volatile uint32_t *icenable = (volatile uint32_t *)(GICD_BASE + GICD_ICENABLER);
+    icenable[irq_num / 32] = (1 << (irq_num % 32));
 }
 
+int irq_request(int irq_num, irq_handler_fn handler, irq_handler_fn thread_fn, void *arg, const char *name) {
+    if (irq_num < 0 || irq_num >= IRQ_NR || (!handler && !thread_fn)) return -1;
+    struct irq_desc *d = &descs[irq_num];
+    unsigned long flags = irq_save();
+    if (d->handler || d->thread_fn) {
+        irq_restore(flags);
+        return -1;
+    }
+    d->handler = handler;
+    d->thread_fn = thread_fn;
+    d->arg = arg;
+    d->name = name;
+    d->masked = 0;
+    irq_unmask(irq_num);
+    irq_restore(flags);
+    return 0;
+}
 
 /* Dispatch handler for a specific IRQ number */
 void irq_dispatch(int irq_num) {
-    for (int i = 0; i < MAX_IRQ_HANDLERS; ++i) {
-        if (handlers[i].fn && handlers[i].num == irq_num) {
-            handlers[i].fn(handlers[i].arg);
+    if (irq_num < 0 || irq_num >= IRQ_NR) return;
+    struct irq_desc *d = &descs[irq_num];
+    d->count++;
+    uint64_t t0 = timer_get_ticks();
+    if (d->handler) d->handler(d->arg);
+    if (d->thread_fn) {
+        /* without a top half nothing has quietened the device yet */
+        if (!d->handler) {
+            irq_mask(irq_num);
+            d->masked = 1;
         }
+        thread_pending[irq_num / 32] |= 1u << (irq_num % 32);
+        thread_gen++;
+        task_wake_event((void *)&thread_gen);
     }
+    uint64_t dt = timer_get_ticks() - t0;
+    d->ticks += dt;
+    if (dt > d->max_ticks) d->max_ticks = dt;
 }
 
-/* Simplified: check UART input and Virtio and call registered handler */
-void irq_poll_and_dispatch(void) {
-    if (uart_haschar()) {
-        irq_dispatch(1);
+static void irq_run_thread(int irq_num) {
+    struct irq_desc *d = &descs[irq_num];
+    if (!d->thread_fn) return;
+    uint64_t t0 = timer_get_ticks();
+    d->thread_fn(d->arg);
+    d->thread_ticks += timer_get_ticks() - t0;
+    d->thread_runs++;
+    if (d->masked) {
+        d->masked = 0;
+        irq_unmask(irq_num);
+    }
+}
+
+/* irqd: runs the bottom halves of the interrupts that came in, in IRQ
+ * number order. The scheduler picks it ahead of everything else. */
+static void irq_thread(void *arg) {
+    (void)arg;
+    for (;;) {
+        uint32_t seen = thread_gen;
+        int ran = 0;
+        for (int w = 0; w < IRQ_WORDS; w++) {
+            if (!thread_pending[w]) continue;
+            unsigned long flags = irq_save();
+            uint32_t bits = thread_pending[w];
+            thread_pending[w] = 0;
+            irq_restore(flags);
+            while (bits) {
+                int bit = __builtin_ctz(bits);
+                bits &= bits - 1;
+                irq_run_thread(w * 32 + bit);
+                ran = 1;
+            }
+        }
+        /* an interrupt storm must not lock out everything else */
+        if (ran) yield();
+        else task_wait_event_unless((void *)&thread_gen, &thread_gen, seen);
+    }
+}
+
+void irq_start_threads(void) {
+    if (irqd_pid > 0) return;
+    irqd_pid = task_create_with_stack(irq_thread, 0, "irqd", IRQD_STACK_KB);
+    if (irqd_pid <= 0) {
+        irqd_pid = 0;
+        uart_puts("[irq] cannot start irqd, threaded handlers will not run\n");
+        return;
     }
+    task_set_parent(irqd_pid, 0);
+    task_set_urgent(irqd_pid);
+}
+
+int irq_get_stat(int irq_num, struct irq_stat *st) {
+    if (irq_num < 0 || irq_num >= IRQ_NR) return 0;
+    struct irq_desc *d = &descs[irq_num];
+    if (!d->handler && !d->thread_fn) return 0;
+    st->name = d->name ? d->name : "-";
+    st->count = d->count;
+    st->top_us = timer_ticks_to_us(d->ticks);
+    st->top_max_us = timer_ticks_to_us(d->max_ticks);
+    st->threaded = d->thread_fn != NULL;
+    st->thread_runs = d->thread_runs;
+    st->thread_us = timer_ticks_to_us(d->thread_ticks);
+    return 1;
+}
+
+/* Poll the input devices that have no interrupt wired up yet. The UART
+ * has its own handler (uart_start). */
+void irq_poll_and_dispatch(void) {
 #ifdef REAL
+    /* USB HID is interrupt driven (usb.c), nothing to poll for it here */
     rpi_input_poll();
-    extern void usb_poll(void);
-    usb_poll();
 #else
     virtio_input_poll();
 #endif
 }
 
+#ifdef REAL
+/* Dispatch every enabled GPU interrupt that is pending; returns how many */
+static int bcm_dispatch_pending(void) {
+    volatile uint32_t *pending = (volatile uint32_t *)(BCM_IC_BASE + BCM_IC_PENDING1);
+    int n = 0;
+    for (int bank = 0; bank < 2; bank++) {
+        uint32_t p = pending[bank] & bcm_enabled[bank];
+        while (p) {
+            int bit = __builtin_ctz(p);
+            p &= p - 1;
+            irq_dispatch(bank * 32 + bit);
+            n++;
+        }
+    }
+    return n;
+}
+#endif
+
 /* Called from assembly IRQ entry. */
 void irq_entry_c(void) {
+#ifdef REAL
+    uint32_t src = *(volatile uint32_t *)LOCAL_IRQ_SRC0;
+    int taken = 0;
+    if (src & LOCAL_IRQ_CNTPNS) {
+        irq_dispatch(IRQ_CNTPNS);
+        taken = 1;
+    }
+    if ((src & LOCAL_IRQ_GPU) && bcm_dispatch_pending()) taken = 1;
+    if (taken) {
+        scheduler_request_preempt();
+        return;
+    }
+#endif
     volatile uint32_t *gicc_iar = (volatile uint32_t *)(GICC_BASE + GICC_IAR);
     volatile uint32_t *gicc_eoir = (volatile uint32_t *)(GICC_BASE + GICC_EOIR);
     
@@ -13,17 +13,51 @@ struct pt_regs {
     uint64_t spsr;     /* saved program status */
 };
 
+/* EL1 physical timer (CNTP). A per-CPU PPI on the GIC; on the Pi it is
+ * a source of the BCM2836 local controller, numbered after the 64 GPU
+ * interrupts. */
+#ifdef REAL
+#define IRQ_LOCAL_BASE 64
+#define IRQ_CNTPNS     (IRQ_LOCAL_BASE + 1)
+#define IRQ_NR         96       /* 64 GPU + 32 local sources */
+#else
+#define IRQ_CNTPNS     30
+#define IRQ_NR         1020     /* every GIC interrupt ID; 1020+ are special */
+#endif
+
 void irq_init(void);
-int irq_register(int irq_num, irq_handler_fn fn, void *arg);
+/* Install the handlers for irq_num and unmask it; -1 if it is taken.
+ * handler (the top half) runs in IRQ context with interrupts masked and
+ * should only quieten the device and grab what cannot wait. thread_fn,
+ * if given, runs afterwards in irqd, a task the scheduler runs ahead of
+ * all others, with interrupts on; it may sleep. With no top half the
+ * line stays masked until thread_fn has run. */
+int irq_request(int irq_num, irq_handler_fn handler, irq_handler_fn thread_fn, void *arg, const char *name);
+void irq_mask(int irq_num);
+void irq_unmask(int irq_num);
+/* Start irqd; needs the scheduler. Bottom halves wait until then. */
+void irq_start_threads(void);
 /* poll for pending interrupts and dispatch handlers (called from scheduler loop) */
 void irq_poll_and_dispatch(void);
 /* dispatch a specific interrupt */
 void irq_dispatch(int irq_num);
 
-/* entry called from assembly IRQ vector */
 /* entry called from assembly IRQ vector */
 void irq_entry_c(void);
 
+struct irq_stat {
+    const char *name;
+    uint32_t count;             /* interrupts taken */
+    uint64_t top_us;            /* total time in the top half */
+    uint64_t top_max_us;
+    int threaded;
+    uint32_t thread_runs;
+    uint64_t thread_us;         /* total time in the bottom half */
+};
+
+/* Counters for irq_num; 0 if nothing is installed there */
+int irq_get_stat(int irq_num, struct irq_stat *st);
+
 static inline unsigned long irq_save(void) {
     unsigned long flags;
     __asm__ volatile(
@@ -0,0 +1,125 @@
+#include "kconsole.h"
+#include "uart.h"
+#include "virtio_console.h"
+#include "pty.h"
+#include "sched.h"
+#include "kmalloc.h"
+#include "klog.h"
+#include "lib.h"
+
+#define TTY_CHUNK      256
+#define TTY_IDLE_MS    2
+
+static volatile int use_virtio = 0;
+
+void kconsole_init(void) {
+    use_virtio = virtio_console_present();
+    if (use_virtio) KLOG(KLOG_CORE, KLOG_INFO, "console on virtio-console");
+}
+
+int kconsole_select(int dev) {
+    if (dev == KCONSOLE_VIRTIO && !virtio_console_present()) return -1;
+    use_virtio = (dev == KCONSOLE_VIRTIO);
+    return 0;
+}
+
+static int vport(void) {
+    return use_virtio ? virtio_console_console_port() : -1;
+}
+
+int kconsole_device(void) {
+    return vport() >= 0 ? KCONSOLE_VIRTIO : KCONSOLE_UART;
+}
+
+size_t kconsole_write(const char *buf, size_t n) {
+    int p = vport();
+    return p >= 0 ? virtio_console_write(p, buf, n) : uart_write(buf, n);
+}
+
+void kconsole_puts(const char *s) {
+    char chunk[128];
+    size_t n = 0;
+    while (*s) {
+        if (*s == '\n') chunk[n++] = '\r';
+        chunk[n++] = *s++;
+        if (n >= sizeof(chunk) - 1) { kconsole_write(chunk, n); n = 0; }
+    }
+    if (n) kconsole_write(chunk, n);
+}
+
+size_t kconsole_room(void) {
+    int p = vport();
+    return p >= 0 ? virtio_console_tx_room(p) : uart_tx_room();
+}
+
+char kconsole_getc(void) {
+    int p = vport();
+    return p >= 0 ? virtio_console_getc(p) : uart_getc();
+}
+
+/* ---- shell on a port ---- */
+
+struct port_tty {
+    int port;
+    struct pty *pty;
+    int shell_pid;
+};
+
+/* Moves bytes between the port and the shell's pty until the shell exits.
+ * Shell output wakes an idle bridge at once; port input has no poll source
+ * yet, so it is picked up within TTY_IDLE_MS. */
+static void port_tty_task(void *arg) {
+    struct port_tty *t = (struct port_tty *)arg;
+    char buf[TTY_CHUNK];
+    while (task_exists(t->shell_pid)) {
+        size_t in = virtio_console_read(t->port, buf, sizeof(buf));
+        pty_write_in_buf(t->pty, buf, in);
+
+        size_t out = 0;
+        if (virtio_console_tx_room(t->port) >= sizeof(buf)) {
+            const char *seg;
+            size_t n = pty_peek_out(t->pty, &seg), used = 0;
+            while (used < n && out < sizeof(buf) - 1) {
+                if (seg[used] == '\n') buf[out++] = '\r';
+                buf[out++] = seg[used++];
+            }
+            pty_consume_out(t->pty, used);
+            if (out) virtio_console_write(t->port, buf, out);
+        }
+
+        if (in || out) yield();
+        else {
+            struct poll_item it = { pty_term_waitable(t->pty), POLLIN, 0 };
+            poll(&it, 1, TTY_IDLE_MS);
+        }
+    }
+    pty_free(t->pty);
+    kfree(t);
+    task_set_fn_null(task_current_id());
+}
+
+extern void shell_main(void *arg);
+
+int kconsole_start_shell(int port) {
+    struct vcon_port_info info;
+    if (!virtio_console_port_info(port, &info)) return -1;
+    struct port_tty *t = kmalloc(sizeof(*t));
+    if (!t) return -1;
+    t->port = port;
+    t->pty = pty_alloc();
+    if (!t->pty) { kfree(t); return -1; }
+    t->shell_pid = task_create(shell_main, t->pty, "vcon_shell");
+    if (t->shell_pid <= 0) { pty_free(t->pty); kfree(t); return -1; }
+    task_set_tty(t->shell_pid, t->pty);
+    int bridge = task_create(port_tty_task, t, "vcon_tty");
+    if (bridge <= 0) {
+        task_kill(t->shell_pid);
+        /* the shell still holds the pty: leak it rather than free it under the shell */
+        kfree(t);
+        return -1;
+    }
+    /* like the GUI terminal: outlive the shell that ran the command */
+    task_set_parent(t->shell_pid, 1);
+    task_set_parent(bridge, 1);
+    return t->shell_pid;
+}
@@ -0,0 +1,31 @@
+#ifndef KCONSOLE_H
+#define KCONSOLE_H
+
+#include <stddef.h>
+
+/* The system console: kernel log output, SYS_PUTS/SYS_GETC of tasks
+ * without a tty, and the serial shell. It is the virtio-console port the
+ * device marks as console when QEMU provides one, the PL011 otherwise or
+ * when selected. Panic output always goes to the PL011. */
+
+#define KCONSOLE_UART   0
+#define KCONSOLE_VIRTIO 1
+
+/* After uart_start() and virtio_console_init() */
+void kconsole_init(void);
+/* -1 if the device is not there */
+int kconsole_select(int dev);
+/* Device in use right now (virtio falls back to the UART until its console port shows up) */
+int kconsole_device(void);
+
+size_t kconsole_write(const char *buf, size_t n);
+/* Newlines become CRLF */
+void kconsole_puts(const char *s);
+/* Bytes kconsole_write() takes without dropping */
+size_t kconsole_room(void);
+char kconsole_getc(void);
+
+/* Run a shell on a virtio-console port through a pty; returns its task id or -1 */
+int kconsole_start_shell(int port);
+
+#endif
@@ -7,42 +7,53 @@
 #include "mmu.h"
 #include "irq.h"
 #include "timer.h"
+#include "hrtimer.h"
 #include "virtio.h"
 #include "sched.h"
+#include "etask.h"
+#include "klog.h"
+#include "kconsole.h"
+#include "virtio_console.h"
 #include "ramfs.h"
 #include "init.h"
 #include "syscall.h"
+#include "dma_blit.h"
+#include "simd.h"
+#include "pixel.h"
 #include <stdint.h>
 
 
 int screen_w = 1024, screen_h = 768; // to be externed to sched.c
 
-void heartbeat_task(void *arg);
+/* Blinks the activity LED: on for a second, off for half a second */
+static struct etask heartbeat;
 
-void heartbeat_task(void *arg) {
-    (void)arg;
-    
-    extern void fb_put_text(const char *s, int x, int y, uint32_t color);
-    extern void rpi_gpu_flush(void);
-    fb_put_text("HEARTBEAT TASK STARTED!", 10, 500, 0xFF00FF00); // GREEN
+static int heartbeat_fn(struct etask *t) {
+    if (t->runs == 1) {
+        extern void fb_put_text(const char *s, int x, int y, uint32_t color);
+        extern void rpi_gpu_flush(void);
+        fb_put_text("HEARTBEAT TASK STARTED!", 10, 500, 0xFF00FF00); // GREEN
 #ifdef REAL
-    rpi_gpu_flush();
+        rpi_gpu_flush();
 #endif
-
 #ifdef DEBUG
-    uart_puts("[heartbeat] task started\n");
+        uart_puts("[heartbeat] task started\n");
 #endif
-    while (1) {
+    }
+    if (t->state == 0) {
 #ifdef REAL
         rpi_gpio16_on();
 #endif
-        task_block_current_until(scheduler_get_tick() + 500);
-        task_block_current_until(scheduler_get_tick() + 500);
+        t->state = 1;
+        etask_sleep_until(t, scheduler_get_tick() + 1000);
+    } else {
 #ifdef REAL
         rpi_gpio16_off();
 #endif
-        task_block_current_until(scheduler_get_tick() + 500);
+        t->state = 0;
+        etask_sleep_until(t, scheduler_get_tick() + 500);
     }
+    return ETASK_WAIT;
 }
 
 extern char __end[];
@@ -114,6 +125,13 @@ void kernel_main(void) {
     uart_flush();
     mmu_init();
     uart_flush();
+#ifdef REAL
+    /* scanout goes write-combined: flushes skip the D-cache clean */
+    if (rpi_gpu_set_cached(0) < 0) uart_puts("[kernel] scanout stays cacheable\n");
+#endif
+    /* NEON pixel paths: FP access on, and their stores need Normal memory */
+    simd_init();
+    pix_set_simd(1);
     // If we survive this, we change color again
     fb_fill(0xFFFFFF00); // Progress: YELLOW
     fb_put_text_centered("MMU ENABLED (IDENTITY)", 0xFF000000);
@@ -130,6 +148,15 @@ void kernel_main(void) {
     
     uart_puts("[kernel] timer_init... ");
     timer_init();
+    hrtimers_init();
+#ifdef REAL
+    /* needs palloc and the peripheral mapping */
+    dma_blit_init();
+#ifdef RPI_FB_RGB565
+    /* the ARGB shadow buffer needs kmalloc, so switch only now */
+    if (rpi_gpu_set_depth(16) < 0) uart_puts("[kernel] RGB565 mode unavailable, staying at 32 bpp\n");
+#endif
+#endif
     fb_fill(0xFFFF00FF); // Progress: MAGENTA
     fb_put_text_centered("TIMER ENABLED", 0xFFFFFFFF);
     virtio_gpu_flush();
@@ -142,6 +169,22 @@ void kernel_main(void) {
 #ifdef DEBUG
     uart_puts("done.\n");
 #endif
+    /* Threaded interrupt handlers run in a task */
+    irq_start_threads();
+    /* Console output of the kernel log; records taken before this are kept */
+    klog_start();
+    /* Serial I/O from here on is interrupt driven */
+    uart_start();
+#ifndef REAL
+    /* A virtio-console, when QEMU has one, becomes the system console */
+    virtio_console_init();
+#endif
+    kconsole_init();
+#ifdef REAL
+    /* USB transfers complete from IRQs; needs the handler table and tasks */
+    extern void usb_start(void);
+    usb_start();
+#endif
 
     /* Initialize Syscalls */
 #ifdef DEBUG
@@ -155,7 +198,7 @@ void kernel_main(void) {
 
     /* 4. Services and Tasks */
     ramfs_init();
-    task_create(heartbeat_task, NULL, "heartbeat");
+    etask_start(&heartbeat, heartbeat_fn, NULL, "heartbeat");
     task_create(init_main, NULL, "init");
 
     fb_fill(0x00000000); // BLACK - Launching system
@@ -0,0 +1,339 @@
+#include "klog.h"
+#include "irq.h"
+#include "sched.h"
+#include "timer.h"
+#include "uart.h"
+#include "kconsole.h"
+#include "lib.h"
+#include <stdarg.h>
+
+#define LOAD_ACQ(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE_REL(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+#define KLOG_MASK        (KLOG_RECORDS - 1)
+#define KLOG_LINE_MAX    192
+#define KLOGD_PERIOD_MS  20
+#define KLOGD_BATCH      16     /* records between yields */
+
+/* 128 bytes. seq is the record's ring position + 1 once it is complete,
+ * 0 while a writer is filling it. */
+struct klog_rec {
+    volatile uint32_t seq;
+    uint8_t level;
+    uint8_t sub;
+    uint8_t nargs;
+    uint8_t pad;
+    uint64_t ts;
+    const char *fmt;
+    uint64_t arg[KLOG_MAX_ARGS];
+    char str[KLOG_STR_BYTES];
+};
+
+static struct klog_rec ring[KLOG_RECORDS];
+static volatile uint32_t head = 0;          /* next position to reserve */
+static volatile uint32_t clear_seq = 0;     /* dmesg -c: reads start here */
+static uint32_t console_seq = 0;            /* next position klogd shows */
+static uint32_t console_lost = 0;
+
+#ifdef DEBUG
+#define KLOG_DEFAULT_LEVEL   KLOG_DEBUG
+#define KLOG_DEFAULT_CONSOLE KLOG_DEBUG
+#else
+#define KLOG_DEFAULT_LEVEL   KLOG_INFO
+#define KLOG_DEFAULT_CONSOLE KLOG_WARN
+#endif
+
+volatile uint8_t klog_level[KLOG_NSUBS] = {
+    KLOG_DEFAULT_LEVEL, KLOG_DEFAULT_LEVEL, KLOG_DEFAULT_LEVEL, KLOG_DEFAULT_LEVEL,
+    KLOG_DEFAULT_LEVEL, KLOG_DEFAULT_LEVEL, KLOG_DEFAULT_LEVEL, KLOG_DEFAULT_LEVEL,
+    KLOG_DEFAULT_LEVEL, KLOG_DEFAULT_LEVEL
+};
+static volatile int console_level = KLOG_DEFAULT_CONSOLE;
+
+static const char *sub_names[KLOG_NSUBS] = {
+    "core", "sched", "mm", "fs", "shell", "irq", "usb", "virtio", "wm", "svc"
+};
+static const char *level_names[4] = { "err", "warn", "info", "debug" };
+
+/* ---- writer ---- */
+
+/* Reserving a position is the only shared step. The kernel runs on one
+ * core, so masking IRQs around the increment makes it atomic without
+ * exclusives (which do not work on the Pi until the MMU is on). */
+static uint32_t reserve(void) {
+    unsigned long flags = irq_save();
+    uint32_t pos = head++;
+    irq_restore(flags);
+    return pos;
+}
+
+void klog_write(int sub, int level, const char *fmt, ...) {
+    if (sub < 0 || sub >= KLOG_NSUBS || !fmt) return;
+    uint32_t pos = reserve();
+    struct klog_rec *r = &ring[pos & KLOG_MASK];
+    STORE_REL(&r->seq, 0);
+    r->level = (uint8_t)level;
+    r->sub = (uint8_t)sub;
+    r->ts = timer_get_ticks();
+    r->fmt = fmt;
+
+    va_list ap;
+    va_start(ap, fmt);
+    int n = 0;
+    size_t soff = 0;
+    for (const char *p = fmt; *p && n < KLOG_MAX_ARGS; p++) {
+        if (*p != '%') continue;
+        p++;
+        if (*p == '%') continue;
+        while (*p >= '0' && *p <= '9') p++;
+        int lng = 0;
+        while (*p == 'l') { lng++; p++; }
+        if (*p == 'z') { lng = 2; p++; }
+        switch (*p) {
+        case 'd': case 'i':
+            r->arg[n++] = lng ? (uint64_t)va_arg(ap, long long) : (uint64_t)(int64_t)va_arg(ap, int);
+            break;
+        case 'u': case 'x': case 'X':
+            r->arg[n++] = lng ? (uint64_t)va_arg(ap, unsigned long long) : (uint64_t)va_arg(ap, unsigned int);
+            break;
+        case 'c':
+            r->arg[n++] = (uint64_t)va_arg(ap, int);
+            break;
+        case 'p':
+            r->arg[n++] = (uint64_t)(uintptr_t)va_arg(ap, void *);
+            break;
+        case 's': {
+            const char *s = va_arg(ap, const char *);
+            if (!s) s = "(null)";
+            r->arg[n++] = soff;
+            if (soff < KLOG_STR_BYTES) {
+                while (*s && soff < KLOG_STR_BYTES - 1) r->str[soff++] = *s++;
+                r->str[soff++] = '\0';
+            }
+            break;
+        }
+        default:
+            p--;    /* unknown or truncated spec: printed literally */
+            break;
+        }
+    }
+    va_end(ap);
+    r->nargs = (uint8_t)n;
+    STORE_REL(&r->seq, pos + 1);
+}
+
+/* ---- rendering ---- */
+
+struct line {
+    char *buf;
+    size_t cap;
+    size_t len;
+};
+
+static void put_c(struct line *l, char c) {
+    if (l->len + 1 < l->cap) l->buf[l->len++] = c;
+}
+
+static void put_s(struct line *l, const char *s) {
+    while (*s) put_c(l, *s++);
+}
+
+static void put_num(struct line *l, uint64_t v, int base, int upper, int neg, int width, int zero) {
+    char tmp[24];
+    const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    int i = 0;
+    do { tmp[i++] = digits[v % (unsigned)base]; v /= (unsigned)base; } while (v);
+    int len = i + (neg ? 1 : 0);
+    if (neg && zero) put_c(l, '-');
+    for (; width > len; width--) put_c(l, zero ? '0' : ' ');
+    if (neg && !zero) put_c(l, '-');
+    while (i > 0) put_c(l, tmp[--i]);
+}
+
+static void render_text(struct line *l, const struct klog_rec *r) {
+    int n = 0;
+    for (const char *p = r->fmt; *p; p++) {
+        if (*p != '%') { put_c(l, *p); continue; }
+        const char *spec = p++;
+        if (*p == '%') { put_c(l, '%'); continue; }
+        int zero = 0, width = 0;
+        if (*p == '0') { zero = 1; p++; }
+        while (*p >= '0' && *p <= '9') width = width * 10 + (*p++ - '0');
+        int lng = 0;
+        while (*p == 'l') { lng++; p++; }
+        if (*p == 'z') { lng = 2; p++; }
+        if (!*p) { put_s(l, spec); break; }
+        if (!strchr("diuxXcps", *p) || n >= r->nargs) {
+            while (spec <= p) put_c(l, *spec++);
+            continue;
+        }
+        uint64_t v = r->arg[n++];
+        switch (*p) {
+        case 'd': case 'i': {
+            int64_t sv = lng ? (int64_t)v : (int64_t)(int32_t)v;
+            put_num(l, sv < 0 ? (uint64_t)-sv : (uint64_t)sv, 10, 0, sv < 0, width, zero);
+            break;
+        }
+        case 'u': put_num(l, v, 10, 0, 0, width, zero); break;
+        case 'x': put_num(l, v, 16, 0, 0, width, zero); break;
+        case 'X': put_num(l, v, 16, 1, 0, width, zero); break;
+        case 'p': put_s(l, "0x"); put_num(l, v, 16, 0, 0, width, zero); break;
+        case 'c': put_c(l, (char)v); break;
+        case 's': {
+            const char *s = v < KLOG_STR_BYTES ? r->str + v : "";
+            int len = (int)strlen(s);
+            for (; width > len; width--) put_c(l, ' ');
+            put_s(l, s);
+            break;
+        }
+        }
+    }
+}
+
+static size_t render(const struct klog_rec *r, char *buf, size_t cap) {
+    struct line l = { buf, cap, 0 };
+    if (cap == 0) return 0;
+    uint64_t us = timer_ticks_to_us(r->ts);
+    put_c(&l, '[');
+    put_num(&l, us / 1000000, 10, 0, 0, 5, 0);
+    put_c(&l, '.');
+    put_num(&l, us % 1000000, 10, 0, 0, 6, 1);
+    put_s(&l, "] ");
+    put_s(&l, klog_sub_name(r->sub));
+    put_s(&l, r->level == KLOG_ERR ? ": error: " : r->level == KLOG_WARN ? ": warning: " : ": ");
+    render_text(&l, r);
+    if (l.len == 0 || l.buf[l.len - 1] != '\n') {
+        if (l.len + 1 >= l.cap && l.len) l.len--;     /* truncated: keep the newline */
+        put_c(&l, '\n');
+    }
+    l.buf[l.len] = '\0';
+    return l.len;
+}
+
+/* ---- readers ---- */
+
+/* Copy out the record at pos. 1: copied; 0: overwritten, skip it;
+ * -1: not written yet (or still being written). */
+static int snapshot(uint32_t pos, struct klog_rec *out) {
+    const struct klog_rec *r = &ring[pos & KLOG_MASK];
+    uint32_t s = LOAD_ACQ(&r->seq);
+    if (s != pos + 1) return (int32_t)(s - (pos + 1)) > 0 ? 0 : -1;
+    memcpy(out, (const void *)r, sizeof(*out));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return LOAD_ACQ(&r->seq) == pos + 1 ? 1 : 0;
+}
+
+/* Oldest position still in the ring, no earlier than `from` */
+static uint32_t oldest(uint32_t from, uint32_t h) {
+    uint32_t first = h - KLOG_RECORDS;
+    if (h < KLOG_RECORDS) first = 0;
+    return (int32_t)(from - first) < 0 ? first : from;
+}
+
+size_t klog_read(uint32_t *seq, char *buf, size_t cap) {
+    struct klog_rec rec;
+    uint32_t h = LOAD_ACQ(&head);
+    uint32_t from = *seq;
+    if ((int32_t)(clear_seq - from) > 0) from = clear_seq;
+    for (uint32_t pos = oldest(from, h); pos != h; pos++) {
+        int got = snapshot(pos, &rec);
+        if (got < 0) { *seq = pos; return 0; }
+        if (got == 0) continue;
+        *seq = pos + 1;
+        return render(&rec, buf, cap);
+    }
+    *seq = h;
+    return 0;
+}
+
+void klog_clear(void) {
+    clear_seq = LOAD_ACQ(&head);
+}
+
+uint32_t klog_total(void) {
+    return LOAD_ACQ(&head);
+}
+
+uint32_t klog_console_lost(void) {
+    return console_lost;
+}
+
+/* ---- console ---- */
+
+/* Show up to `max` pending records at or below `level`; returns how many
+ * positions were consumed. A record still being written stops the drain,
+ * unless `force` (panic: its writer will never finish, and the output
+ * goes straight to the PL011). So does a line the console has no room
+ * for; it is retried on the next pass. */
+static int console_drain(int max, int level, int force) {
+    struct klog_rec rec;
+    char line[KLOG_LINE_MAX];
+    uint32_t h = LOAD_ACQ(&head);
+    uint32_t pos = oldest(console_seq, h);
+    console_lost += pos - console_seq;
+    int done = 0;
+    for (; pos != h && done < max; pos++, done++) {
+        int got = snapshot(pos, &rec);
+        if (got < 0 && !force) break;
+        if (got <= 0) { console_lost++; continue; }
+        if (rec.level > level) continue;
+        size_t len = render(&rec, line, sizeof(line));
+        size_t need = len;
+        for (size_t i = 0; i < len; i++) if (line[i] == '\n') need++;   /* CRLF */
+        if (force) {
+            _uart_puts(line);
+            continue;
+        }
+        if (kconsole_room() < need) break;
+        kconsole_puts(line);
+    }
+    console_seq = pos;
+    return done;
+}
+
+void klog_flush_console(void) {
+    while (console_drain(KLOG_RECORDS, KLOG_DEBUG, 1) > 0) { }
+}
+
+static void klogd_task(void *arg) {
+    (void)arg;
+    for (;;) {
+        while (console_drain(KLOGD_BATCH, console_level, 0) == KLOGD_BATCH) yield();
+        task_block_current_until(scheduler_get_tick() + KLOGD_PERIOD_MS);
+    }
+}
+
+void klog_start(void) {
+    task_create(klogd_task, NULL, "klogd");
+}
+
+void klog_set_console_level(int level) {
+    if (level >= KLOG_ERR && level <= KLOG_DEBUG) console_level = level;
+}
+
+int klog_get_console_level(void) {
+    return console_level;
+}
+
+/* ---- names ---- */
+
+int klog_sub_by_name(const char *name) {
+    for (int i = 0; i < KLOG_NSUBS; i++)
+        if (strcmp(name, sub_names[i]) == 0) return i;
+    return -1;
+}
+
+const char *klog_sub_name(int sub) {
+    return (sub >= 0 && sub < KLOG_NSUBS) ? sub_names[sub] : "?";
+}
+
+int klog_level_by_name(const char *name) {
+    for (int i = 0; i < 4; i++)
+        if (strcmp(name, level_names[i]) == 0) return i;
+    if (name[0] >= '0' && name[0] <= '3' && !name[1]) return name[0] - '0';
+    return -1;
+}
+
+const char *klog_level_name(int level) {
+    return (level >= 0 && level < 4) ? level_names[level] : "?";
+}
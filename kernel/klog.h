@@ -0,0 +1,82 @@
+#ifndef KLOG_H
+#define KLOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Kernel log ring (printk-style).
+ *
+ * KLOG() stores a record (level, subsystem, timer stamp, format pointer
+ * and the raw arguments) in a fixed ring and returns; nothing is formatted
+ * and no UART byte is written on the caller's path. The "klogd" task
+ * renders new records to the console later, panic() renders whatever is
+ * left, and `dmesg` renders the whole ring on demand.
+ *
+ * The format must be a string literal (only its pointer is kept).
+ * Supported conversions: %d %i %u %x %X %p %c %s %%, with an optional
+ * '0' flag, width and l/ll/z length. %s arguments are copied into the
+ * record, up to KLOG_STR_BYTES in total, so they may point at temporary
+ * buffers.
+ *
+ * Records above a subsystem's level are rejected inline by KLOG() with a
+ * load and a compare. Writers never wait for readers: the ring keeps the
+ * newest KLOG_RECORDS and overwrites the oldest. Safe from tasks and IRQ
+ * handlers. */
+
+#define KLOG_ERR   0
+#define KLOG_WARN  1
+#define KLOG_INFO  2
+#define KLOG_DEBUG 3
+
+#define KLOG_CORE   0
+#define KLOG_SCHED  1
+#define KLOG_MM     2
+#define KLOG_FS     3
+#define KLOG_SHELL  4
+#define KLOG_IRQ    5
+#define KLOG_USB    6
+#define KLOG_VIRTIO 7
+#define KLOG_WM     8
+#define KLOG_SVC    9
+#define KLOG_NSUBS  10
+
+#define KLOG_RECORDS   512      /* power of two */
+#define KLOG_MAX_ARGS  6
+#define KLOG_STR_BYTES 56
+
+/* Per-subsystem record threshold; records with level > klog_level[sub] are dropped */
+extern volatile uint8_t klog_level[KLOG_NSUBS];
+
+#define KLOG(sub, lvl, ...) do { \
+    if ((lvl) <= klog_level[(sub)]) klog_write((sub), (lvl), __VA_ARGS__); \
+} while (0)
+
+void klog_write(int sub, int level, const char *fmt, ...);
+
+/* Start the console drainer task (after scheduler_init) */
+void klog_start(void);
+/* Render every record the console has not shown yet, synchronously (panic) */
+void klog_flush_console(void);
+
+/* Records with level <= this are echoed to the console by klogd */
+void klog_set_console_level(int level);
+int klog_get_console_level(void);
+
+/* Name lookups for dmesg; -1 / "?" when unknown */
+int klog_sub_by_name(const char *name);
+const char *klog_sub_name(int sub);
+int klog_level_by_name(const char *name);
+const char *klog_level_name(int level);
+
+/* Iterate the ring: *seq starts at 0 and is advanced past each record
+ * returned. Renders one record as "[  secs.usecs] sub: text\n" into buf;
+ * returns its length, or 0 when there are no more records. Records that
+ * were overwritten while iterating are skipped. */
+size_t klog_read(uint32_t *seq, char *buf, size_t cap);
+/* Forget everything currently in the ring (dmesg -c) */
+void klog_clear(void);
+/* Records written since boot, and how many were overwritten unread by the console */
+uint32_t klog_total(void);
+uint32_t klog_console_lost(void);
+
+#endif
@@ -0,0 +1,103 @@
+#include "latency.h"
+#include "timer.h"
+#include "lib.h"
+#include <string.h>
+
+struct lat_hist {
+    uint32_t count;
+    uint32_t max_us;
+    uint32_t bucket[LAT_BUCKETS];
+};
+
+static struct lat_hist hist[LAT_NSTAGES];
+
+static const char *stage_names[LAT_NSTAGES] = {
+    "key queue", "key window", "key render", "mouse queue",
+    "flush", "key total", "mouse total"
+};
+
+/* Oldest input the frame being composed will show, 0 when none */
+static uint64_t frame_key = 0;
+static uint64_t frame_mouse = 0;
+
+static int lat_bucket(uint32_t us) {
+    if (us < 8) return (int)us;
+    int e = 31 - __builtin_clz(us);
+    int b = 8 + (e - 3) * 4 + (int)((us >> (e - 2)) & 3);
+    return b < LAT_BUCKETS ? b : LAT_BUCKETS - 1;
+}
+
+static uint32_t lat_bucket_hi(int b) {
+    if (b < 8) return (uint32_t)b;
+    int e = (b - 8) / 4 + 3, s = (b - 8) % 4;
+    return ((uint32_t)(5 + s) << (e - 2)) - 1;
+}
+
+void lat_record(int stage, uint64_t ticks) {
+    if (stage < 0 || stage >= LAT_NSTAGES) return;
+    uint64_t us64 = timer_ticks_to_us(ticks);
+    uint32_t us = us64 > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)us64;
+    struct lat_hist *h = &hist[stage];
+    h->count++;
+    if (us > h->max_us) h->max_us = us;
+    h->bucket[lat_bucket(us)]++;
+}
+
+void lat_frame_key(uint64_t stamp) {
+    if (stamp && (!frame_key || stamp < frame_key)) frame_key = stamp;
+}
+
+void lat_frame_mouse(uint64_t stamp) {
+    if (stamp && (!frame_mouse || stamp < frame_mouse)) frame_mouse = stamp;
+}
+
+uint64_t lat_flush_begin(void) {
+    return timer_get_ticks();
+}
+
+void lat_flush_end(uint64_t t0) {
+    if (!frame_key && !frame_mouse) return;
+    uint64_t now = timer_get_ticks();
+    lat_record(LAT_FLUSH, now - t0);
+    if (frame_key) lat_record(LAT_KEY_TOTAL, now - frame_key);
+    if (frame_mouse) lat_record(LAT_MOUSE_TOTAL, now - frame_mouse);
+    frame_key = frame_mouse = 0;
+}
+
+void lat_frame_discard(void) {
+    frame_mouse = 0;
+}
+
+void lat_reset(void) {
+    memset(hist, 0, sizeof(hist));
+    frame_key = frame_mouse = 0;
+}
+
+const char *lat_stage_name(int stage) {
+    return (stage >= 0 && stage < LAT_NSTAGES) ? stage_names[stage] : "?";
+}
+
+uint32_t lat_count(int stage) {
+    return (stage >= 0 && stage < LAT_NSTAGES) ? hist[stage].count : 0;
+}
+
+uint32_t lat_percentile_us(int stage, int pct) {
+    if (stage < 0 || stage >= LAT_NSTAGES || !hist[stage].count) return 0;
+    const struct lat_hist *h = &hist[stage];
+    /* rank of the sample at pct, 1-based, rounded up */
+    uint32_t rank = (uint32_t)(((uint64_t)h->count * (uint32_t)pct + 99) / 100);
+    if (rank == 0) rank = 1;
+    uint32_t seen = 0;
+    for (int b = 0; b < LAT_BUCKETS; b++) {
+        seen += h->bucket[b];
+        if (seen >= rank) {
+            uint32_t hi = lat_bucket_hi(b);
+            return hi < h->max_us ? hi : h->max_us;
+        }
+    }
+    return h->max_us;
+}
+
+uint32_t lat_max_us(int stage) {
+    return (stage >= 0 && stage < LAT_NSTAGES) ? hist[stage].max_us : 0;
+}
@@ -0,0 +1,52 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+
+/* Input-to-pixel latency histograms.
+ *
+ * input_push_event() stamps every event with the generic-timer count when
+ * it arrives. The stamp travels with the event:
+ *   - the wm pops it from the input queue and copies it into the focused
+ *     window's queue;
+ *   - the app pops it from there;
+ *   - the next render of that window hands it to the frame;
+ *   - the flush that puts the frame on screen closes the sample.
+ * Mouse motion goes straight from the wm into the cursor flush.
+ * Events that share a frame produce one total sample, timed from the
+ * oldest of them.
+ *
+ * All recording happens in task context (wm and app tasks), which never
+ * preempt each other, so nothing here locks. */
+
+#define LAT_KEY_QUEUE    0  /* arrival -> wm pops it from the input queue */
+#define LAT_KEY_WINDOW   1  /* wm -> app pops it from the window queue */
+#define LAT_KEY_RENDER   2  /* app pop -> window rendered */
+#define LAT_MOUSE_QUEUE  3  /* arrival -> wm pops it */
+#define LAT_FLUSH        4  /* flush of a frame that carries input */
+#define LAT_KEY_TOTAL    5  /* key arrival -> flush complete */
+#define LAT_MOUSE_TOTAL  6  /* mouse arrival -> flush complete */
+#define LAT_NSTAGES      7
+
+/* Log-linear buckets: exact below 8 us, then 4 per power of two (~25%) */
+#define LAT_BUCKETS 96
+
+void lat_record(int stage, uint64_t ticks);
+/* A rendered window consumed key input that arrived at `stamp` */
+void lat_frame_key(uint64_t stamp);
+/* The wm consumed mouse input that arrived at `stamp` */
+void lat_frame_mouse(uint64_t stamp);
+/* Around the framebuffer flush that ends a compose */
+uint64_t lat_flush_begin(void);
+void lat_flush_end(uint64_t t0);
+/* A compose that ended without a flush: its mouse input showed nothing */
+void lat_frame_discard(void);
+
+void lat_reset(void);
+const char *lat_stage_name(int stage);
+uint32_t lat_count(int stage);
+/* Upper bound, in us, of the bucket holding the pct-th percentile */
+uint32_t lat_percentile_us(int stage, int pct);
+uint32_t lat_max_us(int stage);
+
+#endif
@@ -139,6 +139,34 @@ int atoi(const char *s) {
     while (*s >= '0' && *s <= '9') { v = v * 10 + (*s - '0'); ++s; }
     return v * sign;
 }
+
+void fmt_dec(char *buf, int v) {
+    char tmp[12];
+    unsigned int u = v < 0 ? 0u - (unsigned int)v : (unsigned int)v;
+    int i = 0, j = 0;
+    do { tmp[i++] = (char)('0' + u % 10); u /= 10; } while (u);
+    if (v < 0) buf[j++] = '-';
+    while (i > 0) buf[j++] = tmp[--i];
+    buf[j] = '\0';
+}
+
+void out_puts(char *out, size_t out_cap, size_t *off, const char *s) {
+    size_t l = strlen(s);
+    if (*off + l >= out_cap) l = out_cap > *off + 1 ? out_cap - *off - 1 : 0;
+    memcpy(out + *off, s, l);
+    *off += l;
+}
+
+void out_putd(char *out, size_t out_cap, size_t *off, int v) {
+    char num[12];
+    fmt_dec(num, v);
+    out_puts(out, out_cap, off, num);
+}
+
+void out_putpad(char *out, size_t out_cap, size_t *off, const char *s, int width) {
+    out_puts(out, out_cap, off, s);
+    for (int pad = (int)strlen(s); pad < width; pad++) out_puts(out, out_cap, off, " ");
+}
 int levenshtein_distance(const char *s1, const char *s2) {
     int len1 = (int)strlen(s1);
     int len2 = (int)strlen(s2);
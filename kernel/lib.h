@@ -21,6 +21,14 @@ char *strstr(const char *haystack, const char *needle);
 char *strcpy(char *dest, const char *src);
 char *strtok(char *s, const char *delim);
 int atoi(const char *s);
+/* Decimal, sign included; buf holds at least 12 bytes */
+void fmt_dec(char *buf, int v);
+/* Bounded appends for command output: *off advances by what fits in
+ * out_cap, one byte always left for the caller's terminator */
+void out_puts(char *out, size_t out_cap, size_t *off, const char *s);
+void out_putd(char *out, size_t out_cap, size_t *off, int v);
+/* s, then spaces up to width */
+void out_putpad(char *out, size_t out_cap, size_t *off, const char *s, int width);
 int levenshtein_distance(const char *s1, const char *s2);
 int tolower(int c);
 char *strcasestr(const char *haystack, const char *needle);
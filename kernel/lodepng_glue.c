@@ -1,5 +1,7 @@
 #include "lodepng_glue.h"
 #include "kmalloc.h"
+#include "inflate.h"
+#include "lib.h"
 
 void* lodepng_malloc(size_t size) {
     return kmalloc(size);
@@ -12,3 +14,33 @@ void* lodepng_realloc(void* ptr, size_t new_size) {
 void lodepng_free(void* ptr) {
     kfree(ptr);
 }
+
+unsigned lodepng_fast_zlib(unsigned char** out, size_t* outsize,
+                           const unsigned char* in, size_t insize,
+                           const LodePNGDecompressSettings* settings) {
+    const size_t *hint = (const size_t *)settings->custom_context;
+    uint8_t *buf;
+    size_t len;
+    int err = inflate_zlib_alloc(&buf, &len, in, insize, hint ? *hint : 0, settings->max_output_size);
+    if (err) return 1;
+
+    /* lodepng's contract is to append to whatever *out already holds */
+    if (*out && *outsize) {
+        unsigned char *joined = krealloc(*out, *outsize + len);
+        if (!joined) { kfree(buf); return 1; }
+        memcpy(joined + *outsize, buf, len);
+        kfree(buf);
+        *out = joined;
+        *outsize += len;
+    } else {
+        if (*out) kfree(*out);
+        *out = buf;
+        *outsize = len;
+    }
+    return 0;
+}
+
+void lodepng_use_fast_zlib(LodePNGDecompressSettings* settings, const size_t* size_hint) {
+    settings->custom_zlib = lodepng_fast_zlib;
+    settings->custom_context = size_hint;
+}
@@ -2,9 +2,19 @@
 #define LODEPNG_GLUE_H
 
 #include <stddef.h>
+#include "lodepng.h"
 
 void* lodepng_malloc(size_t size);
 void* lodepng_realloc(void* ptr, size_t new_size);
 void lodepng_free(void* ptr);
 
+/* custom_zlib hook backed by the kernel's table-driven inflate (inflate.c).
+ * settings->custom_context may point to a size_t holding the expected
+ * output size so the buffer is allocated once. */
+unsigned lodepng_fast_zlib(unsigned char** out, size_t* outsize,
+                           const unsigned char* in, size_t insize,
+                           const LodePNGDecompressSettings* settings);
+/* Install lodepng_fast_zlib on a decoder; size_hint may be NULL. */
+void lodepng_use_fast_zlib(LodePNGDecompressSettings* settings, const size_t* size_hint);
+
 #endif
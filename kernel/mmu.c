@@ -2,12 +2,17 @@
 #include "palloc.h"
 #include "uart.h"
 #include "lib.h"
+#include "irq.h"
 #include <string.h>
 
+#define BLOCK_2M            0x200000ULL
+#define BLOCK_ADDR_MASK     0x0000FFFFFFE00000ULL
+
 extern char __bss_start[];
 extern char __bss_end[];
 
 static uint64_t *kernel_l0 = NULL;
+static int mmu_live = 0;    /* translation enabled: changes need break-before-make */
 
 uint64_t* mmu_get_kernel_pgd(void) {
     return kernel_l0;
@@ -124,6 +129,160 @@ int mmu_map_page(uint64_t *pgd, uintptr_t va, uintptr_t pa, uint64_t flags) {
     return mmu_map_table(pgd, va, pa, PAGE_SIZE, flags);
 }
 
+int mmu_unmap_page(uint64_t *pgd, uintptr_t va) {
+    if (!pgd) return -1;
+    uint64_t *l1 = get_next_level(pgd, (va >> 39) & 0x1FF, 0);
+    uint64_t *l2 = l1 ? get_next_level(l1, (va >> 30) & 0x1FF, 0) : NULL;
+    if (!l2 || (l2[(va >> 21) & 0x1FF] & (PTE_VALID | PTE_TABLE)) != (PTE_VALID | PTE_TABLE)) return -1;
+    uint64_t *l3 = (uint64_t *)(l2[(va >> 21) & 0x1FF] & ~0xFFFULL);
+    uint64_t *e = &l3[(va >> 12) & 0x1FF];
+    if (!(*e & PTE_VALID)) return -1;
+    *e = 0;
+    __asm__ volatile("dc civac, %0" : : "r" (e) : "memory");
+    __asm__ volatile("dsb ish" ::: "memory");
+    __asm__ volatile("tlbi vaae1is, %0" : : "r" (va >> 12) : "memory");
+    __asm__ volatile("dsb ish; isb" ::: "memory");
+    return 0;
+}
+
+int mmu_translate(uint64_t *pgd, uintptr_t va, uintptr_t *pa) {
+    if (!pgd) pgd = kernel_l0;
+    if (!pgd) return -1;
+    uint64_t *l1 = get_next_level(pgd, (va >> 39) & 0x1FF, 0);
+    if (!l1) return -1;
+    uint64_t e = l1[(va >> 30) & 0x1FF];
+    if (!(e & PTE_VALID)) return -1;
+    if (!(e & PTE_TABLE)) {         /* 1GB block */
+        *pa = (e & 0xFFFFC0000000ULL) | (va & 0x3FFFFFFFULL);
+        return 0;
+    }
+    e = ((uint64_t *)(e & ~0xFFFULL))[(va >> 21) & 0x1FF];
+    if (!(e & PTE_VALID)) return -1;
+    if (!(e & PTE_TABLE)) {         /* 2MB block */
+        *pa = (e & 0xFFFFFFE00000ULL) | (va & 0x1FFFFFULL);
+        return 0;
+    }
+    e = ((uint64_t *)(e & ~0xFFFULL))[(va >> 12) & 0x1FF];
+    if (!(e & PTE_VALID)) return -1;
+    *pa = (e & 0xFFFFFFFFF000ULL) | (va & 0xFFFULL);
+    return 0;
+}
+
+static uint64_t mmu_type_attrs(int type) {
+    uint64_t attrs = PTE_AF | ((uint64_t)type << 2);
+    if (type == MMU_NORMAL_WB || type == MMU_NORMAL_NC) attrs |= PTE_SH_INNER;
+    if (type != MMU_NORMAL_WB) attrs |= PTE_PXN | PTE_UXN;
+    return attrs;
+}
+
+static void mmu_sync_entry(uint64_t *e) {
+    __asm__ volatile("dc civac, %0" : : "r" (e) : "memory");
+    __asm__ volatile("dsb ish" ::: "memory");
+}
+
+/* Break-before-make: a live entry is invalidated and its TLB entries
+ * dropped before the new descriptor is written. */
+static void mmu_replace_entry(uint64_t *e, uint64_t val, uintptr_t va) {
+    if ((*e & PTE_VALID) && mmu_live) {
+        *e = 0;
+        mmu_sync_entry(e);
+        __asm__ volatile("tlbi vaae1is, %0" : : "r" (va >> 12) : "memory");
+        __asm__ volatile("dsb ish" ::: "memory");
+    }
+    *e = val;
+    mmu_sync_entry(e);
+}
+
+/* The block is unmapped for a moment while it is split, which must not
+ * hit anything this code touches meanwhile (identity map: va == pa). */
+static int mmu_block_in_use(uintptr_t block, const uint64_t *l2) {
+    uintptr_t sp;
+    __asm__ volatile("mov %0, sp" : "=r" (sp));
+    uintptr_t code = (uintptr_t)&mmu_replace_entry;
+    uintptr_t tab = (uintptr_t)l2;
+    return (sp - block < BLOCK_2M) || (code - block < BLOCK_2M) || (tab - block < BLOCK_2M);
+}
+
+/* Replace a 2MB block by an L3 table with the same mapping and attributes */
+static uint64_t *mmu_split_block(uint64_t *l2, int idx, uintptr_t block_va) {
+    uint64_t blk = l2[idx];
+    uint64_t *l3 = (uint64_t *)palloc_alloc();
+    if (!l3) return NULL;
+
+    uint64_t pa = blk & BLOCK_ADDR_MASK;
+    uint64_t attrs = blk & ~(BLOCK_ADDR_MASK | 3ULL);
+    for (int i = 0; i < 512; i++)
+        l3[i] = (pa + (uint64_t)i * PAGE_SIZE) | attrs | PTE_PAGE | PTE_VALID;
+
+    uintptr_t p = (uintptr_t)l3;
+    for (uintptr_t i = 0; i < PAGE_SIZE; i += 64) {
+        __asm__ volatile("dc civac, %0" : : "r" (p + i) : "memory");
+    }
+    __asm__ volatile("dsb ish" ::: "memory");
+
+    mmu_replace_entry(&l2[idx], (uintptr_t)l3 | PTE_TABLE | PTE_VALID, block_va);
+    return l3;
+}
+
+int mmu_map_range(uintptr_t va, uintptr_t pa, size_t size, int type) {
+    if (!kernel_l0 || type < MMU_NORMAL_WB || type > MMU_DEVICE_nGnRE) return -1;
+
+    uint64_t attrs = mmu_type_attrs(type);
+    uintptr_t v = va & ~0xFFFULL;
+    uintptr_t v_end = (va + size + 0xFFFULL) & ~0xFFFULL;
+    uintptr_t p = pa & ~0xFFFULL;
+    int ret = 0;
+
+    unsigned long flags = irq_save();
+    for (; v < v_end; v += PAGE_SIZE, p += PAGE_SIZE) {
+        uint64_t *l1 = get_next_level(kernel_l0, (v >> 39) & 0x1FF, 1);
+        uint64_t *l2 = l1 ? get_next_level(l1, (v >> 30) & 0x1FF, 1) : NULL;
+        if (!l2) { ret = -1; break; }
+
+        int l2_idx = (v >> 21) & 0x1FF;
+        uint64_t *l3;
+        if ((l2[l2_idx] & PTE_VALID) && !(l2[l2_idx] & PTE_TABLE)) {
+            uintptr_t block = v & ~(BLOCK_2M - 1);
+            if (mmu_live && mmu_block_in_use(block, l2)) { ret = -1; break; }
+            l3 = mmu_split_block(l2, l2_idx, block);
+        } else {
+            l3 = get_next_level(l2, l2_idx, 1);
+        }
+        if (!l3) { ret = -1; break; }
+
+        uint64_t *e = &l3[(v >> 12) & 0x1FF];
+        uint64_t val = p | attrs | PTE_PAGE | PTE_VALID;
+        if (*e == val) continue;
+        int was_cached = (*e & PTE_VALID) && (*e & PTE_MEMATTR_MASK) == PTE_MEMATTR_NORMAL;
+        mmu_replace_entry(e, val, v);
+
+        /* Lines from the cacheable mapping must not be written back (or
+         * hit) later; maintenance by VA reaches them through the new one. */
+        if (was_cached && type != MMU_NORMAL_WB && mmu_live) {
+            for (uintptr_t a = v; a < v + PAGE_SIZE; a += 64) {
+                __asm__ volatile("dc civac, %0" : : "r" (a) : "memory");
+            }
+        }
+    }
+    __asm__ volatile("dsb ish" ::: "memory");
+    __asm__ volatile("isb");
+    irq_restore(flags);
+    return ret;
+}
+
+int mmu_get_memtype(uintptr_t va) {
+    if (!kernel_l0) return -1;
+    uint64_t *l1 = get_next_level(kernel_l0, (va >> 39) & 0x1FF, 0);
+    uint64_t *l2 = l1 ? get_next_level(l1, (va >> 30) & 0x1FF, 0) : NULL;
+    if (!l2) return -1;
+
+    uint64_t e = l2[(va >> 21) & 0x1FF];
+    if ((e & PTE_VALID) && (e & PTE_TABLE))
+        e = ((uint64_t *)(e & ~0xFFFULL))[(va >> 12) & 0x1FF];
+    if (!(e & PTE_VALID)) return -1;
+    return (int)((e & PTE_MEMATTR_MASK) >> 2);
+}
+
 void mmu_switch(uint64_t *pgd) {
     uint64_t *target = pgd ? pgd : kernel_l0;
     
@@ -225,6 +384,7 @@ void mmu_init(void) {
     
     __asm__ volatile("msr sctlr_el1, %0" : : "r" (sctlr));
     __asm__ volatile("isb");
+    mmu_live = 1;
 
 #ifdef DEBUG
     uart_puts("[mmu] MMU enabled.\n");
@@ -14,6 +14,9 @@
 #define PTE_SH_INNER        (3ULL << 8)   /* Inner Shareable */
 #define PTE_MEMATTR_NORMAL  (0ULL << 2)   /* MAIR index 0 */
 #define PTE_MEMATTR_DEVICE  (1ULL << 2)   /* MAIR index 1 */
+#define PTE_MEMATTR_NORMAL_NC (2ULL << 2) /* MAIR index 2 */
+#define PTE_MEMATTR_DEVICE_nGnRE (3ULL << 2) /* MAIR index 3 */
+#define PTE_MEMATTR_MASK    (7ULL << 2)
 #define PTE_USER            (1ULL << 6)   /* AP[1] = 1 */
 #define PTE_RDONLY          (1ULL << 7)   /* AP[2] = 1 */
 #define PTE_PXN             (1ULL << 53)  /* Privileged Execute Never */
@@ -21,8 +24,17 @@
 
 /* MAIR Attributes */
 #define MAIR_DEVICE_nGnRnE  0x00ULL
+#define MAIR_DEVICE_nGnRE   0x04ULL
 #define MAIR_NORMAL_WB      0xFFULL
-#define MAIR_VALUE          ((MAIR_NORMAL_WB << 0) | (MAIR_DEVICE_nGnRnE << 8))
+#define MAIR_NORMAL_NC      0x44ULL
+#define MAIR_VALUE          ((MAIR_NORMAL_WB << 0) | (MAIR_DEVICE_nGnRnE << 8) | \
+                             (MAIR_NORMAL_NC << 16) | (MAIR_DEVICE_nGnRE << 24))
+
+/* Memory types for mmu_map_range(); the value is the MAIR index */
+#define MMU_NORMAL_WB       0   /* RAM: write-back cacheable */
+#define MMU_DEVICE_nGnRnE   1   /* strongly ordered MMIO */
+#define MMU_NORMAL_NC       2   /* uncached but write-combining (scanout buffers) */
+#define MMU_DEVICE_nGnRE    3   /* MMIO with early write ack */
 
 /* TCR Flags */
 #define TCR_T0SZ(n)         ((64ULL - (n)) << 0)
@@ -37,7 +49,20 @@ void mmu_map(uintptr_t va, uintptr_t pa, size_t size, uint64_t flags);
 uint64_t* mmu_create_user_pgd(void);
 void mmu_free_user_pgd(uint64_t *pgd);
 int mmu_map_page(uint64_t *pgd, uintptr_t va, uintptr_t pa, uint64_t flags);
+/* Drop one 4KB mapping (not part of a block) and its TLB entries */
+int mmu_unmap_page(uint64_t *pgd, uintptr_t va);
+/* Physical address behind va in pgd (NULL: kernel tables); -1 if unmapped */
+int mmu_translate(uint64_t *pgd, uintptr_t va, uintptr_t *pa);
 void mmu_switch(uint64_t *pgd);
 uint64_t* mmu_get_kernel_pgd(void);
 
+/* Identity-style map of [pa, pa+size) at va in the kernel tables with the
+ * given MMU_* type, in 4KB pages. Safe while the MMU is on: 2MB blocks
+ * that the range touches are split and live entries are replaced with
+ * break-before-make. The range must not share a 2MB block with the
+ * running code, the current stack or the page tables. */
+int mmu_map_range(uintptr_t va, uintptr_t pa, size_t size, int type);
+/* MMU_* type of a kernel address, -1 if unmapped */
+int mmu_get_memtype(uintptr_t va);
+
 #endif
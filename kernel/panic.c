@@ -1,5 +1,6 @@
 #include "panic.h"
 #include "uart.h"
+#include "klog.h"
 #include <stdint.h>
 #include <stddef.h>
 #include "sched.h"
@@ -23,6 +24,8 @@ static void print_hex(uintptr_t x) {
 }
 
 void panic_with_trace(const char *msg) {
+    uart_panic_mode();
+    klog_flush_console();
     uart_puts("\n[PANIC] ");
     uart_puts(msg);
     uart_puts("\nBacktrace:\n");
@@ -86,14 +89,14 @@ void exception_c_handler(int type, uint64_t esr, uint64_t elr, struct pt_regs *r
 
         /* Call syscall handler with up to 3 args */
         regs->regs[0] = syscall_handle(sys_num, regs->regs[0], regs->regs[1], regs->regs[2]);
-        
-        /* Advance PC past SVC instruction */
-        regs->elr += 4;
-        
+
+        /* ELR already points past the SVC (preferred return address) */
         return;
     }
 
     DBG_TEXT(800,"\n[PANIC] EXCEPTION OCCURRED!\n",0xFFFFFFFF);
+    uart_panic_mode();
+    klog_flush_console();
     uart_puts("\n[PANIC] EXCEPTION OCCURRED!\n");
     uart_puts("Type: "); print_hex((uintptr_t)type); uart_puts("\n");
     uart_puts("ESR:  "); print_hex((uintptr_t)esr);  uart_puts("\n");
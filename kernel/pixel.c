@@ -0,0 +1,121 @@
+#include "pixel.h"
+#include "simd.h"
+#include <stddef.h>
+
+#if defined(__aarch64__)
+#define PIX_HAVE_NEON 1
+#else
+#define PIX_HAVE_NEON 0
+#endif
+
+static int pix_simd = 0;
+
+void pix_set_simd(int on) { pix_simd = (on && PIX_HAVE_NEON) ? 1 : 0; }
+int pix_get_simd(void) { return pix_simd; }
+int pix_simd_available(void) { return PIX_HAVE_NEON; }
+
+/* Run the NEON version of a long row and return; otherwise fall through
+ * to the C version */
+#if PIX_HAVE_NEON
+#define PIX_TRY_NEON(n, call) \
+    do { \
+        if (pix_simd && (n) >= PIX_SIMD_MIN) { \
+            kernel_neon_begin(); \
+            call; \
+            kernel_neon_end(); \
+            return; \
+        } \
+    } while (0)
+#else
+#define PIX_TRY_NEON(n, call) do { } while (0)
+#endif
+
+void pix_fill_c(uint32_t *dst, uint32_t color, int n) {
+    for (int i = 0; i < n; i++) dst[i] = color;
+}
+
+void pix_copy_c(uint32_t *dst, const uint32_t *src, int n) {
+    for (int i = 0; i < n; i++) dst[i] = src[i];
+}
+
+void pix_blend_c(uint32_t *dst, const uint32_t *src, int n) {
+    for (int i = 0; i < n; i++) {
+        uint32_t color = src[i];
+        uint32_t a = color >> 24;
+        if (a == 0) continue;
+        if (a == 255) { dst[i] = color; continue; }
+        uint32_t d = dst[i];
+        uint32_t inv_a = 255 - a;
+        uint32_t r = (((color >> 16) & 0xFF) * a + ((d >> 16) & 0xFF) * inv_a) / 255;
+        uint32_t g = (((color >> 8) & 0xFF) * a + ((d >> 8) & 0xFF) * inv_a) / 255;
+        uint32_t b = ((color & 0xFF) * a + (d & 0xFF) * inv_a) / 255;
+        dst[i] = 0xFF000000 | (r << 16) | (g << 8) | b;
+    }
+}
+
+void pix_rgba_to_argb_c(uint32_t *dst, const uint8_t *src, int n) {
+    for (int i = 0; i < n; i++, src += 4)
+        dst[i] = ((uint32_t)src[3] << 24) | ((uint32_t)src[0] << 16) | ((uint32_t)src[1] << 8) | src[2];
+}
+
+void pix_argb_to_rgba_c(uint8_t *dst, const uint32_t *src, int n) {
+    for (int i = 0; i < n; i++, dst += 4) {
+        uint32_t c = src[i];
+        dst[0] = (uint8_t)(c >> 16);
+        dst[1] = (uint8_t)(c >> 8);
+        dst[2] = (uint8_t)c;
+        dst[3] = (uint8_t)(c >> 24);
+    }
+}
+
+void pix_pack_rgb565_c(uint16_t *dst, const uint32_t *src, int n) {
+    for (int i = 0; i < n; i++) {
+        uint32_t c = src[i];
+        dst[i] = (uint16_t)(((c >> 8) & 0xF800) | ((c >> 5) & 0x07E0) | ((c >> 3) & 0x001F));
+    }
+}
+
+void pix_fill(uint32_t *dst, uint32_t color, int n) {
+    PIX_TRY_NEON(n, pix_fill_neon(dst, color, n));
+    pix_fill_c(dst, color, n);
+}
+
+void pix_copy(uint32_t *dst, const uint32_t *src, int n) {
+    PIX_TRY_NEON(n, pix_copy_neon(dst, src, n));
+    pix_copy_c(dst, src, n);
+}
+
+void pix_blend(uint32_t *dst, const uint32_t *src, int n) {
+    PIX_TRY_NEON(n, pix_blend_neon(dst, src, n));
+    pix_blend_c(dst, src, n);
+}
+
+void pix_rgba_to_argb(uint32_t *dst, const uint8_t *src, int n) {
+    PIX_TRY_NEON(n, pix_rgba_to_argb_neon(dst, src, n));
+    pix_rgba_to_argb_c(dst, src, n);
+}
+
+void pix_argb_to_rgba(uint8_t *dst, const uint32_t *src, int n) {
+    PIX_TRY_NEON(n, pix_argb_to_rgba_neon(dst, src, n));
+    pix_argb_to_rgba_c(dst, src, n);
+}
+
+void pix_pack_rgb565(uint16_t *dst, const uint32_t *src, int n) {
+    PIX_TRY_NEON(n, pix_pack_rgb565_neon(dst, src, n));
+    pix_pack_rgb565_c(dst, src, n);
+}
+
+/* AdvSIMD has no gather, so scaling stays scalar; stepping the index
+ * instead of dividing per pixel is what makes it cheap */
+void pix_scale_row(uint32_t *dst, const uint32_t *src, int n, int first, int num, int den) {
+    if (n <= 0 || den <= 0) return;
+    int q = (int)(((int64_t)first * num) / den);
+    int r = (int)(((int64_t)first * num) % den);
+    int qs = num / den, rs = num % den;
+    for (int i = 0; i < n; i++) {
+        dst[i] = src[q];
+        q += qs;
+        r += rs;
+        if (r >= den) { r -= den; q++; }
+    }
+}
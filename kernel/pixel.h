@@ -0,0 +1,49 @@
+#ifndef PIXEL_H
+#define PIXEL_H
+
+#include <stdint.h>
+
+/* Row kernels on ARGB8888 (0xAARRGGBB) pixels, shared by the framebuffer,
+ * image decoding and scanout conversion. Rows of PIX_SIMD_MIN pixels or
+ * more run the NEON versions (pixel_neon.c) inside a kernel NEON region;
+ * shorter rows, early boot and non-AArch64 builds use the C versions. */
+#define PIX_SIMD_MIN 64
+
+void pix_fill(uint32_t *dst, uint32_t color, int n);
+/* Non-overlapping copy */
+void pix_copy(uint32_t *dst, const uint32_t *src, int n);
+/* src over dst by the src alpha, as the compositor draws bitmaps:
+ * alpha 0 leaves dst alone, anything else gives an opaque pixel */
+void pix_blend(uint32_t *dst, const uint32_t *src, int n);
+/* R,G,B,A bytes (lodepng output) <-> ARGB words */
+void pix_rgba_to_argb(uint32_t *dst, const uint8_t *src, int n);
+void pix_argb_to_rgba(uint8_t *dst, const uint32_t *src, int n);
+/* ARGB -> RGB565, truncating */
+void pix_pack_rgb565(uint16_t *dst, const uint32_t *src, int n);
+/* Nearest neighbour: dst[i] = src[(first + i) * num / den] */
+void pix_scale_row(uint32_t *dst, const uint32_t *src, int n, int first, int num, int den);
+
+/* Off until kernel.c enables it after mmu_init (FP access must be on and
+ * NEON stores need Normal memory); 0 forces the C versions again */
+void pix_set_simd(int on);
+int pix_get_simd(void);
+/* NEON versions are built in */
+int pix_simd_available(void);
+
+/* Portable versions, also the reference for the pixtest command */
+void pix_fill_c(uint32_t *dst, uint32_t color, int n);
+void pix_copy_c(uint32_t *dst, const uint32_t *src, int n);
+void pix_blend_c(uint32_t *dst, const uint32_t *src, int n);
+void pix_rgba_to_argb_c(uint32_t *dst, const uint8_t *src, int n);
+void pix_argb_to_rgba_c(uint8_t *dst, const uint32_t *src, int n);
+void pix_pack_rgb565_c(uint16_t *dst, const uint32_t *src, int n);
+
+/* NEON versions; only call inside kernel_neon_begin/end */
+void pix_fill_neon(uint32_t *dst, uint32_t color, int n);
+void pix_copy_neon(uint32_t *dst, const uint32_t *src, int n);
+void pix_blend_neon(uint32_t *dst, const uint32_t *src, int n);
+void pix_rgba_to_argb_neon(uint32_t *dst, const uint8_t *src, int n);
+void pix_argb_to_rgba_neon(uint8_t *dst, const uint32_t *src, int n);
+void pix_pack_rgb565_neon(uint16_t *dst, const uint32_t *src, int n);
+
+#endif
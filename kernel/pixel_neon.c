@@ -0,0 +1,120 @@
+#include "pixel.h"
+
+/* Built without -mgeneral-regs-only (SIMD_FLAGS in build.bat). Everything
+ * here runs inside a kernel NEON region entered by pixel.c. Loops take 16
+ * pixels at a time and hand the tail to the C versions. */
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+
+void pix_fill_neon(uint32_t *dst, uint32_t color, int n) {
+    uint32x4_t v = vdupq_n_u32(color);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        vst1q_u32(dst + i, v);
+        vst1q_u32(dst + i + 4, v);
+        vst1q_u32(dst + i + 8, v);
+        vst1q_u32(dst + i + 12, v);
+    }
+    pix_fill_c(dst + i, color, n - i);
+}
+
+void pix_copy_neon(uint32_t *dst, const uint32_t *src, int n) {
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint32x4_t a = vld1q_u32(src + i);
+        uint32x4_t b = vld1q_u32(src + i + 4);
+        uint32x4_t c = vld1q_u32(src + i + 8);
+        uint32x4_t d = vld1q_u32(src + i + 12);
+        vst1q_u32(dst + i, a);
+        vst1q_u32(dst + i + 4, b);
+        vst1q_u32(dst + i + 8, c);
+        vst1q_u32(dst + i + 12, d);
+    }
+    pix_copy_c(dst + i, src + i, n - i);
+}
+
+/* (s * a + d * (255 - a)) / 255 per byte lane, exactly as the C division:
+ * for x <= 255 * 255, x / 255 == (x + (x >> 8) + 1) >> 8 */
+static inline uint8x16_t blend_channel(uint8x16_t s, uint8x16_t d, uint8x16_t a, uint8x16_t ia) {
+    uint16x8_t lo = vmull_u8(vget_low_u8(s), vget_low_u8(a));
+    uint16x8_t hi = vmull_high_u8(s, a);
+    lo = vmlal_u8(lo, vget_low_u8(d), vget_low_u8(ia));
+    hi = vmlal_high_u8(hi, d, ia);
+    const uint16x8_t one = vdupq_n_u16(1);
+    lo = vaddq_u16(lo, vsraq_n_u16(one, lo, 8));
+    hi = vaddq_u16(hi, vsraq_n_u16(one, hi, 8));
+    return vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8));
+}
+
+void pix_blend_neon(uint32_t *dst, const uint32_t *src, int n) {
+    const uint8x16_t zero = vdupq_n_u8(0);
+    const uint8x16_t opaque = vdupq_n_u8(0xFF);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        /* de-interleaved: val[0] = B, [1] = G, [2] = R, [3] = A */
+        uint8x16x4_t s = vld4q_u8((const uint8_t *)(src + i));
+        uint8x16_t a = s.val[3];
+        /* Fully opaque or fully clear runs (most of any icon or glyph)
+         * skip reading dst, which is slow on an uncached scanout */
+        if (vminvq_u8(a) == 0xFF) {
+            vst4q_u8((uint8_t *)(dst + i), s);
+            continue;
+        }
+        if (vmaxvq_u8(a) == 0) continue;
+
+        uint8x16x4_t d = vld4q_u8((const uint8_t *)(dst + i));
+        uint8x16_t ia = vmvnq_u8(a);
+        uint8x16x4_t o;
+        o.val[0] = blend_channel(s.val[0], d.val[0], a, ia);
+        o.val[1] = blend_channel(s.val[1], d.val[1], a, ia);
+        o.val[2] = blend_channel(s.val[2], d.val[2], a, ia);
+        o.val[3] = vbslq_u8(vceqq_u8(a, zero), d.val[3], opaque);
+        vst4q_u8((uint8_t *)(dst + i), o);
+    }
+    pix_blend_c(dst + i, src + i, n - i);
+}
+
+/* Both directions just swap the R and B bytes of each pixel */
+void pix_rgba_to_argb_neon(uint32_t *dst, const uint8_t *src, int n) {
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16x4_t p = vld4q_u8(src + (size_t)i * 4);
+        uint8x16_t t = p.val[0];
+        p.val[0] = p.val[2];
+        p.val[2] = t;
+        vst4q_u8((uint8_t *)(dst + i), p);
+    }
+    pix_rgba_to_argb_c(dst + i, src + (size_t)i * 4, n - i);
+}
+
+void pix_argb_to_rgba_neon(uint8_t *dst, const uint32_t *src, int n) {
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16x4_t p = vld4q_u8((const uint8_t *)(src + i));
+        uint8x16_t t = p.val[0];
+        p.val[0] = p.val[2];
+        p.val[2] = t;
+        vst4q_u8(dst + (size_t)i * 4, p);
+    }
+    pix_argb_to_rgba_c(dst + (size_t)i * 4, src + i, n - i);
+}
+
+void pix_pack_rgb565_neon(uint16_t *dst, const uint32_t *src, int n) {
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16x4_t p = vld4q_u8((const uint8_t *)(src + i));
+        /* R in the top byte, then shift-insert G and B below its top bits */
+        uint16x8_t lo = vshll_n_u8(vget_low_u8(p.val[2]), 8);
+        uint16x8_t hi = vshll_high_n_u8(p.val[2], 8);
+        lo = vsriq_n_u16(lo, vshll_n_u8(vget_low_u8(p.val[1]), 8), 5);
+        hi = vsriq_n_u16(hi, vshll_high_n_u8(p.val[1], 8), 5);
+        lo = vsriq_n_u16(lo, vshll_n_u8(vget_low_u8(p.val[0]), 8), 11);
+        hi = vsriq_n_u16(hi, vshll_high_n_u8(p.val[0], 8), 11);
+        vst1q_u16(dst + i, lo);
+        vst1q_u16(dst + i + 8, hi);
+    }
+    pix_pack_rgb565_c(dst + i, src + i, n - i);
+}
+
+#endif
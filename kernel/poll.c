@@ -0,0 +1,189 @@
+#include "poll.h"
+#include "sched.h"
+#include "irq.h"
+#include "pty.h"
+#include "input.h"
+
+/* One per poll() call, on the caller's stack. Its address is the event
+ * the caller sleeps on; gen closes the gap between the readiness check
+ * and the sleep. */
+struct poller {
+    volatile uint32_t gen;
+};
+
+void waitable_init(struct waitable *w, uint32_t (*ready)(struct waitable *w)) {
+    w->ready = ready;
+    w->deadline = 0;
+    w->hooks = 0;
+}
+
+void waitable_notify(struct waitable *w) {
+    if (!w->hooks) return;
+    unsigned long flags = irq_save();
+    for (struct poll_hook *h = w->hooks; h; h = h->next) {
+        h->owner->gen++;
+        task_wake_event(h->owner);
+    }
+    irq_restore(flags);
+}
+
+void waitable_detach(struct waitable *w) {
+    unsigned long flags = irq_save();
+    struct poll_hook *h = w->hooks;
+    w->hooks = 0;
+    while (h) {
+        struct poll_hook *next = h->next;
+        h->obj = 0;
+        h->owner->gen++;
+        task_wake_event(h->owner);
+        h = next;
+    }
+    irq_restore(flags);
+}
+
+static void hook(struct poll_hook *h, struct waitable *w, struct poller *p) {
+    h->obj = w;
+    h->owner = p;
+    unsigned long flags = irq_save();
+    h->next = w->hooks;
+    w->hooks = h;
+    irq_restore(flags);
+}
+
+static void unhook(struct poll_hook *h) {
+    unsigned long flags = irq_save();
+    if (h->obj) {
+        struct poll_hook **pp = &h->obj->hooks;
+        while (*pp && *pp != h) pp = &(*pp)->next;
+        if (*pp) *pp = h->next;
+        h->obj = 0;
+    }
+    irq_restore(flags);
+}
+
+struct hook_set {
+    struct poll_hook *hooks;
+    int n;
+};
+
+/* The hooks live on the poller's stack: a task killed in poll() must not
+ * leave them linked into objects that outlive it */
+static void unhook_all(void *arg) {
+    struct hook_set *set = (struct hook_set *)arg;
+    for (int i = 0; i < set->n; i++) unhook(&set->hooks[i]);
+}
+
+int poll(struct poll_item *items, int n, int timeout_ms) {
+    if (n < 0 || n > POLL_MAX || (n && !items)) return -1;
+
+    struct poller me = { 0 };
+    struct poll_hook hooks[POLL_MAX];
+    struct hook_set set = { hooks, n };
+    int hooked = timeout_ms != 0;
+    for (int i = 0; i < n; i++) {
+        hooks[i].obj = 0;
+        if (hooked && items[i].obj) hook(&hooks[i], items[i].obj, &me);
+    }
+    if (hooked) task_set_reap_hook(unhook_all, &set);
+
+    uint32_t start = scheduler_get_tick();
+    int ready;
+    for (;;) {
+        /* snapshot first: a notify after this makes the sleep return at once */
+        uint32_t seen = me.gen;
+        int timed = timeout_ms > 0;
+        uint32_t until = start + (uint32_t)timeout_ms;
+
+        ready = 0;
+        for (int i = 0; i < n; i++) {
+            struct waitable *w = items[i].obj;
+            uint32_t r;
+            if (!w || (hooked && !hooks[i].obj)) {
+                r = POLLHUP;
+            } else {
+                r = w->ready(w) & (items[i].events | POLLHUP);
+                uint32_t t;
+                if (!r && w->deadline && w->deadline(w, &t) && (!timed || (int32_t)(t - until) < 0)) {
+                    until = t;
+                    timed = 1;
+                }
+            }
+            items[i].revents = (uint16_t)r;
+            if (r) ready++;
+        }
+        if (ready || timeout_ms == 0) break;
+        uint32_t now = scheduler_get_tick();
+        if (timeout_ms > 0 && (int32_t)(now - (start + (uint32_t)timeout_ms)) >= 0) break;
+        if (timed && (int32_t)(now - until) >= 0) continue;    /* a timer came due meanwhile */
+
+        if (timed) task_wait_event_until(&me, &me.gen, seen, until);
+        else task_wait_event_unless(&me, &me.gen, seen);
+    }
+
+    if (hooked) {
+        task_set_reap_hook(0, 0);
+        unhook_all(&set);
+    }
+    return ready;
+}
+
+/* ---- timers ---- */
+
+static uint32_t timer_ready(struct waitable *w) {
+    struct poll_timer *t = container_of(w, struct poll_timer, w);
+    return t->armed && (int32_t)(scheduler_get_tick() - t->expires) >= 0 ? POLLIN : 0;
+}
+
+static int timer_deadline(struct waitable *w, uint32_t *tick) {
+    struct poll_timer *t = container_of(w, struct poll_timer, w);
+    if (!t->armed) return 0;
+    *tick = t->expires;
+    return 1;
+}
+
+void poll_timer_init(struct poll_timer *t) {
+    waitable_init(&t->w, timer_ready);
+    t->w.deadline = timer_deadline;
+    t->armed = 0;
+    t->expires = 0;
+    t->period = 0;
+}
+
+void poll_timer_arm(struct poll_timer *t, uint32_t ms, uint32_t period_ms) {
+    t->armed = ms != 0;
+    t->expires = scheduler_get_tick() + ms;
+    t->period = period_ms;
+    /* a poller sleeping on the old deadline has to pick up the new one */
+    waitable_notify(&t->w);
+}
+
+uint32_t poll_timer_ack(struct poll_timer *t) {
+    uint32_t now = scheduler_get_tick();
+    if (!t->armed || (int32_t)(now - t->expires) < 0) return 0;
+    if (!t->period) {
+        t->armed = 0;
+        return 1;
+    }
+    uint32_t n = (now - t->expires) / t->period + 1;
+    t->expires += n * t->period;
+    return n;
+}
+
+/* ---- SYS_POLL ---- */
+
+int poll_sources(struct poll_src *srcs, int n, int timeout_ms) {
+    if (n < 0 || n > POLL_MAX || (n && !srcs)) return -1;
+    struct poll_item items[POLL_MAX];
+    struct pty *tty = (struct pty *)task_get_tty(task_current_id());
+    for (int i = 0; i < n; i++) {
+        struct waitable *w = 0;
+        if (srcs[i].src == POLL_SRC_TTY && tty) w = pty_waitable(tty);
+        else if (srcs[i].src == POLL_SRC_KEYS) w = input_key_waitable();
+        else if (srcs[i].src == POLL_SRC_MOUSE) w = input_mouse_waitable();
+        items[i].obj = w;
+        items[i].events = srcs[i].events;
+    }
+    int ready = poll(items, n, timeout_ms);
+    for (int i = 0; i < n; i++) srcs[i].revents = ready < 0 ? 0 : items[i].revents;
+    return ready;
+}
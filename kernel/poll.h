@@ -0,0 +1,87 @@
+#ifndef POLL_H
+#define POLL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Readiness multiplexing.
+ *
+ * Anything a task may want to sleep on (pty sides, window input queues,
+ * the input queues, poll timers) embeds a struct waitable: a callback
+ * reporting its current readiness and a list of the pollers currently
+ * sleeping on it. Producers call waitable_notify after making the object
+ * more ready; that is a pointer test when nobody is polling, and is safe
+ * from IRQ handlers. poll() sleeps until one of the objects is ready or
+ * the timeout passes, so an idle task costs nothing. */
+
+#define POLLIN   0x01   /* something to read */
+#define POLLOUT  0x04   /* room to write */
+#define POLLHUP  0x10   /* the object went away while being polled */
+
+#ifndef container_of
+#define container_of(ptr, type, member) ((type *)((char *)(ptr) - offsetof(type, member)))
+#endif
+
+struct waitable;
+struct poller;
+
+struct poll_hook {
+    struct poll_hook *next;
+    struct waitable *obj;       /* NULL once the object is gone */
+    struct poller *owner;
+};
+
+struct waitable {
+    uint32_t (*ready)(struct waitable *w);
+    /* Time-based objects: 1 and the tick they become ready at, else 0 */
+    int (*deadline)(struct waitable *w, uint32_t *tick);
+    struct poll_hook *hooks;
+};
+
+void waitable_init(struct waitable *w, uint32_t (*ready)(struct waitable *w));
+/* Wake whoever polls w (task or IRQ context) */
+void waitable_notify(struct waitable *w);
+/* The object is being freed: pollers see POLLHUP and drop their hooks */
+void waitable_detach(struct waitable *w);
+
+#define POLL_MAX 16
+
+struct poll_item {
+    struct waitable *obj;
+    uint16_t events;            /* POLLIN / POLLOUT wanted */
+    uint16_t revents;           /* what was ready; POLLHUP is always reported */
+};
+
+/* Wait until an item is ready. timeout_ms < 0 waits forever, 0 only looks.
+ * Returns how many items have revents set (0 on timeout), -1 for a bad n. */
+int poll(struct poll_item *items, int n, int timeout_ms);
+
+/* Timers as poll sources: ready (POLLIN) once expired until acknowledged */
+struct poll_timer {
+    struct waitable w;
+    int armed;
+    uint32_t expires;           /* scheduler tick */
+    uint32_t period;            /* 0: one-shot */
+};
+
+void poll_timer_init(struct poll_timer *t);
+/* First expiry after ms, then every period_ms (0: once); ms 0 disarms */
+void poll_timer_arm(struct poll_timer *t, uint32_t ms, uint32_t period_ms);
+/* Consume the expiries so far and re-arm a periodic timer; returns how many */
+uint32_t poll_timer_ack(struct poll_timer *t);
+
+/* SYS_POLL: tasks have no descriptors, so user requests name the caller's
+ * own sources */
+#define POLL_SRC_TTY    1       /* the task's tty: input to read, room to write */
+#define POLL_SRC_KEYS   2       /* raw keyboard queue */
+#define POLL_SRC_MOUSE  3       /* raw mouse queue */
+
+struct poll_src {
+    uint32_t src;
+    uint16_t events;
+    uint16_t revents;
+};
+
+int poll_sources(struct poll_src *srcs, int n, int timeout_ms);
+
+#endif
@@ -33,6 +33,22 @@ static struct prog_entry prog_table[] = {
     {"ramfs-import", prog_ramfs_import},
     {"systemctl", prog_systemctl},
     {"free", prog_free},
+    {"pngbench", prog_pngbench},
+    {"blittest", prog_blittest},
+    {"fbmode", prog_fbmode},
+    {"pixtest", prog_pixtest},
+    {"ringbench", prog_ringbench},
+    {"usbstat", prog_usbstat},
+    {"inlat", prog_inlat},
+    {"inrec", prog_inrec},
+    {"dmesg", prog_dmesg},
+    {"console", prog_console},
+    {"uringbench", prog_uringbench},
+    {"shmbench", prog_shmbench},
+    {"etasks", prog_etasks},
+    {"hrtimers", prog_hrtimers},
+    {"irqstat", prog_irqstat},
+    {"utimebench", prog_utimebench},
     {NULL, NULL}
 };
 
@@ -44,9 +60,9 @@ int program_lookup(const char *name, prog_fn_t *out) {
 }
 
 const char **program_list(size_t *count) {
-    static const char *names[16];
+    static const char *names[sizeof(prog_table) / sizeof(prog_table[0])];
     size_t n = 0;
-    for (int i = 0; prog_table[i].name && n < 16; ++i) names[n++] = prog_table[i].name;
+    for (int i = 0; prog_table[i].name; ++i) names[n++] = prog_table[i].name;
     names[n] = NULL;
     if (count) *count = n;
     return names;
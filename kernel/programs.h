@@ -33,6 +33,22 @@ int prog_ramfs_export(int argc, char **argv, const char *in, size_t in_len, char
 int prog_ramfs_import(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap);
 int prog_systemctl(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap);
 int prog_free(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap);
+int prog_pngbench(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap);
+int prog_blittest(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap);
+int prog_fbmode(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap);
+int prog_pixtest(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap);
+int prog_ringbench(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap);
+int prog_usbstat(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap);
+int prog_inlat(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap);
+int prog_inrec(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap);
+int prog_dmesg(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap);
+int prog_console(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap);
+int prog_uringbench(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap);
+int prog_shmbench(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap);
+int prog_etasks(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap);
+int prog_hrtimers(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap);
+int prog_irqstat(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap);
+int prog_utimebench(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap);
 
 typedef int (*prog_fn_t)(int argc, char **argv, const char *in, size_t in_len, char *out, size_t out_cap);
 
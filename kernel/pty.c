@@ -1,93 +1,128 @@
 #include "pty.h"
 #include "kmalloc.h"
 #include <string.h>
-#include "irq.h"
 #include "uart.h"
+#include "sched.h"
 
+static uint32_t prog_ready(struct waitable *w) {
+    struct pty *p = container_of(w, struct pty, prog_w);
+    return (ring_empty(&p->in) ? 0 : POLLIN) | (ring_space(&p->out) ? POLLOUT : 0);
+}
 
+static uint32_t term_ready(struct waitable *w) {
+    struct pty *p = container_of(w, struct pty, term_w);
+    return (ring_empty(&p->out) ? 0 : POLLIN) | (ring_space(&p->in) ? POLLOUT : 0);
+}
 
-struct pty* pty_alloc(void) {
-    struct pty *p = kmalloc(sizeof(struct pty));
+static uint32_t pow2_up(uint32_t n) {
+    uint32_t s = 16;
+    while (s < n && s < (1u << 20)) s <<= 1;
+    return s;
+}
+
+struct pty* pty_alloc_sized(uint32_t in_size, uint32_t out_size) {
+    in_size = pow2_up(in_size);
+    out_size = pow2_up(out_size);
+    struct pty *p = kmalloc(sizeof(struct pty) + in_size + out_size);
     if (p) {
-        memset(p, 0, sizeof(*p));
-        p->lock = 0;
+        char *bufs = (char *)(p + 1);
+        ring_init(&p->in, bufs, in_size, 1);
+        ring_init(&p->out, bufs + in_size, out_size, 1);
+        waitable_init(&p->prog_w, prog_ready);
+        waitable_init(&p->term_w, term_ready);
     } else {
         uart_puts("[pty] ERROR: pty_alloc failed (kmalloc returned NULL)\n");
     }
     return p;
 }
 
+struct pty* pty_alloc(void) {
+    return pty_alloc_sized(PTY_IN_SIZE, PTY_OUT_SIZE);
+}
+
 void pty_write_in(struct pty *p, char c) {
     if (!p) return;
-    // uart_puts("[pty] write_in '"); uart_putc(c); uart_puts("'\n");
-    unsigned long flags = irq_save();
-    int next = (p->in_h + 1) % 512;
-    if (next != p->in_t) {
-        p->in_buf[p->in_h] = c;
-        p->in_h = next;
-    } 
-    irq_restore(flags);
+    if (ring_push(&p->in, &c)) waitable_notify(&p->prog_w);
 }
 
 char pty_read_in(struct pty *p) {
-    if (!p) return 0;
-    unsigned long flags = irq_save();
-    if (p->in_h == p->in_t) {
-        irq_restore(flags);
-        return 0;
-    }
-    char c = p->in_buf[p->in_t];
-    p->in_t = (p->in_t + 1) % 512;
-    irq_restore(flags);
-    // uart_puts("[pty] read_in '"); uart_putc(c); uart_puts("'\n");
+    char c = 0;
+    if (p && ring_pop(&p->in, &c)) waitable_notify(&p->term_w);
     return c;
 }
 
 void pty_write_out(struct pty *p, char c) {
     if (!p) return;
-    unsigned long flags = irq_save();
-    int next = (p->out_h + 1) % 2048;
-    if (next != p->out_t) {
-        p->out_buf[p->out_h] = c;
-        p->out_h = next;
-    }
-    irq_restore(flags);
+    if (ring_push(&p->out, &c)) waitable_notify(&p->term_w);
 }
 
 char pty_read_out(struct pty *p) {
-    if (!p) return 0;
-    unsigned long flags = irq_save();
-    if (p->out_h == p->out_t) {
-        irq_restore(flags);
-        return 0;
-    }
-    char c = p->out_buf[p->out_t];
-    p->out_t = (p->out_t + 1) % 2048;
-    irq_restore(flags);
+    char c = 0;
+    if (p && ring_pop(&p->out, &c)) waitable_notify(&p->prog_w);
     return c;
 }
 
 int pty_has_out(struct pty *p) {
-    if (!p) return 0;
-    unsigned long flags = irq_save();
-    int has = (p->out_h != p->out_t);
-    irq_restore(flags);
-    return has;
+    return p && !ring_empty(&p->out);
 }
 
 int pty_has_in(struct pty *p) {
-    if (!p) return 0;
-    unsigned long flags = irq_save();
-    int has = (p->in_h != p->in_t);
-    irq_restore(flags);
-    return has;
+    return p && !ring_empty(&p->in);
 }
 
-void pty_free(struct pty *p) {
-    if (p) kfree(p);
+size_t pty_write_buf(struct pty *p, const char *buf, size_t n) {
+    if (!p || !buf) return 0;
+    uint32_t done = ring_push_bulk(&p->out, buf, (uint32_t)n);
+    if (done) waitable_notify(&p->term_w);
+    return done;
 }
 
-#include "sched.h"
+size_t pty_read_buf(struct pty *p, char *buf, size_t n) {
+    if (!p || !buf) return 0;
+    uint32_t done = ring_pop_bulk(&p->in, buf, (uint32_t)n);
+    if (done) waitable_notify(&p->term_w);
+    return done;
+}
+
+size_t pty_puts(struct pty *p, const char *s) {
+    return s ? pty_write_buf(p, s, strlen(s)) : 0;
+}
+
+size_t pty_write_in_buf(struct pty *p, const char *buf, size_t n) {
+    if (!p || !buf) return 0;
+    uint32_t done = ring_push_bulk(&p->in, buf, (uint32_t)n);
+    if (done) waitable_notify(&p->prog_w);
+    return done;
+}
+
+size_t pty_peek_out(struct pty *p, const char **seg) {
+    void *v = 0;
+    uint32_t n = p ? ring_peek(&p->out, &v) : 0;
+    *seg = (const char *)v;
+    return n;
+}
+
+void pty_consume_out(struct pty *p, size_t n) {
+    if (p && n) {
+        ring_consume(&p->out, (uint32_t)n);
+        waitable_notify(&p->prog_w);
+    }
+}
+
+struct waitable *pty_waitable(struct pty *p) {
+    return p ? &p->prog_w : 0;
+}
+
+struct waitable *pty_term_waitable(struct pty *p) {
+    return p ? &p->term_w : 0;
+}
+
+void pty_free(struct pty *p) {
+    if (!p) return;
+    waitable_detach(&p->prog_w);
+    waitable_detach(&p->term_w);
+    kfree(p);
+}
 
 int pty_getline(struct pty *p, char *buf, int max_len) {
     if (!p || !buf || max_len <= 0) return 0;
@@ -96,9 +131,8 @@ int pty_getline(struct pty *p, char *buf, int max_len) {
     while (i < max_len - 1) {
         /* Wait for input */
         while (!pty_has_in(p)) {
-            /* Block for 20ms */
-            // uart_puts("z"); 
-            task_block_current_until(scheduler_get_tick() + 20);
+            struct poll_item it = { &p->prog_w, POLLIN, 0 };
+            poll(&it, 1, -1);
         }
         
         char c = pty_read_in(p);
@@ -112,9 +146,7 @@ int pty_getline(struct pty *p, char *buf, int max_len) {
         if (c == '\b' || c == 127) {
             if (i > 0) {
                 i--;
-                pty_write_out(p, '\b'); 
-                pty_write_out(p, ' '); 
-                pty_write_out(p, '\b');
+                pty_write_buf(p, "\b \b", 3);
             }
             continue;
         }
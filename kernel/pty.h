@@ -2,16 +2,27 @@
 #define PTY_H
 
 #include <stdint.h>
+#include <stddef.h>
+#include "ring.h"
+#include "poll.h"
 
+#define PTY_IN_SIZE  512
+#define PTY_OUT_SIZE 2048
+
+/* in: keyboard (wm) -> program, out: program -> terminal. pty users are
+ * all tasks, so each side is a single ring context and needs no lock.
+ * Both ring buffers live in the same allocation, right after the struct. */
 struct pty {
-    char in_buf[512];
-    int in_h, in_t;
-    char out_buf[2048];
-    int out_h, out_t;
-    volatile int lock;
+    struct ring in;
+    struct ring out;
+    struct waitable prog_w;     /* program side: POLLIN input, POLLOUT output room */
+    struct waitable term_w;     /* terminal side: POLLIN output, POLLOUT input room */
 };
 
+/* PTY_IN_SIZE / PTY_OUT_SIZE rings */
 struct pty* pty_alloc(void);
+/* Ring sizes in bytes, rounded up to a power of two */
+struct pty* pty_alloc_sized(uint32_t in_size, uint32_t out_size);
 void pty_write_in(struct pty *p, char c);
 char pty_read_in(struct pty *p);
 void pty_write_out(struct pty *p, char c);
@@ -20,6 +31,23 @@ int pty_has_out(struct pty *p);
 int pty_has_in(struct pty *p);
 void pty_free(struct pty *p);
 
+/* Program side in bulk: write output / read input, returning how many
+ * bytes moved. Output that does not fit is dropped, as with pty_write_out. */
+size_t pty_write_buf(struct pty *p, const char *buf, size_t n);
+size_t pty_read_buf(struct pty *p, char *buf, size_t n);
+size_t pty_puts(struct pty *p, const char *s);
+
+/* Terminal side in bulk */
+size_t pty_write_in_buf(struct pty *p, const char *buf, size_t n);
+/* Pending output in place: *seg gets the oldest contiguous run and its
+ * length is returned; pty_consume_out(n) releases what was parsed. */
+size_t pty_peek_out(struct pty *p, const char **seg);
+void pty_consume_out(struct pty *p, size_t n);
+
+/* poll() sources for the two ends */
+struct waitable *pty_waitable(struct pty *p);
+struct waitable *pty_term_waitable(struct pty *p);
+
 /* Blocking line read with echo and editing (Canonical mode simulation) */
 int pty_getline(struct pty *p, char *buf, int max_len);
 
@@ -0,0 +1,75 @@
+#include "qoi.h"
+#include "lib.h"
+
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF  0x40
+#define QOI_OP_LUMA  0x80
+#define QOI_OP_RUN   0xC0
+#define QOI_OP_RGB   0xFE
+#define QOI_OP_RGBA  0xFF
+#define QOI_MASK_2   0xC0
+#define QOI_MAX_DIM  16384
+
+static uint32_t qoi_be32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+int qoi_probe(const uint8_t *buf, size_t len, int *w, int *h) {
+    if (len < QOI_HEADER_SIZE || memcmp(buf, "qoif", 4) != 0) return 0;
+    uint32_t qw = qoi_be32(buf + 4), qh = qoi_be32(buf + 8);
+    if (qw == 0 || qh == 0 || qw > QOI_MAX_DIM || qh > QOI_MAX_DIM) return 0;
+    if (buf[12] != 3 && buf[12] != 4) return 0;
+    *w = (int)qw;
+    *h = (int)qh;
+    return 1;
+}
+
+int qoi_decode(const uint8_t *buf, size_t len, uint32_t *out, int w, int h) {
+    /* pixels are kept as ARGB words; the index hash works on channels */
+    uint32_t index[64];
+    memset(index, 0, sizeof(index));
+
+    uint32_t px = 0xFF000000;
+    size_t p = QOI_HEADER_SIZE;
+    size_t npix = (size_t)w * h;
+    int run = 0;
+
+    for (size_t i = 0; i < npix; i++) {
+        if (run > 0) {
+            run--;
+        } else {
+            if (p >= len) return -1;
+            uint8_t b1 = buf[p++];
+            if (b1 == QOI_OP_RGB) {
+                if (p + 3 > len) return -1;
+                px = (px & 0xFF000000) | ((uint32_t)buf[p] << 16) | ((uint32_t)buf[p + 1] << 8) | buf[p + 2];
+                p += 3;
+            } else if (b1 == QOI_OP_RGBA) {
+                if (p + 4 > len) return -1;
+                px = ((uint32_t)buf[p + 3] << 24) | ((uint32_t)buf[p] << 16) | ((uint32_t)buf[p + 1] << 8) | buf[p + 2];
+                p += 4;
+            } else if ((b1 & QOI_MASK_2) == QOI_OP_INDEX) {
+                px = index[b1];
+            } else if ((b1 & QOI_MASK_2) == QOI_OP_DIFF) {
+                uint32_t r = ((px >> 16) + ((b1 >> 4) & 3) - 2) & 0xFF;
+                uint32_t g = ((px >> 8) + ((b1 >> 2) & 3) - 2) & 0xFF;
+                uint32_t b = (px + (b1 & 3) - 2) & 0xFF;
+                px = (px & 0xFF000000) | (r << 16) | (g << 8) | b;
+            } else if ((b1 & QOI_MASK_2) == QOI_OP_LUMA) {
+                if (p >= len) return -1;
+                uint8_t b2 = buf[p++];
+                int vg = (b1 & 0x3F) - 32;
+                uint32_t r = ((px >> 16) + vg - 8 + ((b2 >> 4) & 0x0F)) & 0xFF;
+                uint32_t g = ((px >> 8) + vg) & 0xFF;
+                uint32_t b = (px + vg - 8 + (b2 & 0x0F)) & 0xFF;
+                px = (px & 0xFF000000) | (r << 16) | (g << 8) | b;
+            } else { /* QOI_OP_RUN */
+                run = b1 & 0x3F;
+            }
+            uint32_t r = (px >> 16) & 0xFF, g = (px >> 8) & 0xFF, b = px & 0xFF, a = px >> 24;
+            index[(r * 3 + g * 5 + b * 7 + a * 11) & 63] = px;
+        }
+        out[i] = px;
+    }
+    return 0;
+}
@@ -0,0 +1,19 @@
+#ifndef QOI_H
+#define QOI_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* QOI ("Quite OK Image") decoder, used for assets that make_disk.py
+ * converts at build time. Decoding is a single linear pass with no
+ * intermediate buffers, so loading is bound by the file read.
+ */
+
+#define QOI_HEADER_SIZE 14
+
+/* Returns 1 if buf starts with a valid QOI header and fills w/h. */
+int qoi_probe(const uint8_t *buf, size_t len, int *w, int *h);
+/* Decode into out (w*h ARGB). Returns 0 on success, -1 on corrupt data. */
+int qoi_decode(const uint8_t *buf, size_t len, uint32_t *out, int w, int h);
+
+#endif
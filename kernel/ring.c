@@ -0,0 +1,110 @@
+#include "ring.h"
+#include "lib.h"
+
+#define LOAD_ACQ(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE_REL(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+int ring_init(struct ring *r, void *buf, uint32_t size, uint32_t elem) {
+    if (!r || !buf || size == 0 || (size & (size - 1)) || elem == 0) return -1;
+    r->buf = buf;
+    r->size = size;
+    r->mask = size - 1;
+    r->elem = elem;
+    r->head = 0;
+    r->tail = 0;
+    r->dropped = 0;
+    return 0;
+}
+
+void ring_reset(struct ring *r) {
+    STORE_REL(&r->tail, LOAD_ACQ(&r->head));
+}
+
+typedef uint32_t __attribute__((may_alias, aligned(1))) ring_u32;
+typedef uint64_t __attribute__((may_alias, aligned(1))) ring_u64;
+
+/* One element: the common sizes avoid a memcpy call per byte or event */
+static inline void elem_copy(void *dst, const void *src, uint32_t elem) {
+    switch (elem) {
+    case 1: *(uint8_t *)dst = *(const uint8_t *)src; break;
+    case 4: *(ring_u32 *)dst = *(const ring_u32 *)src; break;
+    case 8: *(ring_u64 *)dst = *(const ring_u64 *)src; break;
+    default: memcpy(dst, src, elem); break;
+    }
+}
+
+int ring_push(struct ring *r, const void *e) {
+    uint32_t head = r->head;
+    /* acquire: the consumer has finished reading the slot it released */
+    if (head - LOAD_ACQ(&r->tail) >= r->size) {
+        r->dropped++;
+        return 0;
+    }
+    elem_copy(r->buf + (size_t)(head & r->mask) * r->elem, e, r->elem);
+    STORE_REL(&r->head, head + 1);
+    return 1;
+}
+
+int ring_pop(struct ring *r, void *e) {
+    uint32_t tail = r->tail;
+    if (LOAD_ACQ(&r->head) == tail) return 0;
+    elem_copy(e, r->buf + (size_t)(tail & r->mask) * r->elem, r->elem);
+    STORE_REL(&r->tail, tail + 1);
+    return 1;
+}
+
+uint32_t ring_push_bulk(struct ring *r, const void *src, uint32_t n) {
+    uint32_t head = r->head;
+    uint32_t space = r->size - (head - LOAD_ACQ(&r->tail));
+    if (n > space) {
+        r->dropped += n - space;
+        n = space;
+    }
+    if (n == 0) return 0;
+
+    /* at most two runs: up to the end of the buffer, then from the start */
+    uint32_t at = head & r->mask;
+    uint32_t first = r->size - at < n ? r->size - at : n;
+    memcpy(r->buf + (size_t)at * r->elem, src, (size_t)first * r->elem);
+    if (n > first)
+        memcpy(r->buf, (const uint8_t *)src + (size_t)first * r->elem, (size_t)(n - first) * r->elem);
+    STORE_REL(&r->head, head + n);
+    return n;
+}
+
+uint32_t ring_pop_bulk(struct ring *r, void *dst, uint32_t n) {
+    uint32_t tail = r->tail;
+    uint32_t avail = LOAD_ACQ(&r->head) - tail;
+    if (n > avail) n = avail;
+    if (n == 0) return 0;
+
+    uint32_t at = tail & r->mask;
+    uint32_t first = r->size - at < n ? r->size - at : n;
+    memcpy(dst, r->buf + (size_t)at * r->elem, (size_t)first * r->elem);
+    if (n > first)
+        memcpy((uint8_t *)dst + (size_t)first * r->elem, r->buf, (size_t)(n - first) * r->elem);
+    STORE_REL(&r->tail, tail + n);
+    return n;
+}
+
+uint32_t ring_peek(const struct ring *r, void **seg) {
+    uint32_t tail = r->tail;
+    uint32_t avail = LOAD_ACQ(&r->head) - tail;
+    uint32_t at = tail & r->mask;
+    if (avail > r->size - at) avail = r->size - at;
+    *seg = r->buf + (size_t)at * r->elem;
+    return avail;
+}
+
+void ring_consume(struct ring *r, uint32_t n) {
+    /* release: the producer may reuse the slots only after we are done reading */
+    STORE_REL(&r->tail, r->tail + n);
+}
+
+uint32_t ring_count(const struct ring *r) {
+    return LOAD_ACQ(&r->head) - LOAD_ACQ(&r->tail);
+}
+
+uint32_t ring_space(const struct ring *r) {
+    return r->size - ring_count(r);
+}
@@ -0,0 +1,57 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdint.h>
+
+/* Lock-free single-producer / single-consumer ring of fixed-size elements.
+ *
+ * head and tail are free-running counters: head is only written by the
+ * producer, tail only by the consumer, and each publishes its side with a
+ * release store that the other side reads with an acquire load. One
+ * producer context and one consumer context may therefore run against
+ * each other without any lock or IRQ masking, including from IRQ
+ * handlers. Tasks never preempt one another, so several tasks on the same
+ * side count as one context; an IRQ handler and a task on the same side
+ * do not and have to be serialized by the caller.
+ *
+ * size must be a power of two; buf holds size * elem bytes. */
+struct ring {
+    uint8_t *buf;
+    uint32_t size;
+    uint32_t mask;
+    uint32_t elem;
+    volatile uint32_t head;     /* next element to write (producer) */
+    volatile uint32_t tail;     /* next element to read (consumer) */
+    volatile uint32_t dropped;  /* elements refused because the ring was full (producer) */
+};
+
+/* Static initializer for a ring over an array (n a power of two) */
+#define RING_INIT(arr, n) { (uint8_t *)(arr), (n), (n) - 1, sizeof((arr)[0]), 0, 0, 0 }
+
+/* Returns -1 if size is not a power of two */
+int ring_init(struct ring *r, void *buf, uint32_t size, uint32_t elem);
+/* Empty the ring (consumer side, or while nothing else uses it) */
+void ring_reset(struct ring *r);
+
+/* 1 if stored, 0 if full (counted in dropped) */
+int ring_push(struct ring *r, const void *e);
+/* 1 if an element was taken, 0 if empty */
+int ring_pop(struct ring *r, void *e);
+/* Store up to n elements, returns how many fit; the rest count as dropped */
+uint32_t ring_push_bulk(struct ring *r, const void *src, uint32_t n);
+/* Take up to n elements, returns how many */
+uint32_t ring_pop_bulk(struct ring *r, void *dst, uint32_t n);
+
+/* Zero-copy consumer access: *seg points at the oldest elements and the
+ * return value is how many are contiguous there (0 if empty; a wrapped
+ * ring takes two peeks). They stay valid until ring_consume releases
+ * them, which must not be more than were peeked. */
+uint32_t ring_peek(const struct ring *r, void **seg);
+void ring_consume(struct ring *r, uint32_t n);
+
+/* Snapshots; exact for the side that owns the other counter */
+uint32_t ring_count(const struct ring *r);
+uint32_t ring_space(const struct ring *r);
+static inline int ring_empty(const struct ring *r) { return ring_count(r) == 0; }
+
+#endif
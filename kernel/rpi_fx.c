@@ -2,6 +2,10 @@
 #include "uart.h"
 #include "framebuffer.h"
 #include "debug_overlay.h"
+#include "kmalloc.h"
+#include "mmu.h"
+#include "pixel.h"
+#include "lib.h"
 #include <stddef.h>
 #include <stdint.h>
 
@@ -45,14 +49,28 @@ uint32_t mailbox_clock_rate(uint32_t clock_id) {
     return 0;
 }
 
+/* The VideoCore reads and writes the buffer in RAM; once the D-cache is on
+ * it must be pushed out before the call and dropped after the reply. */
+static void mbox_cache_sync(volatile unsigned int *buffer) {
+    uintptr_t start = (uintptr_t)buffer & ~63ULL;
+    uintptr_t end = (uintptr_t)buffer + buffer[0];
+    for (uintptr_t p = start; p < end; p += 64) {
+        __asm__ volatile("dc civac, %0" : : "r" (p) : "memory");
+    }
+    __asm__ volatile("dsb sy" ::: "memory");
+}
+
 int mbox_call(unsigned char ch, volatile unsigned int *buffer) {
     unsigned int r = ((unsigned int)((unsigned long)buffer) & ~0xF) | (ch & 0xF);
+    mbox_cache_sync(buffer);
     while (MBOX_STATUS & MBOX_FULL);
     MBOX_WRITE = r;
     while (1) {
         while (MBOX_STATUS & MBOX_EMPTY);
-        if (MBOX_READ == r)
+        if (MBOX_READ == r) {
+            mbox_cache_sync(buffer);
             return buffer[1] == 0x80000000;
+        }
     }
 }
 
@@ -100,7 +118,25 @@ void rpi_gpio16_off(void) {
 }
 
 static int rpi_fb_w, rpi_fb_h, rpi_fb_pitch;
-static void *rpi_fb_addr;
+static void *rpi_fb_addr;       /* what the GPU scans out */
+static int rpi_fb_depth = 0;    /* 32 or 16 bpp */
+/* Scanout mapped write-back (flushes clean each row) or Normal-NC
+ * (write-combined, flushes need no cache maintenance) */
+static int rpi_fb_cached = 1;
+
+/* RGB565 mode: everything is composed in ARGB8888 in this shadow buffer
+ * and only converted (optionally dithered) when a rect is flushed, so the
+ * scanout buffer and its cache maintenance cost half as much. */
+static uint32_t *rpi_shadow = NULL;
+static int rpi_dither = 1;
+
+/* 4x4 ordered-dither thresholds, 0..15 */
+static const uint8_t bayer4[4][4] = {
+    {  0,  8,  2, 10 },
+    { 12,  4, 14,  6 },
+    {  3, 11,  1,  9 },
+    { 15,  7, 13,  5 },
+};
 
 int rpi_init(void) {
     // Exact sequence from working test
@@ -110,7 +146,21 @@ int rpi_init(void) {
     return 0;
 }
 
-int rpi_gpu_init(void) {
+/* Map the scanout buffer with the current memory type. Before mmu_init
+ * this is left to the boot identity map (write-back). */
+static void rpi_fb_apply_type(void) {
+    if (!mmu_get_kernel_pgd() || !rpi_fb_addr) return;
+    uintptr_t a = (uintptr_t)rpi_fb_addr;
+    size_t size = (size_t)rpi_fb_pitch * rpi_fb_h;
+    if (mmu_map_range(a, a, size, rpi_fb_cached ? MMU_NORMAL_WB : MMU_NORMAL_NC) < 0 && !rpi_fb_cached) {
+        /* flushes must keep cleaning whatever is still cacheable */
+        rpi_fb_cached = 1;
+        mmu_map_range(a, a, size, MMU_NORMAL_WB);
+    }
+}
+
+/* (Re)allocate the scanout buffer at the given depth */
+static int rpi_gpu_alloc(int depth) {
     mbox[0] = 35 * 4;
     mbox[1] = 0;
 
@@ -132,7 +182,7 @@ int rpi_gpu_init(void) {
     mbox[12] = 0x48005;
     mbox[13] = 4;
     mbox[14] = 0;
-    mbox[15] = 32;
+    mbox[15] = depth;
 
     // Tag 4: Set pixel order
     mbox[16] = 0x48006;
@@ -157,17 +207,104 @@ int rpi_gpu_init(void) {
 
     if (!mbox_call(MBOX_CH_PROP, (unsigned int *)mbox))
         return -1;
+    if ((int)mbox[15] != depth || mbox[23] == 0)
+        return -1;
 
     rpi_fb_w = mbox[5];
     rpi_fb_h = mbox[6];
     rpi_fb_pitch = mbox[28];
     rpi_fb_addr = (void *)((uintptr_t)mbox[23] & 0x3FFFFFFF);
+    rpi_fb_depth = depth;
+    rpi_fb_apply_type();
+    return 0;
+}
+
+int rpi_gpu_init(void) {
+    /* Boot at 32 bpp: RGB565 needs a kmalloc'd shadow, see rpi_gpu_set_depth */
+    if (rpi_gpu_alloc(32) < 0)
+        return -1;
+    fb_init(rpi_fb_addr, rpi_fb_w, rpi_fb_h, rpi_fb_pitch);
+    return 0;
+}
+
+int rpi_gpu_get_depth(void) { return rpi_fb_depth; }
+int rpi_gpu_get_dither(void) { return rpi_dither; }
+int rpi_gpu_get_cached(void) { return rpi_fb_cached; }
+
+int rpi_gpu_set_cached(int cached) {
+    if (!rpi_fb_addr || !mmu_get_kernel_pgd()) return -1;
+    cached = cached ? 1 : 0;
+    if (cached == rpi_fb_cached) return 0;
+    rpi_fb_cached = cached;
+    rpi_fb_apply_type();
+    return rpi_fb_cached == cached ? 0 : -1;
+}
+
+void rpi_gpu_set_dither(int on) {
+    rpi_dither = on ? 1 : 0;
+    if (rpi_shadow) rpi_gpu_flush();
+}
+
+int rpi_gpu_set_depth(int depth) {
+    if (depth != 16 && depth != 32) return -1;
+    if (!rpi_fb_addr) return -1;
+    if (depth == rpi_fb_depth) return 0;
+
+    int w = rpi_fb_w, h = rpi_fb_h;
+    uint32_t *shadow = rpi_shadow;
+    if (depth == 16) {
+        /* Keep what is on screen: the 32 bpp scanout becomes the shadow */
+        shadow = kmalloc((size_t)w * h * 4);
+        if (!shadow) return -1;
+        for (int y = 0; y < h; y++)
+            memcpy(shadow + (size_t)y * w, (uint8_t *)rpi_fb_addr + (size_t)y * rpi_fb_pitch, (size_t)w * 4);
+    }
+
+    int old_depth = rpi_fb_depth;
+    if (rpi_gpu_alloc(depth) < 0) {
+        if (depth == 16) kfree(shadow);
+        if (rpi_gpu_alloc(old_depth) == 0 && old_depth == 32)
+            fb_set_target(rpi_fb_addr, rpi_fb_w, rpi_fb_h, rpi_fb_pitch);
+        return -1;
+    }
+
+    if (depth == 16) {
+        rpi_shadow = shadow;
+        fb_set_target(rpi_shadow, w, h, w * 4);
+    } else {
+        fb_set_target(rpi_fb_addr, rpi_fb_w, rpi_fb_h, rpi_fb_pitch);
+        for (int y = 0; y < h; y++)
+            memcpy((uint8_t *)rpi_fb_addr + (size_t)y * rpi_fb_pitch, shadow + (size_t)y * w, (size_t)w * 4);
+        rpi_shadow = NULL;
+        kfree(shadow);
+    }
+    rpi_gpu_flush();
+    return 0;
+}
 
-    if (rpi_fb_addr) {
-        fb_init(rpi_fb_addr, rpi_fb_w, rpi_fb_h, rpi_fb_pitch);
-        return 0;
+/* Shadow -> RGB565 scanout for one clipped rect */
+static void rpi_convert_rect(int x, int y, int w, int h) {
+    for (int ry = y; ry < y + h; ry++) {
+        const uint32_t *s = rpi_shadow + (size_t)ry * rpi_fb_w + x;
+        uint16_t *d = (uint16_t *)((uint8_t *)rpi_fb_addr + (size_t)ry * rpi_fb_pitch) + x;
+        if (!rpi_dither) {
+            pix_pack_rgb565(d, s, w);
+            continue;
+        }
+        const uint8_t *t = bayer4[ry & 3];
+        for (int i = 0; i < w; i++) {
+            uint32_t c = s[i];
+            int k = t[(x + i) & 3];
+            /* 5-bit channels drop 3 bits (step 8), green drops 2 (step 4) */
+            uint32_t r = ((c >> 16) & 0xFF) + (k >> 1);
+            uint32_t g = ((c >> 8) & 0xFF) + (k >> 2);
+            uint32_t b = (c & 0xFF) + (k >> 1);
+            if (r > 255) r = 255;
+            if (g > 255) g = 255;
+            if (b > 255) b = 255;
+            d[i] = (uint16_t)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+        }
     }
-    return -1;
 }
 
 void rpi_gpu_flush_rect(int x, int y, int w, int h) {
@@ -178,10 +315,19 @@ void rpi_gpu_flush_rect(int x, int y, int w, int h) {
     if (y + h > rpi_fb_h) h = rpi_fb_h - y;
     if (w <= 0 || h <= 0) return;
 
+    int bpp = rpi_fb_depth / 8;
+    if (rpi_shadow) rpi_convert_rect(x, y, w, h);
+
+    /* Normal-NC scanout: the writes only have to drain */
+    if (!rpi_fb_cached) {
+        __asm__ volatile("dsb sy" ::: "memory");
+        return;
+    }
+
     /* Flush each row in the rectangle */
     for (int ry = y; ry < y + h; ry++) {
-        uintptr_t row_start = (uintptr_t)rpi_fb_addr + (ry * rpi_fb_pitch) + (x * 4);
-        uintptr_t row_end = row_start + (w * 4);
+        uintptr_t row_start = (uintptr_t)rpi_fb_addr + (ry * rpi_fb_pitch) + (x * bpp);
+        uintptr_t row_end = row_start + (w * bpp);
         
         // Align to 64 bytes
         uintptr_t start = row_start & ~63ULL;
@@ -16,6 +16,17 @@ int rpi_gpu_get_height(void);
 int rpi_input_init(void);
 void rpi_input_poll(void);
 void rpi_gpu_flush_rect(int,int,int,int);
+/* Scanout depth: 32 (ARGB8888) or 16 (RGB565, composed in an ARGB shadow
+ * and converted on flush). Needs kmalloc, so call after boot. */
+int rpi_gpu_set_depth(int depth);
+int rpi_gpu_get_depth(void);
+/* Ordered dithering for the RGB565 conversion (default on) */
+void rpi_gpu_set_dither(int on);
+int rpi_gpu_get_dither(void);
+/* Scanout mapping: 1 = write-back cacheable (flush cleans the D-cache),
+ * 0 = Normal non-cacheable (no maintenance). Needs the MMU up. */
+int rpi_gpu_set_cached(int cached);
+int rpi_gpu_get_cached(void);
 
 int rpi_blk_init(void);
 int rpi_blk_rw(uint64_t sector, void *buf, int write);
@@ -2,17 +2,24 @@
 #include "framebuffer.h"
 #include "kmalloc.h"
 #include "uart.h"
+#include "klog.h"
 #include "mmu.h"
 #include "palloc.h"
 #include <stdint.h>
 #include "lib.h"
 #include "lib.h"
 #include "timer.h"
+#include "hrtimer.h"
+#include "timepage.h"
+#include "shm.h"
+#include "uring.h"
+#include "etask.h"
 #include "irq.h"
 #include "palloc.h"
 #include "framebuffer.h"
 #include "virtio.h"
 #include "rpi_fx.h" 
+#include "simd.h"
 
 extern int screen_w, screen_h;
 
@@ -27,7 +34,8 @@ int task_kill(int id);
 enum block_reason {
     BLOCK_NONE = 0,
     BLOCK_TIMER,
-    BLOCK_EVENT
+    BLOCK_EVENT,
+    BLOCK_EVENT_TIMED   /* event wait that also ends at wake_tick */
 };
 
 struct task {
@@ -43,12 +51,15 @@ struct task {
     int is_running;
     int zombie;              /* marked for cleanup after context switch */
     void *tty;
+    void (*reap_fn)(void *arg);  /* undo whatever points into the stack */
+    void *reap_arg;
     
     void *stack; /* allocated kernel stack page */
     size_t stack_total_bytes;  /* total allocation including guard */
     struct task_context context;
     
     uint64_t *pgd;
+    uintptr_t user_arg;      /* x0 on the first entry to EL0 */
     
     int parent_id; /* ID of parent task */
     struct task *next;
@@ -62,6 +73,7 @@ static int next_task_id = 1;
 static int scheduler_tick = 0;
 static int total_run_counts = 0;
 static volatile int preempt_requested = 0;
+static struct task *urgent_task = NULL; /* runs ahead of the round robin (irqd) */
 
 /* Event waiting system */
 struct event_waiter {
@@ -166,14 +178,9 @@ int task_create_with_stack(task_fn fn, void *arg, const char *name, size_t stack
     } else {
         /* DEBUG: Validate list BEFORE insertion */
         if (!task_head->next || ((uintptr_t)task_head->next & 7) != 0) {
-#ifdef DEBUG
-            uart_puts("[sched] LIST CORRUPT BEFORE insert! head_addr=");
-            uart_put_hex((uint32_t)(uintptr_t)task_head);
-            uart_puts(" head->next=");
-            uart_put_hex((uint32_t)(uintptr_t)task_head->next);
-            uart_puts(" head_id="); uart_put_hex(task_head->id);
-            uart_puts("\n");
-#endif
+            KLOG(KLOG_SCHED, KLOG_ERR, "list corrupt before insert! head=%p head->next=%p head_id=%d",
+                 (void *)task_head, (void *)task_head->next, task_head->id);
+            klog_flush_console();
             while(1);
         }
         
@@ -187,9 +194,8 @@ int task_create_with_stack(task_fn fn, void *arg, const char *name, size_t stack
         int count = 0;
         do {
             if (!v || ((uintptr_t)v & 7) != 0 || count > 100) {
-#ifdef DEBUG
-                uart_puts("[sched] LIST CORRUPT after insert!\n");
-#endif
+                KLOG(KLOG_SCHED, KLOG_ERR, "list corrupt after insert!");
+                klog_flush_console();
                 while(1);
             }
             count++;
@@ -198,17 +204,18 @@ int task_create_with_stack(task_fn fn, void *arg, const char *name, size_t stack
     }
     
     if (t->context.x19 == 0) {
-#ifdef DEBUG
-        uart_puts("[sched] FATAL: x19 is 0 in task_create! fn=");
-        uart_put_hex((uint32_t)(uintptr_t)fn);
-        uart_puts("\n");
-#endif
+        KLOG(KLOG_SCHED, KLOG_ERR, "x19 is 0 in task_create! fn=%p", (void *)fn);
+        klog_flush_console();
         while(1);
     }
 
     return t->id;
 }
 
+size_t task_footprint(size_t stack_kb) {
+    return sizeof(struct task) + STACK_GUARD_SIZE + stack_kb * 1024;
+}
+
 /* Default: 16KB stack for most tasks */
 int task_create(task_fn fn, void *arg, const char *name) {
     return task_create_with_stack(fn, arg, name, 16);
@@ -218,19 +225,21 @@ static void enter_user_mode(void *entry_point) {
     /* User Stack fixed at start of User Space + 1MB for now */
     uint64_t sp = USER_SPACE_START + 0x100000;
     
+    register uint64_t x0 __asm__("x0") = task_cur->user_arg;
+    
     /* Clear SPSR (EL0t), Set ELR (Entry), Set SP_EL0 */
     /* Ensure PSTATE interrupts are enabled in SPSR (bits 6,7,8=0 means enabled) */
     __asm__ volatile(
-        "msr sp_el0, %0\n"
-        "msr elr_el1, %1\n"
-        "msr spsr_el1, %2\n"
+        "msr sp_el0, %1\n"
+        "msr elr_el1, %2\n"
+        "msr spsr_el1, %3\n"
         "eret\n"
-        : : "r"(sp), "r"(entry_point), "r"(0) : "memory");
+        : : "r"(x0), "r"(sp), "r"(entry_point), "r"(0) : "memory");
     
     __builtin_unreachable();
 }
 
-int task_create_user(const char *name, void *entry_point) {
+int task_create_user(const char *name, void *entry_point, uintptr_t arg) {
     /* Create basic task structure used enter_user_mode as placeholder to avoid x19=0 panic */
     /* Stack size 16KB to prevent overflow during syscalls + IRQs */
     int pid = task_create_with_stack((task_fn)enter_user_mode, NULL, name, 16); 
@@ -275,6 +284,9 @@ int task_create_user(const char *name, void *entry_point) {
     
     mmu_map_page(t->pgd, stack_va, (uintptr_t)stack_page, flags);
 
+    /* clock data for utime.h */
+    time_page_map(t->pgd);
+
     /* Map the Entry Point? 
        For now, we assume the entry point is already mapped or 
        passed as a pointer to code we will copy? 
@@ -300,6 +312,8 @@ int task_create_user(const char *name, void *entry_point) {
     uintptr_t entry_offset = code_pa & 0xFFF;
     uintptr_t user_entry = USER_SPACE_START + entry_offset;
 
+    t->user_arg = arg;
+
     /* Update Task Context to start at enter_user_mode */
     t->context.x19 = (uint64_t)enter_user_mode;
     t->context.x20 = (uint64_t)user_entry; /* Pass User VA */
@@ -363,6 +377,10 @@ static void reap_zombies(void) {
                 /* Capture ID before freeing structure */
                 int zombie_id = t->id;
                 
+                if (to_free == urgent_task) urgent_task = NULL;
+                if (to_free->reap_fn) to_free->reap_fn(to_free->reap_arg);
+                shm_task_exit(zombie_id);
+                uring_task_exit(zombie_id);
                 if (to_free->stack) kfree(to_free->stack);
                 if (to_free->pgd) mmu_free_user_pgd(to_free->pgd);
                 kfree(to_free);
@@ -406,11 +424,16 @@ void schedule(void) {
     DBG_TEXT(600, "Schedule: Entered...", 0xFFFFFFFF);
     
     reap_zombies();
+
+    /* the FP/SIMD registers are not part of the task context */
+    if (kernel_neon_busy()) _uart_puts("[sched] BUG: schedule() inside a kernel NEON region\n");
     
     DBG_TEXT(620, "Schedule: Reaped.", 0xFFFFFFFF);
     
     /* update timer and dispatch polled IRQs */
     timer_poll_and_advance();
+    /* expired hrtimer callbacks run here, between tasks */
+    hrtimer_run();
     
     // Explicitly poll input and IO to ensure responsiveness
     extern void irq_poll_and_dispatch(void);
@@ -516,6 +539,10 @@ void schedule(void) {
         }
     }
 
+    /* the urgent task goes first whenever it is runnable; not twice in a
+       row, so it cannot starve the rest by yielding */
+    if (urgent_task && urgent_task->fn != NULL && urgent_task != prev) next = urgent_task;
+
     if (!next || next->fn == NULL) {
          DBG_TEXT(700, "Return: No Next Found", 0xFFAAAAAA);
          irq_restore(sched_flags);
@@ -612,10 +639,7 @@ static void kill_children_of(int parent_id) {
     /* Marking children as zombies is fast and safe because no memory is freed yet */
     do {
         if (t->parent_id == parent_id && t->id != parent_id && !t->zombie) {
-#ifdef DEBUG
-            uart_puts("[sched] Reaping child id="); uart_put_hex(t->id); 
-            uart_puts(" ("); uart_puts(t->name); uart_puts(") due to parent exit\n");
-#endif
+            KLOG(KLOG_SCHED, KLOG_DEBUG, "reaping child id=%d (%s) due to parent exit", t->id, t->name);
             t->zombie = 1;
             t->fn = NULL;
             /* Recurse to kill grandchildren */
@@ -677,6 +701,16 @@ void task_exit(int code) {
     for(;;) yield();
 }
 
+void task_set_reap_hook(void (*fn)(void *arg), void *arg) {
+    if (!task_cur || task_cur == &boot_task) return;
+    task_cur->reap_fn = fn;
+    task_cur->reap_arg = arg;
+}
+
+uint64_t *task_current_pgd(void) {
+    return task_cur ? task_cur->pgd : NULL;
+}
+
 int task_current_id(void) {
     if (!task_cur) return -1;
     return task_cur->id;
@@ -711,6 +745,19 @@ int task_set_fn_null(int id) {
     return -1;
 }
 
+int task_set_urgent(int id) {
+    if (!task_head) return -1;
+    struct task *t = task_head;
+    do {
+        if (t->id == id) {
+            urgent_task = t;
+            return 0;
+        }
+        t = t->next;
+    } while (t && t != task_head);
+    return -1;
+}
+
 int task_set_parent(int id, int parent_id) {
     if (!task_head) return -1;
     struct task *t = task_head;
@@ -735,6 +782,11 @@ void task_block_current_until(uint32_t wake_tick) {
 }
 
 void task_wait_event(void *event_id) {
+    task_wait_event_unless(event_id, NULL, 0);
+}
+
+static void wait_event(void *event_id, volatile uint32_t *gen, uint32_t seen,
+                       int timed, uint32_t wake_tick) {
     if (!task_cur) return;
     
     struct event_waiter *w = kmalloc(sizeof(*w));
@@ -743,15 +795,42 @@ void task_wait_event(void *event_id) {
     w->event_id = event_id;
     
     unsigned long flags = irq_save();
+    if (gen && *gen != seen) {
+        /* signaled after the caller looked: do not sleep through it */
+        irq_restore(flags);
+        kfree(w);
+        return;
+    }
     w->next = wait_list;
     wait_list = w;
     
     task_cur->saved_fn = task_cur->fn;
     task_cur->fn = NULL;
-    task_cur->block_type = BLOCK_EVENT;
+    task_cur->wake_tick = wake_tick;
+    task_cur->block_type = timed ? BLOCK_EVENT_TIMED : BLOCK_EVENT;
     irq_restore(flags);
     
     schedule();
+
+    if (timed) {
+        /* woken by the deadline: the waiter is still queued (w itself may
+         * already be freed and reused, so match on task and event) */
+        int me = task_cur->id;
+        flags = irq_save();
+        struct event_waiter **prev = &wait_list;
+        for (struct event_waiter *c = wait_list; c; prev = &c->next, c = c->next) {
+            if (c->task_id == me && c->event_id == event_id) { *prev = c->next; kfree(c); break; }
+        }
+        irq_restore(flags);
+    }
+}
+
+void task_wait_event_unless(void *event_id, volatile uint32_t *gen, uint32_t seen) {
+    wait_event(event_id, gen, seen, 0, 0);
+}
+
+void task_wait_event_until(void *event_id, volatile uint32_t *gen, uint32_t seen, uint32_t wake_tick) {
+    wait_event(event_id, gen, seen, 1, wake_tick);
 }
 
 void task_wake_event(void *event_id) {
@@ -787,6 +866,7 @@ void task_wake_event(void *event_id) {
         }
     }
     irq_restore(flags);
+    etask_wake_event(event_id);
 }
 
 void scheduler_tick_advance(uint32_t delta_ms) {
@@ -798,15 +878,14 @@ void scheduler_tick_advance(uint32_t delta_ms) {
     do {
         /* Safety check: ensure t is a valid pointer (8-byte aligned at least) */
         if (((uintptr_t)t & 7) != 0) {
-#ifdef DEBUG
-            uart_puts("[sched] PANIC: Corrupted task list in tick! t=");
-            uart_put_hex((uint32_t)(uintptr_t)t);
-            uart_puts("\n");
-#endif
+            KLOG(KLOG_SCHED, KLOG_ERR, "corrupted task list in tick! t=%p", (void *)t);
+            klog_flush_console();
             while(1);
         }
 
-        if (t->fn == NULL && t->saved_fn != NULL && t->block_type == BLOCK_TIMER && (int)t->wake_tick <= scheduler_tick) {
+        if (t->fn == NULL && t->saved_fn != NULL &&
+            (t->block_type == BLOCK_TIMER || t->block_type == BLOCK_EVENT_TIMED) &&
+            (int)t->wake_tick <= scheduler_tick) {
             t->fn = t->saved_fn;
             t->saved_fn = NULL;
             t->block_type = BLOCK_NONE;
@@ -854,8 +933,7 @@ int task_list(int *out, int max) {
 
 void scheduler_ret_from_fork_debug(void) {
     if (task_cur) {
-        uart_puts("[sched] TASK_ENTRY: "); uart_puts(task_cur->name);
-        uart_puts(" (id="); uart_put_hex(task_cur->id); uart_puts(")\n");
+        KLOG(KLOG_SCHED, KLOG_DEBUG, "task entry: %s (id=%d)", task_cur->name, task_cur->id);
     }
 }
 
@@ -25,16 +25,26 @@ typedef void (*task_fn)(void *arg);
 int scheduler_init(void);
 int task_create(task_fn fn, void *arg, const char *name);
 int task_create_with_stack(task_fn fn, void *arg, const char *name, size_t stack_kb);
-int task_create_user(const char *name, void *entry_point);
+/* entry_point runs at EL0 from the one page it sits in, with arg in x0 */
+int task_create_user(const char *name, void *entry_point, uintptr_t arg);
+/* Bytes a kernel task with this stack takes (struct, guard and stack) */
+size_t task_footprint(size_t stack_kb);
 void schedule(void);
 void yield(void);
 int task_kill(int id);
 int task_exists(int id);
 int task_current_id(void);
+/* Page tables of the current task; NULL for kernel tasks */
+uint64_t *task_current_pgd(void);
 void task_set_tty(int id, void *tty);
 void* task_get_tty(int id);
 int task_set_fn_null(int id);
 int task_set_parent(int id, int parent_id);  /* Change task's parent */
+/* Let task id run ahead of all others whenever it is runnable (one task) */
+int task_set_urgent(int id);
+/* Run fn(arg) if the current task is reaped before it clears the hook
+ * (fn NULL), e.g. to unlink structures living on its stack */
+void task_set_reap_hook(void (*fn)(void *arg), void *arg);
 /* block current task until tick (monotonic) */
 void task_block_current_until(uint32_t wake_tick);
 /* advance scheduler tick (called by timer) and wake tasks */
@@ -45,6 +55,12 @@ uint32_t scheduler_get_tick(void);
 void scheduler_request_preempt(void);
 /* block current task until an event is signaled */
 void task_wait_event(void *event_id);
+/* Same, unless *gen no longer equals `seen`. The test is made with IRQs
+ * masked, so a producer that bumps *gen and then wakes event_id from an
+ * IRQ handler cannot slip in between the caller's check and the sleep. */
+void task_wait_event_unless(void *event_id, volatile uint32_t *gen, uint32_t seen);
+/* task_wait_event_unless that also returns once the tick reaches wake_tick */
+void task_wait_event_until(void *event_id, volatile uint32_t *gen, uint32_t seen, uint32_t wake_tick);
 /* wake all tasks waiting on an event */
 void task_wake_event(void *event_id);
 /* collect task ids into out array, return count (max entries limited by 'max') */
@@ -60,5 +76,9 @@ void scheduler_switch_debug(uint64_t lr, uint64_t sp);
  * Using small integers cast to pointers to avoid string literal address mismatches. */
 #define WM_EVENT_ID    ((void*)0x100)
 #define MOUSE_EVENT_ID ((void*)0x200)
+#define THUMB_EVENT_ID ((void*)0x300)
+#define USB_EVENT_ID   ((void*)0x400)
+#define UART_EVENT_ID  ((void*)0x500)
+#define VCON_EVENT_ID  ((void*)0x600)
 
 #endif
@@ -5,6 +5,9 @@
 #include "sched.h"
 #include "programs.h"
 #include "uart.h"
+#include "chan.h"
+#include "palloc.h"
+#include "klog.h"
 #include <string.h>
 #include <stddef.h>
 
@@ -18,10 +21,16 @@ struct service_entry {
     int redir_append;
     int enabled;
     int pid; /* task id of running service, 0 if not running */
+    /* kept by the manager task */
+    uint32_t runs;
+    uint32_t out_bytes; /* output of the last run */
+    int failed;
+    uint32_t id; /* never reused; what messages to the manager carry */
     struct service_entry *next;
 };
 
 static struct service_entry *services = NULL;
+static uint32_t next_service_id = 1;
 
 static struct service_entry *find_service(const char *name) {
     for (struct service_entry *s = services; s; s = s->next) {
@@ -30,116 +39,78 @@ static struct service_entry *find_service(const char *name) {
     return NULL;
 }
 
+static struct service_entry *find_service_id(uint32_t id) {
+    for (struct service_entry *s = services; s; s = s->next) {
+        if (s->id == id) return s;
+    }
+    return NULL;
+}
+
 /* free_service_entry removed (unused) */
 
+/* Service tasks do not touch the table or ramfs themselves: they report to
+ * the "svcmgr" task over a channel, which keeps the run state, writes the
+ * output where the unit redirects it and answers status queries. Output
+ * travels as the page the program wrote into, without a copy. Messages
+ * name the unit by its id, never by pointer: the entry may be gone by
+ * the time the manager gets to them. */
+#define SVC_MSG_STARTED 1   /* data: id */
+#define SVC_MSG_OUTPUT  2   /* data: id, page: len bytes of output */
+#define SVC_MSG_EXITED  3   /* data: id, arg: 0 ran, 1 no such program */
+#define SVC_MSG_STATUS  4   /* call, data: id; reply page: status text */
+
+#define SVC_QUEUE       16
+#define SVC_STATUS_MS   1000
+
+static struct chan *svc_chan = NULL;
+static int svc_mgr_pid = 0;
+
+static void svc_send(uint32_t id, uint32_t type, uint32_t arg, void *page, uint32_t len) {
+    struct chan_msg m;
+    memset(&m, 0, sizeof(m));
+    m.type = type;
+    m.arg = arg;
+    m.page = page;
+    m.len = len;
+    memcpy(m.data, &id, sizeof(id));
+    if (chan_send(svc_chan, &m, -1) != CHAN_OK && page) chan_page_free(page);
+}
+
 /* service task wrapper: calls program function once and exits */
-struct svc_task_arg { char **argv; int argc; struct service_entry *svc; void *mem; };
+struct svc_task_arg { char **argv; int argc; uint32_t svc_id; void *mem; };
+
+/* the 'echo' fallback for when the program isn't registered */
+static int svc_echo(int argc, char **argv, char *out, size_t out_cap) {
+    size_t off = 0;
+    for (int ai = 1; ai < argc; ++ai) {
+        size_t l = strlen(argv[ai]);
+        if (off + l >= out_cap) l = out_cap - off - 1;
+        if (l > 0) { memcpy(out + off, argv[ai], l); off += l; }
+        if (ai + 1 < argc && off + 1 < out_cap) out[off++] = ' ';
+    }
+    return (int)off;
+}
 
 static void service_task_fn(void *arg) {
     struct svc_task_arg *a = (struct svc_task_arg *)arg;
-    /* debug: announce service task start */
-    if (!a->svc || !a->svc->redir_target) {
-        if (a && a->svc) {
-            uart_puts("[svc] task start: "); uart_puts(a->svc->name); uart_puts("\n");
-        } else {
-            uart_puts("[svc] task start: (no svc)\n");
-        }
-    }
-    /* find program and run it */
-    if (a->argc > 0) {
-        prog_fn_t pfn = NULL;
-        if (program_lookup(a->argv[0], &pfn) == 0 && pfn) {
-            if (!a->svc || !a->svc->redir_target) {
-                uart_puts("[svc] program found: "); uart_puts(a->argv[0]); uart_puts("\n");
-            }
-            char out[256];
-            int wrote = pfn(a->argc, a->argv, NULL, 0, out, sizeof(out));
-            if (wrote > 0) {
-                /* ensure NUL termination then print to console or file */
-                size_t w = (wrote < (int)sizeof(out)-1) ? (size_t)wrote : (size_t)sizeof(out)-1;
-                out[w] = '\0';
-                if (a->svc && a->svc->redir_target) {
-                    const char *tgt = a->svc->redir_target;
-                    char *full = NULL;
-                    if (tgt[0] == '/') {
-                        full = kmalloc(strlen(tgt) + 1);
-                        if (full) memcpy(full, tgt, strlen(tgt) + 1);
-                    } else {
-                        full = kmalloc(strlen(tgt) + 2);
-                        if (full) { full[0] = '/'; memcpy(full+1, tgt, strlen(tgt)+1); }
-                    }
-                    if (full) {
-                        /* ensure parent directory exists */
-                        size_t fl = strlen(full);
-                        if (fl > 1) {
-                            size_t i = fl - 1; while (i > 0 && full[i] != '/') --i;
-                            if (i > 0) {
-                                char parent[256]; size_t plen = (i < sizeof(parent)-2) ? i : (sizeof(parent)-2);
-                                memcpy(parent, full, plen); parent[plen] = '\0';
-                                ramfs_mkdir(parent);
-                            }
-                        }
-                        /* overwrite or create file */
-                        ramfs_remove(full);
-                        ramfs_create(full);
-                        ramfs_write(full, out, w, 0);
-                        if (!a->svc || !a->svc->redir_target) uart_puts("[svc] write complete\n");
-                        kfree(full);
-                    }
-                } else if (!a->svc || !a->svc->redir_target) {
-                    uart_puts(out);
-                }
-            } else if (!a->svc || !a->svc->redir_target) {
-                uart_puts("[svc] program wrote nothing\n");
-            }
-        } else {
-            if (!a->svc || !a->svc->redir_target) {
-                uart_puts("[svc] program lookup failed for: "); uart_puts(a->argv[0]); uart_puts("\n");
-            }
-            /* fallback for simple builtins like 'echo' when program isn't registered */
-            if (a->argc > 0 && strcmp(a->argv[0], "echo") == 0) {
-                if (!a->svc || !a->svc->redir_target) uart_puts("[svc] fallback echo\n");
-                char out[256]; size_t off = 0;
-                for (int ai = 1; ai < a->argc; ++ai) {
-                    size_t l = strlen(a->argv[ai]);
-                    if (off + l >= sizeof(out)) l = sizeof(out) - off - 1;
-                    if (l > 0) { memcpy(out + off, a->argv[ai], l); off += l; }
-                    if (ai + 1 < a->argc) { if (off + 1 < sizeof(out)) out[off++] = ' '; }
-                }
-                if (off < sizeof(out)) out[off] = '\0'; else out[sizeof(out)-1] = '\0';
-                if (a->svc && a->svc->redir_target) {
-                    const char *tgt = a->svc->redir_target;
-                    char *full = NULL;
-                    if (tgt[0] == '/') {
-                        full = kmalloc(strlen(tgt) + 1);
-                        if (full) memcpy(full, tgt, strlen(tgt) + 1);
-                    } else {
-                        full = kmalloc(strlen(tgt) + 2);
-                        if (full) { full[0] = '/'; memcpy(full+1, tgt, strlen(tgt)+1); }
-                    }
-                    if (full) {
-                        size_t fl = strlen(full);
-                        if (fl > 1) {
-                            size_t i = fl - 1; while (i > 0 && full[i] != '/') --i;
-                            if (i > 0) {
-                                char parent[256]; size_t plen = (i < sizeof(parent)-2) ? i : (sizeof(parent)-2);
-                                memcpy(parent, full, plen); parent[plen] = '\0'; ramfs_mkdir(parent);
-                            }
-                        }
-                        ramfs_remove(full);
-                        ramfs_create(full);
-                        ramfs_write(full, out, off, 0);
-                        if (!a->svc || !a->svc->redir_target) uart_puts("[svc] fallback write complete\n");
-                        kfree(full);
-                    }
-                } else if (!a->svc || !a->svc->redir_target) {
-                    uart_puts(out);
-                }
-            }
+    uint32_t id = a->svc_id;
+    svc_send(id, SVC_MSG_STARTED, 0, NULL, 0);
+
+    prog_fn_t pfn = NULL;
+    int found = a->argc > 0 && program_lookup(a->argv[0], &pfn) == 0 && pfn;
+    int echo = !found && a->argc > 0 && strcmp(a->argv[0], "echo") == 0;
+    if (found || echo) {
+        char *page = chan_page_alloc();
+        if (page) {
+            /* leave room for the manager to NUL-terminate */
+            int wrote = found ? pfn(a->argc, a->argv, NULL, 0, page, PAGE_SIZE - 1)
+                              : svc_echo(a->argc, a->argv, page, PAGE_SIZE - 1);
+            if (wrote > 0) svc_send(id, SVC_MSG_OUTPUT, 0, page, (uint32_t)wrote);
+            else chan_page_free(page);
         }
     }
-    /* mark service as stopped */
-    if (a->svc) a->svc->pid = 0;
+    svc_send(id, SVC_MSG_EXITED, (found || echo) ? 0 : 1, NULL, 0);
+
     /* disable future runs of this task (set fn to NULL) */
     int curid = task_current_id();
     if (curid > 0) task_set_fn_null(curid);
@@ -147,6 +118,148 @@ static void service_task_fn(void *arg) {
     if (a->mem) kfree(a->mem);
 }
 
+static void svc_write_output(struct service_entry *s, const char *out, size_t w) {
+    const char *tgt = s->redir_target;
+    char full[256];
+    size_t tl = strlen(tgt);
+    if (tl + 2 > sizeof(full)) return;
+    if (tgt[0] == '/') {
+        memcpy(full, tgt, tl + 1);
+    } else {
+        full[0] = '/';
+        memcpy(full + 1, tgt, tl + 1);
+    }
+    /* ensure parent directory exists */
+    size_t fl = strlen(full);
+    size_t i = fl - 1; while (i > 0 && full[i] != '/') --i;
+    if (i > 0) {
+        char parent[256];
+        memcpy(parent, full, i); parent[i] = '\0';
+        ramfs_mkdir(parent);
+    }
+    int size = ramfs_get_size(full);
+    if (s->redir_append && size >= 0) {
+        ramfs_write(full, out, w, (size_t)size);
+    } else {
+        /* overwrite or create file */
+        ramfs_remove(full);
+        ramfs_create(full);
+        ramfs_write(full, out, w, 0);
+    }
+}
+
+static void svc_utoa(uint32_t v, char *buf) {
+    char tmp[12]; int i = 0;
+    do { tmp[i++] = (char)('0' + v % 10); v /= 10; } while (v);
+    int j = 0; while (i > 0) buf[j++] = tmp[--i];
+    buf[j] = '\0';
+}
+
+static int svc_format_status(struct service_entry *s, char *tmp, size_t cap) {
+    size_t p = 0;
+    const char *label1 = "Name: ";
+    const char *label2 = "Unit: ";
+    const char *label3 = "Exec: ";
+    const char *label4 = "Enabled: ";
+    const char *label5 = "Active: ";
+    const char *label6 = "Runs: ";
+    const char *label7 = "Last output: ";
+    char num[16];
+    size_t l;
+    l = strlen(label1); if (p + l < cap) { memcpy(tmp + p, label1, l); p += l; }
+    l = strlen(s->name); if (p + l < cap) { memcpy(tmp + p, s->name, l); p += l; }
+    if (p + 1 < cap) tmp[p++] = '\n';
+
+    l = strlen(label2); if (p + l < cap) { memcpy(tmp + p, label2, l); p += l; }
+    const char *u = s->unit_path ? s->unit_path : "(none)"; l = strlen(u); if (p + l < cap) { memcpy(tmp + p, u, l); p += l; }
+    if (p + 1 < cap) tmp[p++] = '\n';
+
+    l = strlen(label3); if (p + l < cap) { memcpy(tmp + p, label3, l); p += l; }
+    const char *e = s->exec ? s->exec : "(none)"; l = strlen(e); if (p + l < cap) { memcpy(tmp + p, e, l); p += l; }
+    if (p + 1 < cap) tmp[p++] = '\n';
+
+    l = strlen(label4); if (p + l < cap) { memcpy(tmp + p, label4, l); p += l; }
+    const char *en = s->enabled ? "yes" : "no"; l = strlen(en); if (p + l < cap) { memcpy(tmp + p, en, l); p += l; }
+    if (p + 1 < cap) tmp[p++] = '\n';
+
+    l = strlen(label5); if (p + l < cap) { memcpy(tmp + p, label5, l); p += l; }
+    const char *ac = (s->pid != 0) ? "running" : (s->failed ? "failed" : "inactive"); l = strlen(ac); if (p + l < cap) { memcpy(tmp + p, ac, l); p += l; }
+    if (p + 1 < cap) tmp[p++] = '\n';
+
+    l = strlen(label6); if (p + l < cap) { memcpy(tmp + p, label6, l); p += l; }
+    svc_utoa(s->runs, num); l = strlen(num); if (p + l < cap) { memcpy(tmp + p, num, l); p += l; }
+    if (p + 1 < cap) tmp[p++] = '\n';
+
+    l = strlen(label7); if (p + l < cap) { memcpy(tmp + p, label7, l); p += l; }
+    svc_utoa(s->out_bytes, num); l = strlen(num); if (p + l < cap) { memcpy(tmp + p, num, l); p += l; }
+    const char *to = s->redir_target ? " bytes to " : " bytes to console"; l = strlen(to); if (p + l < cap) { memcpy(tmp + p, to, l); p += l; }
+    if (s->redir_target) { l = strlen(s->redir_target); if (p + l < cap) { memcpy(tmp + p, s->redir_target, l); p += l; } }
+    if (p + 1 < cap) tmp[p++] = '\n';
+    return (int)p;
+}
+
+static void svc_status_reply(struct chan_msg *m, struct service_entry *s) {
+    struct chan_msg r;
+    memset(&r, 0, sizeof(r));
+    r.page = chan_page_alloc();
+    if (!r.page) { chan_msg_drop(m); return; }
+    r.len = (uint32_t)svc_format_status(s, r.page, PAGE_SIZE);
+    chan_reply(m, &r);
+}
+
+static void svcmgr_task(void *arg) {
+    (void)arg;
+    struct chan_msg m;
+    while (chan_recv(svc_chan, &m, -1) == CHAN_OK) {
+        uint32_t id;
+        memcpy(&id, m.data, sizeof(id));
+        struct service_entry *s = find_service_id(id);
+        if (!s) {
+            /* the unit went away: free the output, fail a status call */
+            chan_msg_drop(&m);
+            continue;
+        }
+        switch (m.type) {
+        case SVC_MSG_STARTED:
+            s->runs++;
+            s->failed = 0;
+            KLOG(KLOG_SVC, KLOG_DEBUG, "%s: task %d started", s->name, m.sender);
+            break;
+        case SVC_MSG_OUTPUT:
+            ((char *)m.page)[m.len] = '\0';
+            s->out_bytes = m.len;
+            if (s->redir_target) svc_write_output(s, m.page, m.len);
+            else uart_puts(m.page);
+            break;
+        case SVC_MSG_EXITED:
+            /* a restart may already have started a newer task */
+            if (s->pid == m.sender) s->pid = 0;
+            if (m.arg) {
+                s->failed = 1;
+                KLOG(KLOG_SVC, KLOG_WARN, "%s: program not found", s->name);
+            }
+            break;
+        case SVC_MSG_STATUS:
+            svc_status_reply(&m, s);
+            break;
+        }
+        chan_msg_drop(&m);
+    }
+    svc_mgr_pid = 0;
+    task_set_fn_null(task_current_id());
+}
+
+/* The manager comes up with the first service that needs it */
+static int svc_manager(void) {
+    if (svc_mgr_pid > 0 && task_exists(svc_mgr_pid)) return 0;
+    if (!svc_chan) svc_chan = chan_create(SVC_QUEUE);
+    if (!svc_chan) return -1;
+    svc_mgr_pid = task_create(svcmgr_task, NULL, "svcmgr");
+    if (svc_mgr_pid <= 0) { svc_mgr_pid = 0; return -1; }
+    task_set_parent(svc_mgr_pid, 1);
+    return 0;
+}
+
 int services_init(void) {
     /* ensure directory exists */
     uart_puts("[svc] creating /etc...\n");
@@ -228,6 +341,7 @@ int service_load_unit(const char *path) {
         s = kmalloc(sizeof(*s));
         if (!s) { kfree(cmd); return -1; }
         memset(s, 0, sizeof(*s));
+        s->id = next_service_id++;
         strncpy(s->name, name, SRV_NAME_MAX-1);
         s->unit_path = kmalloc(strlen(path) + 1);
         memcpy(s->unit_path, path, strlen(path)+1);
@@ -293,6 +407,10 @@ int service_start(const char *name) {
     if (!s->redir_target) {
         uart_puts("[svc] starting: "); uart_puts(name); uart_puts("\n");
     }
+    if (svc_manager() < 0) {
+        uart_puts("[svc] start failed: no service manager\n");
+        return -1;
+    }
     /* parse exec into argv (simple split by spaces) and allocate one block
        to avoid many small kmallocs which fragment the heap. Block layout:
        [struct svc_task_arg][argv pointers array][strings buffer]
@@ -327,7 +445,7 @@ int service_start(const char *name) {
         if (*t == ' ') { *t = '\0'; ++t; }
     }
     argv[ai] = NULL;
-    arg->argv = argv; arg->argc = argc; arg->svc = s; arg->mem = block;
+    arg->argv = argv; arg->argc = argc; arg->svc_id = s->id; arg->mem = block;
     int pid = task_create(service_task_fn, arg, name);
     if (pid <= 0) {
         /* cleanup single block */
@@ -440,36 +558,25 @@ int service_status(const char *name, char *buf, size_t len) {
         const char *msg = "no such service\n";
         size_t m = strlen(msg); if (m >= len) m = len-1; if (m > 0) memcpy(buf, msg, m); if (len>0) buf[m]='\0'; return -1;
     }
-    /* write simple status info */
-    char tmp[256]; size_t p = 0;
-    const char *label1 = "Name: ";
-    const char *label2 = "Unit: ";
-    const char *label3 = "Exec: ";
-    const char *label4 = "Enabled: ";
-    const char *label5 = "Active: ";
-    size_t l;
-    l = strlen(label1); if (p + l < sizeof(tmp)) { memcpy(tmp + p, label1, l); p += l; }
-    l = strlen(s->name); if (p + l < sizeof(tmp)) { memcpy(tmp + p, s->name, l); p += l; }
-    if (p + 1 < sizeof(tmp)) tmp[p++] = '\n';
-
-    l = strlen(label2); if (p + l < sizeof(tmp)) { memcpy(tmp + p, label2, l); p += l; }
-    const char *u = s->unit_path ? s->unit_path : "(none)"; l = strlen(u); if (p + l < sizeof(tmp)) { memcpy(tmp + p, u, l); p += l; }
-    if (p + 1 < sizeof(tmp)) tmp[p++] = '\n';
-
-    l = strlen(label3); if (p + l < sizeof(tmp)) { memcpy(tmp + p, label3, l); p += l; }
-    const char *e = s->exec ? s->exec : "(none)"; l = strlen(e); if (p + l < sizeof(tmp)) { memcpy(tmp + p, e, l); p += l; }
-    if (p + 1 < sizeof(tmp)) tmp[p++] = '\n';
-
-    l = strlen(label4); if (p + l < sizeof(tmp)) { memcpy(tmp + p, label4, l); p += l; }
-    const char *en = s->enabled ? "yes" : "no"; l = strlen(en); if (p + l < sizeof(tmp)) { memcpy(tmp + p, en, l); p += l; }
-    if (p + 1 < sizeof(tmp)) tmp[p++] = '\n';
-
-    l = strlen(label5); if (p + l < sizeof(tmp)) { memcpy(tmp + p, label5, l); p += l; }
-    const char *ac = (s->pid != 0) ? "running" : "inactive"; l = strlen(ac); if (p + l < sizeof(tmp)) { memcpy(tmp + p, ac, l); p += l; }
-    if (p + 1 < sizeof(tmp)) tmp[p++] = '\n';
-
-    /* Redirect field removed for cleaner status output */
-
-    size_t cp = p; if (cp >= len) cp = len - 1; if (cp > 0) memcpy(buf, tmp, cp); if (len > 0) buf[cp] = '\0';
+    if (len == 0) return -1;
+    /* the manager owns the run state: ask it */
+    struct chan_msg req, rep;
+    memset(&req, 0, sizeof(req));
+    req.type = SVC_MSG_STATUS;
+    memcpy(req.data, &s->id, sizeof(s->id));
+    size_t cp = 0;
+    if (svc_manager() == 0 && chan_call(svc_chan, &req, &rep, SVC_STATUS_MS) == CHAN_OK && rep.page) {
+        cp = rep.len < len ? rep.len : len - 1;
+        memcpy(buf, rep.page, cp);
+        chan_page_free(rep.page);
+    } else if ((s = find_service(name)) != NULL) {
+        /* looked up again: the call slept */
+        cp = (size_t)svc_format_status(s, buf, len);
+    } else {
+        cp = strlen("no such service\n");
+        if (cp >= len) cp = len - 1;
+        memcpy(buf, "no such service\n", cp);
+    }
+    buf[cp] = '\0';
     return (int)cp;
 }
@@ -1,4 +1,5 @@
 #include "uart.h"
+#include "klog.h"
 #include "init.h"
 #include "sched.h"
 #include "kmalloc.h"
@@ -58,7 +59,6 @@ char *init_resolve_path(const char *p) {
    does NOT normalize '..' */
 static char *resolve_path_alloc(const char *p) {
     if (!p) return NULL;
-    uart_puts("[shell] resolving: "); uart_puts(p);
     char *res;
     if (p[0] == '/') {
         res = normalize_abs_path_alloc(p);
@@ -84,7 +84,7 @@ static char *resolve_path_alloc(const char *p) {
             kfree(tmp);
         }
     }
-    uart_puts(" -> "); uart_puts(res ? res : "NULL"); uart_puts("\n");
+    KLOG(KLOG_SHELL, KLOG_DEBUG, "resolved %s -> %s", p, res ? res : "NULL");
     return res;
 }
 
@@ -233,7 +233,7 @@ static void run_pipeline_internal(struct pipeline_job *job) {
                 tbuf[to] = '\0';
                 
                 if (job->pty) {
-                    for (int k = 0; k < (int)to; ++k) pty_write_out(job->pty, tbuf[k]);
+                    pty_write_buf(job->pty, tbuf, to);
                 } else {
                     init_puts(tbuf);
                 }
@@ -563,12 +563,12 @@ void shell_main(void *arg) {
     }
     shell_should_exit = 0;
     
-    uart_puts("[shell] starting with arg="); uart_put_hex((uintptr_t)arg); uart_puts("\n");
+    KLOG(KLOG_SHELL, KLOG_DEBUG, "starting with arg=%p", arg);
 
     if (_pty) {
         /* Write banner to PTY */
         const char *b = "myras shell v0.2 (PTY)\nType 'help' for commands.\n";
-        for (const char *s = b; *s; ++s) pty_write_out(_pty, *s);
+        pty_puts(_pty, b);
     } else {
         shell_puts("myras shell v0.2\nType 'help' for commands.\n");
     }
@@ -597,7 +597,7 @@ void shell_main(void *arg) {
         }
 
         if (_pty) {
-            for (char *s = pbuf; *s; ++s) pty_write_out(_pty, *s);
+            pty_puts(_pty, pbuf);
         } else {
             shell_puts(pbuf);
         }
@@ -614,7 +614,7 @@ void shell_main(void *arg) {
 
         struct pipeline_job *job = parse_pipeline(line);
         if (!job) { 
-            if (_pty) { const char *e="error parsing\n"; for(const char*s=e;*s;++s) pty_write_out(_pty,*s); }
+            if (_pty) pty_puts(_pty, "error parsing\n");
             else shell_puts("error parsing\n"); 
             continue; 
         }
@@ -630,9 +630,8 @@ void shell_main(void *arg) {
             else { int p10[16]; int pi=0; while (tmp>0 && pi<16) { p10[pi++]=tmp%10; tmp/=10; } for (int j=pi-1;j>=0;--j) bbuf[bl++]= '0' + p10[j]; }
             bbuf[bl++]='\n'; bbuf[bl]=0; 
             if (_pty) {
-                const char *msg = "started pid ";
-                for(const char*s=msg;*s;++s) pty_write_out(_pty,*s);
-                for(char*s=bbuf;*s;++s) pty_write_out(_pty,*s);
+                pty_puts(_pty, "started pid ");
+                pty_puts(_pty, bbuf);
             } else {
                 init_puts("started pid "); init_puts(bbuf);
             }
@@ -663,7 +662,7 @@ int shell_exec(const char *cmdline, char *out, size_t out_cap) {
     /* uart_puts("[shell_exec] running: "); uart_puts(cmdline); uart_puts("\n"); */
     struct pipeline_job *job = parse_pipeline(cmdline);
     if (!job) {
-        uart_puts("[shell_exec] PARSE FAILED\n");
+        KLOG(KLOG_SHELL, KLOG_WARN, "cannot parse: %s", cmdline);
         return -1;
     }
     
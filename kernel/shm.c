@@ -0,0 +1,138 @@
+#include "shm.h"
+#include "palloc.h"
+#include "mmu.h"
+#include "sched.h"
+#include "klog.h"
+#include "lib.h"
+
+#define SHM_MAX_MAPS 64
+
+struct shm_obj {
+    int used;
+    int named;
+    char name[SHM_NAME_MAX];
+    void *pages;
+    uint32_t npages;
+    int refs;                   /* name + mappings */
+};
+
+struct shm_mapping {
+    int task_id;                /* 0: free slot */
+    int obj;
+};
+
+static struct shm_obj objs[SHM_MAX];
+static struct shm_mapping maps[SHM_MAX_MAPS];
+
+static void put(int id) {
+    struct shm_obj *o = &objs[id];
+    if (--o->refs > 0) return;
+    palloc_free(o->pages, o->npages);
+    KLOG(KLOG_MM, KLOG_DEBUG, "shm %d freed (%u pages)", id, o->npages);
+    memset(o, 0, sizeof(*o));
+}
+
+static int valid(int id) {
+    return id >= 0 && id < SHM_MAX && objs[id].used;
+}
+
+int shm_open(const char *name, size_t size) {
+    if (!name || !name[0] || strlen(name) >= SHM_NAME_MAX) return -1;
+    int free_slot = -1;
+    for (int i = 0; i < SHM_MAX; i++) {
+        if (objs[i].used && objs[i].named && strcmp(objs[i].name, name) == 0) return i;
+        if (!objs[i].used && free_slot < 0) free_slot = i;
+    }
+    if (size == 0 || size > SHM_SLOT_SIZE || free_slot < 0) return -1;
+
+    uint32_t npages = (uint32_t)((size + PAGE_SIZE - 1) / PAGE_SIZE);
+    void *pages = palloc_alloc_contig(npages);
+    if (!pages) return -1;
+    memset(pages, 0, (size_t)npages * PAGE_SIZE);
+
+    struct shm_obj *o = &objs[free_slot];
+    o->used = 1;
+    o->named = 1;
+    strcpy(o->name, name);
+    o->pages = pages;
+    o->npages = npages;
+    o->refs = 1;
+    KLOG(KLOG_MM, KLOG_DEBUG, "shm %d '%s' created (%u pages)", free_slot, name, npages);
+    return free_slot;
+}
+
+static uintptr_t user_va(int id) {
+    return (uintptr_t)(USER_SHM_BASE + (uint64_t)id * SHM_SLOT_SIZE);
+}
+
+static int task_maps(int task_id, int id) {
+    int n = 0;
+    for (int i = 0; i < SHM_MAX_MAPS; i++)
+        if (maps[i].task_id == task_id && maps[i].obj == id) n++;
+    return n;
+}
+
+void *shm_map(int id) {
+    if (!valid(id)) return NULL;
+    int me = task_current_id();
+    int slot = -1;
+    for (int i = 0; i < SHM_MAX_MAPS && slot < 0; i++)
+        if (maps[i].task_id == 0) slot = i;
+    if (slot < 0) return NULL;
+
+    struct shm_obj *o = &objs[id];
+    uint64_t *pgd = task_current_pgd();
+    if (pgd && task_maps(me, id) == 0) {
+        uint64_t flags = PTE_USER | PTE_AF | PTE_SH_INNER | PTE_MEMATTR_NORMAL | PTE_UXN | PTE_PXN;
+        for (uint32_t p = 0; p < o->npages; p++) {
+            if (mmu_map_page(pgd, user_va(id) + p * PAGE_SIZE, (uintptr_t)o->pages + p * PAGE_SIZE, flags) < 0) {
+                while (p--) mmu_unmap_page(pgd, user_va(id) + p * PAGE_SIZE);
+                return NULL;
+            }
+        }
+    }
+    maps[slot].task_id = me;
+    maps[slot].obj = id;
+    o->refs++;
+    return pgd ? (void *)user_va(id) : o->pages;
+}
+
+int shm_unmap(int id) {
+    if (!valid(id)) return -1;
+    int me = task_current_id();
+    for (int i = 0; i < SHM_MAX_MAPS; i++) {
+        if (maps[i].task_id != me || maps[i].obj != id) continue;
+        maps[i].task_id = 0;
+        uint64_t *pgd = task_current_pgd();
+        if (pgd && task_maps(me, id) == 0)
+            for (uint32_t p = 0; p < objs[id].npages; p++) mmu_unmap_page(pgd, user_va(id) + p * PAGE_SIZE);
+        put(id);
+        return 0;
+    }
+    return -1;
+}
+
+int shm_unlink(const char *name) {
+    for (int i = 0; i < SHM_MAX; i++) {
+        if (objs[i].used && objs[i].named && strcmp(objs[i].name, name) == 0) {
+            objs[i].named = 0;
+            put(i);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+size_t shm_size(int id) {
+    return valid(id) ? (size_t)objs[id].npages * PAGE_SIZE : 0;
+}
+
+void shm_task_exit(int task_id) {
+    if (task_id <= 0) return;
+    /* the page tables go with the task: only the references need dropping */
+    for (int i = 0; i < SHM_MAX_MAPS; i++) {
+        if (maps[i].task_id != task_id) continue;
+        maps[i].task_id = 0;
+        put(maps[i].obj);
+    }
+}
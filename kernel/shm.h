@@ -0,0 +1,34 @@
+#ifndef SHM_H
+#define SHM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "mmu.h"
+
+/* Named shared memory.
+ *
+ * An object is a run of zeroed, physically contiguous pages. A name
+ * reference keeps it until shm_unlink, and every mapping holds another
+ * reference; it is freed when both are gone. User tasks see object n at
+ * the same address in every address space (USER_SHM_BASE + n *
+ * SHM_SLOT_SIZE), so pointers stored inside it stay valid between them.
+ * Kernel tasks get the kernel address. Mappings of a task that exits
+ * are dropped when it is reaped. */
+
+#define SHM_MAX          16
+#define SHM_NAME_MAX     32
+#define SHM_SLOT_SIZE    0x100000                   /* at most 1MB per object */
+#define USER_SHM_BASE    (USER_SPACE_START + 0x40000000)
+
+/* size > 0 creates the object if the name is new; size 0 only opens.
+ * Returns the object id, -1 on failure */
+int shm_open(const char *name, size_t size);
+/* Map into the caller; returns the address, NULL on failure */
+void *shm_map(int id);
+int shm_unmap(int id);
+int shm_unlink(const char *name);
+size_t shm_size(int id);
+/* Drop every mapping a dead task held (scheduler reap) */
+void shm_task_exit(int task_id);
+
+#endif
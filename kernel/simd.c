@@ -0,0 +1,31 @@
+#include "simd.h"
+#include "uart.h"
+
+static struct fpsimd_state neon_saved;
+static int neon_depth = 0;
+
+void simd_init(void) {
+    uint64_t cpacr;
+    __asm__ volatile("mrs %0, cpacr_el1" : "=r" (cpacr));
+    if ((cpacr & (3ULL << 20)) != (3ULL << 20)) {
+        cpacr |= (3ULL << 20);
+        __asm__ volatile("msr cpacr_el1, %0" : : "r" (cpacr));
+        __asm__ volatile("isb");
+    }
+}
+
+void kernel_neon_begin(void) {
+    if (neon_depth++ == 0) fpsimd_save_state(&neon_saved);
+}
+
+void kernel_neon_end(void) {
+    if (neon_depth <= 0) {
+        _uart_puts("[simd] kernel_neon_end without begin\n");
+        return;
+    }
+    if (--neon_depth == 0) fpsimd_load_state(&neon_saved);
+}
+
+int kernel_neon_busy(void) {
+    return neon_depth;
+}
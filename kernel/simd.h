@@ -0,0 +1,30 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <stdint.h>
+
+/* The kernel is built with -mgeneral-regs-only; only code between
+ * kernel_neon_begin() and kernel_neon_end() may touch the FP/SIMD
+ * registers. Begin saves the live register file (which belongs to
+ * whatever EL0 code the current task runs) and end puts it back.
+ * Regions nest. Do not yield, sleep or block inside one: task switches
+ * do not save FP/SIMD state. IRQ handlers never use it. */
+
+struct fpsimd_state {
+    uint64_t vregs[64];     /* q0..q31 */
+    uint32_t fpsr;
+    uint32_t fpcr;
+} __attribute__((aligned(16)));
+
+void fpsimd_save_state(struct fpsimd_state *st);
+void fpsimd_load_state(const struct fpsimd_state *st);
+
+/* Enable FP/SIMD at EL1 and EL0 (CPACR_EL1.FPEN); boot only sets it when
+ * entered at EL2 */
+void simd_init(void);
+void kernel_neon_begin(void);
+void kernel_neon_end(void);
+/* Nesting depth of the current region, 0 outside */
+int kernel_neon_busy(void);
+
+#endif
@@ -1,11 +1,16 @@
 #include "syscall.h"
 #include "uart.h"
+#include "kconsole.h"
 #include "ramfs.h"
 #include "service.h"
 #include "timer.h"
 #include "framebuffer.h"
 #include <stdint.h>
 #include "pty.h"
+#include "poll.h"
+#include "uring.h"
+#include "shm.h"
+#include "futex.h"
 #include "sched.h"
 
 #define SYSCALL_MAX 64
@@ -35,9 +40,9 @@ static uintptr_t sys_puts(uintptr_t a0, uintptr_t a1, uintptr_t a2) {
     
     struct pty *p = (struct pty *)task_get_tty(task_current_id());
     if (p) {
-        while (*s) pty_write_out(p, *s++);
+        pty_puts(p, s);
     } else {
-        uart_puts(s);
+        kconsole_puts(s);
         // if (fb_is_init()) fb_puts(s);
     }
     return 0;
@@ -47,7 +52,7 @@ static uintptr_t sys_getc(uintptr_t a0, uintptr_t a1, uintptr_t a2) {
     (void)a0; (void)a1; (void)a2;
     struct pty *p = (struct pty *)task_get_tty(task_current_id());
     if (p) return (uintptr_t)pty_read_in(p);
-    return (uintptr_t)uart_getc();
+    return (uintptr_t)kconsole_getc();
 }
 
 static uintptr_t sys_ramfs_create(uintptr_t a0, uintptr_t a1, uintptr_t a2) {
@@ -158,6 +163,46 @@ static uintptr_t sys_sleep(uintptr_t a0, uintptr_t a1, uintptr_t a2) {
     uart_puts("sys_sleep: returned\n");
     return 0;
 }
+static uintptr_t sys_poll(uintptr_t a0, uintptr_t a1, uintptr_t a2) {
+    struct poll_src *srcs = (struct poll_src *)a0;
+    int n = (int)a1;
+    int timeout_ms = (int)a2;
+    return (uintptr_t)poll_sources(srcs, n, timeout_ms);
+}
+static uintptr_t sys_uring_setup(uintptr_t a0, uintptr_t a1, uintptr_t a2) {
+    return (uintptr_t)uring_setup((uint32_t)a0, (uint32_t)a1, (struct uring **)a2);
+}
+static uintptr_t sys_uring_enter(uintptr_t a0, uintptr_t a1, uintptr_t a2) {
+    (void)a2;
+    return (uintptr_t)uring_enter((int)a0, (uint32_t)a1);
+}
+static uintptr_t sys_uring_destroy(uintptr_t a0, uintptr_t a1, uintptr_t a2) {
+    (void)a1; (void)a2;
+    return (uintptr_t)uring_destroy((int)a0);
+}
+static uintptr_t sys_shm_open(uintptr_t a0, uintptr_t a1, uintptr_t a2) {
+    (void)a2;
+    return (uintptr_t)shm_open((const char *)a0, (size_t)a1);
+}
+static uintptr_t sys_shm_map(uintptr_t a0, uintptr_t a1, uintptr_t a2) {
+    (void)a1; (void)a2;
+    return (uintptr_t)shm_map((int)a0);
+}
+static uintptr_t sys_shm_unmap(uintptr_t a0, uintptr_t a1, uintptr_t a2) {
+    (void)a1; (void)a2;
+    return (uintptr_t)shm_unmap((int)a0);
+}
+static uintptr_t sys_shm_unlink(uintptr_t a0, uintptr_t a1, uintptr_t a2) {
+    (void)a1; (void)a2;
+    return (uintptr_t)shm_unlink((const char *)a0);
+}
+static uintptr_t sys_futex_wait(uintptr_t a0, uintptr_t a1, uintptr_t a2) {
+    return (uintptr_t)futex_wait((volatile uint32_t *)a0, (uint32_t)a1, (int)a2);
+}
+static uintptr_t sys_futex_wake(uintptr_t a0, uintptr_t a1, uintptr_t a2) {
+    (void)a2;
+    return (uintptr_t)futex_wake((volatile uint32_t *)a0, (int)a1);
+}
 static uintptr_t sys_yield(uintptr_t a0, uintptr_t a1, uintptr_t a2) {
     (void)a0; (void)a1; (void)a2;
     schedule();
@@ -192,4 +237,14 @@ void syscall_register_defaults(void) {
     /* timing */
     syscall_register(SYS_TIME, sys_time);
     syscall_register(SYS_SLEEP, sys_sleep);
+    syscall_register(SYS_POLL, sys_poll);
+    syscall_register(SYS_URING_SETUP, sys_uring_setup);
+    syscall_register(SYS_URING_ENTER, sys_uring_enter);
+    syscall_register(SYS_URING_DESTROY, sys_uring_destroy);
+    syscall_register(SYS_SHM_OPEN, sys_shm_open);
+    syscall_register(SYS_SHM_MAP, sys_shm_map);
+    syscall_register(SYS_SHM_UNMAP, sys_shm_unmap);
+    syscall_register(SYS_SHM_UNLINK, sys_shm_unlink);
+    syscall_register(SYS_FUTEX_WAIT, sys_futex_wait);
+    syscall_register(SYS_FUTEX_WAKE, sys_futex_wake);
 }
@@ -42,8 +42,21 @@ uintptr_t syscall_handle(uint32_t num, uintptr_t a0, uintptr_t a1, uintptr_t a2)
 #define SYS_SERVICE_STATUS 24      /* a0 = const char *name, a1 = char *buf, a2 = size_t len */
 
 /* timing syscalls */
-#define SYS_TIME 30   /* returns monotonic ms */
+#define SYS_TIME 30   /* returns monotonic ms (user tasks can use utime.h instead) */
 #define SYS_SLEEP 31  /* a0 = ms to sleep */
+/* a0 = struct poll_src *, a1 = count, a2 = timeout ms (-1 forever); see poll.h */
+#define SYS_POLL 32
+/* batched submission, see uring.h */
+#define SYS_URING_SETUP 33     /* a0 = entries, a1 = URING_SETUP_*, a2 = struct uring ** => handle */
+#define SYS_URING_ENTER 34     /* a0 = handle, a1 = min_complete */
+#define SYS_URING_DESTROY 35   /* a0 = handle */
+/* shared memory and futexes, see shm.h / futex.h / usync.h */
+#define SYS_SHM_OPEN 36        /* a0 = name, a1 = size (0: open only) => id */
+#define SYS_SHM_MAP 37         /* a0 = id => address */
+#define SYS_SHM_UNMAP 38       /* a0 = id */
+#define SYS_SHM_UNLINK 39      /* a0 = name */
+#define SYS_FUTEX_WAIT 40      /* a0 = uint32_t *, a1 = expected, a2 = timeout ms (-1 forever) */
+#define SYS_FUTEX_WAKE 41      /* a0 = uint32_t *, a1 = max waiters => woken */
 
 /* register helper/default syscalls */
 void syscall_register_defaults(void);
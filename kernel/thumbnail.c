@@ -0,0 +1,361 @@
+/* Thumbnail service: in-memory slot cache in front of an on-disk cache,
+ * filled by a single worker task so callers never decode in their draw
+ * path.
+ */
+
+#include "thumbnail.h"
+#include "image_decode.h"
+#include "files.h"
+#include "ramfs.h"
+#include "kmalloc.h"
+#include "sched.h"
+#include "timer.h"
+#include "lib.h"
+#include "uart.h"
+#include <stdint.h>
+#include <stddef.h>
+
+#define THUMB_SLOTS        32
+#define THUMB_MAX_SIZE     128
+#define THUMB_RETRY_MS     10000
+#define THUMB_FP_BYTES     4096
+#define THUMB_MAGIC        0x424D4854u /* "THMB" */
+#define THUMB_VERSION      1
+
+enum {
+    SLOT_FREE = 0,
+    SLOT_PENDING,
+    SLOT_BUSY,       /* owned by the worker, never evicted */
+    SLOT_READY,
+    SLOT_FAILED,     /* retried after THUMB_RETRY_MS */
+    SLOT_MISSING     /* no such file: retried only once it shows up */
+};
+
+struct thumb_slot {
+    int state;
+    char path[128];
+    int size;
+    size_t src_size;
+    uint32_t last_used;
+    uint32_t *pixels;
+    struct thumb t;
+};
+
+/* On-disk layout: header followed by w*h ARGB pixels */
+struct thumb_file_hdr {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t src_size;
+    uint32_t fingerprint;
+    uint16_t w, h;
+    uint16_t box;
+    uint16_t reserved;
+    char path[128];
+};
+
+static struct thumb_slot slots[THUMB_SLOTS];
+static volatile uint32_t thumb_gen;
+static int worker_tid = -1;
+
+static uint32_t fnv1a(uint32_t h, const uint8_t *p, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+int thumb_supported(const char *path) {
+    size_t l = strlen(path);
+    if (l < 4) return 0;
+    const char *ext = path + l - 4;
+    if (ext[0] != '.') return 0;
+    char a = (char)tolower(ext[1]), b = (char)tolower(ext[2]), c = (char)tolower(ext[3]);
+    return (a == 'p' && b == 'n' && c == 'g') || (a == 'q' && b == 'o' && c == 'i');
+}
+
+uint32_t thumb_generation(void) {
+    return thumb_gen;
+}
+
+/* ---- worker ---- */
+
+static void thumb_cache_name(const char *path, int size, char *out) {
+    static const char hex[] = "0123456789abcdef";
+    uint32_t h1 = fnv1a(2166136261u, (const uint8_t *)path, strlen(path));
+    uint32_t h2 = fnv1a(h1 ^ 0x5bd1e995u, (const uint8_t *)path, strlen(path));
+    char *p = out;
+    strcpy(p, THUMB_CACHE_DIR "/");
+    p += strlen(p);
+    for (int i = 7; i >= 0; i--) *p++ = hex[(h1 >> (i * 4)) & 0xF];
+    for (int i = 7; i >= 0; i--) *p++ = hex[(h2 >> (i * 4)) & 0xF];
+    *p++ = '_';
+    if (size >= 100) *p++ = (char)('0' + size / 100);
+    if (size >= 10) *p++ = (char)('0' + (size / 10) % 10);
+    *p++ = (char)('0' + size % 10);
+    strcpy(p, ".thm");
+}
+
+/* Size plus a hash of the head and tail of the file. Stands in for an
+ * mtime, which neither ramfs nor diskfs record. */
+/* -2 if the file does not exist */
+static int thumb_fingerprint(const char *path, size_t *size_out, uint32_t *fp_out) {
+    struct file_stat st;
+    if (files_stat(path, &st) < 0) return -2;
+    if (st.is_dir || st.size == 0) return -1;
+
+    uint8_t *buf = kmalloc(THUMB_FP_BYTES);
+    if (!buf) return -1;
+    int fd = files_open(path, O_RDONLY);
+    if (fd < 0) { kfree(buf); return -1; }
+
+    uint32_t h = fnv1a(2166136261u, (const uint8_t *)&st.size, sizeof(st.size));
+    int r = files_read(fd, buf, THUMB_FP_BYTES);
+    if (r > 0) h = fnv1a(h, buf, (size_t)r);
+    if (st.size > THUMB_FP_BYTES) {
+        files_seek(fd, -THUMB_FP_BYTES, SEEK_END);
+        r = files_read(fd, buf, THUMB_FP_BYTES);
+        if (r > 0) h = fnv1a(h, buf, (size_t)r);
+    }
+    files_close(fd);
+    kfree(buf);
+
+    *size_out = st.size;
+    *fp_out = h;
+    return 0;
+}
+
+static int thumb_load_cached(struct thumb_slot *s, const char *cache_path, uint32_t fp) {
+    struct file_stat st;
+    if (files_stat(cache_path, &st) < 0 || st.size < sizeof(struct thumb_file_hdr)) return -1;
+
+    int fd = files_open(cache_path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct thumb_file_hdr hdr;
+    int ok = files_read(fd, &hdr, sizeof(hdr)) == (int)sizeof(hdr) &&
+             hdr.magic == THUMB_MAGIC && hdr.version == THUMB_VERSION &&
+             hdr.src_size == (uint32_t)s->src_size && hdr.fingerprint == fp &&
+             hdr.box == s->size && hdr.w > 0 && hdr.h > 0 &&
+             hdr.w <= s->size && hdr.h <= s->size &&
+             strncmp(hdr.path, s->path, sizeof(hdr.path)) == 0;
+    if (!ok) { files_close(fd); return -1; }
+
+    size_t bytes = (size_t)hdr.w * hdr.h * 4;
+    uint32_t *px = kmalloc(bytes);
+    if (!px) { files_close(fd); return -1; }
+    if (files_read(fd, px, bytes) != (int)bytes) {
+        kfree(px);
+        files_close(fd);
+        return -1;
+    }
+    files_close(fd);
+
+    s->pixels = px;
+    s->t.w = hdr.w;
+    s->t.h = hdr.h;
+    return 0;
+}
+
+/* Box-filter src down to fit size x size. Yields between rows. */
+static uint32_t *thumb_scale(const uint32_t *src, int sw, int sh, int size, int *tw, int *th) {
+    int w = sw, h = sh;
+    if (w > size || h > size) {
+        if (sw >= sh) { w = size; h = (sh * size) / sw; }
+        else { h = size; w = (sw * size) / sh; }
+        if (w < 1) w = 1;
+        if (h < 1) h = 1;
+    }
+    uint32_t *dst = kmalloc((size_t)w * h * 4);
+    if (!dst) return NULL;
+
+    for (int y = 0; y < h; y++) {
+        int y0 = (y * sh) / h, y1 = ((y + 1) * sh) / h;
+        if (y1 <= y0) y1 = y0 + 1;
+        for (int x = 0; x < w; x++) {
+            int x0 = (x * sw) / w, x1 = ((x + 1) * sw) / w;
+            if (x1 <= x0) x1 = x0 + 1;
+            uint32_t a = 0, r = 0, g = 0, b = 0, n = 0;
+            for (int yy = y0; yy < y1; yy++) {
+                const uint32_t *row = src + (size_t)yy * sw;
+                for (int xx = x0; xx < x1; xx++) {
+                    uint32_t c = row[xx];
+                    uint32_t ca = c >> 24;
+                    /* weight colour by alpha so transparent edges don't darken */
+                    a += ca;
+                    r += ((c >> 16) & 0xFF) * ca;
+                    g += ((c >> 8) & 0xFF) * ca;
+                    b += (c & 0xFF) * ca;
+                    n++;
+                }
+            }
+            uint32_t out = 0;
+            if (a) out = ((a / n) << 24) | ((r / a) << 16) | ((g / a) << 8) | (b / a);
+            dst[(size_t)y * w + x] = out;
+        }
+        if ((y & 7) == 7) yield();
+    }
+    *tw = w;
+    *th = h;
+    return dst;
+}
+
+static void thumb_store_cached(struct thumb_slot *s, const char *cache_path, uint32_t fp) {
+    size_t bytes = (size_t)s->t.w * s->t.h * 4;
+    /* diskfs only handles writes starting on a sector, so write it in one go */
+    uint8_t *buf = kmalloc(sizeof(struct thumb_file_hdr) + bytes);
+    if (!buf) return;
+    struct thumb_file_hdr *hdr = (struct thumb_file_hdr *)buf;
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->magic = THUMB_MAGIC;
+    hdr->version = THUMB_VERSION;
+    hdr->src_size = (uint32_t)s->src_size;
+    hdr->fingerprint = fp;
+    hdr->w = (uint16_t)s->t.w;
+    hdr->h = (uint16_t)s->t.h;
+    hdr->box = (uint16_t)s->size;
+    strncpy(hdr->path, s->path, sizeof(hdr->path) - 1);
+    memcpy(buf + sizeof(*hdr), s->pixels, bytes);
+
+    int fd = files_open(cache_path, O_WRONLY | O_CREAT | O_TRUNC);
+    if (fd >= 0) {
+        files_write(fd, buf, sizeof(*hdr) + bytes);
+        files_close(fd);
+    }
+    kfree(buf);
+}
+
+/* 0, -1 on failure, -2 if the file does not exist */
+static int thumb_build(struct thumb_slot *s) {
+    uint32_t fp;
+    char cache_path[64];
+
+    int r = thumb_fingerprint(s->path, &s->src_size, &fp);
+    if (r < 0) return r;
+    thumb_cache_name(s->path, s->size, cache_path);
+    if (thumb_load_cached(s, cache_path, fp) == 0) return 0;
+
+    struct img_decode *job = img_decode_start(s->path, NULL, NULL);
+    if (!job) return -1;
+    img_decode_wait(job);
+    int w = job->w, h = job->h;
+    uint32_t *full = img_decode_take_pixels(job);
+    img_decode_release(job);
+    if (!full) return -1;
+
+    s->pixels = thumb_scale(full, w, h, s->size, &s->t.w, &s->t.h);
+    kfree(full);
+    if (!s->pixels) return -1;
+
+    thumb_store_cached(s, cache_path, fp);
+    return 0;
+}
+
+static struct thumb_slot *thumb_next_pending(void) {
+    /* most recently requested first: that's what is on screen */
+    struct thumb_slot *best = NULL;
+    for (int i = 0; i < THUMB_SLOTS; i++) {
+        if (slots[i].state != SLOT_PENDING) continue;
+        if (!best || (int32_t)(slots[i].last_used - best->last_used) > 0) best = &slots[i];
+    }
+    return best;
+}
+
+static void thumb_task(void *arg) {
+    (void)arg;
+    ramfs_mkdir(THUMB_CACHE_DIR);
+    for (;;) {
+        struct thumb_slot *s = thumb_next_pending();
+        if (!s) {
+            task_wait_event(THUMB_EVENT_ID);
+            continue;
+        }
+        s->state = SLOT_BUSY;
+        int r = thumb_build(s);
+        if (r == 0) {
+            s->t.pixels = s->pixels;
+            s->state = SLOT_READY;
+        } else if (r == -2) {
+            s->state = SLOT_MISSING;
+        } else {
+            uart_puts("[thumb] no thumbnail for "); uart_puts(s->path); uart_puts("\n");
+            s->state = SLOT_FAILED;
+        }
+        s->last_used = timer_get_ms();
+        thumb_gen++;
+    }
+}
+
+/* ---- lookup ---- */
+
+static void thumb_slot_reset(struct thumb_slot *s) {
+    if (s->pixels) kfree(s->pixels);
+    s->pixels = NULL;
+    s->t.pixels = NULL;
+    s->t.w = s->t.h = 0;
+    s->src_size = 0;
+}
+
+static void thumb_queue(struct thumb_slot *s, uint32_t now) {
+    s->state = SLOT_PENDING;
+    s->last_used = now;
+    if (worker_tid < 0) {
+        worker_tid = task_create(thumb_task, NULL, "thumbd");
+        if (worker_tid >= 0) task_set_parent(worker_tid, 1);
+    }
+    task_wake_event(THUMB_EVENT_ID);
+}
+
+const struct thumb *thumb_lookup(const char *path, int size) {
+    if (!path || !path[0] || strlen(path) >= sizeof(slots[0].path)) return NULL;
+    if (size <= 0) return NULL;
+    if (size > THUMB_MAX_SIZE) size = THUMB_MAX_SIZE;
+    uint32_t now = timer_get_ms();
+
+    struct thumb_slot *victim = NULL;
+    for (int i = 0; i < THUMB_SLOTS; i++) {
+        struct thumb_slot *s = &slots[i];
+        if (s->state == SLOT_FREE) {
+            if (!victim || victim->state != SLOT_FREE) victim = s;
+            continue;
+        }
+        if (s->size != size || strcmp(s->path, path) != 0) {
+            if ((s->state == SLOT_READY || s->state == SLOT_FAILED || s->state == SLOT_MISSING) &&
+                (!victim || (victim->state != SLOT_FREE &&
+                             (int32_t)(s->last_used - victim->last_used) < 0))) {
+                victim = s;
+            }
+            continue;
+        }
+
+        if (s->state == SLOT_READY) {
+            /* Only files already in RAM are re-checked; never load from disk here */
+            int cur = ramfs_get_size(path);
+            if (cur >= 0 && (size_t)cur != s->src_size) {
+                thumb_slot_reset(s);
+                thumb_queue(s, now);
+                return NULL;
+            }
+            s->last_used = now;
+            return &s->t;
+        }
+        if (s->state == SLOT_FAILED) {
+            if (now - s->last_used > THUMB_RETRY_MS) thumb_queue(s, now);
+            return NULL;
+        }
+        if (s->state == SLOT_MISSING) {
+            /* like the READY check: only a file that appeared in RAM */
+            if (ramfs_get_size(path) >= 0) thumb_queue(s, now);
+            else s->last_used = now;
+            return NULL;
+        }
+        s->last_used = now;   /* pending/busy: bump priority */
+        return NULL;
+    }
+
+    if (!victim) return NULL;  /* everything is queued; caller retries later */
+    thumb_slot_reset(victim);
+    strcpy(victim->path, path);
+    victim->size = size;
+    thumb_queue(victim, now);
+    return NULL;
+}
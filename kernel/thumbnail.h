@@ -0,0 +1,31 @@
+#ifndef THUMBNAIL_H
+#define THUMBNAIL_H
+
+#include <stdint.h>
+
+/* Thumbnail service.
+ * thumb_lookup() never blocks: it returns a ready thumbnail from the
+ * in-memory cache, or NULL after queueing the image for the "thumbd" task.
+ * The worker first tries the on-disk cache under THUMB_CACHE_DIR and only
+ * decodes the full image on a miss. Disk entries are keyed by path and
+ * box size and validated against the source's size and a content
+ * fingerprint (the filesystem keeps no modification time).
+ *
+ * Callers poll thumb_generation() and redraw when it changes.
+ */
+
+#define THUMB_CACHE_DIR "/system/thumbs"
+
+struct thumb {
+    int w, h;                /* fits inside the requested box, aspect kept */
+    const uint32_t *pixels;  /* ARGB, owned by the cache */
+};
+
+/* size = edge of the square box the thumbnail must fit in (<= 128) */
+const struct thumb *thumb_lookup(const char *path, int size);
+/* Bumped whenever a queued thumbnail becomes ready (or fails) */
+uint32_t thumb_generation(void);
+/* Cheap filename check for formats the service can thumbnail */
+int thumb_supported(const char *path);
+
+#endif
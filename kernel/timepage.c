@@ -0,0 +1,54 @@
+#include "timepage.h"
+#include "mmu.h"
+#include "utime.h"
+
+static union {
+    struct time_page tp;
+    uint8_t raw[4096];
+} page __attribute__((aligned(4096)));
+
+/* mult = unit * 2^shift / freq by long division, one bit of shift at a
+ * time, until mult has 62 significant bits: the 128-bit product has room
+ * and the result stays exact to well under a unit for years of uptime */
+static void conv_init(struct time_conv *c, uint64_t unit, uint64_t freq) {
+    uint64_t q = unit / freq, rem = unit % freq;
+    uint32_t shift = 0;
+    while (q < (1ull << 61) && shift < 127) {
+        rem <<= 1;
+        q <<= 1;
+        if (rem >= freq) { rem -= freq; q |= 1; }
+        shift++;
+    }
+    c->mult = q;
+    c->shift = shift;
+    c->pad = 0;
+}
+
+void time_page_init(uint64_t freq) {
+    struct time_page *tp = &page.tp;
+    uint64_t pct, vct;
+    __asm__ volatile("isb; mrs %0, cntpct_el0; mrs %1, cntvct_el0" : "=r"(pct), "=r"(vct));
+    tp->freq = freq;
+    tp->vct_offset = pct - vct;
+    conv_init(&tp->ms, 1000ull, freq);
+    conv_init(&tp->us, 1000000ull, freq);
+    conv_init(&tp->ns, 1000000000ull, freq);
+    tp->version = 1;
+    tp->magic = TIME_PAGE_MAGIC;
+
+    /* EL0 may read the virtual counter (CNTKCTL_EL1.EL0VCTEN) */
+    uint64_t kctl;
+    __asm__ volatile("mrs %0, cntkctl_el1" : "=r"(kctl));
+    kctl |= (1u << 1);
+    __asm__ volatile("msr cntkctl_el1, %0; isb" : : "r"(kctl));
+}
+
+const struct time_page *time_page_get(void) {
+    return &page.tp;
+}
+
+int time_page_map(uint64_t *pgd) {
+    uint64_t flags = PTE_USER | PTE_RDONLY | PTE_AF | PTE_SH_INNER | PTE_MEMATTR_NORMAL | PTE_UXN | PTE_PXN;
+    /* kernel memory is identity mapped, so the VA is the PA */
+    return mmu_map_page(pgd, USER_TIME_PAGE_VA, (uintptr_t)&page, flags);
+}
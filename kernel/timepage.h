@@ -0,0 +1,45 @@
+#ifndef TIMEPAGE_H
+#define TIMEPAGE_H
+
+#include <stdint.h>
+
+/* Per-boot clock data shared with user space.
+ *
+ * timer_init fills one page with the generic-timer frequency and, for
+ * ms / us / ns, a multiplier and shift such that
+ *     units = (ticks * mult) >> shift        (128-bit product)
+ * which replaces the 64-bit division the clock used to cost per read.
+ * The page is mapped read-only at USER_TIME_PAGE_VA in every user address
+ * space; with CNTKCTL_EL1.EL0VCTEN set, utime.h reads CNTVCT_EL0 and this
+ * page without entering the kernel. Nothing in it changes after boot. */
+
+#define TIME_PAGE_MAGIC 0x54494d45u     /* "TIME" */
+
+struct time_conv {
+    uint64_t mult;
+    uint32_t shift;
+    uint32_t pad;
+};
+
+struct time_page {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t freq;              /* CNTFRQ_EL0 */
+    /* CNTPCT - CNTVCT at boot: added to a virtual count gives the
+     * physical count the kernel clock runs on */
+    uint64_t vct_offset;
+    struct time_conv ms, us, ns;
+};
+
+static inline __attribute__((always_inline)) uint64_t time_conv_apply(const struct time_conv *c, uint64_t ticks) {
+    /* mul + umulh on AArch64, no library call */
+    return (uint64_t)(((unsigned __int128)ticks * c->mult) >> c->shift);
+}
+
+/* Kernel side */
+void time_page_init(uint64_t freq);
+const struct time_page *time_page_get(void);
+/* Map the page read-only into a user address space */
+int time_page_map(uint64_t *pgd);
+
+#endif
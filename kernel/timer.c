@@ -1,6 +1,7 @@
 #include "timer.h"
 #include "sched.h"
 #include "uart.h"
+#include "timepage.h"
 #include <stdint.h>
 
 /* Software-monotonic fallback timer.
@@ -11,20 +12,42 @@
 
 static volatile uint32_t last_ms = 0;
 static uint64_t counter_freq = 0;
+/* tick conversions come from the time page (multiply and shift, no divide) */
+static const struct time_page *tp;
 
 void timer_init(void) {
     __asm__ volatile("mrs %0, cntfrq_el0" : "=r"(counter_freq));
     if (counter_freq == 0) counter_freq = 62500000; // Fallback
+    time_page_init(counter_freq);
+    tp = time_page_get();
     
+    last_ms = timer_get_ms();
+}
+
+uint32_t timer_get_ms(void) {
     uint64_t ticks;
     __asm__ volatile("mrs %0, cntpct_el0" : "=r"(ticks));
-    last_ms = (uint32_t)(ticks * 1000 / counter_freq);
+    return tp ? (uint32_t)time_conv_apply(&tp->ms, ticks) : 0;
 }
 
-uint32_t timer_get_ms(void) {
+uint64_t timer_get_us(void) {
+    return timer_ticks_to_us(timer_get_ticks());
+}
+
+uint64_t timer_get_ticks(void) {
     uint64_t ticks;
     __asm__ volatile("mrs %0, cntpct_el0" : "=r"(ticks));
-    return (uint32_t)(ticks * 1000 / counter_freq);
+    return ticks;
+}
+
+uint64_t timer_ticks_to_us(uint64_t ticks) {
+    return tp ? time_conv_apply(&tp->us, ticks) : 0;
+}
+
+uint64_t timer_us_to_ticks(uint64_t us) {
+    if (!tp) return 0;
+    /* whole seconds first so the product cannot overflow */
+    return (us / 1000000) * tp->freq + (us % 1000000) * tp->freq / 1000000;
 }
 
 void timer_sleep_ms(uint32_t ms) {
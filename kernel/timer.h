@@ -5,6 +5,12 @@
 
 void timer_init(void);
 uint32_t timer_get_ms(void);
+/* microseconds from the generic timer, for measurements */
+uint64_t timer_get_us(void);
+/* raw generic-timer count (CNTPCT) for timestamps, and its conversion */
+uint64_t timer_get_ticks(void);
+uint64_t timer_ticks_to_us(uint64_t ticks);
+uint64_t timer_us_to_ticks(uint64_t us);
 /* sleep current task for ms */
 void timer_sleep_ms(uint32_t ms);
 /* poll hardware and advance scheduler tick (call from scheduler loop) */
@@ -1,5 +1,8 @@
 #include "uart.h"
 #include "sched.h"
+#include "klog.h"
+#include "irq.h"
+#include "ring.h"
 #include <stdint.h>
 
 #ifdef REAL
@@ -15,8 +18,31 @@
 #define UART_FBRD (UART_BASE + 0x28)
 #define UART_LCRH (UART_BASE + 0x2C)
 #define UART_CR   (UART_BASE + 0x30)
+#define UART_IFLS (UART_BASE + 0x34)
+#define UART_IMSC (UART_BASE + 0x38)
+#define UART_MIS  (UART_BASE + 0x40)
 #define UART_ICR  (UART_BASE + 0x44)
 
+#define FR_BUSY   (1 << 3)
+#define FR_RXFE   (1 << 4)
+#define FR_TXFF   (1 << 5)
+#define LCRH_FEN  (1 << 4)
+#define LCRH_8BIT (3 << 5)
+#define INT_RX    (1 << 4)
+#define INT_TX    (1 << 5)
+#define INT_RT    (1 << 6)     /* receive timeout: bytes below the RX trigger sat idle */
+#define IFLS_TX_1_8 (0 << 0)   /* TX interrupt when the FIFO drains to 1/8 */
+#define IFLS_RX_1_2 (2 << 3)   /* RX interrupt when the FIFO fills to 1/2 */
+
+#ifdef REAL
+#define UART_IRQ 57            /* BCM2835 GPU IRQ 57 */
+#else
+#define UART_IRQ 33            /* QEMU virt: SPI 1 */
+#endif
+
+#define UART_TX_RING 4096
+#define UART_RX_RING 1024
+
 #ifdef REAL
 #define GPFSEL1   (GPIO_BASE + 0x04)
 #define GPPUD     (GPIO_BASE + 0x94)
@@ -32,6 +58,116 @@ static inline void mmio_write(uintptr_t reg, uint32_t val) {
     *(volatile uint32_t *)reg = val;
 }
 
+/* After uart_start() the PL011 runs from its interrupts: writers append to
+ * tx_ring and return, the handler refills the TX FIFO whenever it drains
+ * to its trigger level, and received bytes go to rx_ring. Before that
+ * (early boot) and after uart_panic_mode() every byte is written by
+ * spinning on the FIFO.
+ *
+ * tx_ring has many writers (tasks and IRQ handlers) and is consumed by the
+ * handler and by tx_fill() from writers, so all of it runs with IRQs
+ * masked. rx_ring has one producer (the handler) and task consumers. */
+static uint8_t tx_buf[UART_TX_RING];
+static uint8_t rx_buf[UART_RX_RING];
+static struct ring tx_ring = RING_INIT(tx_buf, UART_TX_RING);
+static struct ring rx_ring = RING_INIT(rx_buf, UART_RX_RING);
+static volatile int irq_mode = 0;
+static volatile uint32_t rx_gen = 0;    /* bumped by every RX interrupt that stored bytes */
+static uint32_t imsc = 0;
+
+static void hw_putc(char c) {
+    while (mmio_read(UART_FR) & FR_TXFF);
+    mmio_write(UART_DR, (unsigned int)(uint8_t)c);
+}
+
+/* Move tx_ring into the FIFO until it is full; the TX interrupt stays
+ * enabled only while bytes are left over. IRQs masked. */
+static void tx_fill(void) {
+    uint8_t c;
+    while (!(mmio_read(UART_FR) & FR_TXFF) && ring_pop(&tx_ring, &c))
+        mmio_write(UART_DR, c);
+    uint32_t want = ring_empty(&tx_ring) ? (imsc & ~INT_TX) : (imsc | INT_TX);
+    if (want != imsc) {
+        imsc = want;
+        mmio_write(UART_IMSC, imsc);
+    }
+}
+
+static void uart_irq(void *arg) {
+    (void)arg;
+    uint32_t mis = mmio_read(UART_MIS);
+    if (mis & (INT_RX | INT_RT)) {
+        int got = 0;
+        while (!(mmio_read(UART_FR) & FR_RXFE)) {
+            uint8_t c = (uint8_t)mmio_read(UART_DR);
+            ring_push(&rx_ring, &c);    /* full: counted in rx_ring.dropped */
+            got = 1;
+        }
+        mmio_write(UART_ICR, INT_RX | INT_RT);
+        if (got) {
+            rx_gen++;
+            task_wake_event(UART_EVENT_ID);
+        }
+    }
+    if (mis & INT_TX) {
+        mmio_write(UART_ICR, INT_TX);
+        tx_fill();
+    }
+}
+
+void uart_start(void) {
+    unsigned long flags = irq_save();
+    /* LCRH may only change while the UART is disabled and idle */
+    mmio_write(UART_CR, 0);
+    while (mmio_read(UART_FR) & FR_BUSY);
+    mmio_write(UART_LCRH, LCRH_8BIT | LCRH_FEN);
+    mmio_write(UART_IFLS, IFLS_TX_1_8 | IFLS_RX_1_2);
+    mmio_write(UART_ICR, 0x7FF);
+    mmio_write(UART_CR, (1 << 9) | (1 << 8) | 1);
+    if (irq_request(UART_IRQ, uart_irq, NULL, NULL, "uart") < 0) {
+        irq_restore(flags);
+        KLOG(KLOG_CORE, KLOG_WARN, "uart: no IRQ slot, staying polled");
+        return;
+    }
+    imsc = INT_RX | INT_RT;
+    mmio_write(UART_IMSC, imsc);
+    irq_mode = 1;
+    irq_restore(flags);
+}
+
+size_t uart_write(const char *buf, size_t n) {
+    if (!irq_mode) {
+        for (size_t i = 0; i < n; i++) hw_putc(buf[i]);
+        return n;
+    }
+    unsigned long flags = irq_save();
+    size_t done = ring_push_bulk(&tx_ring, buf, (uint32_t)n);
+    tx_fill();
+    irq_restore(flags);
+    return done;
+}
+
+size_t uart_tx_room(void) {
+    return irq_mode ? ring_space(&tx_ring) : (size_t)-1;
+}
+
+void uart_get_stats(uint32_t *tx_dropped, uint32_t *rx_dropped) {
+    if (tx_dropped) *tx_dropped = tx_ring.dropped;
+    if (rx_dropped) *rx_dropped = rx_ring.dropped;
+}
+
+void uart_panic_mode(void) {
+    unsigned long flags = irq_save();
+    if (irq_mode) {
+        irq_mode = 0;
+        imsc = 0;
+        mmio_write(UART_IMSC, 0);
+        uint8_t c;
+        while (ring_pop(&tx_ring, &c)) hw_putc((char)c);
+    }
+    irq_restore(flags);
+}
+
 void uart_init(void) {
 #ifdef REAL
     /* 1. GPIO Initialization for UART0 (PL011) */
@@ -82,21 +218,33 @@ void _uart_putu(unsigned int u){
 }
 
 void _uart_putc(char c) {
-    while (mmio_read(UART_FR) & (1 << 5)); /* TXFF bit 5 */
-    mmio_write(UART_DR, (unsigned int)c);
+    if (!irq_mode) { hw_putc(c); return; }
+    uart_write(&c, 1);
 }
 
 void _uart_puts(const char *s) {
+    /* newline -> CRLF, handed over in chunks */
+    char chunk[64];
+    size_t n = 0;
     while (*s) {
-        if (*s == '\n')
-            _uart_putc('\r');
-        _uart_putc(*s++);
+        if (*s == '\n') chunk[n++] = '\r';
+        chunk[n++] = *s++;
+        if (n >= sizeof(chunk) - 1) { uart_write(chunk, n); n = 0; }
     }
+    if (n) uart_write(chunk, n);
 }
 
 char uart_getc(void) {
+    if (irq_mode) {
+        uint8_t c;
+        for (;;) {
+            uint32_t gen = rx_gen;
+            if (ring_pop(&rx_ring, &c)) return (char)c;
+            task_wait_event_unless(UART_EVENT_ID, &rx_gen, gen);
+        }
+    }
     /* FR bit 4 == RXFE (receive FIFO empty) */
-    while (mmio_read(UART_FR) & (1 << 4)) {
+    while (mmio_read(UART_FR) & FR_RXFE) {
 #ifndef NO_SCHED
         yield();
 #endif
@@ -105,17 +253,40 @@ char uart_getc(void) {
     return (char)(v & 0xFF);
 }
 
+size_t uart_read(char *buf, size_t n) {
+    size_t got = 0;
+    if (irq_mode) return ring_pop_bulk(&rx_ring, buf, (uint32_t)n);
+    while (got < n && !(mmio_read(UART_FR) & FR_RXFE))
+        buf[got++] = (char)(mmio_read(UART_DR) & 0xFF);
+    return got;
+}
+
+volatile uint32_t *uart_rx_gen(void) {
+    return irq_mode ? &rx_gen : NULL;
+}
+
 int uart_haschar(void) {
+    if (irq_mode) return !ring_empty(&rx_ring);
     /* FR bit 4 == RXFE (receive FIFO empty) */
-    return !(mmio_read(UART_FR) & (1 << 4));
+    return !(mmio_read(UART_FR) & FR_RXFE);
 }
 
 void uart_flush(void) {
+    if (irq_mode) {
+        /* push out what is queued now, without waiting for interrupts */
+        unsigned long flags = irq_save();
+        uint8_t c;
+        while (ring_pop(&tx_ring, &c)) hw_putc((char)c);
+        tx_fill();
+        irq_restore(flags);
+    }
     /* Wait until TXFF (transmit FIFO full) is clear and TXFE is set or BUSY is clear. PL011 FR bit 3 is BUSY */
-    while (mmio_read(UART_FR) & (1 << 3));
+    while (mmio_read(UART_FR) & FR_BUSY);
 }
 
 void panic(const char *reason) {
+    uart_panic_mode();
+    klog_flush_console();
     _uart_puts("\n\033[1;31m[PANIC] \033[0m");
     _uart_puts(reason);
     _uart_puts("\nSystem halted.\n");
@@ -1,6 +1,9 @@
 #ifndef UART_H
 #define UART_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 /* Internal UART functions (always available for critical use like panic) */
 void _uart_putc(char c);
 void _uart_puts(const char *s);
@@ -13,8 +16,26 @@ void delay(unsigned int ticks);
 void panic(const char *reason);
 char uart_getc(void);
 int uart_haschar(void);
+/* Take up to n received bytes without waiting */
+size_t uart_read(char *buf, size_t n);
+/* The count bumped before each UART_EVENT_ID wake, for
+ * task_wait_event_unless; NULL before uart_start (poll instead) */
+volatile uint32_t *uart_rx_gen(void);
 void uart_flush(void);
 
+/* Switch to interrupt-driven I/O (after irq_init and scheduler_init).
+ * From then on writes are queued and return at once, uart_getc() sleeps
+ * until the RX interrupt brings a byte. */
+void uart_start(void);
+/* Queue n raw bytes; returns how many fit (the rest are dropped) */
+size_t uart_write(const char *buf, size_t n);
+/* Bytes uart_write() can take without dropping */
+size_t uart_tx_room(void);
+/* Bytes lost to a full TX or RX ring since boot */
+void uart_get_stats(uint32_t *tx_dropped, uint32_t *rx_dropped);
+/* Back to synchronous output, after writing out what is queued (panic) */
+void uart_panic_mode(void);
+
 /* Conditional Logging Macros */
 #ifdef DEBUG
     #define uart_putc(c) _uart_putc(c)
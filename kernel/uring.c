@@ -0,0 +1,290 @@
+#include "uring.h"
+#include "syscall.h"
+#include "sched.h"
+#include "palloc.h"
+#include "mmu.h"
+#include "klog.h"
+#include "lib.h"
+
+#define LOAD_ACQ(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE_REL(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+/* Kernel side of one handle. sq and cq are private copies of the shared
+ * rings over the kernel address of the same entries: only the counters
+ * the other side owns are taken over from sh, and only ours go back. */
+struct uring_ctx {
+    int used;
+    int owner;
+    int worker;
+    struct uring *sh;           /* kernel address of the shared pages */
+    uint32_t npages;
+    uint64_t *pgd;              /* where they are mapped; NULL for kernel tasks */
+    struct ring sq, cq;
+    volatile uint32_t sq_gen;   /* bumped to wake the worker */
+    volatile uint32_t cq_gen;   /* bumped when completions are posted */
+    volatile int dying;
+    struct { uint64_t user_data; uint32_t until; } timers[URING_MAX_TIMERS];
+    int ntimers;
+};
+
+static struct uring_ctx rings[URING_MAX_RINGS];
+
+static uintptr_t user_va(int id) {
+    return (uintptr_t)(USER_URING_BASE + (uint64_t)id * URING_SLOT_SIZE);
+}
+
+/* The caller's ring, or NULL */
+static struct uring_ctx *lookup(int id) {
+    if (id < 0 || id >= URING_MAX_RINGS) return NULL;
+    struct uring_ctx *u = &rings[id];
+    if (!u->used || u->dying || u->owner != task_current_id()) return NULL;
+    return u;
+}
+
+/* What the submitter has published: new entries in sq, room in cq.
+ * Any value is safe: our copies index through their own mask. */
+static void pull(struct uring_ctx *u) {
+    u->sq.head = LOAD_ACQ(&u->sh->sq.head);
+    u->cq.tail = LOAD_ACQ(&u->sh->cq.tail);
+}
+
+static void publish(struct uring_ctx *u) {
+    STORE_REL(&u->sh->sq.tail, u->sq.tail);
+    STORE_REL(&u->sh->cq.head, u->cq.head);
+}
+
+static void unmap(struct uring_ctx *u, int id) {
+    if (!u->pgd) return;
+    for (uint32_t p = 0; p < u->npages; p++) mmu_unmap_page(u->pgd, user_va(id) + p * PAGE_SIZE);
+    u->pgd = NULL;
+}
+
+static void release(struct uring_ctx *u) {
+    palloc_free(u->sh, u->npages);
+    memset(u, 0, sizeof(*u));
+}
+
+static int is_uring_op(uint32_t op) {
+    return op == SYS_URING_SETUP || op == SYS_URING_ENTER || op == SYS_URING_DESTROY;
+}
+
+static void complete(struct uring_ctx *u, uint64_t user_data, intptr_t res) {
+    struct uring_cqe c = { user_data, res };
+    ring_push(&u->cq, &c);      /* room was checked before taking the entry */
+    u->sh->completed++;
+}
+
+static void post(struct uring_ctx *u) {
+    u->cq_gen++;
+    task_wake_event(&u->cq);
+}
+
+/* Execute queued entries in order while results have somewhere to go.
+ * The worker turns sleeps into timers; inline they simply block. */
+static int run_sq(struct uring_ctx *u, int worker) {
+    int done = 0;
+    void *seg;
+    uint32_t n;
+    while ((n = ring_peek(&u->sq, &seg)) > 0) {
+        struct uring_sqe *e = (struct uring_sqe *)seg;
+        uint32_t i = 0;
+        for (; i < n; i++, e++) {
+            if (ring_space(&u->cq) == 0) break;
+            if (worker && e->op == SYS_SLEEP) {
+                if (u->ntimers == URING_MAX_TIMERS) break;   /* retried after one expires */
+                u->timers[u->ntimers].user_data = e->user_data;
+                u->timers[u->ntimers].until = scheduler_get_tick() + (uint32_t)e->a0;
+                u->ntimers++;
+                u->sh->submitted++;
+                continue;
+            }
+            u->sh->submitted++;
+            intptr_t res = is_uring_op(e->op) ? -1 : (intptr_t)syscall_handle(e->op, e->a0, e->a1, e->a2);
+            complete(u, e->user_data, res);
+            done++;
+        }
+        ring_consume(&u->sq, i);
+        if (i < n) break;
+    }
+    return done;
+}
+
+/* Complete expired sleeps */
+static int run_timers(struct uring_ctx *u) {
+    int done = 0;
+    uint32_t now = scheduler_get_tick();
+    for (int i = 0; i < u->ntimers; ) {
+        if ((int32_t)(now - u->timers[i].until) >= 0 && ring_space(&u->cq)) {
+            complete(u, u->timers[i].user_data, 0);
+            u->timers[i] = u->timers[--u->ntimers];
+            done++;
+        } else {
+            i++;
+        }
+    }
+    return done;
+}
+
+static void uring_worker(void *arg) {
+    struct uring_ctx *u = (struct uring_ctx *)arg;
+    uint32_t last_work = scheduler_get_tick();
+    for (;;) {
+        if (u->dying || !task_exists(u->owner)) break;
+
+        pull(u);
+        int done = run_sq(u, 1);
+        done += run_timers(u);
+        publish(u);
+        if (done) {
+            post(u);
+            last_work = scheduler_get_tick();
+            yield();
+            continue;
+        }
+        if (scheduler_get_tick() - last_work < URING_SQ_IDLE_MS) {
+            yield();
+            continue;
+        }
+
+        /* going to sleep: submitters must enter from now on */
+        uint32_t seen = u->sq_gen;
+        u->sh->flags |= URING_NEED_WAKEUP;
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (!ring_empty(&u->sh->sq)) {
+            u->sh->flags &= ~URING_NEED_WAKEUP;
+            continue;
+        }
+        /* the next sleep to finish, and now and then to notice the owner going away */
+        uint32_t until = scheduler_get_tick() + 1000;
+        for (int i = 0; i < u->ntimers; i++)
+            if ((int32_t)(u->timers[i].until - until) < 0) until = u->timers[i].until;
+        task_wait_event_until(&u->sq, &u->sq_gen, seen, until);
+        u->sh->flags &= ~URING_NEED_WAKEUP;
+        last_work = scheduler_get_tick();
+    }
+    /* the handle stays taken until now, so it cannot be reused under us */
+    release(u);
+    task_set_fn_null(task_current_id());
+}
+
+int uring_setup(uint32_t entries, uint32_t setup, struct uring **ring) {
+    if (!ring || entries == 0 || entries > URING_MAX_ENTRIES) return -1;
+    uint64_t *pgd = task_current_pgd();
+    if ((setup & URING_SETUP_SQPOLL) && pgd) return -1;
+    int id = -1;
+    for (int i = 0; i < URING_MAX_RINGS && id < 0; i++)
+        if (!rings[i].used) id = i;
+    if (id < 0) return -1;
+
+    uint32_t n = 1;
+    while (n < entries) n <<= 1;
+    size_t bytes = sizeof(struct uring) + n * sizeof(struct uring_sqe) + 2 * n * sizeof(struct uring_cqe);
+    uint32_t npages = (uint32_t)((bytes + PAGE_SIZE - 1) / PAGE_SIZE);
+    struct uring *sh = palloc_alloc_contig(npages);
+    if (!sh) return -1;
+    memset(sh, 0, (size_t)npages * PAGE_SIZE);
+
+    struct uring_ctx *u = &rings[id];
+    u->used = 1;
+    u->owner = task_current_id();
+    u->sh = sh;
+    u->npages = npages;
+    struct uring_sqe *sqes = (struct uring_sqe *)(sh + 1);
+    struct uring_cqe *cqes = (struct uring_cqe *)(sqes + n);
+    ring_init(&u->sq, sqes, n, sizeof(struct uring_sqe));
+    ring_init(&u->cq, cqes, 2 * n, sizeof(struct uring_cqe));
+
+    /* the owner's view: the same entries at its own address */
+    uintptr_t base = pgd ? user_va(id) : (uintptr_t)sh;
+    ring_init(&sh->sq, (void *)(base + ((uintptr_t)sqes - (uintptr_t)sh)), n, sizeof(struct uring_sqe));
+    ring_init(&sh->cq, (void *)(base + ((uintptr_t)cqes - (uintptr_t)sh)), 2 * n, sizeof(struct uring_cqe));
+    sh->setup = setup;
+
+    if (pgd) {
+        uint64_t flags = PTE_USER | PTE_AF | PTE_SH_INNER | PTE_MEMATTR_NORMAL | PTE_UXN | PTE_PXN;
+        for (uint32_t p = 0; p < npages; p++) {
+            if (mmu_map_page(pgd, user_va(id) + p * PAGE_SIZE, (uintptr_t)sh + p * PAGE_SIZE, flags) < 0) {
+                while (p--) mmu_unmap_page(pgd, user_va(id) + p * PAGE_SIZE);
+                release(u);
+                return -1;
+            }
+        }
+        u->pgd = pgd;
+    }
+
+    if (setup & URING_SETUP_SQPOLL) {
+        u->worker = task_create(uring_worker, u, "uring_sq");
+        if (u->worker <= 0) {
+            release(u);
+            return -1;
+        }
+        /* tty-bound calls act on the submitter's terminal */
+        task_set_tty(u->worker, task_get_tty(u->owner));
+        task_set_parent(u->worker, u->owner);
+    }
+    KLOG(KLOG_CORE, KLOG_DEBUG, "uring %d: %u entries%s for task %d", id, n,
+         (setup & URING_SETUP_SQPOLL) ? " (sqpoll)" : "", u->owner);
+    *ring = (struct uring *)base;
+    return id;
+}
+
+int uring_enter(int handle, uint32_t min_complete) {
+    struct uring_ctx *u = lookup(handle);
+    if (!u) return -1;
+    u->sh->enters++;
+    if (u->worker) {
+        if (u->sh->flags & URING_NEED_WAKEUP) {
+            u->sh->flags &= ~URING_NEED_WAKEUP;
+            u->sq_gen++;
+            u->sh->wakeups++;
+            task_wake_event(&u->sq);
+        }
+    } else {
+        /* inline: everything that fits in cq is done on return; anything
+         * left waits for the caller to reap and enter again */
+        pull(u);
+        int done = run_sq(u, 0);
+        publish(u);
+        if (done) post(u);
+        return (int)ring_count(&u->cq);
+    }
+
+    /* never wait for more than can still arrive */
+    uint32_t outstanding = ring_count(&u->sh->cq) + ring_count(&u->sh->sq) + (uint32_t)u->ntimers;
+    if (min_complete > outstanding) min_complete = outstanding;
+    for (;;) {
+        uint32_t seen = u->cq_gen;
+        if (ring_count(&u->sh->cq) >= min_complete || u->dying) break;
+        task_wait_event_unless(&u->cq, &u->cq_gen, seen);
+    }
+    return (int)ring_count(&u->sh->cq);
+}
+
+static void destroy(struct uring_ctx *u, int id) {
+    unmap(u, id);
+    if (u->worker) {
+        u->dying = 1;
+        u->sq_gen++;
+        task_wake_event(&u->sq);
+    } else {
+        release(u);
+    }
+}
+
+int uring_destroy(int handle) {
+    struct uring_ctx *u = lookup(handle);
+    if (!u) return -1;
+    destroy(u, handle);
+    return 0;
+}
+
+void uring_task_exit(int task_id) {
+    if (task_id <= 0) return;
+    for (int i = 0; i < URING_MAX_RINGS; i++) {
+        struct uring_ctx *u = &rings[i];
+        if (!u->used || u->dying || u->owner != task_id) continue;
+        /* the page tables go with the task */
+        u->pgd = NULL;
+        destroy(u, i);
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ring.h"
+#include "mmu.h"
+
+/* Batched syscall submission.
+ *
+ * A task sets up a pair of SPSC rings once: it pushes syscall requests
+ * (number, three arguments, a cookie) into sq and pops results from cq,
+ * neither of which traps. Requests are executed in order either
+ *  - inline, by SYS_URING_ENTER: one svc for a whole batch, or
+ *  - with URING_SETUP_SQPOLL, by a kernel worker task that picks them up
+ *    on its own. It sleeps after URING_SQ_IDLE_MS without work and then
+ *    sets URING_NEED_WAKEUP; only then does a submitter have to enter.
+ * SYS_SLEEP entries become timers in the worker, so one sleeping request
+ * does not hold up the ones behind it. Other blocking calls (SYS_GETC)
+ * do hold up the worker.
+ *
+ * The rings and their entries sit in zeroed pages mapped into the owner
+ * (at USER_URING_BASE + handle * URING_SLOT_SIZE for user tasks, like
+ * shm; kernel tasks get the kernel address). The task names the ring by
+ * a small handle, checked against the owner on every call. The kernel
+ * keeps its own copy of each ring's buffer and size and only takes the
+ * head/tail counters from the shared pages, so whatever the task writes
+ * there cannot send the kernel outside the entry arrays. SQPOLL is for
+ * kernel tasks only: the worker has no user address space to resolve
+ * user pointers in. Rings of a task that exits go when it is reaped. */
+
+#define URING_SETUP_SQPOLL  0x1
+#define URING_NEED_WAKEUP   0x1     /* in flags: the worker is asleep */
+#define URING_MAX_ENTRIES   256
+#define URING_SQ_IDLE_MS    2
+#define URING_MAX_TIMERS    16
+#define URING_MAX_RINGS     16
+#define URING_SLOT_SIZE     0x10000                 /* covers URING_MAX_ENTRIES */
+#define USER_URING_BASE     (USER_SPACE_START + 0x48000000)
+
+struct uring_sqe {
+    uint32_t op;            /* SYS_* number */
+    uint32_t pad;
+    uint64_t user_data;     /* returned with the completion */
+    uintptr_t a0, a1, a2;
+};
+
+struct uring_cqe {
+    uint64_t user_data;
+    intptr_t res;           /* the syscall's return value */
+};
+
+/* The shared part, at the start of the mapped pages. sq and cq point at
+ * the entry arrays as the owner sees them. */
+struct uring {
+    struct ring sq;         /* submitter -> kernel */
+    struct ring cq;         /* kernel -> submitter, twice the size of sq */
+    volatile uint32_t flags;
+    uint32_t setup;
+    uint32_t submitted, completed, enters, wakeups;
+};
+
+/* Rings of `entries` (rounded up to a power of two) submissions.
+ * Returns the handle and stores the caller's address of the rings in
+ * *ring; -1 on failure */
+int uring_setup(uint32_t entries, uint32_t setup, struct uring **ring);
+/* Inline: run what is queued (as far as cq has room) and return.
+ * SQPOLL: wake the worker if it sleeps, then wait until cq holds
+ * min_complete results, or everything outstanding has completed.
+ * Returns the number of results ready to reap, -1 for a handle the
+ * caller does not own. */
+int uring_enter(int handle, uint32_t min_complete);
+/* Unmaps the rings; the worker, if any, frees them once it has stopped */
+int uring_destroy(int handle);
+/* Drop every ring a dead task owned (scheduler reap) */
+void uring_task_exit(int task_id);
+
+/* Submitter side, no trap */
+static inline int uring_queue(struct uring *u, uint32_t op, uintptr_t a0, uintptr_t a1, uintptr_t a2,
+                              uint64_t user_data) {
+    struct uring_sqe e = { op, 0, user_data, a0, a1, a2 };
+    return ring_push(&u->sq, &e);
+}
+
+/* After queueing: does the worker need an enter to notice? */
+static inline int uring_needs_enter(const struct uring *u) {
+    if (!(u->setup & URING_SETUP_SQPOLL)) return 1;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);    /* the push before the flag read */
+    return (u->flags & URING_NEED_WAKEUP) != 0;
+}
+
+static inline int uring_reap(struct uring *u, struct uring_cqe *c) {
+    return ring_pop(&u->cq, c);
+}
+
+#endif
@@ -13,6 +13,15 @@
  *           (from circle CUSBHCIDevice, tested on RPi)
  *  HPRT:    When writing to clear W1C bits, do NOT clear PrtPwr (bit 12).
  *           Use the safe_hprt_write() helper which preserves PrtPwr.
+ *
+ * Transfers are interrupt driven. Each channel unmasks only ChHltd and the
+ * IRQ handler decodes HCINT once the channel stops. Interrupt-IN endpoints
+ * are re-armed from the SOF interrupt when their bInterval has elapsed,
+ * after a report as well as after a NAK, and completed reports go straight
+ * from the handler into the input queue. Control transfers (enumeration,
+ * LEDs) run in task context and yield while the channel is busy; port
+ * changes wake the "usbd" task, which does debounce, reset and enumeration
+ * with sleeps instead of busy delays.
  */
 
 #include "usb.h"
@@ -21,6 +30,8 @@
 #include "lib.h"
 #include "input.h"
 #include "sched.h"
+#include "irq.h"
+#include "timer.h"
 #include "debug_overlay.h"
 #include <string.h>
 
@@ -32,29 +43,78 @@ static inline uint32_t _rd(uint32_t off)              { return REG(off); }
 /* Host periodic TX FIFO (not in usb.h since it is not a per-channel reg) */
 #define DWC2_HPTXFSIZ   0x100
 
+/* DWC2 line on the BCM2835 interrupt controller */
+#define USB_IRQ   9
+
+/* GINTSTS / GINTMSK bits used by the host side */
+#define GINT_SOF     (1u<<3)
+#define GINT_PRTINT  (1u<<24)
+#define GINT_HCHINT  (1u<<25)
+
+/* HCTSIZ PID field */
+#define PID_DATA0  0
+#define PID_DATA1  2
+#define PID_SETUP  3
+
 /* ── Channels ──────────────────────────────────────────────────────── */
 #define CH_CTRL   0   /* control EP0  */
 #define CH_KB     1   /* keyboard interrupt IN */
 #define CH_MOUSE  2   /* mouse interrupt IN */
+#define USB_NCHAN 3
+
+#define CH_IDLE   0   /* free */
+#define CH_BUSY   1   /* enabled, owned by the controller */
+#define CH_WAIT   2   /* NAKed or errored, the SOF handler re-arms it */
+#define CH_DONE   3   /* finished, status/actual valid */
+
+#define XFER_RETRIES      3     /* bus errors tolerated before giving up */
+#define CTRL_TIMEOUT_MS   500
+#define CTRL_MAX          512   /* largest control data stage */
+
+struct usb_chan {
+    volatile int state;
+    uint32_t hcchar;        /* everything but ChEna/OddFrm */
+    uint32_t pid;           /* PID of the next attempt */
+    void    *buf;
+    uint16_t len;
+    uint16_t mps;
+    uint8_t  dir;           /* 1 = IN */
+    uint8_t  periodic;
+    uint16_t interval_ms;
+    uint32_t next_ms;       /* CH_WAIT: re-arm at or after this time */
+    int      retries;
+    volatile int status;    /* 0 ok, -2 bus error, -3 stall */
+    volatile int actual;
+    void   (*complete)(struct usb_chan *c);   /* IRQ context */
+    void    *arg;
+};
+static struct usb_chan chans[USB_NCHAN];
+static volatile uint32_t waiting_mask = 0;    /* channels in CH_WAIT */
+static volatile int ctrl_busy = 0;
+static struct usb_stats stats;
 
 /* ── Controller state ──────────────────────────────────────────────── */
 static int usb_initialized  = 0;
 static int port_connected   = 0;
+static volatile uint32_t port_gen = 0;  /* bumped by the IRQ on a port change */
 static int next_addr        = 1;
 static uint16_t usb_mps0   = 8;
 
 /* ── HID device slots ──────────────────────────────────────────────── */
 #define MAX_HID 2
 struct hid_dev {
-    int      active;
+    volatile int active;
     uint8_t  addr;
     uint8_t  ep;
     uint16_t mps;
     uint8_t  is_mouse;
     int      ch;
-    uint32_t last_poll;
+    uint16_t interval_ms;
+    uint32_t reports;
 };
 static struct hid_dev hid_devs[MAX_HID];
+/* One cache line each: the IN DMA invalidates whole lines */
+static uint8_t __attribute__((aligned(64))) hid_bufs[MAX_HID][64];
 
 /* ── Keyboard/mouse state ──────────────────────────────────────────── */
 static uint8_t kb_prev_keys[6] = {0};
@@ -80,10 +140,16 @@ static uint8_t hid_to_scan(uint8_t hid) {
 }
 
 /* ── Delay ─────────────────────────────────────────────────────────── */
+/* Busy wait, only for usb_init() which runs before the scheduler */
 static void usb_delay(int ms) {
     for (volatile int i = 0; i < ms * 50000; i++) __asm__ volatile("nop");
 }
 
+/* Task context: let everything else run meanwhile */
+static void usb_sleep(int ms) {
+    task_block_current_until(scheduler_get_tick() + (uint32_t)ms);
+}
+
 /* ── HPRT safe write ─────────────────────────────────────────────────
  * The HPRT register contains:
  *   - Read-only bits: 0 (PrtConnSts), 4 (PrtOvrCurrAct), 10-11 (PrtLnSts)
@@ -147,94 +213,191 @@ static void usb_cache_invalidate(void *buf, uint16_t len) {
     __asm__ volatile("dsb sy" : : : "memory");
 }
 
-/* ── Low-level single-packet transfer ───────────────────────────────── */
-static int usb_xfer(int ch, uint8_t addr, uint8_t ep,
-                    uint8_t etype, uint8_t dir,
-                    void *buf, uint16_t len,
-                    uint16_t mps, uint8_t pid,
-                    int allow_nak)
+/* ── Channel engine ─────────────────────────────────────────────────
+ * chan_start() programs and enables a channel; everything after that
+ * happens in usb_irq(). Callers mask IRQs around chan_start() so the
+ * SOF handler never sees a half-programmed channel. */
+static uint32_t chan_hcchar(uint8_t addr, uint8_t ep, uint8_t etype,
+                            uint8_t dir, uint16_t mps)
 {
-    usb_halt_ch(ch);
-
-    /* HCCHAR */
     uint32_t hcchar = 0;
     hcchar |= (uint32_t)(mps  & 0x7FF);
     hcchar |= (uint32_t)(ep   & 0xF)   << 11;
     hcchar |= dir ? (1u<<15) : 0;
     hcchar |= (uint32_t)(addr & 0x7F)  << 22;
     hcchar |= (uint32_t)(etype & 0x3)  << 18;
-    /* Low-speed device? HPRT PrtSpd bits [17:16]: 01=FS, 10=LS */
+    /* Low-speed device? HPRT PrtSpd bits [18:17]: 00=HS, 01=FS, 10=LS */
     uint32_t prtspd = (_rd(DWC2_HPRT) >> 17) & 0x3;
     if (prtspd == 2) hcchar |= (1u<<17);  /* LSPDDEV */
+    if (etype == 3)  hcchar |= (1u<<20);  /* MC=1: one transaction per frame */
+    return hcchar;
+}
 
-    /* HCTSIZ: 1 packet */
-    uint32_t hctsiz = (uint32_t)(len & 0x7FFFF)
-                    | (1u << 19)
-                    | ((uint32_t)(pid & 0x3) << 29);
-
-    if (len && buf) {
-        if (dir == 0) {
-            usb_cache_clean(buf, len);
-        } else {
-            usb_cache_clean(buf, len);
-            usb_cache_invalidate(buf, len);
-        }
-        _wr(DWC2_HCDMA(ch), (uint32_t)(uintptr_t)buf);
+static void chan_start(int ch) {
+    struct usb_chan *c = &chans[ch];
+    uint32_t pkts = c->len ? ((uint32_t)c->len + c->mps - 1) / c->mps : 1;
+    uint32_t hctsiz = (uint32_t)(c->len & 0x7FFFF)
+                    | (pkts << 19)
+                    | ((c->pid & 0x3) << 29);
+    uint32_t hcchar = c->hcchar | (1u<<31);
+    /* periodic transfers run in the frame whose parity matches OddFrm */
+    if (c->periodic && !(_rd(DWC2_HFNUM) & 1)) hcchar |= (1u<<29);
+
+    if (c->len && c->buf) {
+        usb_cache_clean(c->buf, c->len);
+        if (c->dir) usb_cache_invalidate(c->buf, c->len);
+        _wr(DWC2_HCDMA(ch), (uint32_t)(uintptr_t)c->buf);
     }
-
+    c->state = CH_BUSY;
     _wr(DWC2_HCINT(ch),    0x7FF);
-    _wr(DWC2_HCINTMSK(ch), 0x7FF);
+    _wr(DWC2_HCINTMSK(ch), HCINT_HALT);
     _wr(DWC2_HCTSIZ(ch),   hctsiz);
-    _wr(DWC2_HCCHAR(ch),   hcchar | (1u<<31));
-
-    int timeout = 100000;
-    while (timeout--) {
-        uint32_t st = _rd(DWC2_HCINT(ch));
-        if (st & HCINT_XFRC)  { 
-            _wr(DWC2_HCINT(ch), st); 
-            if (dir == 1 && len && buf) {
-                usb_cache_invalidate(buf, len);
-            }
-            return 0;  
-        }
-        if (st & HCINT_STALL) { _wr(DWC2_HCINT(ch), st); return -3; }
-        if (st & HCINT_NAK) {
-            _wr(DWC2_HCINT(ch), st);
-            if (allow_nak) return -4;
-            /* NAK: re-arm the channel for retry */
-            _wr(DWC2_HCINT(ch),  0x7FF);
-            _wr(DWC2_HCCHAR(ch), hcchar | (1u<<31));
-            continue;
+    _wr(DWC2_HCCHAR(ch),   hcchar);
+}
+
+/* Park a channel until the SOF handler re-arms it `ms` from now */
+static void chan_defer(int ch, uint32_t ms) {
+    struct usb_chan *c = &chans[ch];
+    c->next_ms = timer_get_ms() + ms;
+    c->state = CH_WAIT;
+    waiting_mask |= 1u << ch;
+    _wr(DWC2_GINTMSK, _rd(DWC2_GINTMSK) | GINT_SOF);
+}
+
+static void chan_finish(struct usb_chan *c, int status) {
+    c->status = status;
+    c->state = CH_DONE;
+    if (status == 0) stats.xfers++;
+    if (c->complete) c->complete(c);
+}
+
+/* ChHltd: work out why the channel stopped */
+static void chan_halted(int ch) {
+    struct usb_chan *c = &chans[ch];
+    uint32_t st = _rd(DWC2_HCINT(ch));
+    _wr(DWC2_HCINT(ch), st);
+    if (c->state != CH_BUSY) return;   /* halted by usb_halt_ch() */
+
+    if (st & HCINT_XFRC) {
+        c->actual = (int)c->len - (int)(_rd(DWC2_HCTSIZ(ch)) & 0x7FFFF);
+        if (c->dir && c->len && c->buf) usb_cache_invalidate(c->buf, c->len);
+        if (c->periodic) c->pid = (c->pid == PID_DATA0) ? PID_DATA1 : PID_DATA0;
+        c->retries = 0;
+        chan_finish(c, 0);
+    } else if (st & HCINT_NAK) {
+        /* Nothing to report yet: try again next interval, not right away */
+        stats.naks++;
+        chan_defer(ch, c->periodic ? c->interval_ms : 1);
+    } else if (st & HCINT_STALL) {
+        chan_finish(c, -3);
+    } else {
+        /* transaction / babble / toggle / frame overrun errors */
+        stats.errors++;
+        if (++c->retries <= XFER_RETRIES) chan_defer(ch, 1);
+        else chan_finish(c, -2);
+    }
+}
+
+/* SOF: re-arm the parked channels that are due, stop SOFs when none wait */
+static void usb_sof(void) {
+    uint32_t now = timer_get_ms();
+    uint32_t m = waiting_mask;
+    stats.sofs++;
+    while (m) {
+        int ch = __builtin_ctz(m);
+        m &= m - 1;
+        if ((int32_t)(now - chans[ch].next_ms) < 0) continue;
+        waiting_mask &= ~(1u << ch);
+        chan_start(ch);
+    }
+    if (!waiting_mask) _wr(DWC2_GINTMSK, _rd(DWC2_GINTMSK) & ~GINT_SOF);
+}
+
+static void usb_irq(void *arg) {
+    (void)arg;
+    uint32_t gint = _rd(DWC2_GINTSTS) & _rd(DWC2_GINTMSK);
+    stats.irqs++;
+
+    if (gint & GINT_HCHINT) {
+        uint32_t haint = _rd(DWC2_HAINT);
+        while (haint) {
+            int ch = __builtin_ctz(haint);
+            haint &= haint - 1;
+            if (ch < USB_NCHAN) chan_halted(ch);
+            else _wr(DWC2_HCINT(ch), 0x7FF);
         }
-        if (st & (HCINT_TXERR|HCINT_DTERR|HCINT_HALT)) {
-            _wr(DWC2_HCINT(ch), st);
-            return -2;
+    }
+    if (gint & GINT_SOF) {
+        _wr(DWC2_GINTSTS, GINT_SOF);
+        usb_sof();
+    }
+    if (gint & GINT_PRTINT) {
+        /* acking the HPRT change bits clears PrtInt; usbd does the rest */
+        hprt_clear_ints();
+        port_gen++;
+        task_wake_event(USB_EVENT_ID);
+    }
+}
+
+/* ── One control stage on CH_CTRL, task context ─────────────────────── */
+static int usb_ctrl_stage(uint8_t addr, uint8_t dir, void *buf,
+                          uint16_t len, uint32_t pid)
+{
+    struct usb_chan *c = &chans[CH_CTRL];
+    c->hcchar   = chan_hcchar(addr, 0, 0, dir, usb_mps0);
+    c->pid      = pid;
+    c->buf      = buf;
+    c->len      = buf ? len : 0;
+    c->mps      = usb_mps0;
+    c->dir      = dir;
+    c->periodic = 0;
+    c->retries  = 0;
+    c->complete = NULL;
+
+    unsigned long flags = irq_save();
+    chan_start(CH_CTRL);
+    irq_restore(flags);
+
+    uint32_t t0 = timer_get_ms();
+    while (c->state != CH_DONE) {
+        if (timer_get_ms() - t0 > CTRL_TIMEOUT_MS) {
+            flags = irq_save();
+            waiting_mask &= ~(1u << CH_CTRL);
+            c->state = CH_IDLE;
+            irq_restore(flags);
+            usb_halt_ch(CH_CTRL);
+            return -10;
         }
+        yield();
     }
-    usb_halt_ch(ch);
-    return -10;
+    c->state = CH_IDLE;
+    return c->status;
 }
 
 /* ── Control transfer (SETUP + optional DATA + STATUS) ──────────────── */
 static int usb_ctrl(uint8_t addr, struct usb_setup_packet *setup, void *data)
 {
-    static struct usb_setup_packet __attribute__((aligned(4))) s_buf;
-    memcpy(&s_buf, setup, sizeof(s_buf));
-
-    int ret = usb_xfer(CH_CTRL, addr, 0, 0, 0, &s_buf, 8,
-                       usb_mps0, 3 /*SETUP*/, 0);
-    if (ret < 0) return ret;
-
-    if (setup->wLength > 0) {
-        uint8_t dir = (setup->bmRequestType & 0x80) ? 1 : 0;
-        ret = usb_xfer(CH_CTRL, addr, 0, 0, dir, data, setup->wLength,
-                       usb_mps0, 2 /*DATA1*/, 0);
-        if (ret < 0) return ret;
+    /* bounce buffers own their cache lines, callers' buffers may not */
+    static uint8_t __attribute__((aligned(64))) s_buf[64];
+    static uint8_t __attribute__((aligned(64))) d_buf[CTRL_MAX];
+    if (setup->wLength > CTRL_MAX) return -1;
+
+    while (ctrl_busy) yield();
+    ctrl_busy = 1;
+
+    uint8_t dir = (setup->bmRequestType & 0x80) ? 1 : 0;
+    memcpy(s_buf, setup, sizeof(*setup));
+    int ret = usb_ctrl_stage(addr, 0, s_buf, 8, PID_SETUP);
+
+    if (ret == 0 && setup->wLength > 0) {
+        if (!dir) memcpy(d_buf, data, setup->wLength);
+        ret = usb_ctrl_stage(addr, dir, d_buf, setup->wLength, PID_DATA1);
+        if (ret == 0 && dir) memcpy(data, d_buf, setup->wLength);
     }
 
-    uint8_t sdir = (setup->bmRequestType & 0x80) ? 0 : 1;
-    usb_xfer(CH_CTRL, addr, 0, 0, sdir, NULL, 0, usb_mps0, 2, 0);
-    return 0;
+    if (ret == 0) usb_ctrl_stage(addr, !dir, NULL, 0, PID_DATA1);
+    ctrl_busy = 0;
+    return ret;
 }
 
 /* ── GET DESCRIPTOR ─────────────────────────────────────────────────── */
@@ -273,31 +436,83 @@ static void usb_port_reset(void) {
     uint32_t w = hprt & ~((1u<<1)|(1u<<2)|(1u<<3)|(1u<<5)); /* clear W1C + PrtEna */
     w |= (1u<<8);   /* PrtRst=1 */
     _wr(DWC2_HPRT, w);
-    usb_delay(60);  /* hold reset ≥50ms */
+    usb_sleep(60);  /* hold reset ≥50ms */
     w &= ~(1u<<8);  /* PrtRst=0  */
     _wr(DWC2_HPRT, w);
-    usb_delay(20);  /* recovery  */
+    usb_sleep(20);  /* recovery  */
 }
 
-/* ── Register one HID slot ──────────────────────────────────────────── */
+/* ── Endpoint bInterval → polling period in ms ───────────────────────── */
+static uint16_t usb_interval_ms(uint8_t binterval) {
+    uint32_t prtspd = (_rd(DWC2_HPRT) >> 17) & 0x3;
+    if (binterval == 0) binterval = 1;
+    if (prtspd == 0) {
+        /* high speed: 2^(bInterval-1) microframes of 125 us */
+        if (binterval > 16) binterval = 16;
+        uint32_t ms = (1u << (binterval - 1)) / 8;
+        return (uint16_t)(ms ? (ms > 1000 ? 1000 : ms) : 1);
+    }
+    return binterval;   /* full/low speed: frames of 1 ms */
+}
+
+/* ── HID report completion, IRQ context ─────────────────────────────── */
+static void usb_process_kb(const uint8_t *raw);
+static void usb_process_mouse(const uint8_t *raw);
+
+static void hid_complete(struct usb_chan *c) {
+    struct hid_dev *d = c->arg;
+    if (!d->active) { c->state = CH_IDLE; return; }
+    if (c->status == 0) {
+        if (d->is_mouse && c->actual >= 3) { d->reports++; usb_process_mouse(c->buf); }
+        else if (!d->is_mouse && c->actual >= 8) { d->reports++; usb_process_kb(c->buf); }
+    } else if (c->status == -3) {
+        /* halted endpoint: stop polling it */
+        d->active = 0;
+        c->state = CH_IDLE;
+        return;
+    }
+    chan_defer(d->ch, d->interval_ms);
+}
+
+/* ── Register one HID slot and start its interrupt-IN polling ───────── */
 static void usb_register_hid(uint8_t addr, uint8_t ep, uint16_t mps,
-                              uint8_t is_mouse)
+                              uint8_t is_mouse, uint8_t binterval)
 {
     for (int i = 0; i < MAX_HID; i++) {
         if (hid_devs[i].active) continue;
-        hid_devs[i].active    = 1;
-        hid_devs[i].addr      = addr;
-        hid_devs[i].ep        = ep;
-        hid_devs[i].mps       = mps ? mps : 8;
-        hid_devs[i].is_mouse  = is_mouse;
-        hid_devs[i].ch        = is_mouse ? CH_MOUSE : CH_KB;
-        hid_devs[i].last_poll = 0;
+        struct hid_dev *d = &hid_devs[i];
+        d->addr        = addr;
+        d->ep          = ep;
+        d->mps         = mps ? mps : 8;
+        d->is_mouse    = is_mouse;
+        d->ch          = is_mouse ? CH_MOUSE : CH_KB;
+        d->interval_ms = usb_interval_ms(binterval);
+        d->reports     = 0;
+        d->active      = 1;
+
+        struct usb_chan *c = &chans[d->ch];
+        c->hcchar      = chan_hcchar(addr, ep, 3, 1, d->mps);
+        c->pid         = PID_DATA0;   /* fresh after SET_CONFIGURATION */
+        c->buf         = hid_bufs[i];
+        c->len         = d->mps < sizeof(hid_bufs[i]) ? d->mps : sizeof(hid_bufs[i]);
+        c->mps         = d->mps;
+        c->dir         = 1;
+        c->periodic    = 1;
+        c->interval_ms = d->interval_ms;
+        c->retries     = 0;
+        c->complete    = hid_complete;
+        c->arg         = d;
+        unsigned long flags = irq_save();
+        chan_start(d->ch);
+        irq_restore(flags);
+
         uart_puts("[usb] registered ");
         uart_puts(is_mouse ? "MOUSE" : "KB");
         uart_puts(" addr="); uart_put_hex(addr);
         uart_puts(" ep=");   uart_put_hex(ep);
         uart_puts(" mps=");  uart_putu(mps);
-        uart_puts("\n");
+        uart_puts(" every "); uart_putu(d->interval_ms);
+        uart_puts(" ms\n");
         if (is_mouse) {
             dbg_set_mouse(1, 1, 0, 0, 0);
         } else {
@@ -319,7 +534,7 @@ static void usb_enumerate_one(void)
     int r = usb_get_desc(0, USB_DESC_DEVICE, 0, &dev_desc, 8);
     if (r < 0) {
         uart_puts("[usb] GET_DESC(dev) failed, retrying...\n");
-        usb_delay(50);
+        usb_sleep(50);
         r = usb_get_desc(0, USB_DESC_DEVICE, 0, &dev_desc, 8);
     }
     if (r < 0) { uart_puts("[usb] GET_DESC(dev) failed\n"); return; }
@@ -335,7 +550,7 @@ static void usb_enumerate_one(void)
         if (usb_ctrl(0, &s, NULL) < 0) {
             uart_puts("[usb] SET_ADDRESS failed\n"); return;
         }
-        usb_delay(10);
+        usb_sleep(10);
     }
     uart_puts("[usb] addr="); uart_put_hex(new_addr); uart_puts("\n");
 
@@ -346,7 +561,7 @@ static void usb_enumerate_one(void)
         s.wValue   = 1;
         usb_ctrl(new_addr, &s, NULL);
     }
-    usb_delay(10);
+    usb_sleep(10);
 
     /* Step 4: Try config descriptor (optional — we fall back if it fails) */
     static uint8_t __attribute__((aligned(4))) cfg_buf[512];
@@ -375,10 +590,11 @@ static void usb_enumerate_one(void)
                 (p[2] & 0x80) && (p[3] & 0x3) == 3) { /* Interrupt IN */
                 uint8_t ep_n = p[2] & 0x7F;
                 uint16_t mps = (uint16_t)(p[4] | ((uint16_t)p[5] << 8));
+                uint8_t ival = p[6];
                 if (cur_sub == 1 && cur_prot == 1 && !found_kb) {
-                    usb_register_hid(new_addr, ep_n, mps, 0); found_kb = 1;
+                    usb_register_hid(new_addr, ep_n, mps, 0, ival); found_kb = 1;
                 } else if (cur_sub == 1 && cur_prot == 2 && !found_ms) {
-                    usb_register_hid(new_addr, ep_n, mps, 1); found_ms = 1;
+                    usb_register_hid(new_addr, ep_n, mps, 1, ival); found_ms = 1;
                 }
             }
             p += p[0];
@@ -390,18 +606,18 @@ static void usb_enumerate_one(void)
         uart_puts("[usb] fallback: EP1=KB\n");
         usb_set_protocol_boot(new_addr, 0);
         usb_set_idle(new_addr, 0);
-        usb_register_hid(new_addr, 1, 8, 0);
+        usb_register_hid(new_addr, 1, 8, 0, 10);
     }
     if (!found_ms) {
         uart_puts("[usb] fallback: EP2=MOUSE\n");
         usb_set_protocol_boot(new_addr, 1);
         usb_set_idle(new_addr, 1);
-        usb_register_hid(new_addr, 2, 4, 1);
+        usb_register_hid(new_addr, 2, 4, 1, 10);
     }
     uart_puts("[usb] enumeration done\n");
 }
 
-/* ── Process keyboard boot report ───────────────────────────────────── */
+/* ── Process keyboard boot report (IRQ context) ─────────────────────── */
 static void usb_process_kb(const uint8_t *raw) {
     uint8_t mods = raw[0];
     const uint8_t *keys = raw + 2;
@@ -445,7 +661,7 @@ static void usb_process_kb(const uint8_t *raw) {
     dbg_set_kb(1, 1, mods, last_hid, (int)last_sc, last_ch);
 }
 
-/* ── Process mouse boot report ──────────────────────────────────────── */
+/* ── Process mouse boot report (IRQ context) ────────────────────────── */
 static void usb_process_mouse(const uint8_t *raw) {
     uint8_t btns = raw[0];
     int8_t  dx   = (int8_t)raw[1];
@@ -467,10 +683,14 @@ static void usb_process_mouse(const uint8_t *raw) {
 
 /* ── Disconnect cleanup ─────────────────────────────────────────────── */
 static void usb_disconnect_all(void) {
-    for (int i = 0; i < MAX_HID; i++) {
-        if (hid_devs[i].active) usb_halt_ch(hid_devs[i].ch);
-        hid_devs[i].active = 0;
+    unsigned long flags = irq_save();
+    for (int i = 0; i < MAX_HID; i++) hid_devs[i].active = 0;
+    for (int ch = CH_KB; ch < USB_NCHAN; ch++) {
+        waiting_mask &= ~(1u << ch);
+        chans[ch].state = CH_IDLE;
     }
+    irq_restore(flags);
+    for (int ch = CH_KB; ch < USB_NCHAN; ch++) usb_halt_ch(ch);
     next_addr = 1; usb_mps0 = 8;
     memset(kb_prev_keys, 0, sizeof(kb_prev_keys));
     kb_prev_mods = 0; mouse_prev_btns = 0;
@@ -538,8 +758,12 @@ int usb_init(void) {
     _wr(DWC2_GRSTCTL, (1u<<4)|(0x10u<<6)); /* TxFFlsh, TxFNum=all */
     { int t=100000; while ((_rd(DWC2_GRSTCTL)&(1u<<4)) && --t>0); }
 
-    /* 8. Enable port interrupt only */
-    _wr(DWC2_GINTMSK, (1u<<24));
+    /* 8. Port and channel interrupts; SOF is switched on only while a
+     *    channel waits for its next slot. Channels report ChHltd only. */
+    _wr(DWC2_GINTSTS, 0xFFFFFFFF);
+    _wr(DWC2_GINTMSK, GINT_PRTINT | GINT_HCHINT);
+    _wr(DWC2_HAINTMSK, (1u << USB_NCHAN) - 1);
+    for (int ch = 0; ch < USB_NCHAN; ch++) _wr(DWC2_HCINTMSK(ch), HCINT_HALT);
 
     /* 9. Power the port (preserve current HPRT, set PrtPwr) */
     {
@@ -551,6 +775,7 @@ int usb_init(void) {
     usb_delay(20);
 
     memset(hid_devs, 0, sizeof(hid_devs));
+    memset(chans, 0, sizeof(chans));
     usb_initialized = 1;
     dbg_set_kb(0, 1, 0, 0, 0, 0);
     dbg_set_mouse(0, 1, 0, 0, 0);
@@ -558,47 +783,58 @@ int usb_init(void) {
     return 0;
 }
 
-/* ── Public: poll ───────────────────────────────────────────────────── */
-void usb_poll(void) {
-    if (!usb_initialized) return;
-
-    /* Clear W1C status bits safely (does NOT clear PrtPwr) */
-    hprt_clear_ints();
-
-    /* Check current physical connection */
-    int connected = (_rd(DWC2_HPRT) & (1u<<0)) ? 1 : 0;
-
-    if (connected && !port_connected) {
-        port_connected = 1;
-        uart_puts("[usb] device connected!\n");
-        usb_delay(200);     /* debounce */
-        usb_port_reset();
-        usb_enumerate_one();
-    } else if (!connected && port_connected) {
-        port_connected = 0;
-        usb_disconnect_all();
+/* ── usbd: port changes, debounce, reset, enumeration ───────────────── */
+static void usb_task(void *arg) {
+    (void)arg;
+    uint32_t handled = 0;
+    for (;;) {
+        /* the gen check closes the window between the test and the sleep */
+        uint32_t seen = port_gen;
+        if (seen == handled) {
+            task_wait_event_unless(USB_EVENT_ID, &port_gen, seen);
+            continue;
+        }
+        handled = seen;
+
+        /* Check current physical connection */
+        int connected = (_rd(DWC2_HPRT) & (1u<<0)) ? 1 : 0;
+
+        if (connected && !port_connected) {
+            port_connected = 1;
+            uart_puts("[usb] device connected!\n");
+            usb_sleep(200);     /* debounce */
+            usb_port_reset();
+            usb_enumerate_one();
+        } else if (!connected && port_connected) {
+            port_connected = 0;
+            usb_disconnect_all();
+        }
     }
+}
 
-    if (!port_connected) return;
+/* ── Public: start ──────────────────────────────────────────────────── */
+void usb_start(void) {
+    if (!usb_initialized) return;
+    if (irq_request(USB_IRQ, usb_irq, NULL, NULL, "usb") < 0) {
+        uart_puts("[usb] no IRQ slot\n");
+        return;
+    }
+    port_gen++;         /* a device may already be plugged in */
+    task_create(usb_task, NULL, "usbd");
+}
 
-    /* Poll every active HID device */
-    uint32_t now = scheduler_get_tick();
+void usb_get_stats(struct usb_stats *st) {
+    *st = stats;
+    st->kb_interval_ms = st->mouse_interval_ms = 0;
+    st->kb_reports = st->mouse_reports = 0;
     for (int i = 0; i < MAX_HID; i++) {
-        struct hid_dev *d = &hid_devs[i];
-        if (!d->active) continue;
-        if (now - d->last_poll < 8) continue; /* ~8 ms */
-        d->last_poll = now;
-
-        if (!d->is_mouse) {
-            static uint8_t kb_buf[8] __attribute__((aligned(4)));
-            int ret = usb_xfer(d->ch, d->addr, d->ep, 3, 1,
-                               kb_buf, 8, d->mps, 2, 1);
-            if (ret == 0) usb_process_kb(kb_buf);
+        if (!hid_devs[i].active) continue;
+        if (hid_devs[i].is_mouse) {
+            st->mouse_interval_ms = hid_devs[i].interval_ms;
+            st->mouse_reports = hid_devs[i].reports;
         } else {
-            static uint8_t ms_buf[4] __attribute__((aligned(4)));
-            int ret = usb_xfer(d->ch, d->addr, d->ep, 3, 1,
-                               ms_buf, 4, d->mps, 2, 1);
-            if (ret == 0) usb_process_mouse(ms_buf);
+            st->kb_interval_ms = hid_devs[i].interval_ms;
+            st->kb_reports = hid_devs[i].reports;
         }
     }
 }
@@ -613,6 +849,7 @@ void usb_set_leds(uint8_t leds) {
         s.wValue        = (0x02u << 8);
         s.wLength       = 1;
         kb_led_state    = leds;
+        /* control transfer from the caller's task; yields until done */
         usb_ctrl(hid_devs[i].addr, &s, &kb_led_state);
     }
 }
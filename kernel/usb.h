@@ -109,9 +109,21 @@ struct usb_mouse_report {
     int8_t  wheel;    /* scroll wheel */
 } __attribute__((packed));
 
+struct usb_stats {
+    uint32_t irqs;              /* controller interrupts taken */
+    uint32_t sofs;              /* SOFs handled (enabled only while a channel waits) */
+    uint32_t xfers;             /* completed transfers */
+    uint32_t naks;
+    uint32_t errors;            /* bus errors, retried up to 3 times */
+    uint32_t kb_reports, mouse_reports;
+    int kb_interval_ms, mouse_interval_ms;   /* 0 when not attached */
+};
+
 /* Controller API */
 int usb_init(void);
-void usb_poll(void);
+/* After irq_init/scheduler_init: hook the IRQ and start the usbd task */
+void usb_start(void);
 void usb_set_leds(uint8_t leds);
+void usb_get_stats(struct usb_stats *st);
 
 #endif
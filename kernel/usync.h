@@ -0,0 +1,208 @@
+#ifndef USYNC_H
+#define USYNC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "syscall.h"
+#include "futex.h"
+
+/* Synchronization for tasks sharing memory (see shm.h). Everything runs
+ * on plain loads and stores plus exclusives; only a task that has to
+ * sleep, or has to wake a sleeper, traps into the kernel (futex.h).
+ *
+ *  - umutex: 0 free, 1 locked, 2 locked and maybe contended. Unlock only
+ *    calls futex_wake when it sees 2 (Drepper, "Futexes Are Tricky").
+ *  - ucond: a sequence word; waiters sleep on the value they last saw.
+ *  - ushm_ring: a single-producer single-consumer byte ring placed inside
+ *    a shared object. Either side sleeps on the other's index only after
+ *    announcing it in rd_wait / wr_wait, so the fast path never traps. */
+
+static inline uintptr_t usys(uint32_t num, uintptr_t a0, uintptr_t a1, uintptr_t a2) {
+    register uintptr_t x0 __asm__("x0") = a0;
+    register uintptr_t x1 __asm__("x1") = a1;
+    register uintptr_t x2 __asm__("x2") = a2;
+    register uintptr_t x8 __asm__("x8") = num;
+    __asm__ volatile("svc #0" : "+r"(x0) : "r"(x1), "r"(x2), "r"(x8) : "memory");
+    return x0;
+}
+
+static inline int ufutex_wait(volatile uint32_t *w, uint32_t expected) {
+    return (int)usys(SYS_FUTEX_WAIT, (uintptr_t)w, expected, (uintptr_t)-1);
+}
+
+static inline void ufutex_wake(volatile uint32_t *w, int n) {
+    usys(SYS_FUTEX_WAKE, (uintptr_t)w, (uintptr_t)n, 0);
+}
+
+/* Atomics (no LSE on the target): each returns the previous value */
+static inline uint32_t usync_cas(volatile uint32_t *p, uint32_t old, uint32_t val) {
+    uint32_t prev, fail;
+    __asm__ volatile(
+        "1: ldaxr %w0, [%2]\n"
+        "   cmp %w0, %w3\n"
+        "   b.ne 2f\n"
+        "   stlxr %w1, %w4, [%2]\n"
+        "   cbnz %w1, 1b\n"
+        "   b 3f\n"
+        "2: clrex\n"
+        "3:\n"
+        : "=&r"(prev), "=&r"(fail) : "r"(p), "r"(old), "r"(val) : "cc", "memory");
+    return prev;
+}
+
+static inline uint32_t usync_xchg(volatile uint32_t *p, uint32_t val) {
+    uint32_t prev, fail;
+    __asm__ volatile(
+        "1: ldaxr %w0, [%2]\n"
+        "   stlxr %w1, %w3, [%2]\n"
+        "   cbnz %w1, 1b\n"
+        : "=&r"(prev), "=&r"(fail) : "r"(p), "r"(val) : "memory");
+    return prev;
+}
+
+static inline uint32_t usync_add(volatile uint32_t *p, uint32_t v) {
+    uint32_t prev, next, fail;
+    __asm__ volatile(
+        "1: ldaxr %w0, [%3]\n"
+        "   add %w1, %w0, %w4\n"
+        "   stlxr %w2, %w1, [%3]\n"
+        "   cbnz %w2, 1b\n"
+        : "=&r"(prev), "=&r"(next), "=&r"(fail) : "r"(p), "r"(v) : "memory");
+    return prev;
+}
+
+/* ---- mutex ---- */
+
+struct umutex { volatile uint32_t state; };
+#define UMUTEX_INIT { 0 }
+
+/* Take a lock known to be contended: whoever leaves it next must wake */
+static inline void umutex_lock_slow(struct umutex *m, uint32_t c) {
+    if (c != 2) c = usync_xchg(&m->state, 2);
+    while (c != 0) {
+        ufutex_wait(&m->state, 2);
+        c = usync_xchg(&m->state, 2);
+    }
+}
+
+static inline void umutex_lock(struct umutex *m) {
+    uint32_t c = usync_cas(&m->state, 0, 1);
+    if (c != 0) umutex_lock_slow(m, c);
+}
+
+static inline int umutex_trylock(struct umutex *m) {
+    return usync_cas(&m->state, 0, 1) == 0;
+}
+
+static inline void umutex_unlock(struct umutex *m) {
+    if (usync_xchg(&m->state, 0) == 2) ufutex_wake(&m->state, 1);
+}
+
+/* ---- condition variable ---- */
+
+struct ucond { volatile uint32_t seq; };
+#define UCOND_INIT { 0 }
+
+/* Called with m held; returns with m held. Wakeups may be spurious. */
+static inline void ucond_wait(struct ucond *c, struct umutex *m) {
+    uint32_t seq = c->seq;
+    umutex_unlock(m);
+    ufutex_wait(&c->seq, seq);
+    /* others may have been woken with us: relock as contended */
+    umutex_lock_slow(m, 1);
+}
+
+static inline void ucond_signal(struct ucond *c) {
+    usync_add(&c->seq, 1);
+    ufutex_wake(&c->seq, 1);
+}
+
+static inline void ucond_broadcast(struct ucond *c) {
+    usync_add(&c->seq, 1);
+    ufutex_wake(&c->seq, 0x7fffffff);
+}
+
+/* ---- shared byte ring ---- */
+
+struct ushm_ring {
+    volatile uint32_t head;     /* bytes ever written, producer only */
+    volatile uint32_t tail;     /* bytes ever read, consumer only */
+    volatile uint32_t rd_wait;  /* consumer is (about to be) asleep on head */
+    volatile uint32_t wr_wait;  /* producer is (about to be) asleep on tail */
+    uint32_t size;              /* power of two */
+    uint32_t rd_sleeps, wr_sleeps;
+    uint32_t pad;
+    uint8_t data[];
+};
+
+/* Lay a ring out over `bytes` of shared memory; returns the data size */
+static inline uint32_t ushm_ring_init(struct ushm_ring *r, size_t bytes) {
+    uint32_t n = 1;
+    while ((size_t)n * 2 <= bytes - sizeof(*r)) n <<= 1;
+    memset(r, 0, sizeof(*r));
+    r->size = n;
+    return n;
+}
+
+/* Sleep on *w while it still reads `seen`, unless the other side moved */
+static inline void ushm_ring_sleep(volatile uint32_t *flag, volatile uint32_t *w, uint32_t seen) {
+    *flag = 1;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);    /* the flag before the re-check */
+    if (*w == seen) ufutex_wait(w, seen);
+    *flag = 0;
+}
+
+/* Wake the other side if it announced it is sleeping on *w */
+static inline void ushm_ring_kick(volatile uint32_t *flag, volatile uint32_t *w) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);    /* the index before the flag read */
+    if (*flag) ufutex_wake(w, 1);
+}
+
+/* Blocks until all n bytes are in */
+static inline void ushm_ring_write(struct ushm_ring *r, const void *buf, size_t n) {
+    const uint8_t *p = (const uint8_t *)buf;
+    while (n) {
+        uint32_t head = r->head;
+        uint32_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+        uint32_t room = r->size - (head - tail);
+        if (room == 0) {
+            r->wr_sleeps++;
+            ushm_ring_sleep(&r->wr_wait, &r->tail, tail);
+            continue;
+        }
+        uint32_t off = head & (r->size - 1);
+        uint32_t len = room < n ? room : (uint32_t)n;
+        uint32_t first = r->size - off < len ? r->size - off : len;
+        memcpy(r->data + off, p, first);
+        memcpy(r->data, p + first, len - first);
+        __atomic_store_n(&r->head, head + len, __ATOMIC_RELEASE);
+        ushm_ring_kick(&r->rd_wait, &r->head);
+        p += len;
+        n -= len;
+    }
+}
+
+/* Blocks until at least one byte is there; returns how many were read */
+static inline size_t ushm_ring_read(struct ushm_ring *r, void *buf, size_t n) {
+    for (;;) {
+        uint32_t tail = r->tail;
+        uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        uint32_t avail = head - tail;
+        if (avail == 0) {
+            r->rd_sleeps++;
+            ushm_ring_sleep(&r->rd_wait, &r->head, head);
+            continue;
+        }
+        uint32_t off = tail & (r->size - 1);
+        uint32_t len = avail < n ? avail : (uint32_t)n;
+        uint32_t first = r->size - off < len ? r->size - off : len;
+        memcpy(buf, r->data + off, first);
+        memcpy((uint8_t *)buf + first, r->data, len - first);
+        __atomic_store_n(&r->tail, tail + len, __ATOMIC_RELEASE);
+        ushm_ring_kick(&r->wr_wait, &r->tail);
+        return len;
+    }
+}
+
+#endif
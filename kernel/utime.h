@@ -0,0 +1,38 @@
+#ifndef UTIME_H
+#define UTIME_H
+
+#include <stdint.h>
+#include "mmu.h"
+#include "timepage.h"
+
+/* Clock reads for user tasks: CNTVCT_EL0 plus the time page, no syscall.
+ * Same timebase as the kernel's timer_get_ms / timer_get_us. Always
+ * inlined: the kernel is built without optimization, and user code cannot
+ * call into the kernel image. */
+
+#define USER_TIME_PAGE_VA (USER_SPACE_START + 0x200000)
+
+static inline __attribute__((always_inline)) const struct time_page *utime_page(void) {
+    return (const struct time_page *)USER_TIME_PAGE_VA;
+}
+
+static inline __attribute__((always_inline)) uint64_t utime_ticks(void) {
+    uint64_t vct;
+    /* isb: do not let the read run ahead of earlier instructions */
+    __asm__ volatile("isb; mrs %0, cntvct_el0" : "=r"(vct) :: "memory");
+    return vct + utime_page()->vct_offset;
+}
+
+static inline __attribute__((always_inline)) uint64_t utime_ns(void) {
+    return time_conv_apply(&utime_page()->ns, utime_ticks());
+}
+
+static inline __attribute__((always_inline)) uint64_t utime_us(void) {
+    return time_conv_apply(&utime_page()->us, utime_ticks());
+}
+
+static inline __attribute__((always_inline)) uint32_t utime_ms(void) {
+    return (uint32_t)time_conv_apply(&utime_page()->ms, utime_ticks());
+}
+
+#endif
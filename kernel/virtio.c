@@ -117,6 +117,7 @@ struct virtio_input_state {
     struct virtio_input_event *ev_buf;
     uint32_t qsize;
     uint16_t last_used_idx;
+    int irq_wired;              /* drained by irqd rather than polled */
 };
 
 static struct virtio_input_state input_devs[MAX_INPUT_DEVICES];
@@ -584,6 +585,23 @@ void virtio_gpu_flush(void) {
 
 
 #ifndef REAL
+void virtio_input_handle_dev(struct virtio_input_state *dev);
+
+/* Top half: ACK the IRQ. The used ring is drained by the thread, in
+ * task context, never on top of anything else draining it. */
+static void virtio_input_irq_ack(void *arg) {
+    struct virtio_input_state *dev = (struct virtio_input_state *)arg;
+    #define RI_IRQ(off) ((volatile uint32_t *)(dev->mmio_base + (off)))
+    
+    uint32_t status = *RI_IRQ(0x060);
+    if (status & 1) *RI_IRQ(0x064) = 1;
+    #undef RI_IRQ
+}
+
+static void virtio_input_irq_thread(void *arg) {
+    virtio_input_handle_dev((struct virtio_input_state *)arg);
+}
+
 int virtio_input_init(void) {
     // uart_puts("[virtio] searching for virtio-input devices...\n");
     num_input_devs = 0;
@@ -741,9 +759,8 @@ int virtio_input_init(void) {
             
             uart_puts("[virtio] DRIVER_OK set. Input active IRQ="); uart_put_hex(48+i); uart_puts("\n");
 
-            extern int irq_register(int irq_num, void (*fn)(void *), void *arg);
-            extern void virtio_input_irq_handler(void *arg);
-            irq_register(48 + i, virtio_input_irq_handler, dev);
+            dev->irq_wired = irq_request(48 + i, virtio_input_irq_ack, virtio_input_irq_thread,
+                                         dev, "virtio-input") == 0;
 
             num_input_devs++;
             #undef RI_INIT
@@ -1007,21 +1024,11 @@ void virtio_input_handle_dev(struct virtio_input_state *dev) {
     }
 }
 
+/* Only devices whose interrupt could not be wired up; the rest are
+ * drained by their IRQ thread */
 void virtio_input_poll(void) {
     for (int i = 0; i < num_input_devs; i++) {
-        virtio_input_handle_dev(&input_devs[i]);
-    }
-}
-
-void virtio_input_irq_handler(void *arg) {
-    struct virtio_input_state *dev = (struct virtio_input_state *)arg;
-    #define RI_IRQ(off) ((volatile uint32_t *)(dev->mmio_base + (off)))
-    
-    /* ACK IRQ */
-    uint32_t status = *RI_IRQ(0x060);
-    if (status & 1) {
-        *RI_IRQ(0x064) = 1;
-        virtio_input_handle_dev(dev);
+        if (!input_devs[i].irq_wired) virtio_input_handle_dev(&input_devs[i]);
     }
 }
 
@@ -0,0 +1,523 @@
+#include "virtio_console.h"
+#include "virtio.h"
+#include "irq.h"
+#include "sched.h"
+#include "ring.h"
+#include "klog.h"
+#include "lib.h"
+#include <string.h>
+
+#ifndef REAL
+
+#define VIRTIO_MMIO_BASE   0x0A000000UL
+#define VIRTIO_MMIO_STRIDE 0x200
+#define VIRTIO_MMIO_SLOTS  32
+#define VIRTIO_MMIO_IRQ0   48       /* slot i raises SPI 16 + i */
+#define VIRTIO_MAGIC       0x74726976u
+#define VIRTIO_ID_CONSOLE  3u
+
+/* virtio-mmio registers */
+#define MMIO_VERSION          0x004
+#define MMIO_DEVICE_ID        0x008
+#define MMIO_DEV_FEATURES     0x010
+#define MMIO_DEV_FEATURES_SEL 0x014
+#define MMIO_DRV_FEATURES     0x020
+#define MMIO_DRV_FEATURES_SEL 0x024
+#define MMIO_GUEST_PAGE_SIZE  0x028     /* legacy */
+#define MMIO_QUEUE_SEL        0x030
+#define MMIO_QUEUE_NUM_MAX    0x034
+#define MMIO_QUEUE_NUM        0x038
+#define MMIO_QUEUE_ALIGN      0x03c     /* legacy */
+#define MMIO_QUEUE_PFN        0x040     /* legacy */
+#define MMIO_QUEUE_READY      0x044
+#define MMIO_QUEUE_NOTIFY     0x050
+#define MMIO_INT_STATUS       0x060
+#define MMIO_INT_ACK          0x064
+#define MMIO_STATUS           0x070
+#define MMIO_QUEUE_DESC       0x080
+#define MMIO_QUEUE_AVAIL      0x090
+#define MMIO_QUEUE_USED       0x0a0
+#define MMIO_CONFIG           0x100
+
+#define STATUS_ACK         1
+#define STATUS_DRIVER      2
+#define STATUS_DRIVER_OK   4
+#define STATUS_FEATURES_OK 8
+
+#define F_MULTIPORT  (1u << 1)
+#define F_VERSION_1  (1u << 0)      /* feature bit 32: second feature word */
+
+/* control queue events (virtio spec 5.3.6.2) */
+#define CTRL_DEVICE_READY  0
+#define CTRL_DEVICE_ADD    1
+#define CTRL_DEVICE_REMOVE 2
+#define CTRL_PORT_READY    3
+#define CTRL_CONSOLE_PORT  4
+#define CTRL_RESIZE        5
+#define CTRL_PORT_OPEN     6
+#define CTRL_PORT_NAME     7
+
+/* Every queue lives in its own 8 KB: descriptors at 0, avail ring right
+ * after them, used ring at 4096 (the legacy layout with QueueAlign 4096).
+ * Each buffer owns the descriptor with its index, so nothing is chained
+ * and no free list is needed. */
+#define VQ_SIZE   16
+#define VQ_MEM    8192
+#define DESC_F_WRITE 2
+
+#define RX_BUFS       8
+#define RX_BUF_SIZE   512
+#define RX_SOFT       2048
+#define TX_BUFS       4
+#define TX_BUF_SIZE   4096
+#define CTRL_BUFS     8
+#define CTRL_BUF_SIZE 64
+
+#define NQUEUES (4 + 2 * (VCON_MAX_PORTS - 1))
+
+struct vq_desc {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+};
+
+struct vq {
+    uint8_t *mem;
+    uint16_t index;         /* queue number on the device */
+    uint16_t size;
+    uint16_t last_used;
+};
+
+#define VQ_DESC(q)  ((volatile struct vq_desc *)(q)->mem)
+#define VQ_AVAIL(q) ((volatile uint16_t *)((q)->mem + (q)->size * 16))  /* flags, idx, ring[] */
+#define VQ_USED(q)  ((volatile uint16_t *)((q)->mem + 4096))            /* flags, idx, {id, len}[] */
+
+struct vcon_ctrl {
+    uint32_t id;
+    uint16_t event;
+    uint16_t value;
+};
+
+struct port {
+    int present;
+    int console;
+    int host_open;
+    char name[32];
+    struct vq rxq;
+    struct vq txq;
+    /* transmit: buffers are filled in order; tx_busy ones are with the device */
+    uint16_t tx_len[TX_BUFS];
+    uint8_t tx_busy[TX_BUFS];
+    int tx_cur;
+    int tx_inflight;
+    /* receive: the IRQ handler copies completed buffers here */
+    uint8_t rx_soft[RX_SOFT];
+    struct ring rx;
+    volatile uint32_t rx_gen;
+    uint32_t tx_bytes, rx_bytes, kicks, tx_dropped;
+};
+
+static uint8_t vq_mem[NQUEUES][VQ_MEM] __attribute__((aligned(4096)));
+static uint8_t rx_mem[VCON_MAX_PORTS][RX_BUFS][RX_BUF_SIZE] __attribute__((aligned(64)));
+static uint8_t tx_mem[VCON_MAX_PORTS][TX_BUFS][TX_BUF_SIZE] __attribute__((aligned(64)));
+static uint8_t ctrl_rx_mem[CTRL_BUFS][CTRL_BUF_SIZE] __attribute__((aligned(64)));
+static struct vcon_ctrl ctrl_tx_mem[CTRL_BUFS] __attribute__((aligned(64)));
+static uint8_t ctrl_tx_busy[CTRL_BUFS];
+
+static struct port ports[VCON_MAX_PORTS];
+static struct vq ctrl_rxq, ctrl_txq;
+static uintptr_t vcon_base = 0;
+static uint32_t vcon_version = 0;
+static int nports = 0;
+static int multiport = 0;
+
+#define R(off)     (*(volatile uint32_t *)(vcon_base + (off)))
+
+/* ---- virtqueues ---- */
+
+static int vq_setup(struct vq *q, uint16_t index, uint8_t *mem) {
+    R(MMIO_QUEUE_SEL) = index;
+    uint32_t qmax = R(MMIO_QUEUE_NUM_MAX);
+    if (qmax == 0) return -1;
+    q->mem = mem;
+    q->index = index;
+    q->size = qmax < VQ_SIZE ? (uint16_t)qmax : VQ_SIZE;
+    q->last_used = 0;
+    memset(mem, 0, VQ_MEM);
+    virtio_flush_dcache(mem, VQ_MEM);
+    R(MMIO_QUEUE_NUM) = q->size;
+    uintptr_t phys = (uintptr_t)mem;
+    if (vcon_version >= 2) {
+        R(MMIO_QUEUE_DESC) = (uint32_t)phys;
+        R(MMIO_QUEUE_DESC + 4) = (uint32_t)(phys >> 32);
+        R(MMIO_QUEUE_AVAIL) = (uint32_t)(phys + q->size * 16);
+        R(MMIO_QUEUE_AVAIL + 4) = (uint32_t)((phys + q->size * 16) >> 32);
+        R(MMIO_QUEUE_USED) = (uint32_t)(phys + 4096);
+        R(MMIO_QUEUE_USED + 4) = (uint32_t)((phys + 4096) >> 32);
+        R(MMIO_QUEUE_READY) = 1;
+    } else {
+        R(MMIO_QUEUE_ALIGN) = 4096;
+        R(MMIO_QUEUE_PFN) = (uint32_t)(phys / 4096);
+    }
+    return 0;
+}
+
+/* Point descriptor id at a buffer for good */
+static void vq_bind(struct vq *q, uint16_t id, void *buf, int device_writes) {
+    volatile struct vq_desc *d = &VQ_DESC(q)[id];
+    d->addr = (uintptr_t)buf;
+    d->len = 0;
+    d->flags = device_writes ? DESC_F_WRITE : 0;
+    d->next = 0;
+}
+
+/* Make descriptor id (len bytes) available to the device; IRQs masked */
+static void vq_push(struct vq *q, uint16_t id, uint32_t len) {
+    volatile struct vq_desc *d = &VQ_DESC(q)[id];
+    d->len = len;
+    virtio_flush_dcache((void *)d, sizeof(*d));
+    volatile uint16_t *avail = VQ_AVAIL(q);
+    uint16_t idx = avail[1];
+    avail[2 + idx % q->size] = id;
+    __asm__ volatile("dmb sy" ::: "memory");
+    avail[1] = (uint16_t)(idx + 1);
+    virtio_flush_dcache((void *)avail, 4 + 2 * q->size);
+}
+
+static void vq_kick(struct vq *q) {
+    __asm__ volatile("dsb sy" ::: "memory");
+    R(MMIO_QUEUE_NOTIFY) = q->index;
+}
+
+/* Next buffer the device is done with; 0 when there is none */
+static int vq_pop(struct vq *q, uint32_t *id, uint32_t *len) {
+    volatile uint16_t *used = VQ_USED(q);
+    virtio_invalidate_dcache((void *)used, 4 + 8 * q->size);
+    if (used[1] == q->last_used) return 0;
+    __asm__ volatile("dmb sy" ::: "memory");
+    volatile uint32_t *e = (volatile uint32_t *)((volatile uint8_t *)used + 4) + 2 * (q->last_used % q->size);
+    *id = e[0];
+    *len = e[1];
+    q->last_used++;
+    return 1;
+}
+
+/* ---- control queue (multiport) ---- */
+
+static void ctrl_send(uint32_t id, uint16_t event, uint16_t value) {
+    uint32_t d, len;
+    while (vq_pop(&ctrl_txq, &d, &len))
+        if (d < CTRL_BUFS) ctrl_tx_busy[d] = 0;
+    for (int i = 0; i < CTRL_BUFS; i++) {
+        if (ctrl_tx_busy[i]) continue;
+        ctrl_tx_mem[i].id = id;
+        ctrl_tx_mem[i].event = event;
+        ctrl_tx_mem[i].value = value;
+        virtio_flush_dcache(&ctrl_tx_mem[i], sizeof(ctrl_tx_mem[i]));
+        ctrl_tx_busy[i] = 1;
+        vq_push(&ctrl_txq, (uint16_t)i, sizeof(struct vcon_ctrl));
+        vq_kick(&ctrl_txq);
+        return;
+    }
+    KLOG(KLOG_VIRTIO, KLOG_WARN, "virtio-console: control queue full, event %d lost", event);
+}
+
+static void ctrl_handle(const uint8_t *buf, uint32_t len) {
+    const struct vcon_ctrl *c = (const struct vcon_ctrl *)buf;
+    if (c->id >= (uint32_t)nports) return;
+    struct port *p = &ports[c->id];
+    switch (c->event) {
+    case CTRL_DEVICE_ADD:
+        p->present = 1;
+        ctrl_send(c->id, CTRL_PORT_READY, 1);
+        ctrl_send(c->id, CTRL_PORT_OPEN, 1);
+        break;
+    case CTRL_DEVICE_REMOVE:
+        p->present = 0;
+        p->host_open = 0;
+        break;
+    case CTRL_CONSOLE_PORT:
+        p->console = 1;
+        break;
+    case CTRL_PORT_OPEN:
+        p->host_open = c->value;
+        break;
+    case CTRL_PORT_NAME: {
+        uint32_t n = len - sizeof(*c);
+        if (n >= sizeof(p->name)) n = sizeof(p->name) - 1;
+        memcpy(p->name, buf + sizeof(*c), n);
+        p->name[n] = '\0';
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static void ctrl_service(void) {
+    uint32_t d, len;
+    int any = 0;
+    while (vq_pop(&ctrl_rxq, &d, &len)) {
+        if (d >= CTRL_BUFS) continue;
+        if (len > CTRL_BUF_SIZE) len = CTRL_BUF_SIZE;
+        virtio_invalidate_dcache(ctrl_rx_mem[d], CTRL_BUF_SIZE);
+        if (len >= sizeof(struct vcon_ctrl)) ctrl_handle(ctrl_rx_mem[d], len);
+        vq_push(&ctrl_rxq, (uint16_t)d, CTRL_BUF_SIZE);
+        any = 1;
+    }
+    if (any) vq_kick(&ctrl_rxq);
+}
+
+/* ---- data queues ---- */
+
+/* Hand the buffer being filled to the device; IRQs masked */
+static int tx_submit(struct port *p) {
+    int c = p->tx_cur;
+    if (p->tx_busy[c] || p->tx_len[c] == 0) return 0;
+    uint8_t *buf = tx_mem[p - ports][c];
+    virtio_flush_dcache(buf, p->tx_len[c]);
+    p->tx_busy[c] = 1;
+    p->tx_inflight++;
+    vq_push(&p->txq, (uint16_t)c, p->tx_len[c]);
+    p->tx_cur = (c + 1) % TX_BUFS;
+    return 1;
+}
+
+static void port_service(struct port *p) {
+    uint32_t d, len;
+    int got = 0;
+    while (vq_pop(&p->rxq, &d, &len)) {
+        if (d >= RX_BUFS) continue;
+        if (len > RX_BUF_SIZE) len = RX_BUF_SIZE;
+        uint8_t *buf = rx_mem[p - ports][d];
+        virtio_invalidate_dcache(buf, len);
+        p->rx_bytes += ring_push_bulk(&p->rx, buf, len);   /* overflow: rx.dropped */
+        vq_push(&p->rxq, (uint16_t)d, RX_BUF_SIZE);
+        got = 1;
+    }
+    if (got) {
+        vq_kick(&p->rxq);
+        p->rx_gen++;
+        task_wake_event(VCON_EVENT_ID);
+    }
+
+    while (vq_pop(&p->txq, &d, &len)) {
+        if (d < TX_BUFS && p->tx_busy[d]) {
+            p->tx_busy[d] = 0;
+            p->tx_len[d] = 0;
+            p->tx_inflight--;
+        }
+    }
+    /* what was written while the device was busy goes out now, in one go */
+    if (!p->tx_inflight && tx_submit(p)) {
+        p->kicks++;
+        vq_kick(&p->txq);
+    }
+}
+
+static void vcon_irq(void *arg) {
+    (void)arg;
+    uint32_t st = R(MMIO_INT_STATUS);
+    R(MMIO_INT_ACK) = st;
+    if (multiport) ctrl_service();
+    for (int i = 0; i < nports; i++) port_service(&ports[i]);
+}
+
+/* ---- init ---- */
+
+static uint16_t rx_queue_index(int port) { return port == 0 ? 0 : (uint16_t)(2 + 2 * port); }
+static uint16_t tx_queue_index(int port) { return port == 0 ? 1 : (uint16_t)(3 + 2 * port); }
+
+static int port_setup(int i) {
+    struct port *p = &ports[i];
+    memset(p, 0, sizeof(*p));
+    ring_init(&p->rx, p->rx_soft, RX_SOFT, 1);
+    int qi = i == 0 ? 0 : 2 + 2 * i;
+    if (vq_setup(&p->rxq, rx_queue_index(i), vq_mem[qi]) < 0) return -1;
+    if (vq_setup(&p->txq, tx_queue_index(i), vq_mem[qi + 1]) < 0) return -1;
+    for (uint16_t b = 0; b < RX_BUFS && b < p->rxq.size; b++) {
+        vq_bind(&p->rxq, b, rx_mem[i][b], 1);
+        vq_push(&p->rxq, b, RX_BUF_SIZE);
+    }
+    for (uint16_t b = 0; b < TX_BUFS; b++) vq_bind(&p->txq, b, tx_mem[i][b], 0);
+    return 0;
+}
+
+int virtio_console_init(void) {
+    for (int slot = 0; slot < VIRTIO_MMIO_SLOTS; slot++) {
+        uintptr_t base = VIRTIO_MMIO_BASE + (uintptr_t)slot * VIRTIO_MMIO_STRIDE;
+        volatile uint32_t *r = (volatile uint32_t *)base;
+        if (r[0] != VIRTIO_MAGIC || r[MMIO_DEVICE_ID / 4] != VIRTIO_ID_CONSOLE) continue;
+
+        vcon_base = base;
+        vcon_version = R(MMIO_VERSION);
+        R(MMIO_STATUS) = 0;
+        R(MMIO_STATUS) = STATUS_ACK;
+        R(MMIO_STATUS) = STATUS_ACK | STATUS_DRIVER;
+
+        R(MMIO_DEV_FEATURES_SEL) = 0;
+        multiport = (R(MMIO_DEV_FEATURES) & F_MULTIPORT) != 0;
+        R(MMIO_DRV_FEATURES_SEL) = 0;
+        R(MMIO_DRV_FEATURES) = multiport ? F_MULTIPORT : 0;
+        R(MMIO_DRV_FEATURES_SEL) = 1;
+        R(MMIO_DRV_FEATURES) = vcon_version >= 2 ? F_VERSION_1 : 0;
+        if (vcon_version >= 2) {
+            R(MMIO_STATUS) = STATUS_ACK | STATUS_DRIVER | STATUS_FEATURES_OK;
+            if (!(R(MMIO_STATUS) & STATUS_FEATURES_OK)) {
+                KLOG(KLOG_VIRTIO, KLOG_WARN, "virtio-console: features rejected");
+                vcon_base = 0;
+                return -1;
+            }
+        } else {
+            R(MMIO_GUEST_PAGE_SIZE) = 4096;
+        }
+
+        nports = 1;
+        if (multiport) {
+            uint32_t max = R(MMIO_CONFIG + 4);     /* cols, rows (u16 each), max_nr_ports */
+            nports = max < VCON_MAX_PORTS ? (int)max : VCON_MAX_PORTS;
+            if (nports < 1) nports = 1;
+        }
+        int ok = port_setup(0) == 0;
+        if (ok && multiport) {
+            ok = vq_setup(&ctrl_rxq, 2, vq_mem[2]) == 0 && vq_setup(&ctrl_txq, 3, vq_mem[3]) == 0;
+            for (uint16_t b = 0; ok && b < CTRL_BUFS && b < ctrl_rxq.size; b++) {
+                vq_bind(&ctrl_rxq, b, ctrl_rx_mem[b], 1);
+                vq_push(&ctrl_rxq, b, CTRL_BUF_SIZE);
+            }
+            for (uint16_t b = 0; ok && b < CTRL_BUFS && b < ctrl_txq.size; b++)
+                vq_bind(&ctrl_txq, b, &ctrl_tx_mem[b], 0);
+            for (int i = 1; ok && i < nports; i++) ok = port_setup(i) == 0;
+        }
+        if (!ok || irq_request(VIRTIO_MMIO_IRQ0 + slot, vcon_irq, NULL, NULL, "virtio-console") < 0) {
+            KLOG(KLOG_VIRTIO, KLOG_WARN, "virtio-console: queue or IRQ setup failed");
+            R(MMIO_STATUS) = 0;
+            vcon_base = 0;
+            return -1;
+        }
+
+        R(MMIO_STATUS) = R(MMIO_STATUS) | STATUS_DRIVER_OK;
+
+        unsigned long flags = irq_save();
+        for (int i = 0; i < nports; i++) vq_kick(&ports[i].rxq);
+        if (multiport) {
+            vq_kick(&ctrl_rxq);
+            /* the device answers with DEVICE_ADD for each port */
+            ctrl_send(0, CTRL_DEVICE_READY, 1);
+        } else {
+            ports[0].present = 1;
+            ports[0].console = 1;
+            ports[0].host_open = 1;
+        }
+        irq_restore(flags);
+
+        KLOG(KLOG_VIRTIO, KLOG_INFO, "virtio-console at %p (v%u), %d port(s)%s",
+             (void *)base, vcon_version, nports, multiport ? ", multiport" : "");
+        return 0;
+    }
+    return -1;
+}
+
+/* ---- API ---- */
+
+static struct port *get_port(int port) {
+    if (!vcon_base || port < 0 || port >= nports || !ports[port].present) return NULL;
+    return &ports[port];
+}
+
+int virtio_console_present(void) {
+    return vcon_base != 0;
+}
+
+int virtio_console_console_port(void) {
+    for (int i = 0; i < nports; i++)
+        if (ports[i].present && ports[i].console) return i;
+    return get_port(0) ? 0 : -1;
+}
+
+int virtio_console_port_info(int port, struct vcon_port_info *info) {
+    struct port *p = get_port(port);
+    if (!p) return 0;
+    info->present = p->present;
+    info->console = p->console;
+    info->host_open = p->host_open;
+    memcpy(info->name, p->name, sizeof(info->name));
+    info->tx_bytes = p->tx_bytes;
+    info->rx_bytes = p->rx_bytes;
+    info->kicks = p->kicks;
+    info->tx_dropped = p->tx_dropped;
+    info->rx_dropped = p->rx.dropped;
+    return 1;
+}
+
+size_t virtio_console_write(int port, const char *buf, size_t n) {
+    struct port *p = get_port(port);
+    if (!p) return 0;
+    unsigned long flags = irq_save();
+    size_t done = 0;
+    int kick = 0;
+    while (done < n) {
+        int c = p->tx_cur;
+        if (p->tx_busy[c]) break;       /* every buffer is with the device */
+        size_t k = TX_BUF_SIZE - p->tx_len[c];
+        if (k > n - done) k = n - done;
+        memcpy(tx_mem[port][c] + p->tx_len[c], buf + done, k);
+        p->tx_len[c] = (uint16_t)(p->tx_len[c] + k);
+        done += k;
+        if (p->tx_len[c] == TX_BUF_SIZE) kick |= tx_submit(p);
+    }
+    /* a partial buffer goes now if the device is idle or being kicked
+     * anyway; otherwise the completion interrupt sends it together with
+     * whatever is written until then */
+    if (!p->tx_inflight || kick) kick |= tx_submit(p);
+    if (kick) {
+        p->kicks++;
+        vq_kick(&p->txq);
+    }
+    p->tx_bytes += (uint32_t)done;
+    p->tx_dropped += (uint32_t)(n - done);
+    irq_restore(flags);
+    return done;
+}
+
+size_t virtio_console_tx_room(int port) {
+    struct port *p = get_port(port);
+    if (!p) return 0;
+    unsigned long flags = irq_save();
+    size_t room = 0;
+    for (int i = 0, c = p->tx_cur; i < TX_BUFS && !p->tx_busy[c]; i++, c = (c + 1) % TX_BUFS)
+        room += TX_BUF_SIZE - p->tx_len[c];
+    irq_restore(flags);
+    return room;
+}
+
+size_t virtio_console_read(int port, char *buf, size_t n) {
+    struct port *p = get_port(port);
+    if (!p) return 0;
+    return ring_pop_bulk(&p->rx, buf, (uint32_t)n);
+}
+
+char virtio_console_getc(int port) {
+    struct port *p = get_port(port);
+    if (!p) return 0;
+    char c;
+    for (;;) {
+        uint32_t gen = p->rx_gen;
+        if (ring_pop(&p->rx, &c)) return c;
+        task_wait_event_unless(VCON_EVENT_ID, &p->rx_gen, gen);
+    }
+}
+
+#else
+
+int virtio_console_init(void) { return -1; }
+int virtio_console_present(void) { return 0; }
+int virtio_console_console_port(void) { return -1; }
+int virtio_console_port_info(int port, struct vcon_port_info *info) { (void)port; (void)info; return 0; }
+size_t virtio_console_write(int port, const char *buf, size_t n) { (void)port; (void)buf; (void)n; return 0; }
+size_t virtio_console_tx_room(int port) { (void)port; return 0; }
+size_t virtio_console_read(int port, char *buf, size_t n) { (void)port; (void)buf; (void)n; return 0; }
+char virtio_console_getc(int port) { (void)port; return 0; }
+
+#endif
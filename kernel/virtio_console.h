@@ -0,0 +1,43 @@
+#ifndef VIRTIO_CONSOLE_H
+#define VIRTIO_CONSOLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* virtio-console (virtio-serial) on the virtio-mmio bus, QEMU only.
+ *
+ * With VIRTIO_CONSOLE_F_MULTIPORT the device exposes several ports
+ * (-device virtconsole / virtserialport); without it there is just port 0.
+ * Writes are copied into per-port 4 KB transmit buffers and handed to the
+ * device a whole buffer per descriptor: a write kicks the device only
+ * when nothing is in flight, otherwise the data rides along with the
+ * next completion. Received bytes are buffered per port by the interrupt
+ * handler. On the Pi every call reports "no device". */
+
+#define VCON_MAX_PORTS 4
+
+struct vcon_port_info {
+    int present;        /* device announced the port */
+    int console;        /* device marked it as the console port */
+    int host_open;      /* something is connected on the host side */
+    char name[32];
+    uint32_t tx_bytes, rx_bytes, kicks, tx_dropped, rx_dropped;
+};
+
+/* Probe and start the device (after irq_init); -1 when there is none */
+int virtio_console_init(void);
+int virtio_console_present(void);
+/* The port the device flagged as console, else port 0 if it exists, else -1 */
+int virtio_console_console_port(void);
+/* 0 when the port does not exist */
+int virtio_console_port_info(int port, struct vcon_port_info *info);
+
+/* Queue n bytes without blocking; returns how many fit */
+size_t virtio_console_write(int port, const char *buf, size_t n);
+size_t virtio_console_tx_room(int port);
+/* Take up to n received bytes without blocking */
+size_t virtio_console_read(int port, char *buf, size_t n);
+/* Next received byte, sleeping until there is one */
+char virtio_console_getc(int port);
+
+#endif
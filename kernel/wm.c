@@ -9,6 +9,8 @@
 #include "sched.h"
 #include "input.h"
 #include "timer.h"
+#include "latency.h"
+#include "input_rec.h"
 #include "apps/myra_app.h"
 #include "cursor.h"
 #include "image.h"
@@ -47,24 +49,16 @@ static uint8_t scan_to_ascii_shift[] = {
     'Z', 'X', 'C', 'V', 'B', 'N', 'M', '<', '>', '?', 0, '*', 0, ' '
 };
 
-/* Per-window spinlock helpers */
-static void wm_lock_window(struct window *win) {
-    if (!win) return;
-    volatile int *l = &win->input_lock;
-    /* irq_save is done by caller usually, but if not, single core is safe enough for now. The proper fix is using irq_save in the caller. */
-    while (*l) {
-        yield();
-    }
-    *l = 1;
-}
 
-static void wm_unlock_window(struct window *win) {
-    if (!win) return;
-    __asm__ volatile("dmb sy" ::: "memory");
-    win->input_lock = 0;
+static void wm_append_uint(char *dst, unsigned v) {
+    char tmp[12];
+    int n = 0;
+    do { tmp[n++] = (char)('0' + v % 10); v /= 10; } while (v);
+    dst += strlen(dst);
+    while (n) *dst++ = tmp[--n];
+    *dst = '\0';
 }
 
-
 void wm_init(void) {
 #ifdef DEBUG
     uart_puts("[wm] wm_init start\n");
@@ -83,9 +77,24 @@ void wm_init(void) {
     virtio_gpu_flush();
 #endif
 
-    /* Try to load wallpaper */
-    if (img_load_png("/system/assets/wallpaper.png", &wallpaper_w, &wallpaper_h, &wallpaper_buf) == 0) {
-        
+    /* Try to load wallpaper: the build pre-scales a QOI copy per common
+     * resolution (see asset_pipeline.py); the PNG is the fallback. */
+    char wp_path[64];
+    strcpy(wp_path, "/system/assets/wallpaper_");
+    wm_append_uint(wp_path, (unsigned)screen_w);
+    strcat(wp_path, "x");
+    wm_append_uint(wp_path, (unsigned)screen_h);
+    strcat(wp_path, ".qoi");
+
+    uint32_t wp_start = timer_get_ms();
+    int wp_ret = img_load(wp_path, &wallpaper_w, &wallpaper_h, &wallpaper_buf);
+    if (wp_ret < 0) {
+        strcpy(wp_path, "/system/assets/wallpaper.png");
+        wp_ret = img_load(wp_path, &wallpaper_w, &wallpaper_h, &wallpaper_buf);
+    }
+    if (wp_ret == 0) {
+        _uart_puts("[wm] wallpaper "); _uart_puts(wp_path);
+        _uart_puts(" loaded in "); _uart_putu(timer_get_ms() - wp_start); _uart_puts(" ms\n");
     } else {
         fb_fill(0xFFAA0000); // Dark Red
         fb_put_text_centered("WM: WALLPAPER FAILED", 0xFFFFFFFF);
@@ -122,6 +131,11 @@ static void wm_list_unlock(void) {
     wm_global_lock = 0;
 }
 
+static uint32_t win_input_ready(struct waitable *w) {
+    struct window *win = container_of(w, struct window, input_w);
+    return ring_empty(&win->input) ? 0 : POLLIN;
+}
+
 struct window* wm_create_window(const char *name, int x, int y, int w, int h, void (*render_fn)(struct window*)) {
     struct window *win = kmalloc(sizeof(struct window));
     if (!win) return NULL;
@@ -136,10 +150,11 @@ struct window* wm_create_window(const char *name, int x, int y, int w, int h, vo
     win->render = render_fn;
     win->on_close = NULL;
     win->user_data = NULL;
-    win->input_head = win->input_tail = 0;
-    win->input_lock = 0;
+    ring_init(&win->input, win->input_queue, WM_INPUT_QUEUE_SIZE, sizeof(struct wm_input_event));
+    waitable_init(&win->input_w, win_input_ready);
     win->tty = NULL;
     win->is_dirty = 1;
+    win->lat_stamp = win->lat_popped = 0;
     
     wm_list_lock();
     win->next = window_list;
@@ -167,6 +182,7 @@ void wm_close_window(struct window *win) {
             if (win->on_close) {
                 win->on_close(win);
             }
+            waitable_detach(&win->input_w);
             kfree(win);
             desktop_dirty = 1;
             task_wake_event(WM_EVENT_ID);
@@ -269,14 +285,14 @@ int wm_is_focused(struct window *win) {
 
 int wm_pop_key_event(struct window *win, struct wm_input_event *ev) {
     if (!win) return 0;
-    wm_lock_window(win);
-    if (win->input_head == win->input_tail) {
-        wm_unlock_window(win);
-        return 0;
+    if (!ring_pop(&win->input, ev)) return 0;
+    if (ev->stamp) {
+        /* consumed: now waits for the window's next render */
+        uint64_t now = timer_get_ticks();
+        lat_record(LAT_KEY_WINDOW, now - ev->t_wm);
+        if (!win->lat_stamp || ev->stamp < win->lat_stamp) win->lat_stamp = ev->stamp;
+        win->lat_popped = now;
     }
-    *ev = win->input_queue[win->input_tail];
-    win->input_tail = (win->input_tail + 1) % WM_INPUT_QUEUE_SIZE;
-    wm_unlock_window(win);
     return 1;
 }
 
@@ -448,14 +464,122 @@ void wm_set_state(struct window *win, wm_state_t state) {
     task_wake_event(WM_EVENT_ID);
 }
 
+/* ---- Occlusion ----
+ * Every window is opaque over its whole rectangle (frame, title bar and a
+ * black content fill), so what a window can show is its rectangle minus
+ * the rectangles of everything stacked above it, taskbar included. The
+ * compositor computes that as a small list of disjoint rectangles and
+ * hands it to the framebuffer as a clip region. Running out of slots just
+ * leaves a rectangle unsplit: painting is still back to front, so that
+ * only costs overdraw, never correctness. */
+
+struct wm_region {
+    int n;
+    struct fb_rect r[FB_CLIP_MAX];
+};
+
+static int wm_rect_intersect(const struct fb_rect *a, const struct fb_rect *b, struct fb_rect *out) {
+    int x0 = (a->x > b->x) ? a->x : b->x;
+    int y0 = (a->y > b->y) ? a->y : b->y;
+    int x1 = (a->x + a->w < b->x + b->w) ? a->x + a->w : b->x + b->w;
+    int y1 = (a->y + a->h < b->y + b->h) ? a->y + a->h : b->y + b->h;
+    if (x1 <= x0 || y1 <= y0) return 0;
+    out->x = x0; out->y = y0; out->w = x1 - x0; out->h = y1 - y0;
+    return 1;
+}
+
+static void wm_region_subtract(struct wm_region *rg, const struct fb_rect *cut) {
+    struct fb_rect out[FB_CLIP_MAX];
+    int n = 0;
+    for (int i = 0; i < rg->n; i++) {
+        const struct fb_rect *r = &rg->r[i];
+        struct fb_rect c;
+        if (!wm_rect_intersect(r, cut, &c)) { out[n++] = *r; continue; }
+
+        /* Up to four pieces: full-width bands above and below the cut,
+         * then the left and right remainders beside it. */
+        struct fb_rect piece[4];
+        int np = 0;
+        if (c.y > r->y) piece[np++] = (struct fb_rect){ r->x, r->y, r->w, c.y - r->y };
+        if (c.y + c.h < r->y + r->h) piece[np++] = (struct fb_rect){ r->x, c.y + c.h, r->w, r->y + r->h - (c.y + c.h) };
+        if (c.x > r->x) piece[np++] = (struct fb_rect){ r->x, c.y, c.x - r->x, c.h };
+        if (c.x + c.w < r->x + r->w) piece[np++] = (struct fb_rect){ c.x + c.w, c.y, r->x + r->w - (c.x + c.w), c.h };
+
+        /* keep a slot for each rectangle still to be processed */
+        int remaining = rg->n - i - 1;
+        if (n + np + remaining > FB_CLIP_MAX) { out[n++] = *r; continue; }
+        for (int k = 0; k < np; k++) out[n++] = piece[k];
+    }
+    rg->n = n;
+    for (int i = 0; i < n; i++) rg->r[i] = out[i];
+}
+
+static int wm_window_rect(struct window *w, struct fb_rect *out) {
+    if (w->state == WM_STATE_MINIMIZED || w->w <= 0 || w->h <= 0) return 0;
+    out->x = w->x; out->y = w->y; out->w = w->w; out->h = w->h;
+    return 1;
+}
+
+/* Visible part of `area` given the windows stack[0..above) on top of it */
+static void wm_visible_region(const struct fb_rect *area, struct window **stack, int above, struct wm_region *rg) {
+    struct fb_rect screen = { 0, 0, screen_w, screen_h };
+    struct fb_rect taskbar = { 0, screen_h - taskbar_h, screen_w, taskbar_h };
+    rg->n = wm_rect_intersect(area, &screen, &rg->r[0]);
+    if (rg->n) wm_region_subtract(rg, &taskbar);
+    for (int i = 0; i < above && rg->n; i++) {
+        struct fb_rect r;
+        if (wm_window_rect(stack[i], &r)) wm_region_subtract(rg, &r);
+    }
+}
+
+static int frame_windows_drawn = 0;
+static int frame_windows_culled = 0;
+
+void wm_get_frame_stats(int *drawn, int *culled) {
+    if (drawn) *drawn = frame_windows_drawn;
+    if (culled) *culled = frame_windows_culled;
+}
+
+static void wm_draw_window(struct window *w) {
+    uint32_t border_color = (w == focused_window) ? 0xFFFFFF00 : 0xFF444488;
+    fb_draw_rect_outline(w->x, w->y, w->w, w->h, border_color, 2);
+    if (w->state != WM_STATE_FULLSCREEN) {
+        uint32_t title_color = (w == focused_window) ? 0xFF00AA00 : 0xFF2222BB;
+        fb_draw_rect(w->x + 2, w->y + 2, w->w - 4, 20, title_color);
+        fb_draw_text(w->x + 8, w->y + 4, w->name, 0xFFFFFFFF, 2);
+        fb_draw_rect(w->x + w->w - 22, w->y + 2, 20, 20, 0xFFFF0000);
+        fb_draw_text(w->x + w->w - 16, w->y + 4, "X", 0xFFFFFFFF, 2);
+        /* Maximize ([]) */
+        fb_draw_rect(w->x + w->w - 42, w->y + 2, 20, 20, 0xFF00AA00);
+        fb_draw_rect_outline(w->x + w->w - 38, w->y + 6, 12, 12, 0xFFFFFFFF, 1);
+        /* Minimize (_) */
+        fb_draw_rect(w->x + w->w - 62, w->y + 2, 20, 20, 0xFFAAAA00);
+        fb_draw_hline(w->x + w->w - 58, w->x + w->w - 46, w->y + 16, 0xFFFFFFFF);
+    }
+    int content_y = (w->state == WM_STATE_FULLSCREEN) ? w->y + 2 : w->y + 22;
+    int content_h = (w->state == WM_STATE_FULLSCREEN) ? w->h - 4 : w->h - 24;
+    fb_draw_rect(w->x + 2, content_y, w->w - 4, content_h, 0xFF000000);
+    if (w->render) w->render(w);
+    if (w->lat_stamp) {
+        lat_record(LAT_KEY_RENDER, timer_get_ticks() - w->lat_popped);
+        lat_frame_key(w->lat_stamp);
+        w->lat_stamp = 0;
+    }
+}
+
 void wm_compose(void) {
     if (!fb_is_init()) return;
+    uint64_t t_compose = timer_get_ticks();
     // uart_puts("[wm] wm_compose start\n");
 
     /* 1. ALWAYS pop all mouse events to keep the queue healthy and detect clicks.
      * Note: coordinate updates are now handled in the input driver. */
     struct input_event ev;
     while (input_pop_mouse_event(&ev)) {
+        if (ev.stamp) {
+            lat_record(LAT_MOUSE_QUEUE, timer_get_ticks() - ev.stamp);
+            lat_frame_mouse(ev.stamp);
+        }
         if (ev.type == INPUT_TYPE_MOUSE_BTN) {
             if (ev.code == 0x110 && ev.value) { // Left Button Pressed
                 wm_handle_clicks(1);
@@ -466,6 +590,8 @@ void wm_compose(void) {
     /* 2. Process keyboard events and distribute to focus */
     struct input_event kev;
     while (input_pop_key_event(&kev)) {
+        uint64_t t_wm = timer_get_ticks();
+        if (kev.stamp) lat_record(LAT_KEY_QUEUE, t_wm - kev.stamp);
         /* INTERCEPT META KEY (Scan Code 125) */
         if (kev.type == INPUT_TYPE_KEY && kev.code == 125 && kev.value == 1) {
             myra_app_toggle();
@@ -473,14 +599,10 @@ void wm_compose(void) {
         }
 
         if (focused_window) {
-            wm_lock_window(focused_window);
-            int next_head = (focused_window->input_head + 1) % WM_INPUT_QUEUE_SIZE;
-            if (next_head != focused_window->input_tail) {
-                focused_window->input_queue[focused_window->input_head].type = kev.type;
-                focused_window->input_queue[focused_window->input_head].code = kev.code;
-                focused_window->input_queue[focused_window->input_head].value = kev.value;
-                focused_window->input_head = next_head;
+            struct wm_input_event wev = { kev.type, kev.code, kev.value, kev.stamp, t_wm };
+            if (ring_push(&focused_window->input, &wev)) {
                 focused_window->is_dirty = 1;
+                waitable_notify(&focused_window->input_w);
                 
                 /* TTY Streaming: if window has a tty, push ASCII directly */
                 if (focused_window->tty && kev.type == INPUT_TYPE_KEY) {
@@ -511,7 +633,6 @@ void wm_compose(void) {
                     }
                 }
             }
-            wm_unlock_window(focused_window);
         }
     }
 
@@ -530,7 +651,10 @@ void wm_compose(void) {
         w_ptr = w_ptr->next;
     }
     
-    if (!any_dirty && !mouse_moved) return;
+    if (!any_dirty && !mouse_moved) {
+        lat_frame_discard();
+        return;
+    }
     
     /* 5. Perform the Draw */
     if (any_dirty) {
@@ -541,15 +665,7 @@ void wm_compose(void) {
             w_reset = w_reset->next;
         }
 
-        /* Desktop background */
-        if (wallpaper_buf) {
-            fb_draw_bitmap_scaled(0, 0, screen_w, screen_h, wallpaper_buf, wallpaper_w, wallpaper_h, 0, 0, screen_w, screen_h);
-        } else {
-            /* Fallback: Steel Blue */
-            fb_draw_rect(0, 0, screen_w, screen_h, 0xFF4682B4);
-        }
-
-    /* Draw windows back to front */
+    /* Top-first snapshot of the stack (window_list is front to back) */
     struct window *stack[16];
     int count = 0;
     wm_list_lock();
@@ -559,31 +675,39 @@ void wm_compose(void) {
         curr = curr->next;
     }
     wm_list_unlock();
-    
+
+    /* Desktop background: only what no window covers */
+    struct wm_region rg;
+    struct fb_rect full = { 0, 0, screen_w, screen_h };
+    wm_visible_region(&full, stack, count, &rg);
+    if (rg.n) {
+        fb_set_clip(rg.r, rg.n);
+        if (wallpaper_buf && wallpaper_w == screen_w && wallpaper_h == screen_h) {
+            /* pre-scaled wallpaper: straight copy (DMA on REAL) */
+            fb_blit(0, 0, screen_w, screen_h, wallpaper_buf, wallpaper_w);
+        } else if (wallpaper_buf) {
+            fb_draw_bitmap_scaled(0, 0, screen_w, screen_h, wallpaper_buf, wallpaper_w, wallpaper_h, 0, 0, screen_w, screen_h);
+        } else {
+            /* Fallback: Steel Blue */
+            fb_draw_rect(0, 0, screen_w, screen_h, 0xFF4682B4);
+        }
+    }
+
+    /* Draw windows back to front, each clipped to its visible region;
+     * fully covered windows are skipped, render callback included. */
+    frame_windows_drawn = 0;
+    frame_windows_culled = 0;
     for (int i = count - 1; i >= 0; i--) {
         struct window *w = stack[i];
-        if (w->state != WM_STATE_MINIMIZED) {
-            uint32_t border_color = (w == focused_window) ? 0xFFFFFF00 : 0xFF444488;
-            fb_draw_rect_outline(w->x, w->y, w->w, w->h, border_color, 2);
-            if (w->state != WM_STATE_FULLSCREEN) {
-                uint32_t title_color = (w == focused_window) ? 0xFF00AA00 : 0xFF2222BB;
-                fb_draw_rect(w->x + 2, w->y + 2, w->w - 4, 20, title_color);
-                fb_draw_text(w->x + 8, w->y + 4, w->name, 0xFFFFFFFF, 2);
-                fb_draw_rect(w->x + w->w - 22, w->y + 2, 20, 20, 0xFFFF0000);
-                fb_draw_text(w->x + w->w - 16, w->y + 4, "X", 0xFFFFFFFF, 2);
-                /* Maximize ([]) */
-                fb_draw_rect(w->x + w->w - 42, w->y + 2, 20, 20, 0xFF00AA00);
-                fb_draw_rect_outline(w->x + w->w - 38, w->y + 6, 12, 12, 0xFFFFFFFF, 1);
-                /* Minimize (_) */
-                fb_draw_rect(w->x + w->w - 62, w->y + 2, 20, 20, 0xFFAAAA00);
-                fb_draw_hline(w->x + w->w - 58, w->x + w->w - 46, w->y + 16, 0xFFFFFFFF);
-            }
-            int content_y = (w->state == WM_STATE_FULLSCREEN) ? w->y + 2 : w->y + 22;
-            int content_h = (w->state == WM_STATE_FULLSCREEN) ? w->h - 4 : w->h - 24;
-            fb_draw_rect(w->x + 2, content_y, w->w - 4, content_h, 0xFF000000);
-            if (w->render) w->render(w);
-        }
+        struct fb_rect wr;
+        if (!wm_window_rect(w, &wr)) continue;
+        wm_visible_region(&wr, stack, i, &rg);
+        if (!rg.n) { frame_windows_culled++; continue; }
+        fb_set_clip(rg.r, rg.n);
+        wm_draw_window(w);
+        frame_windows_drawn++;
     }
+    fb_clear_clip();
 
     draw_taskbar();
     
@@ -598,17 +722,21 @@ void wm_compose(void) {
     draw_cursor_overlay(mx, my);
     wm_last_mx = mx; wm_last_my = my;
     
+    uint64_t t_flush = lat_flush_begin();
 #ifdef REAL
     rpi_gpu_flush();
 #else
     virtio_gpu_flush();
 #endif
+    lat_flush_end(t_flush);
+    inrec_frame(t_compose);
 } else if (mouse_moved) {
     /* Only mouse moved - optimized sprite update */
     restore_bg();
     save_bg(mx, my);
     draw_cursor_overlay(mx, my);
     
+    uint64_t t_flush = lat_flush_begin();
 #ifdef REAL
     /* Real hardware: flush only the cursor regions for speed */
     rpi_gpu_flush_rect(wm_last_mx, wm_last_my, CURSOR_W, CURSOR_H);
@@ -617,6 +745,8 @@ void wm_compose(void) {
     /* VM: full flush is more reliable and actually faster (1 cmd vs 2) */
     virtio_gpu_flush();
 #endif
+    lat_flush_end(t_flush);
+    inrec_frame(t_compose);
 
     wm_last_mx = mx; wm_last_my = my;
 }
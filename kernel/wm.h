@@ -2,6 +2,8 @@
 #define WM_H
 
 #include <stdint.h>
+#include "ring.h"
+#include "poll.h"
 struct pty;
 
 #define WM_WINDOW_NAME_MAX 32
@@ -19,6 +21,8 @@ struct wm_input_event {
     uint16_t type;
     uint16_t code;
     int32_t value;
+    uint64_t stamp;     /* arrival, from struct input_event */
+    uint64_t t_wm;      /* when the wm queued it for the window */
 };
 
 struct window {
@@ -35,11 +39,16 @@ struct window {
     struct window *next;
     struct pty *tty;
     
-    /* Input stream for this window */
+    /* Input stream for this window: filled by the wm task, drained by the
+     * window's app task */
     struct wm_input_event input_queue[WM_INPUT_QUEUE_SIZE];
-    int input_head, input_tail;
-    volatile int input_lock;
+    struct ring input;
+    struct waitable input_w;    /* POLLIN while input is queued */
     int is_dirty;
+    /* Oldest input the app has consumed since the last render, and when
+     * it last consumed some (latency.h); 0 when nothing is pending */
+    uint64_t lat_stamp;
+    uint64_t lat_popped;
 };
 
 void wm_init(void);
@@ -61,5 +70,7 @@ int wm_is_focused(struct window *win);
 int wm_pop_key_event(struct window *win, struct wm_input_event *ev);
 void wm_start_task(void);
 void wm_request_redraw(void);
+/* Windows painted / skipped as fully occluded in the last full compose */
+void wm_get_frame_stats(int *drawn, int *culled);
 
 #endif
@@ -1,6 +1,8 @@
 import struct
 import os
 
+from asset_pipeline import collect_assets
+
 # Configuration
 DISK_SIZE = 16 * 1024 * 1024  # 16 MB
 SECTOR_SIZE = 512
@@ -16,38 +18,31 @@ def main():
     data_blob = bytearray()
     
     print(f"Scanning directory: {ASSETS_DIR}")
-    if os.path.exists(ASSETS_DIR):
-        files = os.listdir(ASSETS_DIR)
-        print(f"Found {len(files)} files/folders.")
-        for fname in files:
-            fpath = os.path.join(ASSETS_DIR, fname)
-            if os.path.isfile(fpath):
-                dest_name = TARGET_PREFIX + fname
-                print(f"  Adding: {dest_name}")
-                if len(dest_name) >= 64:
-                    print(f"    Warning: Filename too long, skipping: {dest_name}")
-                    continue
-                
-                with open(fpath, 'rb') as f:
-                    content = f.read()
-                
-                size = len(content)
-                start_sector = current_sector
-                
-                entries.append({
-                    "name": dest_name,
-                    "size": size,
-                    "start": start_sector
-                })
-                
-                # Append data and pad to sector boundary
-                data_blob.extend(content)
-                padding = (SECTOR_SIZE - (len(content) % SECTOR_SIZE)) % SECTOR_SIZE
-                data_blob.extend(b'\0' * padding)
-                
-                sectors_used = (len(content) + SECTOR_SIZE - 1) // SECTOR_SIZE
-                current_sector += sectors_used
-    
+    # PNGs are also converted to QOI (and pre-scaled) by the asset pipeline
+    for fname, content in collect_assets(ASSETS_DIR):
+        dest_name = TARGET_PREFIX + fname
+        print(f"  Adding: {dest_name}")
+        if len(dest_name) >= 64:
+            print(f"    Warning: Filename too long, skipping: {dest_name}")
+            continue
+
+        size = len(content)
+        start_sector = current_sector
+
+        entries.append({
+            "name": dest_name,
+            "size": size,
+            "start": start_sector
+        })
+
+        # Append data and pad to sector boundary
+        data_blob.extend(content)
+        padding = (SECTOR_SIZE - (len(content) % SECTOR_SIZE)) % SECTOR_SIZE
+        data_blob.extend(b'\0' * padding)
+
+        sectors_used = (len(content) + SECTOR_SIZE - 1) // SECTOR_SIZE
+        current_sector += sectors_used
+
     disk_img = bytearray(DISK_SIZE)
     
     # Write Directory Table
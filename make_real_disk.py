@@ -20,6 +20,8 @@ import shutil
 import struct
 import subprocess
 
+from asset_pipeline import collect_assets
+
 # ── Config ───────────────────────────────────────────────────────────
 BOOT_DIR       = "outputs\\boot"
 ASSETS_DIR     = "assets"
@@ -242,16 +244,12 @@ def build_disk_image():
     print(f"\n[diskfs] Scanning: {ASSETS_DIR}")
     if os.path.exists(ASSETS_DIR):
         TARGET_PREFIX = "/system/assets/"
-        for fname in sorted(os.listdir(ASSETS_DIR)):
-            fpath = os.path.join(ASSETS_DIR, fname)
-            if not os.path.isfile(fpath):
-                continue
+        # PNGs are also converted to QOI (and pre-scaled) by the asset pipeline
+        for fname, content in collect_assets(ASSETS_DIR):
             dest = TARGET_PREFIX + fname
             if len(dest) >= 64:
                 print(f"  skip (name too long): {dest}")
                 continue
-            with open(fpath, "rb") as f:
-                content = f.read()
             entries.append({"name": dest, "size": len(content), "start": current_sector})
             data_blob.extend(content)
             pad = (SECTOR_SIZE - (len(content) % SECTOR_SIZE)) % SECTOR_SIZE